@@ -25,6 +25,13 @@ message(STATUS "Using qicc: ${QICC_EXECUTABLE}")
 # \flag:NOREMOTE    do not generate remote file
 # \group:FLAGS      flags to pass to qicc
 #
+# The outputs are built by the target qi_gen_idl_files_${pkg}, by a single
+# qicc run. Breaking change: a target using them (the library compiling
+# the generated files...) must now
+#   add_dependencies(<target> qi_gen_idl_files_${pkg})
+# or, with the Makefile generators, qicc runs for it concurrently with the
+# qi_gen_idl_files_${pkg} target. qi_gen_lib does it for its library.
+#
 # This function will set three variables:
 # - ${OUT}_INTERFACE which contains the interfaces of your classes
 # - ${OUT}_LOCAL which is the implementation of the interfaces as local
@@ -65,17 +72,32 @@ function(qi_gen_idl OUT lang pkg dir)
       ${copy_idl_file_target} ALL
       COMMAND ${CMAKE_COMMAND} -E copy_if_different "${abs_idl_path}" "${staged_idl_path}"
     )
+    list(APPEND _copy_idl_file_targets ${copy_idl_file_target})
 
     # each idl file shall be installed in the sdk
     qi_install_data("${rel_idl_path}" SUBFOLDER "qi/idl")
 
+    # every output of the package is generated by a single qicc run,
+    # which parses and analyses the imported packages once:
+    #   qicc <idl> -g codegen:output... <idl> -g codegen:output...
+    list(APPEND _qicc_args "${staged_idl_path}")
+    list(APPEND _idl_paths "${abs_idl_path}")
+    list(APPEND _qicc_depends "${abs_idl_path}" "${staged_idl_path}" ${copy_idl_file_target})
+
+    # with its binary AST, loaded by qicc instead of parsing the idl file
+    # when it imports the package (ignored when out of date)
+    set(staged_ast_path "${staged_idl_path}.ast")
+    list(APPEND _qicc_args -g "ast:${staged_ast_path}")
+    list(APPEND _qicc_outputs "${staged_ast_path}")
+    install(FILES "${staged_ast_path}"
+      DESTINATION "${QI_SDK_SHARE}/qi/idl/${package_and_subpackage}"
+      COMPONENT data
+      OPTIONAL)
+
     if(NOT ARG_NOINTERFACE)
       set(generated_path "${abs_gen_dest_dir}/${package_and_subpackage}/${dest_basename}.hpp")
-      qi_generate_src("${generated_path}"
-        SRC "${abs_idl_path}"
-        COMMENT "Generating interface ${generated_path}"
-        DEPENDS "${QICC_EXECUTABLE}" "${staged_idl_path}" ${copy_idl_file_target}
-        COMMAND "${QICC_EXECUTABLE}" -c cpp_interface "${staged_idl_path}" -o "${generated_path}" -t ${QI_SDK_DIR})
+      list(APPEND _qicc_args -g "cpp_interface:${generated_path}")
+      list(APPEND _qicc_outputs "${generated_path}")
       list(APPEND _out "${generated_path}")
       list(APPEND _${OUT}_INTERFACE "${generated_path}")
       message(STATUS "Will generate C++ interface header: ${generated_path}")
@@ -83,11 +105,8 @@ function(qi_gen_idl OUT lang pkg dir)
 
     if(NOT ARG_NOLOCAL)
       set(generated_path "${abs_gen_dest_dir}/src/${maybe_subpackage}${dest_basename}_p.hpp")
-      qi_generate_src(${generated_path}
-        SRC "${abs_idl_path}"
-        COMMENT "Generating local ${generated_path}"
-        DEPENDS "${QICC_EXECUTABLE}" "${staged_idl_path}" ${copy_idl_file_target}
-        COMMAND "${QICC_EXECUTABLE}" -c cpp_local "${staged_idl_path}" -o "${generated_path}" -t ${QI_SDK_DIR})
+      list(APPEND _qicc_args -g "cpp_local:${generated_path}")
+      list(APPEND _qicc_outputs "${generated_path}")
       list(APPEND _out "${generated_path}")
       list(APPEND _${OUT}_LOCAL "${generated_path}")
       message(STATUS "Will generate C++ private header: ${generated_path}")
@@ -95,17 +114,55 @@ function(qi_gen_idl OUT lang pkg dir)
 
     if(NOT ARG_NOREMOTE)
       set(generated_path "${abs_gen_dest_dir}/src/${subpackage}/${dest_basename}remote.cpp")
-      qi_generate_src("${generated_path}"
-        SRC "${abs_idl_path}"
-        COMMENT "Generating remote ${generated_path}"
-        DEPENDS "${QICC_EXECUTABLE}" "${staged_idl_path}" ${copy_idl_file_target}
-        COMMAND "${QICC_EXECUTABLE}" -c cpp_remote "${staged_idl_path}" -o "${generated_path}" -t ${QI_SDK_DIR})
+      list(APPEND _qicc_args -g "cpp_remote:${generated_path}")
+      list(APPEND _qicc_outputs "${generated_path}")
       list(APPEND _out "${generated_path}")
       list(APPEND _${OUT}_REMOTE "${generated_path}")
       message(STATUS "Will generate C++ proxy implementation: ${generated_path}")
     endif()
   endforeach()
 
+  string(MAKE_C_IDENTIFIER "${pkg}" _pkg_id)
+
+  if(_qicc_outputs)
+    # qicc does not touch generated files whose content did not change:
+    # the stamp, touched by every run, tells the build tool when it ran.
+    # Make then runs qicc again only when an input changed (and touches all
+    # the outputs), Ninja (restat) also skips the compilation of the outputs
+    # that did not change.
+    set(_qicc_stamp "${CMAKE_CURRENT_BINARY_DIR}/qi_gen_idl_${_pkg_id}.stamp")
+    list(APPEND _qicc_args --stamp "${_qicc_stamp}")
+
+    # qicc lists every IDL file it read, those of the imported packages
+    # included, in a depfile naming the stamp (only Ninja reads them before
+    # CMake 3.20).
+    set(_qicc_depfile_args)
+    if(NOT CMAKE_VERSION VERSION_LESS 3.20 OR
+       (CMAKE_GENERATOR MATCHES "Ninja" AND NOT CMAKE_VERSION VERSION_LESS 3.7))
+      set(_qicc_depfile "${CMAKE_CURRENT_BINARY_DIR}/qi_gen_idl_${_pkg_id}.d")
+      set(_qicc_depfile_args DEPFILE "${_qicc_depfile}")
+      list(APPEND _qicc_args --depfile "${_qicc_depfile}")
+    endif()
+
+    # with QICC_CACHE, the outputs of a run done before, in any build
+    # directory, are taken from the output cache of qicc (see qicc --cache)
+    if(QICC_CACHE)
+      list(APPEND _qicc_args --cache)
+    endif()
+
+    set_source_files_properties(${_qicc_outputs} PROPERTIES GENERATED TRUE)
+    add_custom_command(
+      OUTPUT "${_qicc_stamp}" ${_qicc_outputs}
+      COMMENT "Generating C++ files of ${pkg}"
+      DEPENDS "${QICC_EXECUTABLE}" ${_qicc_depends}
+      ${_qicc_depfile_args}
+      COMMAND "${QICC_EXECUTABLE}" ${_qicc_args} -t ${QI_SDK_DIR})
+  endif()
+
+  # the only target listing the outputs: with the Makefile generators, the
+  # command would run concurrently for each independent target listing them
+  add_custom_target(qi_gen_idl_files_${pkg} ALL DEPENDS ${_qicc_stamp} ${_qicc_outputs})
+
   # Bounce out variables
   set(${OUT} ${_out} PARENT_SCOPE)
   if(NOT ARG_NOINTERFACE)
@@ -121,6 +178,45 @@ function(qi_gen_idl OUT lang pkg dir)
   # This target is only useful for qilang unit tests.
   # It makes possible to add dependencies to qicc target.
   add_custom_target(qi_gen_idl_${pkg})
+  add_dependencies(qi_gen_idl_files_${pkg} qi_gen_idl_${pkg})
+
+  # summarize and index the IDL trees of the SDK and of the install prefix
+  # once the files are there: qicc locates packages without walking them and
+  # loads the exports of imported packages without parsing them (it walks and
+  # parses when a summary or the index is missing or out of date).
+  # A single qi_gen_idl_index target indexes the SDK for every package, when
+  # the IDL files of one of them changed; only the packages whose files
+  # changed are parsed again.
+  if(NOT TARGET qi_gen_idl_index)
+    set(_qicc_index_stamp "${CMAKE_BINARY_DIR}/qi_gen_idl_index.stamp")
+    add_custom_command(
+      OUTPUT "${_qicc_index_stamp}"
+      COMMENT "Indexing IDL files of ${QI_SDK_DIR}"
+      DEPENDS "${QICC_EXECUTABLE}" "$<TARGET_PROPERTY:qi_gen_idl_index,QI_GEN_IDL_FILES>"
+      COMMAND "${QICC_EXECUTABLE}" --write-package-summaries "${QI_SDK_DIR}" --write-package-index "${QI_SDK_DIR}"
+      COMMAND "${CMAKE_COMMAND}" -E touch "${_qicc_index_stamp}")
+    add_custom_target(qi_gen_idl_index ALL DEPENDS "${_qicc_index_stamp}")
+  endif()
+  set_property(TARGET qi_gen_idl_index APPEND PROPERTY QI_GEN_IDL_FILES ${_idl_paths})
+  add_dependencies(qi_gen_idl_index qi_gen_idl_files_${pkg} ${_copy_idl_file_targets})
+
+  # the same at install time, once, by the install code of the last package
+  # installed: the install code of each package counts them
+  set_property(GLOBAL APPEND PROPERTY QI_GEN_IDL_PACKAGES ${pkg})
+  get_property(_qicc_packages GLOBAL PROPERTY QI_GEN_IDL_PACKAGES)
+  list(LENGTH _qicc_packages _qicc_package_count)
+  set(_qicc_install_count "${CMAKE_BINARY_DIR}/qi_gen_idl_index_install.cmake")
+  file(WRITE "${_qicc_install_count}" "set(_qi_gen_idl_packages ${_qicc_package_count})\n")
+  install(CODE
+    "include(\"${_qicc_install_count}\")
+    if(NOT DEFINED _qi_gen_idl_installed)
+      set(_qi_gen_idl_installed 0)
+    endif()
+    math(EXPR _qi_gen_idl_installed \"\${_qi_gen_idl_installed} + 1\")
+    if(_qi_gen_idl_installed EQUAL _qi_gen_idl_packages)
+      execute_process(COMMAND \"${QICC_EXECUTABLE}\" --write-package-summaries \"\$ENV{DESTDIR}\${CMAKE_INSTALL_PREFIX}\" --write-package-index \"\$ENV{DESTDIR}\${CMAKE_INSTALL_PREFIX}\")
+    endif()"
+    COMPONENT data)
 endfunction()
 
 #! Generate C++ files and create a shared library out of them.
@@ -167,6 +263,7 @@ function(qi_gen_lib package destination)
     qi
     ${ARG_DEPENDS}
   )
+  add_dependencies(${package} qi_gen_idl_files_${package})
 
   get_filename_component(header_dir "${ARG_API_HEADER}" DIRECTORY)
 
@@ -0,0 +1,116 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_ARENA_HPP
+#define QILANG_ARENA_HPP
+
+#include <qilang/api.hpp>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+namespace qilang {
+
+  /** Bump allocator owning the nodes of a ParseResult.
+   *
+   * Memory is carved out of big chunks, deallocation is a no-op and
+   * everything is released at once when the arena is destroyed.
+   * Not thread safe: one arena is used by one Parser.
+   */
+  class QILANG_API NodeArena : private boost::noncopyable {
+  public:
+    explicit NodeArena(std::size_t firstChunkSize = 4096);
+    ~NodeArena();
+
+    void* allocate(std::size_t size, std::size_t align);
+
+    //! size the first chunk, up to the largest chunk size (no-op once something has been allocated)
+    void reserve(std::size_t size);
+
+    std::size_t usedBytes() const  { return _used; }
+    std::size_t chunkCount() const { return _chunks.size(); }
+
+  private:
+    void newChunk(std::size_t minSize);
+
+    std::vector<char*> _chunks;
+    char*              _cur;
+    char*              _end;
+    std::size_t        _nextChunkSize;
+    std::size_t        _used;
+  };
+
+  typedef boost::shared_ptr<NodeArena> NodeArenaPtr;
+
+  inline NodeArenaPtr newNodeArena() { return boost::make_shared<NodeArena>(); }
+
+  /** Allocator used with boost::allocate_shared to put nodes into a NodeArena.
+   *
+   * Each allocator (and so each node control block) keeps a reference on the
+   * arena: nodes stay valid after the ParseResult that created them is gone.
+   */
+  template <typename T>
+  class NodeAllocator {
+  public:
+    typedef T              value_type;
+    typedef T*             pointer;
+    typedef const T*       const_pointer;
+    typedef T&             reference;
+    typedef const T&       const_reference;
+    typedef std::size_t    size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind { typedef NodeAllocator<U> other; };
+
+    explicit NodeAllocator(const NodeArenaPtr& arena)
+      : _arena(arena)
+    {}
+
+    template <typename U>
+    NodeAllocator(const NodeAllocator<U>& other)
+      : _arena(other.arena())
+    {}
+
+    pointer allocate(size_type n, const void* = 0) {
+      return static_cast<pointer>(_arena->allocate(n * sizeof(T), boost::alignment_of<T>::value));
+    }
+
+    //released with the arena
+    void deallocate(pointer, size_type) {}
+
+    size_type max_size() const { return std::numeric_limits<size_type>::max() / sizeof(T); }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template <typename U>
+    void destroy(U* p) { p->~U(); }
+
+    pointer       address(reference x) const       { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    const NodeArenaPtr& arena() const { return _arena; }
+
+  private:
+    NodeArenaPtr _arena;
+  };
+
+  template <typename T, typename U>
+  inline bool operator==(const NodeAllocator<T>& a, const NodeAllocator<U>& b) { return a.arena() == b.arena(); }
+  template <typename T, typename U>
+  inline bool operator!=(const NodeAllocator<T>& a, const NodeAllocator<U>& b) { return a.arena() != b.arena(); }
+
+}
+
+#endif // QILANG_ARENA_HPP
@@ -0,0 +1,203 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_ASTFILE_HPP
+#define QILANG_ASTFILE_HPP
+
+#include <qilang/api.hpp>
+#include <qilang/node.hpp>
+#include <qilang/parser.hpp>
+#include <qi/types.hpp>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace qilang {
+
+  /* Binary AST format
+   * =================
+   *
+   * A file is made of five sections, all native endian and 8 bytes aligned:
+   *
+   *   AstFileHeader
+   *   AstNodeRecord[nodeCount]      nodes in pre-order, the toplevel ones first in their range
+   *   qi::uint32_t[refCount]        child node indexes and string list indexes, referenced by ranges
+   *   AstStringRecord[stringCount]  (offset, size) in the blob
+   *   char[stringBytes]             blob of NUL terminated strings
+   *
+   * Records only contain integers, the file can be mmap'ed and read in place.
+   * A child index is always greater than the index of its parent. Optional
+   * children are AstNoIndex. The header stores the size and a hash of the
+   * source it was built from, so that a stale file can be detected.
+   *
+   * Bump AstFileVersion on any layout or semantic change.
+   */
+
+  static const qi::uint32_t AstFileVersion   = 1;
+  static const qi::uint32_t AstFileByteOrder = 0x01020304;
+  static const qi::uint32_t AstNoIndex       = 0xFFFFFFFF;
+
+  //! concrete node class of a record
+  enum AstNodeTag {
+    AstNodeTag_None = 0,
+
+    AstNodeTag_BinaryOpExpr,    // sub: op                 children: left right
+    AstNodeTag_UnaryOpExpr,     // sub: op                 children: expr
+    AstNodeTag_VarExpr,         // name: value
+    AstNodeTag_LiteralExpr,     //                         children: data
+    AstNodeTag_CallExpr,        // name                    children: args...
+
+    AstNodeTag_BoolLiteral,     // value
+    AstNodeTag_IntLiteral,      // value
+    AstNodeTag_FloatLiteral,    // value: the double bits
+    AstNodeTag_StringLiteral,   // str: value
+    AstNodeTag_ListLiteral,     //                         children: values...
+    AstNodeTag_TupleLiteral,    //                         children: values...
+    AstNodeTag_DictLiteral,     //                         children: key0 value0 key1 value1...
+
+    AstNodeTag_BuiltinTypeExpr, // sub: builtinType, str: value
+    AstNodeTag_CustomTypeExpr,  // str: value
+    AstNodeTag_ListTypeExpr,    //                         children: element
+    AstNodeTag_MapTypeExpr,     //                         children: key value
+    AstNodeTag_TupleTypeExpr,   //                         children: elements...
+    AstNodeTag_VarArgTypeExpr,  //                         children: element?
+    AstNodeTag_KeywordArgTypeExpr, //                      children: value?
+
+    AstNodeTag_Package,         // name
+    AstNodeTag_Import,          // sub: importType, name   list: imports
+    AstNodeTag_VarDef,          // name                    children: type? data?
+    AstNodeTag_ObjectDef,       // name                    children: type values...
+    AstNodeTag_PropertyDef,     // name                    children: data
+    AstNodeTag_At,              // str: receiver           children: sender
+
+    AstNodeTag_TypeDefDecl,     // name                    children: type
+    AstNodeTag_EnumDecl,        // name                    children: fields...
+    AstNodeTag_EnumFieldDecl,   // sub: fieldType          children: node
+    AstNodeTag_StructDecl,      // name, str: package      children: decls...  list: inherits
+    AstNodeTag_StructFieldDecl, //                         children: type?     list: names
+    AstNodeTag_InterfaceDecl,   // name                    children: values... list: inherits
+    AstNodeTag_FnDecl,          // name                    children: ret? args...
+    AstNodeTag_ParamFieldDecl,  // sub: paramType          children: type?     list: names
+    AstNodeTag_SigDecl,         // name                    children: args...
+    AstNodeTag_PropDecl,        // name                    children: args...
+    AstNodeTag_ConstDecl,       // name                    children: type? data?
+
+    AstNodeTag_Count
+  };
+
+  struct AstFileHeader {
+    char         magic[8];      // "QILAST\n"
+    qi::uint32_t version;       // AstFileVersion
+    qi::uint32_t byteOrder;     // AstFileByteOrder as written
+    qi::uint64_t sourceSize;
+    qi::uint64_t sourceHash;
+    qi::uint32_t nodeCount;
+    qi::uint32_t refCount;
+    qi::uint32_t stringCount;
+    qi::uint32_t stringBytes;
+    qi::uint32_t rootBegin;     // range of the toplevel nodes in refs
+    qi::uint32_t rootCount;
+    qi::uint32_t nodesOffset;   // byte offsets of the sections
+    qi::uint32_t refsOffset;
+    qi::uint32_t stringsOffset;
+    qi::uint32_t blobOffset;
+  };
+
+  struct AstNodeRecord {
+    qi::uint64_t value;         // bool/int/float payload
+    qi::uint32_t tag;           // AstNodeTag
+    qi::uint32_t sub;           // op, builtin type, import/param/enum field type
+    qi::uint32_t name;          // string index or AstNoIndex
+    qi::uint32_t str;           // string index or AstNoIndex
+    qi::uint32_t comment;       // string index or AstNoIndex
+    qi::uint32_t childBegin;    // range of child node indexes in refs
+    qi::uint32_t childCount;
+    qi::uint32_t listBegin;     // range of string indexes in refs
+    qi::uint32_t listCount;
+    qi::int32_t  begLine;
+    qi::int32_t  begColumn;
+    qi::int32_t  endLine;
+    qi::int32_t  endColumn;
+    qi::uint32_t reserved;
+  };
+
+  struct AstStringRecord {
+    qi::uint32_t offset;        // in the blob
+    qi::uint32_t size;          // without the trailing NUL
+  };
+
+  //! identifies the source an AST was built from
+  struct AstSourceStamp {
+    AstSourceStamp()
+      : size(0)
+      , hash(0)
+    {}
+
+    qi::uint64_t size;
+    qi::uint64_t hash;
+  };
+
+  QILANG_API AstSourceStamp astSourceStamp(const char* data, std::size_t size);
+  //! stamp of a file on disk, false if it can't be read
+  QILANG_API bool astSourceStamp(const std::string& filename, AstSourceStamp* stamp);
+
+  //! name of the binary AST file associated to a source file
+  QILANG_API std::string astFileName(const std::string& source);
+
+  //! serialize an AST. throw std::runtime_error on nodes that can't be serialized
+  QILANG_API std::string serializeAST(const NodePtrVector& ast, const AstSourceStamp& stamp);
+
+  class MappedFile;
+
+  /** Binary AST file, mapped in memory and accessed in place.
+   */
+  class QILANG_API AstFile : private boost::noncopyable {
+  public:
+    AstFile();
+    ~AstFile();
+
+    //! map and validate a file. on failure, error (if set) tells why
+    bool open(const std::string& filename, std::string* error = 0);
+    //! use a buffer owned by the caller (it must outlive the AstFile)
+    bool openBuffer(const char* data, std::size_t size, std::string* error = 0);
+
+    const AstFileHeader&  header() const { return *_header; }
+    qi::uint32_t          nodeCount() const { return _header->nodeCount; }
+    const AstNodeRecord&  node(qi::uint32_t index) const { return _nodes[index]; }
+    //! pointer to count indexes of refs, starting at begin (ranges are validated by open)
+    const qi::uint32_t*   refs(qi::uint32_t begin) const { return _refs + begin; }
+    //! NUL terminated string, size (if set) receives its length
+    const char*           string(qi::uint32_t index, std::size_t* size = 0) const;
+
+    bool matches(const AstSourceStamp& stamp) const;
+
+    /** create the nodes in the arena of pr, locations refer to file.
+     *  throw std::runtime_error on inconsistent records
+     */
+    NodePtrVector toAST(const ParseResultPtr& pr, Symbol file) const;
+
+  private:
+    bool validate(std::string* error);
+
+    boost::shared_ptr<MappedFile> _file;
+    const char*                   _data;
+    std::size_t                   _size;
+    const AstFileHeader*          _header;
+    const AstNodeRecord*          _nodes;
+    const qi::uint32_t*           _refs;
+    const AstStringRecord*        _strings;
+    const char*                   _blob;
+  };
+
+  /** load the binary AST associated to source if it exists, is valid and up to date.
+   *  return an empty pointer otherwise, the source has to be parsed.
+   */
+  QILANG_API ParseResultPtr loadAST(const std::string& source);
+
+}
+
+#endif // QILANG_ASTFILE_HPP
@@ -0,0 +1,51 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_COMMANDLINE_HPP
+#define QILANG_COMMANDLINE_HPP
+
+#include <qilang/api.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace qilang {
+
+  //! a file to generate from an input of qicc
+  struct Generation {
+    std::string codegen;
+    std::string output;   // as given, empty: the output of the run
+  };
+
+  struct Input {
+    std::string             file;
+    std::vector<Generation> generations;
+  };
+
+  typedef std::vector<Input> InputVector;
+
+  //! name and value of an option of the command line
+  typedef std::pair<std::string, std::string> CommandLineOption;
+  typedef std::vector<CommandLineOption>      CommandLineOptionVector;
+
+  /** inputs of qicc, in command line order, with the generations asked for
+   *  them.
+   *
+   *  options are the "inputs" (one file each) and "generate"
+   *  (codegen:output) options, in command line order, others are ignored.
+   *  The -g codegen:output that follow an input apply to it, those given
+   *  before any input apply to the only input. The inputs without -g get
+   *  single (-c and -o), -o is only valid for one of them.
+   *
+   *  @return false if the command line is invalid, error tells why
+   */
+  QILANG_API bool parseInputs(const CommandLineOptionVector& options, const Generation& single,
+                              InputVector* inputs, std::string* error = 0);
+
+}
+
+#endif // QILANG_COMMANDLINE_HPP
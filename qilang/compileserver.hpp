@@ -0,0 +1,207 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_COMPILESERVER_HPP
+#define QILANG_COMPILESERVER_HPP
+
+#include <qilang/api.hpp>
+#include <qilang/node.hpp>
+#include <qilang/packagemanager.hpp>
+#include <qi/types.hpp>
+#include <condition_variable>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace qilang {
+
+  /* Compile server protocol
+   * =======================
+   *
+   * A local stream socket (see CompileServer::defaultSocket), one request per
+   * connection. The client writes its request then shuts down its side, the
+   * server answers and closes the connection. Both are a header line then
+   * fields, each "<size>\n<bytes>":
+   *
+   *   request:  qicc-server <CompileServerVersion>\n kind cwd cache cachedir argc argv...
+   *   response: qicc-server <CompileServerVersion>\n status output
+   *
+   * where kind is "run" or "stop" and cache is "1" or "0". Requests are
+   * answered concurrently (see CompileServer::setJobs): a client has
+   * CompileServerTimeout seconds to send its request, at most
+   * CompileServerMaxRequest bytes, or the connection is dropped.
+   *
+   * Bump CompileServerVersion on any format change.
+   */
+
+  static const unsigned int CompileServerVersion = 2;
+  static const unsigned int CompileServerTimeout = 10;
+  static const std::size_t  CompileServerMaxRequest = 1024 * 1024;
+
+  struct CompileRequest {
+    CompileRequest()
+      : stop(false)
+      , cache(false)
+    {}
+
+    bool         stop;  // stop the server, nothing else
+    std::string  cwd;   // working directory of the client
+    bool         cache; // the environment of the client enables the output cache (QICC_CACHE)
+    std::string  cacheDir; // default output cache directory of the client, absolute
+    StringVector args;  // command line of the client, without the program name
+  };
+
+  struct CompileResponse {
+    CompileResponse()
+      : status(1)
+    {}
+
+    int         status;  // exit status for the client
+    std::string output;  // what the client prints on its standard output
+  };
+
+  /** Package managers kept between the runs of a process, one per include and
+   *  lookup paths. A package manager is given back checked against the files
+   *  it read: changed files are parsed again (only their packages and the
+   *  packages importing them are analysed again), and it is dropped when
+   *  files were added or removed in the directories of its packages.
+   *  The files are not watched, each acquire stats them again.
+   *
+   *  Thread safe. A package manager is used by one run at a time: acquiring
+   *  the package manager of paths another run holds waits for its release
+   *  (or drop), runs with other paths do not wait.
+   */
+  class QILANG_API PackageManagerPool {
+  public:
+    struct Stats {
+      Stats()
+        : acquired(0)
+        , reused(0)
+        , reparsed(0)
+        , dropped(0)
+      {}
+
+      qi::uint64_t acquired;
+      qi::uint64_t reused;    // package managers given back warm
+      qi::uint64_t reparsed;  // files that changed between two runs
+      qi::uint64_t dropped;   // package managers out of date or with errors
+    };
+
+    /** an up to date package manager for these paths (absolute, or relative
+     *  to the working directory), new or warm. It prints the diagnostics of
+     *  the run, those of the changed files included, on diagnostics. It is
+     *  held until release() or drop().
+     */
+    PackageManagerPtr acquire(const StringVector& includes, const StringVector& lookupPaths, unsigned int jobs,
+                              std::ostream& diagnostics = std::cout);
+    /** done with pm: remember the files it read, forget it if it has errors
+     *  (they would fail every run sharing it). Its diagnostics go to
+     *  std::cout again.
+     */
+    void release(const PackageManagerPtr& pm);
+    //! forget pm, a run failed in a way that may have left it inconsistent
+    void drop(const PackageManagerPtr& pm);
+
+    Stats stats() const;
+
+  private:
+    struct FileStamp {
+      FileStamp()
+        : size(0)
+        , mtime(0)
+      {}
+
+      qi::uint64_t size;
+      std::time_t  mtime;
+    };
+
+    struct Workspace {
+      Workspace()
+        : checked(0)
+        , busy(false)
+      {}
+
+      PackageManagerPtr                   pm;
+      std::map<std::string, FileStamp>    files; // the source files read
+      std::map<std::string, std::string>  dirs;  // the .idl.qi files, by directory
+      std::time_t                         checked; // stamps older than this can be trusted
+      bool                                busy;    // acquired by a run
+    };
+    typedef boost::shared_ptr<Workspace> WorkspacePtr;
+    typedef std::map<std::string, WorkspacePtr> WorkspaceMap;
+
+    //! parse the files that changed, ws held. false when ws must be dropped
+    bool refresh(Workspace& ws);
+    //! the workspace of pm, locked
+    WorkspaceMap::iterator find(const PackageManagerPtr& pm);
+    //! forget the workspace held at it, locked
+    void erase(WorkspaceMap::iterator it);
+
+    mutable std::mutex      _mutex;     // the map, the stats and the busy flags
+    std::condition_variable _released;  // a workspace is no longer busy
+    WorkspaceMap _workspaces;  // by include and lookup paths
+    Stats        _stats;
+  };
+
+  /** Server side of the compile server: answers the requests sent on a
+   *  local socket with a handler, on jobs threads. The handler must be
+   *  thread safe.
+   *
+   *  Unix domain sockets: not available on Windows, listen() fails.
+   */
+  class QILANG_API CompileServer : private boost::noncopyable {
+  public:
+    typedef boost::function<CompileResponse (const CompileRequest&)> Handler;
+
+    explicit CompileServer(const std::string& socket);
+    ~CompileServer();
+
+    //! $QICC_SERVER_SOCKET, qicc.sock in $XDG_RUNTIME_DIR, or qicc-<user>.sock in the temporary directory
+    static std::string defaultSocket();
+
+    const std::string& socket() const { return _socket; }
+
+    //! requests answered at once (default: the number of cores)
+    void         setJobs(unsigned int jobs);
+    unsigned int jobs() const { return _jobs; }
+
+    /** create the socket, only accessible by the user. Fails when a server
+     *  already answers on it.
+     */
+    bool listen(std::string* error = 0);
+    /** answer the requests until a stop request, then remove the socket.
+     *  Returns once the requests being answered are done.
+     */
+    void run(const Handler& handler);
+
+  private:
+    //! answer the connections until a stop request, on a thread of run()
+    void serve(const Handler& handler);
+
+    std::string  _socket;
+    int          _fd;
+    int          _wake[2];  // readable once a stop request arrived
+    unsigned int _jobs;
+  };
+
+  /** send a request to the compile server listening on socket. false, with
+   *  error set, when there is no server, it is not run by the user or it
+   *  failed to answer.
+   */
+  QILANG_API bool callCompileServer(const std::string& socket,
+                                    const CompileRequest& request,
+                                    CompileResponse* response,
+                                    std::string* error = 0);
+
+}
+
+#endif // QILANG_COMPILESERVER_HPP
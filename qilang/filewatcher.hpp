@@ -0,0 +1,118 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_FILEWATCHER_HPP
+#define QILANG_FILEWATCHER_HPP
+
+#include <qilang/api.hpp>
+#include <qilang/node.hpp>
+#include <qilang/packagemanager.hpp>
+#include <qi/types.hpp>
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace qilang {
+
+  /** Report the .idl.qi files created, modified or removed in directory trees.
+   *
+   *  Uses inotify on Linux, new subdirectories are watched as they appear.
+   *  Elsewhere, or when inotify is not available, the trees are polled.
+   */
+  class QILANG_API FileWatcher : private boost::noncopyable {
+  public:
+    FileWatcher();
+    ~FileWatcher();
+
+    //! watch dir and its subdirectories. false, with error set, if dir can't be watched
+    bool addTree(const std::string& dir, std::string* error = 0);
+
+    /** wait for changes, up to timeout milliseconds (negative: no limit).
+     *  files are the absolute paths of the files that changed, sorted: the
+     *  changes that follow the first one closely (an editor saving, a
+     *  checkout) are reported together. false on timeout.
+     */
+    bool wait(StringVector* files, int timeout = -1);
+
+    //! true with inotify, false when the trees are polled
+    bool native() const { return _fd >= 0; }
+
+  private:
+    struct FileStamp {
+      FileStamp()
+        : size(0)
+        , mtime(0)
+      {}
+
+      bool operator==(const FileStamp& rhs) const { return size == rhs.size && mtime == rhs.mtime; }
+
+      qi::uint64_t size;
+      std::time_t  mtime;
+    };
+    typedef std::map<std::string, FileStamp> FileStampMap;
+
+    bool addDir(const std::string& dir, std::string* error);
+    //! read the pending inotify events, waiting up to timeout milliseconds
+    bool readEvents(StringVector* files, int timeout);
+    //! watch the directories of the trees again and report all their files (after lost events)
+    void rescan(StringVector* files);
+    //! the .idl.qi files of the trees, when polling
+    FileStampMap scan() const;
+    bool poll(StringVector* files, int timeout);
+
+    int                        _fd;
+    std::map<int, std::string> _watches;  // watch descriptor -> directory
+    StringVector               _trees;
+    FileStampMap               _files;    // as of the last poll
+  };
+
+  /** The inputs of a watch mode run (qicc --watch) and the ones to generate
+   *  again when IDL files change.
+   *
+   *  Changed files are parsed again, or forgotten when removed, by the same
+   *  package manager. The inputs of their packages, and of the packages
+   *  importing them directly or not (PackageGraph::importers, as of the last
+   *  analysis), are pending again. Generating them is up to the caller.
+   */
+  class QILANG_API WatchedInputs {
+  public:
+    typedef std::set<unsigned int> IndexSet;
+
+    //! inputs are absolute paths, all pending
+    WatchedInputs(const PackageManagerPtr& pm, const StringVector& inputs);
+
+    //! indexes of the inputs to generate
+    const IndexSet& pending() const { return _pending; }
+    //! the parse result of input i, parsed if needed (throws when it can't be)
+    ParseResultPtr parseResult(unsigned int i);
+    //! input i was generated
+    void generated(unsigned int i) { _pending.erase(i); }
+    //! generating input i failed with an exception: parse it again next time
+    void failed(unsigned int i) { _prs.at(i).reset(); }
+
+    /** update the package manager and the pending inputs after files
+     *  changed (absolute paths, as FileWatcher::wait reports them).
+     *  Exceptions parsing them are printed on diagnostics.
+     */
+    void changed(const StringVector& files, std::ostream& diagnostics);
+
+  private:
+    bool inKnownDirectory(const std::string& file) const;
+
+    PackageManagerPtr           _pm;
+    StringVector                _inputs;
+    std::vector<ParseResultPtr> _prs;
+    IndexSet                    _pending;
+  };
+
+}
+
+#endif // QILANG_FILEWATCHER_HPP
@@ -0,0 +1,88 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_FLATAST_HPP
+#define QILANG_FLATAST_HPP
+
+#include <qilang/api.hpp>
+#include <qilang/node.hpp>
+#include <qilang/symbol.hpp>
+#include <qi/types.hpp>
+#include <vector>
+
+namespace qilang {
+
+  /** Compact, read-only view of an AST stored as a struct of arrays.
+   *
+   *  Nodes are numbered in pre-order, in the order DefaultNodeVisitor walks
+   *  them, so a linear scan returns the same nodes as findNode. Every node
+   *  keeps a back pointer to its Node, so code can move to the flat arrays
+   *  one query at a time.
+   *
+   *  The descendants of node i are the nodes [i + 1, subtreeEnd(i)), its
+   *  direct children are the indexes children(i)[0..childCount(i)).
+   */
+  class QILANG_API FlatAST {
+  public:
+    typedef qi::uint32_t                Index;
+    typedef std::vector<Index>          IndexVector;
+    static const Index NoIndex = 0xFFFFFFFF;
+
+    FlatAST();
+    explicit FlatAST(const NodePtrVector& ast);
+
+    //! replace the content by a flattened copy of ast
+    void assign(const NodePtrVector& ast);
+    void clear();
+
+    std::size_t size() const  { return _types.size(); }
+    bool        empty() const { return _types.empty(); }
+
+    NodeType        type(Index i) const       { return _types[i]; }
+    NodeKind        kind(Index i) const       { return _kinds[i]; }
+    Index           parent(Index i) const     { return _parents[i]; }
+    Index           subtreeEnd(Index i) const { return _ends[i]; }
+    //! declared name of the node (name, value of a VarExpr or a type expression), empty if none
+    Symbol          name(Index i) const       { return _names[i]; }
+    const Location& loc(Index i) const        { return _locs[i]; }
+    const NodePtr&  node(Index i) const       { return _nodes[i]; }
+
+    Index        childCount(Index i) const { return _childBegins[i + 1] - _childBegins[i]; }
+    const Index* children(Index i) const   { return _children.data() + _childBegins[i]; }
+    Index        child(Index i, Index n) const { return _children[_childBegins[i] + n]; }
+
+    //! toplevel nodes
+    const IndexVector& roots() const { return _roots; }
+
+    //! linear scans, indexes in pre-order
+    IndexVector find(NodeType type) const;
+    IndexVector find(NodeKind kind) const;
+    //! nodes of a given type declaring name
+    IndexVector find(NodeType type, Symbol name) const;
+
+    //! same result as qilang::findNode on the source AST
+    NodePtrVector findNode(NodeType type) const;
+    NodePtrVector findNode(NodeKind kind) const;
+
+  private:
+    friend class FlatASTBuilder;
+
+    std::vector<NodeType> _types;
+    std::vector<NodeKind> _kinds;
+    IndexVector           _parents;
+    IndexVector           _ends;
+    std::vector<Symbol>   _names;
+    std::vector<Location> _locs;
+    NodePtrVector         _nodes;
+    IndexVector           _childBegins;   // size() + 1 entries
+    IndexVector           _children;
+    IndexVector           _roots;
+  };
+
+}
+
+#endif // QILANG_FLATAST_HPP
@@ -10,6 +10,7 @@
 
 #include <qilang/api.hpp>
 #include <qilang/node.hpp>
+#include <qilang/outputbuffer.hpp>
 #include <sstream>
 #include <fstream>
 #include <boost/make_shared.hpp>
@@ -21,33 +22,61 @@ namespace qilang {
   typedef boost::shared_ptr<PackageManager> PackageManagerPtr;
   typedef boost::shared_ptr<ParseResult> ParseResultPtr;
 
+  /** Output of a code generator.
+   *
+   *  The content is kept in an OutputStream the generators write into. A file
+   *  is only written by close() (or the destructor), and only when its
+   *  content changed: unchanged generated headers keep their timestamp and do
+   *  not trigger a rebuild of what includes them. Nothing is written when
+   *  out() is never called. A stream gets the content on close().
+   */
   class QILANG_API FileWriter {
   public:
-    explicit FileWriter(const std::string& filename)
+    explicit FileWriter(const std::string& filename, std::ios::openmode mode = std::ios::out)
       : _filename(filename)
-      , _out(&_fileout)
+      , _stream(0)
+      , _mode(mode)
+      , _used(false)
+      , _written(false)
     {}
 
     explicit FileWriter(std::ostream *out, const std::string& filename)
       : _filename(filename)
-      , _out(out)
+      , _stream(out)
+      , _mode(std::ios::out)
+      , _used(false)
+      , _written(false)
     {}
 
-    bool isOpen()                       { return _out->good(); }
+    ~FileWriter() { close(); }
+
+    bool isOpen()                       { return _stream ? _stream->good() : _buffer.good(); }
     const std::string& filename() const { return _filename; }
-    std::ostream& out() {
-      if (_out == &_fileout && !_fileout.is_open())
-        _fileout.open(_filename.c_str());
-      return *_out;
+    OutputStream& out() {
+      _used = true;
+      return _buffer;
     }
 
+    /** write the content to the stream, or to the file if its content
+     *  changed, atomically. Return false if it can't be written. Does
+     *  nothing on the next calls.
+     */
+    bool close();
+    //! close() wrote the file (false when its content was already there)
+    bool written() const { return _written; }
+    //! content written so far (a copy)
+    std::string str() const { return _buffer.str(); }
+
   protected:
-    std::string   _filename;
-    std::ofstream _fileout;
-    std::ostream* _out;
+    std::string        _filename;
+    OutputStream       _buffer;
+    std::ostream*      _stream;
+    std::ios::openmode _mode;
+    bool               _used;
+    bool               _written;
   };
   typedef boost::shared_ptr<FileWriter> FileWriterPtr;
-  inline FileWriterPtr newFileWriter(const std::string& fname) { return boost::make_shared<FileWriter>(fname); }
+  inline FileWriterPtr newFileWriter(const std::string& fname, std::ios::openmode mode = std::ios::out) { return boost::make_shared<FileWriter>(fname, mode); }
   inline FileWriterPtr newFileWriter(std::ostream* o, const std::string& fname) { return boost::make_shared<FileWriter>(o, fname); }
 
   QILANG_API std::string genCppObjectInterface(const PackageManagerPtr& pm, const ParseResultPtr& nodes);
@@ -65,6 +94,14 @@ namespace qilang {
   QILANG_API std::string genDoc(const NodePtr& node);
   QILANG_API std::string genDoc(const NodePtrVector& node);
 
+  //! the generators above, writing into out instead of returning a string
+  QILANG_API void genCppObjectInterface(OutputStream& out, const PackageManagerPtr& pm, const ParseResultPtr& nodes);
+  QILANG_API void genCppObjectRemote(OutputStream& out, const PackageManagerPtr& pm, const ParseResultPtr& nodes);
+  QILANG_API void genCppObjectLocal(OutputStream& out, const PackageManagerPtr& pm, const ParseResultPtr& nodes);
+  QILANG_API void formatAST(OutputStream& out, const NodePtrVector& node);
+  QILANG_API void format(OutputStream& out, const NodePtrVector& node);
+  QILANG_API void genDoc(OutputStream& out, const NodePtrVector& node);
+
   QILANG_API qi::AnyValue toAnyValue(const NodePtr& node);
 
 
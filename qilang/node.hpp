@@ -9,6 +9,7 @@
 #define QILANG_NODE_HPP
 
 #include <qilang/api.hpp>
+#include <qilang/symbol.hpp>
 
 //#include <qilang/node2.hpp>  //import the future
 #include <string>
@@ -28,30 +29,46 @@ public:
     , beg_column(0)
     , end_line(0)
     , end_column(0)
-    , filename(filename)
+    , file(filename)
+  {}
+  explicit Location(Symbol file)
+    : beg_line(0)
+    , beg_column(0)
+    , end_line(0)
+    , end_column(0)
+    , file(file)
   {}
   Location(int bline = 0, int bcols = 0, int eline = 0, int ecols = 0, const std::string& filename = std::string())
     : beg_line(bline)
     , beg_column(bcols)
     , end_line(eline)
     , end_column(ecols)
-    , filename(filename)
+    , file(filename)
+  {}
+  Location(int bline, int bcols, int eline, int ecols, Symbol file)
+    : beg_line(bline)
+    , beg_column(bcols)
+    , end_line(eline)
+    , end_column(ecols)
+    , file(file)
   {}
 
+  const std::string& filename() const { return file.str(); }
+
   int beg_line;
   int beg_column;
   int end_line;
   int end_column;
-  std::string filename;
+  Symbol file;   // interned filename
 };
 
 inline std::ostream& operator<<(std::ostream& os, const Location& loc) {
-  if (loc.filename.empty() && loc.beg_line == -1) {
+  if (loc.file.empty() && loc.beg_line == -1) {
     os << "<noloc>";
     return os;
   }
-  if (!loc.filename.empty()) {
-    os << loc.filename;
+  if (!loc.file.empty()) {
+    os << loc.file;
     os << ":";
   }
   os << loc.beg_line << ":" << loc.beg_column;
@@ -273,6 +290,9 @@ enum NodeType {
   NodeType_ConstDecl,
 
   NodeType_Comment,
+
+  //new types go last: the values are stored in binary AST files and summaries
+  NodeType_CallExpr,
 };
 
 enum TypeKind {
@@ -290,8 +310,11 @@ public:
 
   NodeKind kind() const { return _kind; }
   NodeType type() const { return _type; }
-  Location loc() const { return _loc; }
-  std::string comment() const { return _comment; }
+  const Location& loc() const { return _loc; }
+  const std::string& comment() const { return _comment; }
+
+  //! move the node, used by reparse for the nodes following an edit
+  void setLoc(const Location& loc) { _loc = loc; }
 
   virtual void accept(NodeVisitor *visitor) = 0;
 
@@ -302,17 +325,6 @@ private:
   std::string _comment;
 };
 
-class KeywordNode : public Node {
-public:
-  KeywordNode(const Location& loc, const std::string& comment) :
-    Node(NodeKind_Literal, NodeType_LiteralExpr, loc, comment)
-  {}
-
-  void accept(NodeVisitor*) { throw std::runtime_error("visiting keywords not supported"); };
-};
-
-typedef boost::shared_ptr<KeywordNode> KeywordNodePtr;
-
 enum UnaryOpCode {
   UnaryOpCode_Negate,
   UnaryOpCode_Minus
@@ -394,11 +406,11 @@ public:
 class QILANG_API CallExprNode : public ExprNode {
 public:
   CallExprNode(const std::string& id, const Location& loc)
-    : ExprNode(NodeType_UOpExpr, loc)
+    : ExprNode(NodeType_CallExpr, loc)
     , name(id)
   {}
   CallExprNode(const std::string& id, const ExprNodePtrVector& args, const Location& loc)
-    : ExprNode(NodeType_UOpExpr, loc)
+    : ExprNode(NodeType_CallExpr, loc)
     , name(id)
     , args(args)
   {}
@@ -587,6 +599,10 @@ public:
 
 class QILANG_API CustomTypeExprNode : public TypeExprNode {
 public:
+  explicit CustomTypeExprNode(Symbol sym, const Location& loc)
+    : TypeExprNode(NodeType_CustomTypeExpr, loc)
+    , value(sym)
+  {}
   explicit CustomTypeExprNode(const std::string& sym, const Location& loc)
     : TypeExprNode(NodeType_CustomTypeExpr, loc)
     , value(sym)
@@ -594,12 +610,15 @@ public:
 
   void accept(NodeVisitor* visitor) { visitor->visitTypeExpr(this); }
 
-  std::string resolved_package;
-  std::string resolved_value;
+  Symbol   resolved_package;
+  Symbol   resolved_value;
   TypeKind resolved_kind;
-  std::string value;
+  Symbol   value;
 };
 
+typedef boost::shared_ptr<CustomTypeExprNode> CustomTypeExprNodePtr;
+typedef std::vector<CustomTypeExprNodePtr>    CustomTypeExprNodePtrVector;
+
 class QILANG_API ListTypeExprNode : public TypeExprNode {
 public:
   explicit ListTypeExprNode(const TypeExprNodePtr& element, const Location& loc)
@@ -717,14 +736,14 @@ enum ImportType {
 
 class QILANG_API ImportNode : public StmtNode {
 public:
-  explicit ImportNode(ImportType importType, const std::string& packageName, const Location& loc)
+  explicit ImportNode(ImportType importType, Symbol packageName, const Location& loc)
     : StmtNode(NodeType_Import, loc)
     , name(packageName)
     , importType(importType)
   {}
 
 
-  ImportNode(ImportType importType, const std::string& packageName, const StringVector& imports, const Location& loc)
+  ImportNode(ImportType importType, Symbol packageName, const SymbolVector& imports, const Location& loc)
     : StmtNode(NodeType_Import, loc)
     , name(packageName)
     , importType(importType)
@@ -737,11 +756,14 @@ public:
   void accept(NodeVisitor* visitor) { visitor->visitStmt(this); }
 
 public:
-  std::string  name;
+  Symbol       name;
   ImportType   importType;
-  StringVector imports;
+  SymbolVector imports;
 };
 
+typedef boost::shared_ptr<ImportNode> ImportNodePtr;
+typedef std::vector<ImportNodePtr>    ImportNodePtrVector;
+
 
 
 class QILANG_API VarDefNode : public StmtNode {
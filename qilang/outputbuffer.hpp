@@ -0,0 +1,98 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_OUTPUTBUFFER_HPP
+#define QILANG_OUTPUTBUFFER_HPP
+
+#include <qilang/api.hpp>
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace qilang {
+
+  /** Append-only output of the code generators, in chunks.
+   *
+   *  Growing never moves what was written (a std::stringstream copies its
+   *  whole content each time it grows): chunks start small, for the many
+   *  short lived formatters, and double up to MaxChunkSize. The content is
+   *  read chunk by chunk, without being gathered into a string.
+   */
+  class QILANG_API OutputBuffer : public std::streambuf {
+  public:
+    static const std::size_t MinChunkSize = 256;
+    static const std::size_t MaxChunkSize = 64 * 1024;
+
+    OutputBuffer();
+
+    std::size_t size() const;
+    bool        empty() const { return size() == 0; }
+    void        clear();
+
+    //! append count times c
+    void repeat(char c, std::size_t count);
+    //! append the content of other, which is left empty. Large chunks are moved, not copied
+    void splice(OutputBuffer& other);
+
+    //! the content, in one string (a copy)
+    std::string str() const;
+    //! write the content to os, chunk by chunk. false on a stream error
+    bool writeTo(std::ostream& os) const;
+    //! true when is holds exactly the content, compared chunk by chunk
+    bool equals(std::istream& is) const;
+
+  protected:
+    int_type        overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+
+  private:
+    //! close the current chunk, the next one holds at least min bytes
+    void grow(std::size_t min);
+
+    //! written chunks are shrunk to their content: only the last one has spare room
+    std::vector< std::vector<char> > _chunks;
+    std::size_t                      _sealed;  // size of the chunks before the last one
+  };
+
+  /** std::ostream writing into an OutputBuffer: what the formatters write
+   *  their output to.
+   */
+  class QILANG_API OutputStream : public std::ostream {
+  public:
+    OutputStream()
+      : std::ostream(0)
+    {
+      rdbuf(&_buffer);
+    }
+
+    OutputBuffer&       buffer()       { return _buffer; }
+    const OutputBuffer& buffer() const { return _buffer; }
+
+    std::size_t size() const { return _buffer.size(); }
+    std::string str() const  { return _buffer.str(); }
+
+    //! append count times c, in one go (indentation)
+    OutputStream& repeat(char c, std::size_t count) {
+      _buffer.repeat(c, count);
+      return *this;
+    }
+    //! append the content of other, which is left empty
+    OutputStream& splice(OutputStream& other) {
+      _buffer.splice(other._buffer);
+      return *this;
+    }
+
+  private:
+    OutputBuffer _buffer;
+  };
+
+}
+
+#endif // QILANG_OUTPUTBUFFER_HPP
@@ -0,0 +1,137 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_OUTPUTCACHE_HPP
+#define QILANG_OUTPUTCACHE_HPP
+
+#include <qilang/api.hpp>
+#include <qilang/node.hpp>
+#include <qi/types.hpp>
+#include <string>
+#include <vector>
+
+namespace qilang {
+
+  /* Output cache layout
+   * ===================
+   *
+   * A directory (see OutputCache::defaultDir) shared by every qicc run:
+   *
+   *   <xx>/<key>.manifest   the results known for a run key
+   *   <xx>/<key>.<n>        output n of a result
+   *   stats                 hits, misses, stores, evictions and size
+   *   lock                  held while the stats or a manifest are updated
+   *
+   * where xx is the first two characters of the key.
+   *
+   * The run key hashes what is known before parsing: the generator, its
+   * flags, the codegens and the content of the input files. The outputs also
+   * depend on the files of the imported packages, only known once parsed, so
+   * a manifest lists the results of the run key, with the files they were
+   * generated from:
+   *
+   *   qilang-output-manifest <OutputCacheVersion>
+   *   r <result key> <output count>
+   *   f <size> <hash> <file>
+   *   l <hash> <dir>
+   *
+   * A result is used when all its files still have the same stamp (see
+   * astSourceStamp), and the .idl.qi files of their directories are the same
+   * (l lines, a hash of their names: a new file in an imported package can
+   * change the outputs).
+   *
+   * Files and directories below a base directory (see setBaseDirs) are named
+   * $<index>/<relative path> in the keys and manifests: builds of the same
+   * sources in different directories share the entries. The result key is a
+   * hash of the outputs, runs with the same outputs share them.
+   *
+   * Bump OutputCacheVersion on any format change, and when the generated
+   * code changes.
+   */
+
+  static const unsigned int OutputCacheVersion = 1;
+
+  /** Content addressed store of the outputs of code generation runs, so that
+   *  a run that was already done somewhere does not parse anything.
+   *
+   *  Every method is safe to call from concurrent processes. Failing to read
+   *  or to update the cache is never an error, it is a miss.
+   */
+  class QILANG_API OutputCache {
+  public:
+    struct Stats {
+      Stats()
+        : hits(0)
+        , misses(0)
+        , stores(0)
+        , evictions(0)
+        , size(0)
+      {}
+
+      qi::uint64_t hits;
+      qi::uint64_t misses;
+      qi::uint64_t stores;
+      qi::uint64_t evictions;  // results removed to stay below the maximum size
+      qi::uint64_t size;       // bytes, of the outputs and manifests
+    };
+
+    struct Result {
+      std::vector<std::string> outputs;
+      StringVector             files;  // the files the outputs were generated from
+    };
+
+    static const qi::uint64_t DefaultMaxSize = 1024ULL * 1024 * 1024;
+
+    //! a cache stored in dir, evicting the least recently used results above maxSize bytes
+    explicit OutputCache(const std::string& dir, qi::uint64_t maxSize = DefaultMaxSize);
+
+    //! $QICC_CACHE_DIR, $XDG_CACHE_HOME/qicc or ~/.cache/qicc
+    static std::string defaultDir();
+
+    const std::string& dir() const     { return _dir; }
+    qi::uint64_t       maxSize() const { return _maxSize; }
+
+    //! directories the files are named relative to, usually the lookup paths
+    void setBaseDirs(const StringVector& dirs);
+
+    /** key of a run: hash of parts (the generator, its flags and codegens)
+     *  and of the name and content of files. Empty if a file can't be read.
+     */
+    std::string runKey(const StringVector& parts, const StringVector& files) const;
+
+    //! the result of a run whose files did not change, counted as a hit or a miss
+    bool lookup(const std::string& runKey, Result* result);
+    //! add the result of a run, evict old results if needed
+    bool store(const std::string& runKey, const Result& result);
+
+    Stats stats() const;
+    //! remove every result, keep the statistics
+    bool  clear();
+    //! remove the least recently used results until the cache is below its maximum size
+    void  evict();
+
+  private:
+    std::string path(const std::string& key, const std::string& suffix) const;
+    //! file relative to a base directory if below one, $<index>/<path>
+    std::string relative(const std::string& file) const;
+    //! the file named by relative, empty if its base directory is unknown
+    std::string absolute(const std::string& name) const;
+    Stats       readStats() const;
+    bool        writeStats(const Stats& stats) const;
+    //! add delta to the statistics, then evict if the cache is too large
+    void        addStats(const Stats& delta);
+    //! with the lock held
+    void        evictLocked(Stats* stats);
+
+    std::string  _dir;
+    qi::uint64_t _maxSize;
+    StringVector _baseDirs;
+  };
+
+}
+
+#endif // QILANG_OUTPUTCACHE_HPP
@@ -0,0 +1,75 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_PACKAGEGRAPH_HPP
+#define QILANG_PACKAGEGRAPH_HPP
+
+#include <qilang/api.hpp>
+#include <qi/types.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace qilang {
+
+  /** Dependency graph of packages, an edge per imported package.
+   *
+   *  Packages are numbered in the order they are added. Imports are kept
+   *  sorted by name, so that every traversal, and the components, only depend
+   *  on the graph and not on the order it was built in.
+   */
+  class QILANG_API PackageGraph {
+  public:
+    typedef qi::uint32_t       Index;
+    typedef std::vector<Index> IndexVector;
+    static const Index NoIndex = 0xFFFFFFFF;
+
+    //! add a package if needed, return its index
+    Index addPackage(const std::string& name);
+    //! pkg imports imported (both are added if needed)
+    void  addImport(const std::string& pkg, const std::string& imported);
+    void  clear();
+
+    std::size_t        size() const          { return _names.size(); }
+    const std::string& name(Index i) const   { return _names[i]; }
+    //! NoIndex if unknown
+    Index              find(const std::string& name) const;
+    //! packages imported by i, sorted by name
+    const IndexVector& imports(Index i) const    { return _imports[i]; }
+    //! packages importing i, sorted by name
+    const IndexVector& importedBy(Index i) const { return _importedBy[i]; }
+    //! packages importing i, directly or not, sorted by index (i only if in a cycle)
+    IndexVector        importers(Index i) const;
+
+    /** strongly connected components, packages sorted by name in each.
+     *  They come in dependency order: a component only imports packages of
+     *  itself and of the components before it.
+     */
+    std::vector<IndexVector> components() const;
+    //! package i imports itself, or is part of a larger component
+    bool inCycle(Index i) const;
+    //! the components that are import cycles
+    std::vector<IndexVector> cycles() const;
+    /** shortest import path from the first package of a cycle back to it,
+     *  the first package is repeated at the end
+     */
+    IndexVector cyclePath(const IndexVector& cycle) const;
+    //! every package after the packages it imports, except inside a cycle
+    IndexVector topologicalOrder() const;
+
+  private:
+    void insertSorted(IndexVector& v, Index i) const;
+
+    std::vector<std::string>     _names;
+    std::map<std::string, Index> _indexes;
+    std::vector<IndexVector>     _imports;
+    std::vector<IndexVector>     _importedBy;
+  };
+
+}
+
+#endif // QILANG_PACKAGEGRAPH_HPP
@@ -0,0 +1,93 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_PACKAGEINDEX_HPP
+#define QILANG_PACKAGEINDEX_HPP
+
+#include <qilang/api.hpp>
+#include <qi/types.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+namespace qilang {
+
+  /* Package index format
+   * ====================
+   *
+   * A text file named PackageIndexFileName at the root of an IDL tree
+   * (<sdk>/share/qi/idl), listing the tree as it was when the index was written:
+   *
+   *   qilang-package-index <PackageIndexVersion> <time the walk started>
+   *   d <mtime> <dir>
+   *   f <mtime> <size> <file>
+   *
+   * Paths are relative to the root, '/' separated and sorted. Every directory
+   * is listed, only the .idl.qi files are. Adding, removing or renaming a file
+   * changes the mtime of its directory, so checking the directories of a package
+   * is enough to know whether its list of files is still right.
+   *
+   * Bump PackageIndexVersion on any format change.
+   */
+
+  static const unsigned int PackageIndexVersion  = 1;
+  static const char* const  PackageIndexFileName = "packages.qi.index";
+
+  /** Index of the packages of an IDL tree, so that locating a package does not
+   *  have to walk the tree.
+   */
+  class QILANG_API PackageIndex {
+  public:
+    struct Entry {
+      Entry()
+        : dir(false)
+        , mtime(0)
+        , size(0)
+      {}
+
+      bool         dir;
+      qi::int64_t  mtime;
+      qi::uint64_t size;
+    };
+    //! relative path -> entry, sorted
+    typedef std::map<std::string, Entry> EntryMap;
+
+    PackageIndex();
+
+    //! walk root and index it
+    void scan(const std::string& root);
+    //! read the index of root. on failure, error (if set) tells why
+    bool load(const std::string& root, std::string* error = 0);
+    //! write the index in root, atomically. on failure, error (if set) tells why
+    bool save(std::string* error = 0) const;
+
+    const std::string& root() const    { return _root; }
+    const EntryMap&    entries() const { return _entries; }
+
+    /** files of the package stored in dir (relative, '/' separated) and its
+     *  subdirectories, as paths below root.
+     *  return false when the entries of the package are out of date, the
+     *  tree has to be walked.
+     */
+    bool locate(const std::string& dir, std::vector<std::string>* files) const;
+
+  private:
+    bool upToDate(const std::string& path, const Entry& entry) const;
+
+    std::string _root;
+    qi::int64_t _time;
+    EntryMap    _entries;
+  };
+  typedef boost::shared_ptr<PackageIndex> PackageIndexPtr;
+
+  //! index root and write the index in it
+  QILANG_API bool writePackageIndex(const std::string& root, std::string* error = 0);
+
+}
+
+#endif // QILANG_PACKAGEINDEX_HPP
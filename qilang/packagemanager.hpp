@@ -8,12 +8,15 @@
 #ifndef   	PACKAGEMANAGER_HPP_
 # define   	PACKAGEMANAGER_HPP_
 
-#include <unordered_set>
+#include <unordered_map>
 #include <qilang/api.hpp>
 #include <qilang/node.hpp>
 #include <qilang/parser.hpp>
 #include <qilang/formatter.hpp>
+#include <qilang/packageindex.hpp>
+#include <qilang/packagegraph.hpp>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 #include <boost/make_shared.hpp>
@@ -25,7 +28,43 @@ namespace qilang {
   typedef std::map<std::string, ParseResultPtr>   ParseResultMap;
   typedef std::vector<ParseResultPtr>             ParseResultVector;
   typedef std::map<std::string, NodePtrVector> ASTMap;
-  typedef std::map<std::string, NodePtr>       NodeMap;
+  typedef std::unordered_map<Symbol, NodePtr>  NodeMap;
+
+  enum ResolutionStatus {
+    ResolutionStatus_Resolved = 0,
+    ResolutionStatus_NotAType,     // pkg exports type, but it is not a type
+    ResolutionStatus_NotFound,     // pkg does not export type
+    ResolutionStatus_NoPackage,    // pkg is not loaded
+    ResolutionStatus_Unresolved    // no package nor import provides the name
+  };
+
+  struct ResolutionResult {
+    Symbol           pkg;
+    Symbol           type;
+    TypeKind         kind;
+    ResolutionStatus status;
+
+    ResolutionResult()
+      : kind(TypeKind_Interface)
+      , status(ResolutionStatus_Unresolved)
+    {}
+    ResolutionResult(Symbol pkg, Symbol type, TypeKind kind)
+      : pkg(pkg)
+      , type(type)
+      , kind(kind)
+      , status(ResolutionStatus_Resolved)
+    {}
+    ResolutionResult(Symbol pkg, Symbol type, ResolutionStatus status)
+      : pkg(pkg)
+      , type(type)
+      , kind(TypeKind_Interface)
+      , status(status)
+    {}
+
+    bool resolved() const { return status == ResolutionStatus_Resolved; }
+  };
+
+  typedef std::unordered_map<Symbol, ResolutionResult> ResolutionMap;
 
   /** Describe a package
    *
@@ -38,6 +77,8 @@ namespace qilang {
     Package(const std::string& name)
       : _name(name)
       , _parsed(false)
+      , _analyzed(false)
+      , _analysisImports(0)
     {}
 
     void addImport(const std::string& import, const NodePtr& node) {
@@ -45,25 +86,25 @@ namespace qilang {
       qiLogVerbose() << "Added import '" << import << "' to package " << _name;
       //ok add the symbol
       _imports[import].push_back(node);
+      _resolutions.clear();
     }
 
-    void addMember(const std::string& member, const NodePtr& node) {
+    void addMember(Symbol member, const NodePtr& node) {
       qiLogCategory("qilang.pm");
-      NodeMap::iterator it;
-      for (it = _exports.begin(); it != _exports.end(); ++it) {
-        if (it->first == member)
-          throw std::runtime_error("symbol " + _name + "." + member +
-                                   "\ndefined by\n" +
-                                   node->loc().filename +
-                                   "\nis already defined by\n" +
-                                   it->second->loc().filename);
-      }
+      NodeMap::const_iterator it = _exports.find(member);
+      if (it != _exports.end())
+        throw std::runtime_error("symbol " + _name + "." + member.str() +
+                                 "\ndefined by\n" +
+                                 node->loc().filename() +
+                                 "\nis already defined by\n" +
+                                 it->second->loc().filename());
       qiLogVerbose() << "Added export '" << member << "' to package " << _name;
       //ok add the symbol
       _exports[member] = node;
+      _resolutions.clear();
     }
 
-    NodePtr getExport(const std::string& decl) {
+    NodePtr getExport(Symbol decl) {
        NodeMap::const_iterator it;
        qiLogCategory("qilang.pm");
        qiLogVerbose() << _name << " looking for export: " << decl;
@@ -81,9 +122,12 @@ namespace qilang {
     }
 
     void dump() {
-      NodeMap::iterator it;
-      for (it = _exports.begin(); it != _exports.end(); ++it) {
-        std::cout << "refs:" << _name << "." << it->first << std::endl;
+      //_exports is not ordered
+      std::set<std::string> names;
+      for (NodeMap::const_iterator it = _exports.begin(); it != _exports.end(); ++it)
+        names.insert(it->first.str());
+      for (std::set<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+        std::cout << "refs:" << _name << "." << *it << std::endl;
       }
     }
 
@@ -96,22 +140,33 @@ namespace qilang {
       return ret;
     }
 
-    std::string fileFromExport(const std::string& name) {
+    const std::string& fileFromExport(Symbol name) {
       NodeMap::const_iterator it = _exports.find(name);
 
       if (it == _exports.end())
-        throw std::runtime_error("export symbol '" + name + "' not found in package '" + this->_name + "'");
-      return _exports.at(name)->loc().filename;
+        throw std::runtime_error("export symbol '" + name.str() + "' not found in package '" + this->_name + "'");
+      return it->second->loc().filename();
     }
 
     bool hasError() const;
     void printMessage(std::ostream& os) const;
 
+    //! hash of the exported names and the type of their node: what importers resolve against
+    qi::uint64_t exportsHash() const;
+    //! hash of the import statements of all the files
+    qi::uint64_t importsHash() const;
+    //! hash of the files of the package and of their content
+    qi::uint64_t contentHash() const;
+
     std::string    _name;      // package name
     ParseResultMap _contents;  // map<filename, ParseResult>  file of the package
     NodeMap        _exports;   // map<membername, Node> package exported symbol
     ASTMap         _imports;   // map<pkgname, Nodes>   list of declared imports
     bool           _parsed;    // true if each files of the package are parsed
+    ResolutionMap  _resolutions; // map<type name as written, ResolutionResult> memo of PackageManager::resolveImport
+    bool           _analyzed;  // types of the files resolved once, see _analysisInputs
+    std::map<std::string, qi::uint64_t> _analysisInputs; // map<pkgname, exportsHash or 0 if not loaded> read by the last analysis
+    qi::uint64_t   _analysisImports; // importsHash at the last analysis
   };
 
   typedef boost::shared_ptr<Package>        PackagePtr;
@@ -128,19 +183,6 @@ namespace qilang {
 
   typedef boost::shared_ptr<DiagnosticManager> DiagnosticManagerPtr;
 
-  struct ResolutionResult {
-    std::string pkg;
-    std::string type;
-    TypeKind kind;
-
-    ResolutionResult() {}
-    ResolutionResult(const std::string& pkg, const std::string& type, TypeKind kind)
-      : pkg(pkg)
-      , type(type)
-      , kind(kind)
-    {}
-  };
-
   /**
    *  PackageManager...
    *
@@ -155,15 +197,52 @@ namespace qilang {
   class QILANG_API PackageManager {
   public:
     PackageManager()
+      : _jobs(1)
+      , _diagnostics(&std::cout)
+      , _useAstFiles(true)
+      , _usePackageIndexes(true)
+      , _usePackageSummaries(true)
       //: _diag(new DiagnosticManager)
     {}
 
     ParseResultPtr parseFile(const FileReaderPtr& file);
     void parsePackage(const std::string& packageName);
 
+    /** number of threads used to parse the files of packages and directories.
+     *  0 means one per hardware thread. Results do not depend on it.
+     */
+    void         setJobs(unsigned int jobs);
+    unsigned int jobs() const { return _jobs; }
+
+    /** where the diagnostics of the files are printed (default: std::cout),
+     *  the files already known included. os must outlive its use.
+     */
+    void          setDiagnosticStream(std::ostream& os);
+    std::ostream& diagnosticStream() const { return *_diagnostics; }
+
+    //! load up to date binary ASTs (<file>.ast) instead of parsing package files (default: true)
+    void setUseAstFiles(bool use) { _useAstFiles = use; }
+    //! locate packages with the index of the lookup paths when it is up to date (default: true)
+    void setUsePackageIndexes(bool use) { _usePackageIndexes = use; }
+    /** load the summary of imported packages (see packagesummary.hpp) when it is
+     *  up to date, instead of parsing their files (default: true).
+     *  Packages that already have parsed files are always parsed.
+     */
+    void setUsePackageSummaries(bool use) { _usePackageSummaries = use; }
+
     void addLookupPaths(const StringVector& lookupPaths);
+    const StringVector& lookupPaths() const { return _lookupPaths; }
+    /** analyse a package, or every known package and the packages they
+     *  import. Without package, the dependency graph is built first and
+     *  independent packages are analysed concurrently (see setJobs), each
+     *  one after the packages it imports. Import cycles are reported once,
+     *  as a warning on an import of the cycle.
+     */
     void anal(const std::string& package = std::string());
 
+    //! dependency graph of the packages, as of the last anal() of every package
+    const PackageGraph& graph() const { return _graph; }
+
     NodePtrVector ast(const std::string& filename);
     PackagePtr    package(const std::string& packagename) const;
 
@@ -171,14 +250,37 @@ namespace qilang {
     void         setIncludes(const StringVector& includes) { _includes = includes; }
     StringVector includes() const                          { return _includes; }
 
-    //return all the files composing a package  (their may be false)
-    std::unordered_set<std::string> locatePackage(const std::string& pkgName);
+    /** return all the files composing a package (their may be false), sorted:
+     *  the outputs must not depend on the order of the filesystem.
+     */
+    StringVector locatePackage(const std::string& pkgName);
 
     bool hasError() const;
     void printMessage(std::ostream& os) const;
 
+    /** absolute path of every source file known: parsed, loaded from its
+     *  binary AST or from a package summary. Sorted.
+     */
+    StringVector sourceFiles() const;
+    /** absolute path of the source files of packages and of the packages
+     *  they import, transitively: what the code generated for them depends on.
+     *  Sorted.
+     */
+    StringVector sourceFiles(const StringVector& packages) const;
+    //! the parse result of a source file (absolute path), null if unknown
+    ParseResultPtr parseResult(const std::string& absfile) const;
+    /** forget a file, the exports and imports of its package are updated.
+     *  Its package is analysed again by the next anal().
+     */
+    void removeFile(const std::string& absfile);
+
     void parseDir(const std::string &dirname);
 
+    /** resolve the name of a custom type used in pkg. On failure the
+     *  diagnostic is added to pr and the status of the result tells why.
+     *  Results are memoized by name in the package until its exports or
+     *  imports change, or until the next resolution pass of the package.
+     */
     ResolutionResult resolveImport(const ParseResultPtr& pr, const PackagePtr &pkg, const CustomTypeExprNode* node);
 
   protected:
@@ -188,14 +290,41 @@ namespace qilang {
       _packages[name] = boost::make_shared<Package>(name);
       return _packages[name];
     }
-    bool addFileToPackage(const std::string& absfile, const FileReaderPtr& file, ParseResultPtr& ret);
+    bool addFileToPackage(const std::string& absfile, const std::string& filename, ParseResultPtr& ret);
+    void mergeFile(const std::string& absfile, const std::string& filename, ParseResultPtr& ret);
+    ParseResultPtr loadOrParse(const std::string& filename, bool echoDiagnostics) const;
+    //! with failed, the files that can't be read are added to it instead of throwing
+    void parseFiles(const StringVector& files, StringVector* failed = 0);
+    void mergeFiles(const StringVector& files, const StringVector& absfiles, StringVector* failed = 0);
+    void prefetchPackages(const StringVector& names);
+    bool readSummaries(const std::string& name, const StringVector& files, ParseResultVector* results) const;
+    bool loadSummaries(const PackagePtr& pkg, const StringVector& files);
     void resolvePackage(const std::string &packageName);
+    void parseImports(const PackagePtr& pkg);
+    void resolveTypes(const PackagePtr& pkg);
+    bool analysisUpToDate(const Package& pkg) const;
+    qi::uint64_t exportsHash(const std::string& pkgName) const;
+    void indexPackage(const PackagePtr& pkg);
+    void loadDependencies();
+    void reportCycles();
+    void resolveComponents(const std::vector<PackageGraph::IndexVector>& components);
+    ResolutionResult resolveName(const Package& pkg, Symbol name) const;
+    ResolutionResult resolveExport(Symbol pkgName, Symbol type) const;
+    PackageIndexPtr packageIndex(const std::string& root);
 
   protected:
     PackagePtrMap        _packages; // packagename , packageptr
     FilenameToPackageMap _sources;  // abs filename , packagename
     StringVector         _includes;
     StringVector _lookupPaths;
+    unsigned int _jobs;
+    std::ostream* _diagnostics;
+    bool         _useAstFiles;
+    bool         _usePackageIndexes;
+    bool         _usePackageSummaries;
+    std::map<std::string, PackageIndexPtr> _indexes; // idl dir, index (null if missing)
+    PackageGraph          _graph;
+    std::set<std::string> _reportedCycles;
   };
   typedef boost::shared_ptr<PackageManager> PackageManagerPtr;
   inline PackageManagerPtr newPackageManager() { return boost::make_shared<PackageManager>(); }
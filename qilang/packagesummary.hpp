@@ -0,0 +1,121 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_PACKAGESUMMARY_HPP
+#define QILANG_PACKAGESUMMARY_HPP
+
+#include <qilang/api.hpp>
+#include <qilang/node.hpp>
+#include <qilang/parser.hpp>
+#include <qilang/packagemanager.hpp>
+#include <qi/types.hpp>
+#include <string>
+#include <vector>
+
+namespace qilang {
+
+  /* Package summary format
+   * ======================
+   *
+   * A text file named PackageSummaryFileName in the directory of a package
+   * (<sdk>/share/qi/idl/<package dir>), with what importers of the package
+   * read: its imports and its exported declarations, file by file.
+   *
+   *   qilang-package-summary <PackageSummaryVersion> <time the build started> <package>
+   *   f <mtime> <size> <hash> <file>
+   *   i <line> <column> <ImportType> <package> [<name>...]
+   *   e <line> <column> <NodeType> <name>
+   *
+   * Files are the .idl.qi of the directory, by name, with the stamp of their
+   * source (see astSourceStamp). The i and e lines that follow a file are the
+   * imports and the exports it declares. A summary is only used when the
+   * files of the directory are still the ones it lists, with the same stamps.
+   * A file with the same size and mtime, older than the summary, is not read
+   * again: the others are hashed, and a touched file still matches.
+   *
+   * Bump PackageSummaryVersion on any format change, or when NodeType or
+   * ImportType are renumbered.
+   */
+
+  static const unsigned int PackageSummaryVersion  = 2;
+  static const char* const  PackageSummaryFileName = "package.qi.summary";
+
+  /** Exports and imports of the files of a package stored in a directory,
+   *  so that importing the package does not have to parse them.
+   */
+  class QILANG_API PackageSummary {
+  public:
+    struct Decl {
+      Decl()
+        : type(NodeType_Package)
+        , line(0)
+        , column(0)
+        , importType(ImportType_All)
+      {}
+
+      NodeType     type;       // NodeType_Import or the type of the exported node
+      int          line;
+      int          column;
+      std::string  name;       // exported name or imported package
+      ImportType   importType;
+      StringVector imports;
+    };
+    typedef std::vector<Decl> DeclVector;
+
+    struct File {
+      File()
+        : mtime(0)
+        , size(0)
+        , hash(0)
+      {}
+
+      std::string  name;       // relative to the directory
+      qi::int64_t  mtime;
+      qi::uint64_t size;
+      qi::uint64_t hash;
+      DeclVector   decls;      // sorted by location
+    };
+    typedef std::vector<File> FileVector;
+
+    PackageSummary();
+
+    //! summary of the files of pkg stored in dir
+    void build(const std::string& dir, const Package& pkg);
+    //! read the summary of dir. on failure, error (if set) tells why
+    bool load(const std::string& dir, std::string* error = 0);
+    //! write the summary in its directory, atomically. on failure, error (if set) tells why
+    bool save(std::string* error = 0) const;
+
+    const std::string& dir() const     { return _dir; }
+    const std::string& package() const { return _package; }
+    const FileVector&  files() const   { return _files; }
+
+    //! files (absolute) are the ones of the summary, and they did not change
+    bool matches(const StringVector& files) const;
+
+    /** one ParseResult per file, with the package declaration, the imports
+     *  and the exported declarations without their content.
+     *  ParseResult::summary is set, the full AST comes from the source.
+     */
+    ParseResultVector toParseResults() const;
+
+  private:
+    std::string _dir;
+    std::string _package;
+    qi::int64_t _time;
+    FileVector  _files;
+  };
+
+  /** write the summary of every package directory of root (an IDL tree:
+   *  <sdk>/share/qi/idl). Directories with errors are skipped, summaries
+   *  that are up to date are kept.
+   */
+  QILANG_API bool writePackageSummaries(const std::string& root, std::string* error = 0);
+
+}
+
+#endif // QILANG_PACKAGESUMMARY_HPP
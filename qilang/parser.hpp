@@ -10,7 +10,12 @@
 
 #include <qilang/api.hpp>
 #include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 #include <qilang/node.hpp>
+#include <qilang/arena.hpp>
+#include <qilang/sourcemanager.hpp>
 #include <boost/make_shared.hpp>
 
 namespace qi {
@@ -44,10 +49,14 @@ namespace qilang {
 
     DiagnosticType  type() const           { return _type; }
     const char*  what() const           { return _what.c_str(); }
-    const std::string& filename() const { return _loc.filename; }
+    const std::string& filename() const { return _loc.filename(); }
     const Location&    loc() const      { return _loc; }
 
-    void print(std::ostream &out) const;
+    /** print the diagnostic and the line it points to, taken from source:
+     *  the content of its file (ParseResult::source). Without it, the line
+     *  is taken from the SourceManager.
+     */
+    void print(std::ostream &out, const SourceBufferPtr& source = SourceBufferPtr()) const;
   protected:
     DiagnosticType _type;
     std::string _what;
@@ -56,27 +65,48 @@ namespace qilang {
 
   typedef std::vector<Diagnostic> DiagnosticVector;
 
+  /** Source of a qilang file.
+   *
+   * Files opened by name are loaded in memory at once and the scanner runs
+   * in place on that buffer. The istream constructor is kept for stdin and
+   * in-memory sources, those are read chunk by chunk.
+   */
   class QILANG_API FileReader {
   public:
-    explicit FileReader(const std::string& filename)
-      : _filename(filename)
-      , _filein(filename.c_str())
-      , _in(&_filein)
-    {}
+    explicit FileReader(const std::string& filename);
 
     explicit FileReader(std::istream *in, const std::string& filename)
       : _filename(filename)
       , _in(in)
+      , _loaded(false)
     {}
 
-    bool isOpen()                       { return _in->good(); }
+    //! in-memory content (an unsaved editor buffer for example), buffered like a file
+    FileReader(const std::string& filename, const char* data, std::size_t size);
+
+    bool isOpen() const;
     const std::string& filename() const { return _filename; }
-    std::istream& in()                  { return *_in; }
+    //! the stream of a reader built from one, throws for a buffered reader
+    std::istream& in() {
+      if (!_in)
+        throw std::runtime_error("'" + _filename + "' is buffered, it has no stream");
+      return *_in;
+    }
+
+    //! true if the content is preloaded in buffer() (in() throws)
+    bool isBuffered() const             { return _in == 0; }
+
+    /** the file content followed by two NUL bytes (required by yy_scan_buffer)
+     *  the flex scanner modifies it while running, the hand-written lexer
+     *  takes it: a buffered reader is parsed once.
+     */
+    std::string& buffer()               { return _buffer; }
 
   protected:
-    std::string   _filename;
-    std::ifstream _filein;
-    std::istream* _in;
+    std::string       _filename;
+    std::istream*     _in;
+    std::string       _buffer;
+    bool              _loaded;
   };
 
   typedef boost::shared_ptr<FileReader> FileReaderPtr;
@@ -84,26 +114,89 @@ namespace qilang {
 
   inline FileReaderPtr newFileReader(const std::string& fname) { return boost::make_shared<FileReader>(fname); }
   inline FileReaderPtr newFileReader(std::istream* in, const std::string& fname) { return boost::make_shared<FileReader>(in, fname); }
+  inline FileReaderPtr newFileReader(const std::string& fname, const std::string& content) { return boost::make_shared<FileReader>(fname, content.data(), content.size()); }
+
+  /** State of the lexer right after the last token of a toplevel declaration,
+   *  parsing can restart from there (see reparse). line is 0 if unknown.
+   */
+  struct ParseBoundary {
+    ParseBoundary()
+      : line(1)
+      , column(1)
+      , linesSinceComment(0)
+    {}
+
+    int          line;
+    int          column;
+    std::string  comment;            // documentation comment not yet dropped by the lexer
+    unsigned int linesSinceComment;
+  };
+
+  typedef std::vector<ParseBoundary> ParseBoundaryVector;
 
   class QILANG_API ParseResult {
   public:
+    ParseResult()
+      : arena(newNodeArena())
+      , echoDiagnostics(true)
+      , diagnosticStream(&std::cout)
+      , sourceHash(0)
+      , analyzed(false)
+      , analysisBegin(0)
+      , analysisEnd(0)
+      , summary(false)
+    {}
+
     std::string      filename;
     std::string      package;
     NodePtrVector    ast;
     DiagnosticVector _messages;
+    NodeArenaPtr     arena;     // memory of the nodes created by the parser
+    bool             echoDiagnostics; // print diagnostics on diagnosticStream as they are added
+    std::ostream*    diagnosticStream; // std::cout, or the stream of the package manager owning it
+    SourceBufferPtr  source;    // content ast was parsed from
+    ParseBoundaryVector boundaries; // end of each toplevel node of ast
+    qi::uint64_t     sourceHash; // hash of the content ast comes from (see astSourceStamp), 0 if unknown
+    bool             analyzed;   // types of ast resolved by PackageManager::anal, reset when ast changes
+    std::size_t      analysisBegin; // range of _messages added by the last analysis
+    std::size_t      analysisEnd;
+    bool             summary;    // ast only has the declarations importers need (see packagesummary.hpp)
 
     DiagnosticVector& messages() { return _messages; }
 
     void addDiag(const Diagnostic& diag) {
       _messages.push_back(diag);
-      diag.print(std::cout);
+      if (echoDiagnostics)
+        diag.print(*diagnosticStream, source);
     }
 
+    //! warnings (e.g. import cycles) are reported but do not fail
     bool hasError() const {
-      return _messages.size() > 0;
+      for (unsigned i = 0; i < _messages.size(); ++i) {
+        if (_messages[i].type() != DiagnosticType_Warning)
+          return true;
+      }
+      return false;
     }
 
     void printMessage(std::ostream& out) const;
+
+    /** nodes of ast by type or kind, same result as findNode(ast, ...).
+     *  The index is built on first use in a single walk, and rebuilt when the
+     *  toplevel nodes of ast change. Call invalidateIndex after adding or
+     *  removing nodes below the toplevel.
+     */
+    const NodePtrVector& nodes(NodeType type) const;
+    const NodePtrVector& nodes(NodeKind kind) const;
+    void invalidateIndex();
+
+  private:
+    void updateIndex() const;
+
+    mutable std::mutex                 _indexMutex;
+    mutable std::vector<Node*>         _indexedRoots;
+    mutable std::vector<NodePtrVector> _typeIndex;   // by NodeType, empty when not built
+    mutable std::vector<NodePtrVector> _kindIndex;   // by NodeKind
   };
 
   typedef boost::shared_ptr<ParseResult> ParseResultPtr;
@@ -111,6 +204,57 @@ namespace qilang {
   inline ParseResultPtr newParseResult() { return boost::make_shared<ParseResult>(); }
 
   QILANG_API ParseResultPtr parse(const FileReaderPtr& filename);
+  /** parse, without printing the diagnostics if echoDiagnostics is false.
+   *  (set ParseResult::echoDiagnostics back and use printMessage later)
+   */
+  QILANG_API ParseResultPtr parse(const FileReaderPtr& filename, bool echoDiagnostics);
+
+  /** Replacement of a range of text. Positions are 1-based lines and
+   *  columns (in bytes) like Location, the end is excluded.
+   */
+  struct TextEdit {
+    TextEdit(int begLine, int begColumn, int endLine, int endColumn, const std::string& text)
+      : beg_line(begLine)
+      , beg_column(begColumn)
+      , end_line(endLine)
+      , end_column(endColumn)
+      , text(text)
+    {}
+
+    int beg_line;
+    int beg_column;
+    int end_line;
+    int end_column;
+    std::string text;
+  };
+
+  /** Apply edit to the source of result and update result in place.
+   *
+   *  Only the toplevel declarations touched by the edit are parsed again,
+   *  they are spliced into result->ast and the nodes after them are moved to
+   *  their new lines. The whole file is parsed again when the change can't be
+   *  isolated (previous errors, new errors, a comment or string running past
+   *  the declarations, ...), the result is the same as a full parse anyway.
+   *
+   *  @return the number of toplevel declarations parsed, or -1 if the whole file was.
+   *  @throw std::runtime_error if the source of result is unknown or the edit is out of it
+   */
+  QILANG_API int reparse(const ParseResultPtr& result, const TextEdit& edit);
+
+  enum LexerType {
+    LexerType_Flex,
+    LexerType_HandWritten
+  };
+
+  //! lexer used by parse, chosen at build time with the QILANG_HANDWRITTEN_LEXER option
+  QILANG_API LexerType defaultLexer();
+
+  /** run a lexer alone on file and return the number of tokens, end of file excluded.
+   *  tokens (if set) receives one line per token: kind, location and value. On an
+   *  invalid token, the last line is the error and the lexing stops.
+   */
+  QILANG_API std::size_t tokenize(const FileReaderPtr& file, LexerType lexer, StringVector* tokens = 0);
+
   QILANG_API TypeExprNodePtr signatureToQiLang(const qi::Signature& sig);
   QILANG_API NodePtr metaObjectToQiLang(const std::string& name, const qi::MetaObject& obj);
 
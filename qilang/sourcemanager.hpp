@@ -0,0 +1,90 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_SOURCEMANAGER_HPP
+#define QILANG_SOURCEMANAGER_HPP
+
+#include <qilang/api.hpp>
+#include <qilang/symbol.hpp>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace qilang {
+
+  /** Content of a source file.
+   *
+   * The line offset table is computed on first use, line() is then O(1).
+   */
+  class QILANG_API SourceBuffer : private boost::noncopyable {
+  public:
+    SourceBuffer(const char* data, std::size_t size);
+    //! takes content, without copying it
+    explicit SourceBuffer(std::string&& content);
+
+    const std::string& content() const { return _content; }
+
+    //! number of lines (a last line without EOL is counted)
+    unsigned int lineCount() const;
+
+    /** Text of a line, without the end of line.
+     *  @param lineno 1-based line number
+     *  @return false if the line does not exist
+     */
+    bool line(unsigned int lineno, const char** begin, std::size_t* size) const;
+
+  private:
+    void buildLines() const;
+
+    std::string                       _content;
+    mutable std::once_flag            _linesOnce;
+    mutable std::vector<std::size_t>  _lines;    // offset of the beginning of each line
+  };
+
+  typedef boost::shared_ptr<const SourceBuffer> SourceBufferPtr;
+
+  /** Process wide index of the source files in use, by interned filename.
+   *
+   * The parser registers the content of each file it reads (preloaded or
+   * streamed) and keeps it in the ParseResult, so diagnostics never need to
+   * go back to the disk. The manager only references contents weakly: they
+   * live as long as a ParseResult (or a caller) holds them. A file parsed by
+   * several package managers is indexed with its last content, each
+   * ParseResult keeps its own. Files without a content in use are loaded
+   * from the disk on demand.
+   */
+  class QILANG_API SourceManager : private boost::noncopyable {
+  public:
+    static SourceManager& instance();
+
+    //! set (or replace) the content of a file
+    SourceBufferPtr setSource(Symbol file, const char* data, std::size_t size);
+    //! the same, taking content without copying it
+    SourceBufferPtr setSource(Symbol file, std::string&& content);
+
+    //! content of a file, loaded from the disk if none is in use. null if the file can't be read
+    SourceBufferPtr source(Symbol file);
+
+  private:
+    SourceManager();
+    SourceBufferPtr store(Symbol file, const SourceBufferPtr& buf);
+
+    typedef std::unordered_map<Symbol, boost::weak_ptr<const SourceBuffer> > SourceMap;
+
+    std::mutex  _mutex;
+    SourceMap   _sources;
+    std::size_t _sweepSize; // the expired entries are dropped when the map reaches it
+  };
+
+}
+
+#endif // QILANG_SOURCEMANAGER_HPP
@@ -0,0 +1,83 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_SYMBOL_HPP
+#define QILANG_SYMBOL_HPP
+
+#include <qilang/api.hpp>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace qilang {
+
+  /** Interned string.
+   *
+   * A Symbol is a compact id into a process wide table: copying, hashing and
+   * testing symbols for equality never touch the characters. Interning is
+   * thread safe.
+   *
+   * Interned strings are never released: the table grows with the number of
+   * distinct strings, not with the number of parses. A long running qicc
+   * (--server, --watch) keeps every identifier and filename it has read,
+   * edits only add the new ones.
+   *
+   * The default Symbol is the empty string.
+   */
+  class QILANG_API Symbol {
+  public:
+    Symbol()
+      : _id(0)
+    {}
+    explicit Symbol(const std::string& str)
+      : _id(intern(str.data(), str.size()))
+    {}
+    explicit Symbol(const char* str)
+      : _id(intern(str, std::strlen(str)))
+    {}
+    Symbol(const char* str, std::size_t size)
+      : _id(intern(str, size))
+    {}
+
+    unsigned int       id() const    { return _id; }
+    bool               empty() const { return _id == 0; }
+    const std::string& str() const;
+
+    operator const std::string&() const { return str(); }
+
+  private:
+    static unsigned int intern(const char* str, std::size_t size);
+
+    unsigned int _id;
+  };
+
+  typedef std::vector<Symbol> SymbolVector;
+
+  inline bool operator==(Symbol lhs, Symbol rhs) { return lhs.id() == rhs.id(); }
+  inline bool operator!=(Symbol lhs, Symbol rhs) { return lhs.id() != rhs.id(); }
+  //! the order of the strings: ids depend on the interning order, which depends on thread scheduling
+  inline bool operator<(Symbol lhs, Symbol rhs)  { return lhs.id() != rhs.id() && lhs.str() < rhs.str(); }
+
+  inline std::ostream& operator<<(std::ostream& os, Symbol sym) {
+    return os << sym.str();
+  }
+
+  inline std::size_t hash_value(Symbol sym) { return sym.id(); }
+
+}
+
+namespace std {
+  template <>
+  struct hash<qilang::Symbol> {
+    std::size_t operator()(qilang::Symbol sym) const { return sym.id(); }
+  };
+}
+
+#endif // QILANG_SYMBOL_HPP
@@ -182,25 +182,247 @@ namespace qilang {
   }
 
 
-  inline void findNodeTypeVisitor(const NodePtr& parent, const NodePtr& node, NodeType wanted, NodePtrVector& result) {
-    if (node->type() == wanted)
-      result.push_back(node);
+  /* Static dispatch
+   * ===============
+   *
+   * The templates below walk the AST without virtual calls nor boost::function:
+   * dispatchNode switches on Node::type() and calls the overload of f for the
+   * concrete class. A visitor is a functor with an operator() per node class it
+   * handles, and a template operator() as a fallback for the others:
+   *
+   *   struct CountFn {
+   *     CountFn() : count(0) {}
+   *     void operator()(FnDeclNode* node) { ++count; }
+   *     template <typename T> void operator()(T* node) {}
+   *     int count;
+   *   };
+   */
+
+#define QILANG_NODE_TYPES(X)                        \
+    X(Package,            PackageNode)              \
+    X(Import,             ImportNode)               \
+    X(BinOpExpr,          BinaryOpExprNode)         \
+    X(UOpExpr,            UnaryOpExprNode)          \
+    X(VarExpr,            VarExprNode)              \
+    X(LiteralExpr,        LiteralExprNode)          \
+    X(CallExpr,           CallExprNode)             \
+    X(BuiltinTypeExpr,    BuiltinTypeExprNode)      \
+    X(CustomTypeExpr,     CustomTypeExprNode)       \
+    X(VarArgTypeExpr,     VarArgTypeExprNode)       \
+    X(KeywordArgTypeExpr, KeywordArgTypeExprNode)   \
+    X(MapTypeExpr,        MapTypeExprNode)          \
+    X(ListTypeExpr,       ListTypeExprNode)         \
+    X(TupleTypeExpr,      TupleTypeExprNode)        \
+    X(BoolData,           BoolLiteralNode)          \
+    X(IntData,            IntLiteralNode)           \
+    X(FloatData,          FloatLiteralNode)         \
+    X(StringData,         StringLiteralNode)        \
+    X(MapData,            DictLiteralNode)          \
+    X(ListData,           ListLiteralNode)          \
+    X(TupleData,          TupleLiteralNode)         \
+    X(ObjectDef,          ObjectDefNode)            \
+    X(PropDef,            PropertyDefNode)          \
+    X(VarDef,             VarDefNode)               \
+    X(At,                 AtNode)                   \
+    X(InterfaceDecl,      InterfaceDeclNode)        \
+    X(FnDecl,             FnDeclNode)               \
+    X(ParamFieldDecl,     ParamFieldDeclNode)       \
+    X(SigDecl,            SigDeclNode)              \
+    X(PropDecl,           PropDeclNode)             \
+    X(TypeDefDecl,        TypeDefDeclNode)          \
+    X(EnumDecl,           EnumDeclNode)             \
+    X(EnumFieldDecl,      EnumFieldDeclNode)        \
+    X(StructDecl,         StructDeclNode)           \
+    X(StructFieldDecl,    StructFieldDeclNode)      \
+    X(ConstDecl,          ConstDeclNode)
+
+  //! NodeType of a concrete node class: NodeTypeOf<FnDeclNode>::value
+  template <typename T>
+  struct NodeTypeOf;
+
+#define QILANG_NODE_TYPE_OF(TYPE, CLASS)                                 \
+  template <>                                                            \
+  struct NodeTypeOf<CLASS> { static const NodeType value = NodeType_##TYPE; };
+  QILANG_NODE_TYPES(QILANG_NODE_TYPE_OF)
+#undef QILANG_NODE_TYPE_OF
+
+  //! call f with node casted to its concrete class
+  template <typename F>
+  inline void dispatchNode(Node* node, F& f) {
+    switch (node->type()) {
+#define QILANG_DISPATCH_NODE(TYPE, CLASS)                  \
+      case NodeType_##TYPE:                                \
+        f(static_cast<CLASS*>(node));                      \
+        return;
+      QILANG_NODE_TYPES(QILANG_DISPATCH_NODE)
+#undef QILANG_DISPATCH_NODE
+      default:
+        return;
+    }
   }
 
-  inline void findNodeKindVisitor(const NodePtr& parent, const NodePtr& node, NodeKind wanted, NodePtrVector& result) {
-    if (node->kind() == wanted)
-      result.push_back(node);
+  namespace detail {
+
+    //call f on each child, in the order of DefaultNodeVisitor
+    template <typename F>
+    struct NodeChildren {
+      explicit NodeChildren(F& f)
+        : f(f)
+      {}
+
+      template <typename T>
+      void each(const std::vector< boost::shared_ptr<T> >& nodes) {
+        typename std::vector< boost::shared_ptr<T> >::const_iterator it;
+        for (it = nodes.begin(); it != nodes.end(); ++it)
+          f(*it);
+      }
+
+      void operator()(ListLiteralNode* node)        { each(node->values); }
+      void operator()(TupleLiteralNode* node)       { each(node->values); }
+
+      void operator()(ListTypeExprNode* node)       { f(node->element); }
+      void operator()(MapTypeExprNode* node)        { f(node->key); f(node->value); }
+      void operator()(TupleTypeExprNode* node)      { each(node->elements); }
+      void operator()(VarArgTypeExprNode* node)     { f(node->element); }
+      void operator()(KeywordArgTypeExprNode* node) { f(node->value); }
+
+      void operator()(BinaryOpExprNode* node)       { f(node->left); f(node->right); }
+      void operator()(UnaryOpExprNode* node)        { f(node->expr); }
+      void operator()(LiteralExprNode* node)        { f(node->data); }
+      void operator()(CallExprNode* node)           { each(node->args); }
+
+      void operator()(InterfaceDeclNode* node)      { each(node->values); }
+      void operator()(FnDeclNode* node)             { each(node->args); f(node->ret); }
+      void operator()(ParamFieldDeclNode* node)     { f(node->type); }
+      void operator()(SigDeclNode* node)            { each(node->args); }
+      void operator()(PropDeclNode* node)           { each(node->args); }
+      void operator()(StructDeclNode* node)         { each(node->decls); }
+      void operator()(StructFieldDeclNode* node)    { f(node->type); }
+      void operator()(EnumDeclNode* node)           { each(node->fields); }
+      void operator()(TypeDefDeclNode* node)        { f(node->type); }
+
+      void operator()(ObjectDefNode* node)          { each(node->values); }
+      void operator()(PropertyDefNode* node)        { f(node->data); }
+      void operator()(VarDefNode* node)             { f(node->data); }
+
+      //leaves
+      template <typename T>
+      void operator()(T* node) {}
+
+      F& f;
+    };
+
+    template <typename F>
+    struct NodeWalker {
+      NodeWalker(F& f, Node* parent)
+        : f(f)
+        , parent(parent)
+      {}
+
+      template <typename T>
+      void operator()(const boost::shared_ptr<T>& node) {
+        if (!node)
+          return;
+        f(parent, node);
+        NodeWalker<F> sub(f, node.get());
+        NodeChildren< NodeWalker<F> > children(sub);
+        dispatchNode(node.get(), children);
+      }
+
+      F&    f;
+      Node* parent;
+    };
+
+    struct FindNodeType {
+      FindNodeType(NodeType type, NodePtrVector& result)
+        : type(type)
+        , result(result)
+      {}
+
+      template <typename T>
+      void operator()(Node* parent, const boost::shared_ptr<T>& node) {
+        if (static_cast<Node*>(node.get())->type() == type)
+          result.push_back(node);
+      }
+
+      NodeType       type;
+      NodePtrVector& result;
+    };
+
+    struct FindNodeKind {
+      FindNodeKind(NodeKind kind, NodePtrVector& result)
+        : kind(kind)
+        , result(result)
+      {}
+
+      template <typename T>
+      void operator()(Node* parent, const boost::shared_ptr<T>& node) {
+        if (static_cast<Node*>(node.get())->kind() == kind)
+          result.push_back(node);
+      }
+
+      NodeKind       kind;
+      NodePtrVector& result;
+    };
+
+    template <typename R>
+    struct FindNodeOf {
+      explicit FindNodeOf(std::vector< boost::shared_ptr<R> >& result)
+        : result(result)
+      {}
+
+      template <typename T>
+      void operator()(Node* parent, const boost::shared_ptr<T>& node) {
+        Node* n = node.get();
+        if (n->type() == NodeTypeOf<R>::value)
+          result.push_back(boost::shared_ptr<R>(node, static_cast<R*>(n)));
+      }
+
+      std::vector< boost::shared_ptr<R> >& result;
+    };
+
+  }
+
+  //! call f(child) with the shared pointer of each direct child of node
+  template <typename F>
+  inline void forEachChild(Node* node, F& f) {
+    detail::NodeChildren<F> children(f);
+    dispatchNode(node, children);
   }
 
-  inline NodePtrVector findNode(NodePtrVector nodes, NodeType type) {
+  /** pre-order walk, in the order of DefaultNodeVisitor.
+   *  f(Node* parent, const boost::shared_ptr<T>& node) is called on each node, parent is 0 for toplevel nodes.
+   *  T is the static type of the member holding the node, use a Node* to call type() or kind():
+   *  some node classes have a member named type.
+   */
+  template <typename T, typename F>
+  inline void walkNode(const std::vector< boost::shared_ptr<T> >& nodes, F& f) {
+    detail::NodeWalker<F> walker(f, 0);
+    typename std::vector< boost::shared_ptr<T> >::const_iterator it;
+    for (it = nodes.begin(); it != nodes.end(); ++it)
+      walker(*it);
+  }
+
+  inline NodePtrVector findNode(const NodePtrVector& nodes, NodeType type) {
     NodePtrVector result;
-    qilang::visitNode(nodes, boost::bind<void>(&findNodeTypeVisitor, _1, _2, type, boost::ref(result)));
+    detail::FindNodeType finder(type, result);
+    walkNode(nodes, finder);
     return result;
   }
 
-  inline NodePtrVector findNode(NodePtrVector nodes, NodeKind kind) {
+  inline NodePtrVector findNode(const NodePtrVector& nodes, NodeKind kind) {
     NodePtrVector result;
-    qilang::visitNode(nodes, boost::bind<void>(&findNodeKindVisitor, _1, _2, kind, boost::ref(result)));
+    detail::FindNodeKind finder(kind, result);
+    walkNode(nodes, finder);
+    return result;
+  }
+
+  //! all nodes of class T: findNodes<InterfaceDeclNode>(pr->ast)
+  template <typename T, typename N>
+  inline std::vector< boost::shared_ptr<T> > findNodes(const std::vector< boost::shared_ptr<N> >& nodes) {
+    std::vector< boost::shared_ptr<T> > result;
+    detail::FindNodeOf<T> finder(result);
+    walkNode(nodes, finder);
     return result;
   }
 
@@ -0,0 +1,53 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <qilang/arena.hpp>
+
+namespace qilang {
+
+  static const std::size_t MaxChunkSize = 1024 * 1024;
+
+  NodeArena::NodeArena(std::size_t firstChunkSize)
+    : _cur(0)
+    , _end(0)
+    , _nextChunkSize(firstChunkSize)
+    , _used(0)
+  {}
+
+  NodeArena::~NodeArena() {
+    for (unsigned i = 0; i < _chunks.size(); ++i)
+      delete[] _chunks.at(i);
+  }
+
+  void NodeArena::reserve(std::size_t size) {
+    if (_chunks.empty())
+      _nextChunkSize = std::max(_nextChunkSize, std::min(size, MaxChunkSize));
+  }
+
+  void NodeArena::newChunk(std::size_t minSize) {
+    std::size_t size = std::max(_nextChunkSize, minSize);
+    _chunks.push_back(new char[size]);
+    _cur = _chunks.back();
+    _end = _cur + size;
+    //grow geometrically so big files only need a few chunks
+    _nextChunkSize = std::min(std::max(_nextChunkSize, size) * 2, MaxChunkSize);
+  }
+
+  void* NodeArena::allocate(std::size_t size, std::size_t align) {
+    std::size_t pad = _cur ? (align - reinterpret_cast<std::size_t>(_cur) % align) % align : 0;
+    if (!_cur || pad + size > static_cast<std::size_t>(_end - _cur)) {
+      newChunk(size + align);
+      pad = (align - reinterpret_cast<std::size_t>(_cur) % align) % align;
+    }
+    char* ret = _cur + pad;
+    _cur = ret + size;
+    _used += size;
+    return ret;
+  }
+
+}
@@ -0,0 +1,758 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <qi/log.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/arena.hpp>
+#include "mappedfile.hpp"
+
+qiLogCategory("qilang.astfile");
+
+namespace qilang {
+
+  static const char AstFileMagic[8] = { 'Q', 'I', 'L', 'A', 'S', 'T', '\n', '\0' };
+
+  static std::size_t align8(std::size_t size) {
+    return (size + 7) & ~static_cast<std::size_t>(7);
+  }
+
+  AstSourceStamp astSourceStamp(const char* data, std::size_t size) {
+    //FNV-1a 64
+    qi::uint64_t h = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < size; ++i) {
+      h ^= static_cast<unsigned char>(data[i]);
+      h *= 1099511628211ULL;
+    }
+    AstSourceStamp ret;
+    ret.size = size;
+    ret.hash = h;
+    return ret;
+  }
+
+  bool astSourceStamp(const std::string& filename, AstSourceStamp* stamp) {
+    MappedFile mf;
+    if (!mf.open(filename))
+      return false;
+    *stamp = astSourceStamp(mf.data(), mf.size());
+    return true;
+  }
+
+  std::string astFileName(const std::string& source) {
+    return source + ".ast";
+  }
+
+  // ###############
+  // # Writer
+  // ###############
+  class AstWriter : public NodeVisitor {
+  public:
+    AstWriter()
+      : _cur(AstNoIndex)
+    {}
+
+    std::string serialize(const NodePtrVector& ast, const AstSourceStamp& stamp) {
+      std::vector<qi::uint32_t> roots;
+      for (unsigned i = 0; i < ast.size(); ++i)
+        roots.push_back(add(ast.at(i).get()));
+
+      AstFileHeader header;
+      std::memset(&header, 0, sizeof(header));
+      std::memcpy(header.magic, AstFileMagic, sizeof(header.magic));
+      header.version     = AstFileVersion;
+      header.byteOrder   = AstFileByteOrder;
+      header.sourceSize  = stamp.size;
+      header.sourceHash  = stamp.hash;
+      header.rootBegin   = refs(roots);
+      header.rootCount   = roots.size();
+      header.nodeCount   = _nodes.size();
+      header.refCount    = _refs.size();
+      header.stringCount = _strings.size();
+      header.stringBytes = _blob.size();
+
+      std::size_t offset = align8(sizeof(AstFileHeader));
+      header.nodesOffset   = offset;
+      offset = align8(offset + _nodes.size() * sizeof(AstNodeRecord));
+      header.refsOffset    = offset;
+      offset = align8(offset + _refs.size() * sizeof(qi::uint32_t));
+      header.stringsOffset = offset;
+      offset = align8(offset + _strings.size() * sizeof(AstStringRecord));
+      header.blobOffset    = offset;
+      offset = offset + _blob.size();
+
+      std::string ret(offset, '\0');
+      std::memcpy(&ret[0], &header, sizeof(header));
+      if (!_nodes.empty())
+        std::memcpy(&ret[header.nodesOffset], &_nodes[0], _nodes.size() * sizeof(AstNodeRecord));
+      if (!_refs.empty())
+        std::memcpy(&ret[header.refsOffset], &_refs[0], _refs.size() * sizeof(qi::uint32_t));
+      if (!_strings.empty())
+        std::memcpy(&ret[header.stringsOffset], &_strings[0], _strings.size() * sizeof(AstStringRecord));
+      if (!_blob.empty())
+        std::memcpy(&ret[header.blobOffset], _blob.data(), _blob.size());
+      return ret;
+    }
+
+  protected:
+    virtual void doAccept(Node* node) { node->accept(this); }
+
+    //serialize node and its children, return its index
+    qi::uint32_t add(Node* node) {
+      if (!node)
+        return AstNoIndex;
+      qi::uint32_t saved = _cur;
+      _cur = _nodes.size();
+
+      AstNodeRecord rec;
+      std::memset(&rec, 0, sizeof(rec));
+      rec.name       = AstNoIndex;
+      rec.str        = AstNoIndex;
+      rec.comment    = node->comment().empty() ? AstNoIndex : string(node->comment());
+      rec.begLine    = node->loc().beg_line;
+      rec.begColumn  = node->loc().beg_column;
+      rec.endLine    = node->loc().end_line;
+      rec.endColumn  = node->loc().end_column;
+      _nodes.push_back(rec);
+
+      doAccept(node);
+
+      qi::uint32_t ret = _cur;
+      _cur = saved;
+      return ret;
+    }
+
+    //the record of the node being visited (do not keep the reference across add)
+    AstNodeRecord& rec() { return _nodes[_cur]; }
+
+    qi::uint32_t string(const std::string& str) {
+      std::map<std::string, qi::uint32_t>::const_iterator it = _stringIndex.find(str);
+      if (it != _stringIndex.end())
+        return it->second;
+      AstStringRecord sr;
+      sr.offset = _blob.size();
+      sr.size   = str.size();
+      _blob.append(str);
+      _blob.push_back('\0');
+      qi::uint32_t index = _strings.size();
+      _strings.push_back(sr);
+      _stringIndex[str] = index;
+      return index;
+    }
+
+    qi::uint32_t refs(const std::vector<qi::uint32_t>& v) {
+      qi::uint32_t begin = _refs.size();
+      _refs.insert(_refs.end(), v.begin(), v.end());
+      return begin;
+    }
+
+    void set(AstNodeTag tag, qi::uint32_t sub = 0) {
+      rec().tag = tag;
+      rec().sub = sub;
+    }
+    void name(const std::string& name) {
+      qi::uint32_t index = string(name);
+      rec().name = index;
+    }
+    void str(const std::string& str) {
+      qi::uint32_t index = string(str);
+      rec().str = index;
+    }
+    template <typename V>
+    void list(const V& strs) {
+      std::vector<qi::uint32_t> v;
+      for (unsigned i = 0; i < strs.size(); ++i)
+        v.push_back(string(strs.at(i)));
+      qi::uint32_t begin = refs(v);
+      rec().listBegin = begin;
+      rec().listCount = v.size();
+    }
+    void children(const std::vector<qi::uint32_t>& v) {
+      qi::uint32_t begin = refs(v);
+      rec().childBegin = begin;
+      rec().childCount = v.size();
+    }
+    template <typename V>
+    void append(std::vector<qi::uint32_t>& v, const V& nodes) {
+      for (unsigned i = 0; i < nodes.size(); ++i)
+        v.push_back(add(nodes.at(i).get()));
+    }
+    void children(Node* a, Node* b = 0, bool hasB = false) {
+      std::vector<qi::uint32_t> v;
+      v.push_back(add(a));
+      if (hasB)
+        v.push_back(add(b));
+      children(v);
+    }
+    template <typename V>
+    void childList(const V& nodes) {
+      std::vector<qi::uint32_t> v;
+      append(v, nodes);
+      children(v);
+    }
+
+    // DECL
+    void visitDecl(InterfaceDeclNode* node) {
+      set(AstNodeTag_InterfaceDecl);
+      name(node->name);
+      list(node->inherits);
+      childList(node->values);
+    }
+    void visitDecl(FnDeclNode* node) {
+      set(AstNodeTag_FnDecl);
+      name(node->name);
+      std::vector<qi::uint32_t> v;
+      v.push_back(add(node->ret.get()));
+      append(v, node->args);
+      children(v);
+    }
+    void visitDecl(SigDeclNode* node) {
+      set(AstNodeTag_SigDecl);
+      name(node->name);
+      childList(node->args);
+    }
+    void visitDecl(PropDeclNode* node) {
+      set(AstNodeTag_PropDecl);
+      name(node->name);
+      childList(node->args);
+    }
+    void visitDecl(ParamFieldDeclNode* node) {
+      set(AstNodeTag_ParamFieldDecl, node->paramType);
+      list(node->names);
+      children(node->type.get());
+    }
+    void visitDecl(StructDeclNode* node) {
+      set(AstNodeTag_StructDecl);
+      name(node->name);
+      str(node->package);
+      list(node->inherits);
+      childList(node->decls);
+    }
+    void visitDecl(ConstDeclNode* node) {
+      set(AstNodeTag_ConstDecl);
+      name(node->name);
+      children(node->type.get(), node->data.get(), true);
+    }
+    void visitDecl(StructFieldDeclNode* node) {
+      set(AstNodeTag_StructFieldDecl);
+      list(node->names);
+      children(node->type.get());
+    }
+    void visitDecl(TypeDefDeclNode* node) {
+      set(AstNodeTag_TypeDefDecl);
+      name(node->name);
+      children(node->type.get());
+    }
+    void visitDecl(EnumDeclNode* node) {
+      set(AstNodeTag_EnumDecl);
+      name(node->name);
+      childList(node->fields);
+    }
+    void visitDecl(EnumFieldDeclNode* node) {
+      set(AstNodeTag_EnumFieldDecl, node->fieldType);
+      children(node->node.get());
+    }
+
+    // STMT
+    void visitStmt(PackageNode* node) {
+      set(AstNodeTag_Package);
+      name(node->name);
+    }
+    void visitStmt(ImportNode* node) {
+      set(AstNodeTag_Import, node->importType);
+      name(node->name);
+      list(node->imports);
+    }
+    void visitStmt(ObjectDefNode* node) {
+      set(AstNodeTag_ObjectDef);
+      name(node->name);
+      std::vector<qi::uint32_t> v;
+      v.push_back(add(node->type.get()));
+      append(v, node->values);
+      children(v);
+    }
+    void visitStmt(PropertyDefNode* node) {
+      set(AstNodeTag_PropertyDef);
+      name(node->name);
+      children(node->data.get());
+    }
+    void visitStmt(AtNode* node) {
+      set(AstNodeTag_At);
+      str(node->receiver);
+      children(node->_sender.get());
+    }
+    void visitStmt(VarDefNode* node) {
+      set(AstNodeTag_VarDef);
+      name(node->name);
+      children(node->type.get(), node->data.get(), true);
+    }
+
+    // EXPR
+    void visitExpr(BinaryOpExprNode* node) {
+      set(AstNodeTag_BinaryOpExpr, node->op);
+      children(node->left.get(), node->right.get(), true);
+    }
+    void visitExpr(UnaryOpExprNode* node) {
+      set(AstNodeTag_UnaryOpExpr, node->op);
+      children(node->expr.get());
+    }
+    void visitExpr(VarExprNode* node) {
+      set(AstNodeTag_VarExpr);
+      name(node->value);
+    }
+    void visitExpr(LiteralExprNode* node) {
+      set(AstNodeTag_LiteralExpr);
+      children(node->data.get());
+    }
+    void visitExpr(CallExprNode* node) {
+      set(AstNodeTag_CallExpr);
+      name(node->name);
+      childList(node->args);
+    }
+
+    // DATA
+    void visitData(BoolLiteralNode* node) {
+      set(AstNodeTag_BoolLiteral);
+      rec().value = node->value ? 1 : 0;
+    }
+    void visitData(IntLiteralNode* node) {
+      set(AstNodeTag_IntLiteral);
+      rec().value = node->value;
+    }
+    void visitData(FloatLiteralNode* node) {
+      set(AstNodeTag_FloatLiteral);
+      qi::uint64_t bits;
+      std::memcpy(&bits, &node->value, sizeof(bits));
+      rec().value = bits;
+    }
+    void visitData(StringLiteralNode* node) {
+      set(AstNodeTag_StringLiteral);
+      str(node->value);
+    }
+    void visitData(TupleLiteralNode* node) {
+      set(AstNodeTag_TupleLiteral);
+      childList(node->values);
+    }
+    void visitData(ListLiteralNode* node) {
+      set(AstNodeTag_ListLiteral);
+      childList(node->values);
+    }
+    void visitData(DictLiteralNode* node) {
+      set(AstNodeTag_DictLiteral);
+      std::vector<qi::uint32_t> v;
+      for (unsigned i = 0; i < node->values.size(); ++i) {
+        v.push_back(add(node->values.at(i).first.get()));
+        v.push_back(add(node->values.at(i).second.get()));
+      }
+      children(v);
+    }
+
+    // TYPEEXPR
+    void visitTypeExpr(BuiltinTypeExprNode* node) {
+      set(AstNodeTag_BuiltinTypeExpr, node->builtinType);
+      str(node->value);
+    }
+    void visitTypeExpr(CustomTypeExprNode* node) {
+      set(AstNodeTag_CustomTypeExpr);
+      str(node->value);
+    }
+    void visitTypeExpr(ListTypeExprNode* node) {
+      set(AstNodeTag_ListTypeExpr);
+      children(node->element.get());
+    }
+    void visitTypeExpr(MapTypeExprNode* node) {
+      set(AstNodeTag_MapTypeExpr);
+      children(node->key.get(), node->value.get(), true);
+    }
+    void visitTypeExpr(TupleTypeExprNode* node) {
+      set(AstNodeTag_TupleTypeExpr);
+      childList(node->elements);
+    }
+    void visitTypeExpr(VarArgTypeExprNode* node) {
+      set(AstNodeTag_VarArgTypeExpr);
+      children(node->element.get());
+    }
+    void visitTypeExpr(KeywordArgTypeExprNode* node) {
+      set(AstNodeTag_KeywordArgTypeExpr);
+      children(node->value.get());
+    }
+
+  private:
+    qi::uint32_t                        _cur;
+    std::vector<AstNodeRecord>          _nodes;
+    std::vector<qi::uint32_t>           _refs;
+    std::vector<AstStringRecord>        _strings;
+    std::string                         _blob;
+    std::map<std::string, qi::uint32_t> _stringIndex;
+  };
+
+  std::string serializeAST(const NodePtrVector& ast, const AstSourceStamp& stamp) {
+    AstWriter writer;
+    return writer.serialize(ast, stamp);
+  }
+
+  // ###############
+  // # Reader
+  // ###############
+  AstFile::AstFile()
+    : _data(0)
+    , _size(0)
+    , _header(0)
+    , _nodes(0)
+    , _refs(0)
+    , _strings(0)
+    , _blob(0)
+  {}
+
+  AstFile::~AstFile()
+  {}
+
+  bool AstFile::open(const std::string& filename, std::string* error) {
+    boost::shared_ptr<MappedFile> mf(new MappedFile);
+    if (!mf->open(filename)) {
+      if (error)
+        *error = "can't open '" + filename + "'";
+      return false;
+    }
+    _file = mf;
+    return openBuffer(mf->data(), mf->size(), error);
+  }
+
+  static bool fail(std::string* error, const std::string& what) {
+    if (error)
+      *error = what;
+    return false;
+  }
+
+  static bool inRange(qi::uint64_t offset, qi::uint64_t count, qi::uint64_t elemSize, qi::uint64_t size) {
+    return offset <= size && count <= (size - offset) / elemSize;
+  }
+
+  bool AstFile::openBuffer(const char* data, std::size_t size, std::string* error) {
+    _data   = data;
+    _size   = size;
+    _header = 0;
+    if (reinterpret_cast<std::size_t>(data) % 8 != 0)
+      return fail(error, "misaligned buffer");
+    if (size < sizeof(AstFileHeader))
+      return fail(error, "file too small");
+    const AstFileHeader* h = reinterpret_cast<const AstFileHeader*>(data);
+    if (std::memcmp(h->magic, AstFileMagic, sizeof(AstFileMagic)) != 0)
+      return fail(error, "not a binary AST file");
+    if (h->byteOrder != AstFileByteOrder)
+      return fail(error, "byte order mismatch");
+    if (h->version != AstFileVersion)
+      return fail(error, "unsupported version");
+    if (h->nodesOffset % 8 || h->refsOffset % 4 || h->stringsOffset % 4
+        || !inRange(h->nodesOffset, h->nodeCount, sizeof(AstNodeRecord), size)
+        || !inRange(h->refsOffset, h->refCount, sizeof(qi::uint32_t), size)
+        || !inRange(h->stringsOffset, h->stringCount, sizeof(AstStringRecord), size)
+        || !inRange(h->blobOffset, h->stringBytes, 1, size))
+      return fail(error, "truncated file");
+    _header  = h;
+    _nodes   = reinterpret_cast<const AstNodeRecord*>(data + h->nodesOffset);
+    _refs    = reinterpret_cast<const qi::uint32_t*>(data + h->refsOffset);
+    _strings = reinterpret_cast<const AstStringRecord*>(data + h->stringsOffset);
+    _blob    = data + h->blobOffset;
+    if (!validate(error)) {
+      _header = 0;
+      return false;
+    }
+    return true;
+  }
+
+  //check every range once, so that accessors do not have to
+  bool AstFile::validate(std::string* error) {
+    const AstFileHeader& h = *_header;
+    for (qi::uint32_t i = 0; i < h.stringCount; ++i) {
+      const AstStringRecord& s = _strings[i];
+      if (!inRange(s.offset, qi::uint64_t(s.size) + 1, 1, h.stringBytes) || _blob[s.offset + s.size] != '\0')
+        return fail(error, "bad string table");
+    }
+    if (!inRange(h.rootBegin, h.rootCount, 1, h.refCount))
+      return fail(error, "bad root range");
+    for (qi::uint32_t i = 0; i < h.nodeCount; ++i) {
+      const AstNodeRecord& r = _nodes[i];
+      if (r.tag == AstNodeTag_None || r.tag >= AstNodeTag_Count)
+        return fail(error, "bad node tag");
+      if (!inRange(r.childBegin, r.childCount, 1, h.refCount) || !inRange(r.listBegin, r.listCount, 1, h.refCount))
+        return fail(error, "bad node range");
+      if ((r.name != AstNoIndex && r.name >= h.stringCount)
+          || (r.str != AstNoIndex && r.str >= h.stringCount)
+          || (r.comment != AstNoIndex && r.comment >= h.stringCount))
+        return fail(error, "bad string index");
+      for (qi::uint32_t j = 0; j < r.listCount; ++j) {
+        if (_refs[r.listBegin + j] >= h.stringCount)
+          return fail(error, "bad string index");
+      }
+      //children come after their parent: no cycle
+      for (qi::uint32_t j = 0; j < r.childCount; ++j) {
+        qi::uint32_t c = _refs[r.childBegin + j];
+        if (c != AstNoIndex && (c <= i || c >= h.nodeCount))
+          return fail(error, "bad child index");
+      }
+    }
+    for (qi::uint32_t j = 0; j < h.rootCount; ++j) {
+      if (_refs[h.rootBegin + j] >= h.nodeCount)
+        return fail(error, "bad root index");
+    }
+    return true;
+  }
+
+  const char* AstFile::string(qi::uint32_t index, std::size_t* size) const {
+    if (index == AstNoIndex) {
+      if (size)
+        *size = 0;
+      return "";
+    }
+    const AstStringRecord& s = _strings[index];
+    if (size)
+      *size = s.size;
+    return _blob + s.offset;
+  }
+
+  bool AstFile::matches(const AstSourceStamp& stamp) const {
+    return _header && _header->sourceSize == stamp.size && _header->sourceHash == stamp.hash;
+  }
+
+  /** Materialize the records into nodes allocated in the arena of a ParseResult.
+   */
+  class AstBuilder {
+  public:
+    AstBuilder(const AstFile& file, const ParseResultPtr& pr, Symbol filename)
+      : _file(file)
+      , _pr(pr)
+      , _filename(filename)
+    {}
+
+    NodePtrVector roots() {
+      NodePtrVector ret;
+      const AstFileHeader& h = _file.header();
+      const qi::uint32_t* r = _file.refs(h.rootBegin);
+      for (qi::uint32_t i = 0; i < h.rootCount; ++i)
+        ret.push_back(build(r[i]));
+      return ret;
+    }
+
+  private:
+    template <typename T, typename... Args>
+    boost::shared_ptr<T> make(Args&&... args) {
+      return boost::allocate_shared<T>(NodeAllocator<T>(_pr->arena), std::forward<Args>(args)...);
+    }
+
+    std::string str(qi::uint32_t index) const {
+      std::size_t size;
+      const char* s = _file.string(index, &size);
+      return std::string(s, size);
+    }
+
+    StringVector strings(const AstNodeRecord& r) const {
+      StringVector ret;
+      const qi::uint32_t* refs = _file.refs(r.listBegin);
+      for (qi::uint32_t i = 0; i < r.listCount; ++i)
+        ret.push_back(str(refs[i]));
+      return ret;
+    }
+
+    SymbolVector symbols(const AstNodeRecord& r) const {
+      SymbolVector ret;
+      const qi::uint32_t* refs = _file.refs(r.listBegin);
+      for (qi::uint32_t i = 0; i < r.listCount; ++i) {
+        std::size_t size;
+        const char* s = _file.string(refs[i], &size);
+        ret.push_back(Symbol(s, size));
+      }
+      return ret;
+    }
+
+    template <typename T>
+    boost::shared_ptr<T> child(const AstNodeRecord& r, qi::uint32_t k, bool optional = false) {
+      if (k >= r.childCount)
+        throw std::runtime_error("binary AST: missing child");
+      qi::uint32_t index = _file.refs(r.childBegin)[k];
+      if (index == AstNoIndex) {
+        if (!optional)
+          throw std::runtime_error("binary AST: missing child");
+        return boost::shared_ptr<T>();
+      }
+      boost::shared_ptr<T> ret = boost::dynamic_pointer_cast<T>(build(index));
+      if (!ret)
+        throw std::runtime_error("binary AST: unexpected child type");
+      return ret;
+    }
+
+    template <typename T>
+    std::vector< boost::shared_ptr<T> > childList(const AstNodeRecord& r, qi::uint32_t first = 0) {
+      std::vector< boost::shared_ptr<T> > ret;
+      for (qi::uint32_t k = first; k < r.childCount; ++k)
+        ret.push_back(child<T>(r, k));
+      return ret;
+    }
+
+    template <typename E>
+    E sub(const AstNodeRecord& r, E last) const {
+      if (r.sub > static_cast<qi::uint32_t>(last))
+        throw std::runtime_error("binary AST: bad node attribute");
+      return static_cast<E>(r.sub);
+    }
+
+    NodePtr build(qi::uint32_t index) {
+      const AstNodeRecord& r = _file.node(index);
+      Location loc(r.begLine, r.begColumn, r.endLine, r.endColumn, _filename);
+
+      switch (r.tag) {
+      case AstNodeTag_BinaryOpExpr:
+        return make<BinaryOpExprNode>(child<ExprNode>(r, 0), child<ExprNode>(r, 1), sub(r, BinaryOpCode_FetchArray), loc);
+      case AstNodeTag_UnaryOpExpr:
+        return make<UnaryOpExprNode>(child<ExprNode>(r, 0), sub(r, UnaryOpCode_Minus), loc);
+      case AstNodeTag_VarExpr:
+        return make<VarExprNode>(str(r.name), loc);
+      case AstNodeTag_LiteralExpr:
+        return make<LiteralExprNode>(child<LiteralNode>(r, 0), loc);
+      case AstNodeTag_CallExpr:
+        return make<CallExprNode>(str(r.name), childList<ExprNode>(r), loc);
+
+      case AstNodeTag_BoolLiteral:
+        return make<BoolLiteralNode>(r.value != 0, loc);
+      case AstNodeTag_IntLiteral:
+        return make<IntLiteralNode>(r.value, loc);
+      case AstNodeTag_FloatLiteral: {
+        double d;
+        std::memcpy(&d, &r.value, sizeof(d));
+        return make<FloatLiteralNode>(d, loc);
+      }
+      case AstNodeTag_StringLiteral:
+        return make<StringLiteralNode>(str(r.str), loc);
+      case AstNodeTag_ListLiteral:
+        return make<ListLiteralNode>(childList<LiteralNode>(r), loc);
+      case AstNodeTag_TupleLiteral:
+        return make<TupleLiteralNode>(childList<LiteralNode>(r), loc);
+      case AstNodeTag_DictLiteral: {
+        if (r.childCount % 2)
+          throw std::runtime_error("binary AST: odd dict");
+        LiteralNodePtrPairVector values;
+        for (qi::uint32_t k = 0; k < r.childCount; k += 2)
+          values.push_back(std::make_pair(child<LiteralNode>(r, k), child<LiteralNode>(r, k + 1)));
+        return make<DictLiteralNode>(values, loc);
+      }
+
+      case AstNodeTag_BuiltinTypeExpr:
+        return make<BuiltinTypeExprNode>(sub(r, BuiltinType_Object), str(r.str), loc);
+      case AstNodeTag_CustomTypeExpr: {
+        std::size_t size;
+        const char* s = _file.string(r.str, &size);
+        return make<CustomTypeExprNode>(Symbol(s, size), loc);
+      }
+      case AstNodeTag_ListTypeExpr:
+        return make<ListTypeExprNode>(child<TypeExprNode>(r, 0), loc);
+      case AstNodeTag_MapTypeExpr:
+        return make<MapTypeExprNode>(child<TypeExprNode>(r, 0), child<TypeExprNode>(r, 1), loc);
+      case AstNodeTag_TupleTypeExpr:
+        return make<TupleTypeExprNode>(childList<TypeExprNode>(r), loc);
+      case AstNodeTag_VarArgTypeExpr:
+        return make<VarArgTypeExprNode>(child<TypeExprNode>(r, 0, true), loc);
+      case AstNodeTag_KeywordArgTypeExpr:
+        return make<KeywordArgTypeExprNode>(child<TypeExprNode>(r, 0, true), loc);
+
+      case AstNodeTag_Package:
+        return make<PackageNode>(str(r.name), loc);
+      case AstNodeTag_Import: {
+        std::size_t size;
+        const char* s = _file.string(r.name, &size);
+        ImportType it = sub(r, ImportType_All);
+        if (it == ImportType_List)
+          return make<ImportNode>(it, Symbol(s, size), symbols(r), loc);
+        return make<ImportNode>(it, Symbol(s, size), loc);
+      }
+      case AstNodeTag_VarDef:
+        return make<VarDefNode>(str(r.name), child<TypeExprNode>(r, 0, true), child<LiteralNode>(r, 1, true), loc);
+      case AstNodeTag_ObjectDef:
+        return make<ObjectDefNode>(child<TypeExprNode>(r, 0), str(r.name), childList<StmtNode>(r, 1), loc);
+      case AstNodeTag_PropertyDef:
+        return make<PropertyDefNode>(str(r.name), child<LiteralNode>(r, 0), loc);
+      case AstNodeTag_At:
+        return make<AtNode>(child<ExprNode>(r, 0), str(r.str), loc);
+
+      case AstNodeTag_TypeDefDecl:
+        return make<TypeDefDeclNode>(str(r.name), child<TypeExprNode>(r, 0), loc);
+      case AstNodeTag_EnumDecl:
+        return make<EnumDeclNode>(str(r.name), childList<EnumFieldDeclNode>(r), loc);
+      case AstNodeTag_EnumFieldDecl:
+        return make<EnumFieldDeclNode>(sub(r, EnumFieldType_Const), child<Node>(r, 0), loc);
+      case AstNodeTag_StructDecl: {
+        boost::shared_ptr<StructDeclNode> ret = make<StructDeclNode>(str(r.name), strings(r), childList<DeclNode>(r), loc);
+        ret->package = str(r.str);
+        return ret;
+      }
+      case AstNodeTag_StructFieldDecl:
+        return make<StructFieldDeclNode>(strings(r), child<TypeExprNode>(r, 0, true), loc);
+      case AstNodeTag_InterfaceDecl:
+        return make<InterfaceDeclNode>(str(r.name), strings(r), childList<DeclNode>(r), loc, str(r.comment));
+      case AstNodeTag_FnDecl:
+        return make<FnDeclNode>(str(r.name), childList<ParamFieldDeclNode>(r, 1), child<TypeExprNode>(r, 0, true), loc, str(r.comment));
+      case AstNodeTag_ParamFieldDecl: {
+        boost::shared_ptr<ParamFieldDeclNode> ret = make<ParamFieldDeclNode>(strings(r), child<TypeExprNode>(r, 0, true), loc);
+        ret->paramType = sub(r, ParamFieldType_KeywordArgs);
+        return ret;
+      }
+      case AstNodeTag_SigDecl:
+        return make<SigDeclNode>(str(r.name), childList<ParamFieldDeclNode>(r), loc);
+      case AstNodeTag_PropDecl:
+        return make<PropDeclNode>(str(r.name), childList<ParamFieldDeclNode>(r), loc);
+      case AstNodeTag_ConstDecl:
+        return make<ConstDeclNode>(str(r.name), child<TypeExprNode>(r, 0, true), child<LiteralNode>(r, 1, true), loc);
+      default:
+        throw std::runtime_error("binary AST: bad node tag");
+      }
+    }
+
+    const AstFile&        _file;
+    const ParseResultPtr& _pr;
+    Symbol                _filename;
+  };
+
+  NodePtrVector AstFile::toAST(const ParseResultPtr& pr, Symbol file) const {
+    if (!_header)
+      throw std::runtime_error("binary AST: file not open");
+    AstBuilder builder(*this, pr, file);
+    return builder.roots();
+  }
+
+  ParseResultPtr loadAST(const std::string& source) {
+    std::string astfile = astFileName(source);
+    boost::system::error_code ec;
+    if (!boost::filesystem::exists(astfile, ec))
+      return ParseResultPtr();
+
+    AstFile af;
+    std::string error;
+    if (!af.open(astfile, &error)) {
+      qiLogVerbose() << "ignoring '" << astfile << "': " << error;
+      return ParseResultPtr();
+    }
+    AstSourceStamp stamp;
+    if (!astSourceStamp(source, &stamp) || !af.matches(stamp)) {
+      qiLogVerbose() << "ignoring '" << astfile << "': out of date";
+      return ParseResultPtr();
+    }
+
+    ParseResultPtr pr = newParseResult();
+    pr->filename = source;
+    pr->sourceHash = stamp.hash;
+    pr->arena->reserve(af.nodeCount() * 128);
+    try {
+      pr->ast = af.toAST(pr, Symbol(source));
+    } catch (const std::exception& e) {
+      qiLogWarning() << "ignoring '" << astfile << "': " << e.what();
+      return ParseResultPtr();
+    }
+    return pr;
+  }
+
+}
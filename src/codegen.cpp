@@ -8,11 +8,38 @@
 #include <iostream>
 #include <qilang/formatter.hpp>
 #include <qilang/packagemanager.hpp>
+#include <qilang/astfile.hpp>
+#include "mappedfile.hpp"
 
 qiLogCategory("qilang.codegen");
 
 namespace qilang {
 
+  bool FileWriter::close() {
+    if (!_used)
+      return true;
+    _used = false;
+    if (_stream)
+      return _buffer.buffer().writeTo(*_stream);
+
+    //read back in the same mode, so that text files compare on any platform
+    {
+      std::ifstream is(_filename.c_str(), std::ios::in | (_mode & std::ios::binary));
+      if (is && _buffer.buffer().equals(is)) {
+        qiLogVerbose() << "'" << _filename << "' is up to date";
+        return true;
+      }
+    }
+
+    std::string error;
+    if (!writeFileAtomically(_filename, [this](std::ostream& os) { return _buffer.buffer().writeTo(os); }, _mode, &error)) {
+      qiLogError() << error;
+      return false;
+    }
+    _written = true;
+    return true;
+  }
+
   bool codegen(const FileWriterPtr&             out,
                const std::string&               codegen,
                const qilang::PackageManagerPtr& pm,
@@ -21,7 +48,7 @@ namespace qilang {
     static const char* vals[] = { "cpp_interface", "cppi",
                                   "cpp_local", "cppl",
                                   "cpp_remote", "cppr",
-                                  "sexpr", "qilang", "doc", 0 };
+                                  "sexpr", "qilang", "doc", "ast", 0 };
     int index = 0;
     const char* v = vals[index];
     while (v) {
@@ -37,15 +64,25 @@ namespace qilang {
       return false;
     }
     if (codegen == "qilang") {
-      out->out() << qilang::format(pr->ast);
+      qilang::format(out->out(), pr->ast);
       return true;
     }
     else if (codegen == "sexpr") {
-      out->out() << qilang::formatAST(pr->ast);
+      qilang::formatAST(out->out(), pr->ast);
       return true;
     }
     else if (codegen == "doc") {
-      out->out() << qilang::genDoc(pr->ast);
+      qilang::genDoc(out->out(), pr->ast);
+      return true;
+    }
+    else if (codegen == "ast") {
+      qilang::AstSourceStamp stamp;
+      if (!qilang::astSourceStamp(pr->filename, &stamp)) {
+        qiLogError() << "can't read '" << pr->filename << "'";
+        return false;
+      }
+      std::string data = qilang::serializeAST(pr->ast, stamp);
+      out->out().write(data.data(), data.size());
       return true;
     }
     pm->anal();
@@ -53,11 +90,11 @@ namespace qilang {
       return false;
     }
     if      (codegen == "cpp_interface" || codegen == "cppi")
-      out->out() << qilang::genCppObjectInterface(pm, pr);
+      qilang::genCppObjectInterface(out->out(), pm, pr);
     else if (codegen == "cpp_local"     || codegen == "cppl")
-      out->out() << qilang::genCppObjectLocal(pm, pr);
+      qilang::genCppObjectLocal(out->out(), pm, pr);
     else if (codegen == "cpp_remote"    || codegen == "cppr")
-      out->out() << qilang::genCppObjectRemote(pm, pr);
+      qilang::genCppObjectRemote(out->out(), pm, pr);
     return true;
   }
 
@@ -0,0 +1,65 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <qilang/commandline.hpp>
+#include <qilang/pathformatter.hpp>
+
+namespace qilang {
+
+  static bool fail(std::string* error, const std::string& what) {
+    if (error)
+      *error = what;
+    return false;
+  }
+
+  bool parseInputs(const CommandLineOptionVector& options, const Generation& single,
+                   InputVector* inputs, std::string* error) {
+    InputVector& ret = *inputs;
+    std::vector<Generation> leading;
+    for (unsigned i = 0; i < options.size(); ++i) {
+      const std::string& value = options[i].second;
+      if (options[i].first == "inputs") {
+        Input input;
+        input.file = formatPath(value);
+        ret.push_back(input);
+      } else if (options[i].first == "generate") {
+        //the codegen has no ':', the output may have one (C:\...)
+        std::string::size_type colon = value.find(':');
+        if (colon == std::string::npos || colon == 0)
+          return fail(error, "bad value for --generate: '" + value + "', expected codegen:output");
+        Generation gen;
+        gen.codegen = value.substr(0, colon);
+        gen.output  = formatPath(value.substr(colon + 1));
+        if (ret.empty())
+          leading.push_back(gen);
+        else
+          ret.back().generations.push_back(gen);
+      }
+    }
+    if (ret.empty())
+      return fail(error, "no input");
+    if (!leading.empty()) {
+      if (ret.size() != 1)
+        return fail(error, "--generate given before the input files: only valid with one input file");
+      ret[0].generations.insert(ret[0].generations.begin(), leading.begin(), leading.end());
+    }
+
+    //-c and -o: a single generation, for the inputs without -g
+    unsigned int singles = 0;
+    for (unsigned i = 0; i < ret.size(); ++i) {
+      if (!ret[i].generations.empty())
+        continue;
+      if (!single.output.empty() && singles++)
+        return fail(error, "-o is for a single input, use -g codegen:output");
+      if (single.codegen.empty())
+        return fail(error, "no codegen for '" + ret[i].file + "' (use -c or -g)");
+      ret[i].generations.push_back(single);
+    }
+    return true;
+  }
+
+}
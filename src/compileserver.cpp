@@ -0,0 +1,637 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <qilang/compileserver.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/parser.hpp>
+#include <qilang/pathformatter.hpp>
+#include <qi/log.hpp>
+#include <qi/os.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/make_shared.hpp>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <poll.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/time.h>
+# include <sys/un.h>
+# include <unistd.h>
+# ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+# endif
+#endif
+
+qiLogCategory("qilang.server");
+
+namespace qilang {
+
+  namespace fs = boost::filesystem;
+
+  static const char* const CompileServerMagic = "qicc-server";
+
+  // ###############
+  // # Pool
+  // ###############
+
+  //the .idl.qi files of dir, sorted: adding or removing one changes the packages
+  static std::string idlFiles(const std::string& dir) {
+    StringVector names;
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+      std::string name = it->path().filename().string();
+      if (boost::algorithm::ends_with(name, ".idl.qi"))
+        names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    return boost::algorithm::join(names, "\n");
+  }
+
+  static StringVector absolutePaths(const StringVector& paths) {
+    StringVector ret;
+    for (unsigned i = 0; i < paths.size(); ++i)
+      ret.push_back(formatPath(fs::absolute(paths.at(i)).string()));
+    return ret;
+  }
+
+  PackageManagerPtr PackageManagerPool::acquire(const StringVector& includes, const StringVector& lookupPaths, unsigned int jobs,
+                                                std::ostream& diagnostics) {
+    std::time_t now = std::time(0);
+    StringVector absIncludes = absolutePaths(includes);
+    StringVector absLookupPaths = absolutePaths(lookupPaths);
+    std::string key = boost::algorithm::join(absIncludes, "\n") + "\n--\n" + boost::algorithm::join(absLookupPaths, "\n");
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    ++_stats.acquired;
+    WorkspaceMap::iterator it;
+    while ((it = _workspaces.find(key)) != _workspaces.end() && it->second->busy)
+      _released.wait(lock);
+    if (it != _workspaces.end()) {
+      WorkspacePtr ws = it->second;
+      ws->busy = true;
+      //held: the files are checked without blocking the other runs
+      lock.unlock();
+      ws->pm->setDiagnosticStream(diagnostics);
+      bool fresh = refresh(*ws);
+      lock.lock();
+      if (fresh) {
+        ++_stats.reused;
+        ws->checked = now;
+        ws->pm->setJobs(jobs);
+        return ws->pm;
+      }
+      ++_stats.dropped;
+      _workspaces.erase(key);
+    }
+
+    WorkspacePtr ws = boost::make_shared<Workspace>();
+    ws->pm = newPackageManager();
+    ws->pm->setIncludes(absIncludes);
+    ws->pm->addLookupPaths(absLookupPaths);
+    ws->pm->setJobs(jobs);
+    ws->pm->setDiagnosticStream(diagnostics);
+    ws->checked = now;
+    ws->busy = true;
+    _workspaces[key] = ws;
+    return ws->pm;
+  }
+
+  bool PackageManagerPool::refresh(Workspace& ws) {
+    for (std::map<std::string, std::string>::const_iterator it = ws.dirs.begin(); it != ws.dirs.end(); ++it) {
+      if (idlFiles(it->first) != it->second) {
+        qiLogVerbose() << "files added or removed in '" << it->first << "'";
+        return false;
+      }
+    }
+
+    StringVector changed;
+    for (std::map<std::string, FileStamp>::iterator it = ws.files.begin(); it != ws.files.end(); ++it) {
+      boost::system::error_code ec;
+      FileStamp stamp;
+      stamp.size  = fs::file_size(it->first, ec);
+      stamp.mtime = ec ? 0 : fs::last_write_time(it->first, ec);
+      if (ec)
+        return false;
+      //a file written in the second it was read may have changed since
+      if (stamp.size == it->second.size && stamp.mtime == it->second.mtime && stamp.mtime < ws.checked)
+        continue;
+      ParseResultPtr pr = ws.pm->parseResult(it->first);
+      AstSourceStamp source;
+      if (!pr || !astSourceStamp(it->first, &source))
+        return false;
+      it->second = stamp;
+      if (source.hash == pr->sourceHash)
+        continue;
+      //the summary of its package is out of date: its files have to be parsed
+      if (pr->summary)
+        return false;
+      changed.push_back(it->first);
+    }
+
+    try {
+      for (unsigned i = 0; i < changed.size(); ++i) {
+        qiLogVerbose() << "'" << changed.at(i) << "' changed, parsing it again";
+        ws.pm->parseFile(newFileReader(changed.at(i)));
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          ++_stats.reparsed;
+        }
+        //a file moved to another package
+        if (!ws.pm->parseResult(changed.at(i)))
+          return false;
+      }
+    } catch (const std::exception& e) {
+      qiLogVerbose() << "can't parse again: " << e.what();
+      return false;
+    }
+    return true;
+  }
+
+  PackageManagerPool::WorkspaceMap::iterator PackageManagerPool::find(const PackageManagerPtr& pm) {
+    WorkspaceMap::iterator it = _workspaces.begin();
+    while (it != _workspaces.end() && it->second->pm != pm)
+      ++it;
+    return it;
+  }
+
+  void PackageManagerPool::erase(WorkspaceMap::iterator it) {
+    ++_stats.dropped;
+    _workspaces.erase(it);
+    _released.notify_all();
+  }
+
+  void PackageManagerPool::drop(const PackageManagerPtr& pm) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    WorkspaceMap::iterator it = find(pm);
+    if (it != _workspaces.end())
+      erase(it);
+  }
+
+  void PackageManagerPool::release(const PackageManagerPtr& pm) {
+    WorkspacePtr ws;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      WorkspaceMap::iterator it = find(pm);
+      if (it == _workspaces.end())
+        return;
+      //the stream of the run is gone
+      pm->setDiagnosticStream(std::cout);
+      if (pm->hasError()) {
+        erase(it);
+        return;
+      }
+      ws = it->second;
+    }
+
+    //still held: nobody else reads the stamps
+    ws->files.clear();
+    ws->dirs.clear();
+    StringVector files = pm->sourceFiles();
+    for (unsigned i = 0; i < files.size(); ++i) {
+      boost::system::error_code ec;
+      FileStamp& stamp = ws->files[files.at(i)];
+      stamp.size  = fs::file_size(files.at(i), ec);
+      stamp.mtime = ec ? 0 : fs::last_write_time(files.at(i), ec);
+      std::string dir = fs::path(files.at(i)).parent_path().string();
+      if (ws->dirs.find(dir) == ws->dirs.end())
+        ws->dirs[dir] = idlFiles(dir);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    ws->busy = false;
+    _released.notify_all();
+  }
+
+  PackageManagerPool::Stats PackageManagerPool::stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+  // ###############
+  // # Protocol
+  // ###############
+
+  static void writeField(std::string* data, const std::string& field) {
+    std::stringstream ss;
+    ss << field.size() << "\n";
+    *data += ss.str();
+    *data += field;
+  }
+
+  static bool readField(const std::string& data, std::size_t* pos, std::string* field) {
+    std::size_t eol = data.find('\n', *pos);
+    if (eol == std::string::npos || eol == *pos)
+      return false;
+    std::size_t size = 0;
+    for (std::size_t i = *pos; i < eol; ++i) {
+      if (data[i] < '0' || data[i] > '9')
+        return false;
+      size = size * 10 + (data[i] - '0');
+    }
+    if (size > data.size() - eol - 1)
+      return false;
+    field->assign(data, eol + 1, size);
+    *pos = eol + 1 + size;
+    return true;
+  }
+
+  static std::string header() {
+    std::stringstream ss;
+    ss << CompileServerMagic << " " << CompileServerVersion << "\n";
+    return ss.str();
+  }
+
+  static bool readHeader(const std::string& data, std::size_t* pos) {
+    std::string expected = header();
+    if (data.compare(0, expected.size(), expected) != 0)
+      return false;
+    *pos = expected.size();
+    return true;
+  }
+
+  static std::string formatRequest(const CompileRequest& request) {
+    std::string ret = header();
+    writeField(&ret, request.stop ? "stop" : "run");
+    writeField(&ret, request.cwd);
+    writeField(&ret, request.cache ? "1" : "0");
+    writeField(&ret, request.cacheDir);
+    std::stringstream argc;
+    argc << request.args.size();
+    writeField(&ret, argc.str());
+    for (unsigned i = 0; i < request.args.size(); ++i)
+      writeField(&ret, request.args.at(i));
+    return ret;
+  }
+
+  static bool parseRequest(const std::string& data, CompileRequest* request) {
+    std::size_t pos = 0;
+    std::string kind;
+    std::string cache;
+    std::string argc;
+    if (!readHeader(data, &pos) || !readField(data, &pos, &kind) || !readField(data, &pos, &request->cwd)
+        || !readField(data, &pos, &cache) || !readField(data, &pos, &request->cacheDir)
+        || !readField(data, &pos, &argc) || (kind != "run" && kind != "stop") || (cache != "1" && cache != "0"))
+      return false;
+    request->stop = kind == "stop";
+    request->cache = cache == "1";
+    //each argument takes 2 bytes at least
+    std::size_t count = std::strtoul(argc.c_str(), 0, 10);
+    if (count > data.size() - pos)
+      return false;
+    request->args.resize(count);
+    for (unsigned i = 0; i < request->args.size(); ++i) {
+      if (!readField(data, &pos, &request->args.at(i)))
+        return false;
+    }
+    return pos == data.size();
+  }
+
+  static std::string formatResponse(const CompileResponse& response) {
+    std::string ret = header();
+    std::stringstream status;
+    status << response.status;
+    writeField(&ret, status.str());
+    writeField(&ret, response.output);
+    return ret;
+  }
+
+  static bool parseResponse(const std::string& data, CompileResponse* response) {
+    std::size_t pos = 0;
+    std::string status;
+    if (!readHeader(data, &pos) || !readField(data, &pos, &status) || !readField(data, &pos, &response->output))
+      return false;
+    response->status = std::atoi(status.c_str());
+    return pos == data.size();
+  }
+
+  // ###############
+  // # Socket
+  // ###############
+
+#ifndef _WIN32
+  static bool socketAddress(const std::string& path, struct sockaddr_un* addr, std::string* error) {
+    std::memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+      if (error)
+        *error = "bad socket path '" + path + "' (too long?)";
+      return false;
+    }
+    std::memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+    return true;
+  }
+
+  static int connectTo(const std::string& path, std::string* error) {
+    struct sockaddr_un addr;
+    if (!socketAddress(path, &addr, error))
+      return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+      if (error)
+        *error = "can't connect to '" + path + "': " + std::strerror(errno);
+      if (fd >= 0)
+        ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  /** connect to a server of this user only: the socket path can be guessed,
+   *  anybody could listen on it and answer with fake outputs and statuses.
+   */
+  static int connectToOwn(const std::string& path, std::string* error) {
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode) || st.st_uid != ::getuid()) {
+      if (error)
+        *error = "'" + path + "' is not a socket of this user";
+      return -1;
+    }
+    int fd = connectTo(path, error);
+    if (fd < 0)
+      return -1;
+#if defined(SO_PEERCRED)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    bool own = ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == ::getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    bool own = ::getpeereid(fd, &uid, &gid) == 0 && uid == ::getuid();
+#endif
+    if (!own) {
+      if (error)
+        *error = "the server on '" + path + "' is not run by this user";
+      ::close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  static bool writeAll(int fd, const std::string& data) {
+    std::size_t done = 0;
+    while (done < data.size()) {
+      ssize_t n = ::send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      done += static_cast<std::size_t>(n);
+    }
+    return true;
+  }
+
+  //until the peer shuts down its side. false past maxSize bytes (0: no limit)
+  static bool readAll(int fd, std::string* data, std::size_t maxSize = 0) {
+    char buffer[65536];
+    for (;;) {
+      ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        return false;
+      if (n == 0)
+        return true;
+      data->append(buffer, static_cast<std::size_t>(n));
+      if (maxSize && data->size() > maxSize)
+        return false;
+    }
+  }
+
+  //a client that stops sending or reading can't hold the server longer
+  static void setTimeout(int fd, unsigned int seconds) {
+    struct timeval tv;
+    tv.tv_sec  = seconds;
+    tv.tv_usec = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  }
+
+  //the pipe stays readable: every thread polling it wakes up
+  static void wakeAll(int fd) {
+    if (::write(fd, "", 1) < 0)
+      qiLogError() << "can't stop the server threads: " << std::strerror(errno);
+  }
+
+  static void setNonBlocking(int fd, bool on) {
+    int flags = ::fcntl(fd, F_GETFL);
+    ::fcntl(fd, F_SETFL, on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+  }
+#endif
+
+  CompileServer::CompileServer(const std::string& socket)
+    : _socket(socket)
+    , _fd(-1)
+    , _jobs(std::max(1u, std::thread::hardware_concurrency()))
+  {
+    _wake[0] = _wake[1] = -1;
+  }
+
+  void CompileServer::setJobs(unsigned int jobs) {
+    _jobs = jobs ? jobs : 1;
+  }
+
+  CompileServer::~CompileServer() {
+#ifndef _WIN32
+    if (_fd >= 0) {
+      ::close(_fd);
+      ::unlink(_socket.c_str());
+    }
+#endif
+  }
+
+  std::string CompileServer::defaultSocket() {
+    std::string socket = qi::os::getenv("QICC_SERVER_SOCKET");
+    if (!socket.empty())
+      return socket;
+    std::string dir = qi::os::getenv("XDG_RUNTIME_DIR");
+    if (!dir.empty())
+      return (fs::path(dir) / "qicc.sock").string();
+    //the temporary directory is shared: one socket per user
+    std::string user = qi::os::getenv("USER");
+#ifndef _WIN32
+    if (user.empty()) {
+      std::stringstream ss;
+      ss << ::getuid();
+      user = ss.str();
+    }
+#endif
+    return (fs::path(qi::os::tmp()) / ("qicc-" + user + ".sock")).string();
+  }
+
+  bool CompileServer::listen(std::string* error) {
+#ifndef _WIN32
+    struct sockaddr_un addr;
+    if (!socketAddress(_socket, &addr, error))
+      return false;
+    //a socket left by a server that died is removed, a live one is not
+    int other = connectTo(_socket, 0);
+    if (other >= 0) {
+      ::close(other);
+      if (error)
+        *error = "a compile server already listens on '" + _socket + "'";
+      return false;
+    }
+    ::unlink(_socket.c_str());
+
+    _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    //only the user can send requests: they write files as the server
+    mode_t mask = ::umask(0077);
+    bool ok = _fd >= 0
+        && ::bind(_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0
+        && ::listen(_fd, SOMAXCONN) == 0;
+    ::umask(mask);
+    if (!ok) {
+      if (error)
+        *error = "can't listen on '" + _socket + "': " + std::strerror(errno);
+      if (_fd >= 0)
+        ::close(_fd);
+      _fd = -1;
+      return false;
+    }
+    qiLogVerbose() << "listening on " << _socket;
+    return true;
+#else
+    if (error)
+      *error = "the compile server is not available on this platform";
+    return false;
+#endif
+  }
+
+  void CompileServer::run(const Handler& handler) {
+#ifndef _WIN32
+    if (_fd < 0)
+      return;
+    if (::pipe(_wake) != 0) {
+      qiLogError() << "can't create the stop pipe: " << std::strerror(errno);
+      return;
+    }
+    //the threads all accept: those that lose a connection must not block
+    setNonBlocking(_fd, true);
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < _jobs; ++i)
+      threads.push_back(std::thread([this, &handler]() { serve(handler); }));
+    serve(handler);
+    for (unsigned i = 0; i < threads.size(); ++i)
+      threads[i].join();
+    ::close(_wake[0]);
+    ::close(_wake[1]);
+    _wake[0] = _wake[1] = -1;
+    ::close(_fd);
+    ::unlink(_socket.c_str());
+    _fd = -1;
+#else
+    (void)handler;
+#endif
+  }
+
+  void CompileServer::serve(const Handler& handler) {
+#ifndef _WIN32
+    for (;;) {
+      struct pollfd fds[2];
+      fds[0].fd = _wake[0];
+      fds[0].events = POLLIN;
+      fds[1].fd = _fd;
+      fds[1].events = POLLIN;
+      if (::poll(fds, 2, -1) < 0) {
+        if (errno == EINTR)
+          continue;
+        qiLogError() << "can't wait on '" << _socket << "': " << std::strerror(errno);
+        wakeAll(_wake[1]);
+        return;
+      }
+      if (fds[0].revents)
+        return;
+      int fd = ::accept(_fd, 0, 0);
+      if (fd < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED)
+          continue;
+        qiLogError() << "can't accept on '" << _socket << "': " << std::strerror(errno);
+        wakeAll(_wake[1]);
+        return;
+      }
+      //inherited from the listening socket on some systems
+      setNonBlocking(fd, false);
+      setTimeout(fd, CompileServerTimeout);
+      std::string data;
+      CompileRequest request;
+      CompileResponse response;
+      if (!readAll(fd, &data, CompileServerMaxRequest)) {
+        if (data.size() > CompileServerMaxRequest)
+          qiLogVerbose() << "request larger than " << CompileServerMaxRequest << " bytes, dropped";
+        else
+          qiLogVerbose() << "request not received: " << std::strerror(errno);
+        ::close(fd);
+        continue;
+      }
+      bool stop = false;
+      if (!parseRequest(data, &request)) {
+        qiLogVerbose() << "malformed request";
+        response.output = "Error: malformed request (client and server of different versions?)\n";
+      } else if (request.stop) {
+        stop = true;
+        response.status = 0;
+      } else {
+        try {
+          response = handler(request);
+        } catch (const std::exception& e) {
+          response.status = 1;
+          response.output = std::string("Exception: ") + e.what() + "\n";
+        }
+      }
+      if (!writeAll(fd, formatResponse(response)))
+        qiLogVerbose() << "the client left before the response";
+      ::close(fd);
+      //the requests being answered by the other threads are finished first
+      if (stop) {
+        wakeAll(_wake[1]);
+        return;
+      }
+    }
+#else
+    (void)handler;
+#endif
+  }
+
+  bool callCompileServer(const std::string& socket,
+                         const CompileRequest& request,
+                         CompileResponse* response,
+                         std::string* error) {
+#ifndef _WIN32
+    int fd = connectToOwn(socket, error);
+    if (fd < 0)
+      return false;
+    std::string data;
+    bool ok = writeAll(fd, formatRequest(request))
+        && ::shutdown(fd, SHUT_WR) == 0
+        && readAll(fd, &data);
+    ::close(fd);
+    if (!ok || !parseResponse(data, response)) {
+      if (error)
+        *error = "no response from the compile server on '" + socket + "'";
+      return false;
+    }
+    return true;
+#else
+    (void)socket;
+    (void)request;
+    (void)response;
+    if (error)
+      *error = "the compile server is not available on this platform";
+    return false;
+#endif
+  }
+
+}
@@ -180,7 +180,7 @@ static StringVector filenameFromImport(const PackagePtr& pkg, ImportNode* tnode)
     return pkg->files();
   }
   for (unsigned i = 0; i < tnode->imports.size(); ++i) {
-    std::string& name = tnode->imports.at(i);
+    Symbol name = tnode->imports.at(i);
     pushIfNot(ret, pkg->fileFromExport(name));
   }
   return ret;
@@ -205,16 +205,15 @@ static StringVector cppFilenameFromImport(const PackagePtr& pkg, ImportNode* tno
 }
 
 StringVector extractCppIncludeDir(const PackageManagerPtr& pm, const ParseResultPtr& pr, bool self) {
-  StringVector  includes;
-  NodePtrVector imports;
-  NodePtrVector typeExprs;
-  NodePtrVector decls;
+  StringVector         includes;
+  const NodePtrVector& imports   = pr->nodes(NodeType_Import);
+  const NodePtrVector& typeExprs = pr->nodes(NodeKind_TypeExpr);
+  const NodePtrVector& decls     = pr->nodes(NodeKind_Decl);
 
   if (self) {
     pushIfNot(includes, qiLangToCppInclude(pm->package(pr->package), pr->filename) + " //self");
   }
   //for each import generate the include.
-  imports = findNode(pr->ast, NodeType_Import);
   for (unsigned i = 0; i < imports.size(); ++i) {
     ImportNode* tnode = static_cast<ImportNode*>(imports.at(i).get());
     PackagePtr pkg = pm->package(tnode->name);
@@ -225,9 +224,8 @@ StringVector extractCppIncludeDir(const PackageManagerPtr& pm, const ParseResult
   }
 
   //for each TypeExpr generate include as appropriate (for built-in types)
-  typeExprs = findNode(pr->ast, NodeKind_TypeExpr);
   for (unsigned i = 0; i < typeExprs.size(); ++i) {
-    NodePtr& node = typeExprs.at(i);
+    const NodePtr& node = typeExprs.at(i);
     switch (node->type()) {
       case NodeType_TupleTypeExpr: {
         TupleTypeExprNode* tnode = static_cast<TupleTypeExprNode*>(node.get());
@@ -282,9 +280,8 @@ StringVector extractCppIncludeDir(const PackageManagerPtr& pm, const ParseResult
   }
 
   //for each TypeExpr generate include as appropriated  (for builtin types)
-  decls = findNode(pr->ast, NodeKind_Decl);
   for (unsigned i = 0; i < decls.size(); ++i) {
-    NodePtr& node = decls.at(i);
+    const NodePtr& node = decls.at(i);
     switch (node->type()) {
       case NodeType_SigDecl:
         pushIfNot(includes, "<qi/signal.hpp>");
@@ -31,7 +31,7 @@ namespace qilang {
     FormatAttr constattr;
 
     explicit CppTypeFormatter();
-    explicit CppTypeFormatter(std::stringstream& ss, int indent = 0);
+    explicit CppTypeFormatter(OutputStream& ss, int indent = 0);
 
     virtual void doAccept(Node* node) { node->accept(this); }
 
@@ -12,7 +12,7 @@ CppTypeFormatter<T>::CppTypeFormatter()
 }
 
 template <typename T>
-CppTypeFormatter<T>::CppTypeFormatter(std::stringstream& ss, int indent)
+CppTypeFormatter<T>::CppTypeFormatter(OutputStream& ss, int indent)
   : T(ss, indent)
 {
 }
@@ -0,0 +1,304 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <qilang/filewatcher.hpp>
+#include <qilang/pathformatter.hpp>
+#include <qi/log.hpp>
+#include <qi/os.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+
+#ifdef __linux__
+# include <poll.h>
+# include <sys/inotify.h>
+# include <unistd.h>
+#endif
+
+qiLogCategory("qilang.watch");
+
+namespace qilang {
+
+  namespace fs = boost::filesystem;
+
+  //changes closer than this to the previous one are reported with it
+  static const int SettleTime = 100;
+  static const int PollPeriod = 500;
+
+  static bool isIdlFile(const std::string& path) {
+    return boost::algorithm::ends_with(path, ".idl.qi");
+  }
+
+  FileWatcher::FileWatcher()
+    : _fd(-1)
+  {
+#ifdef __linux__
+    _fd = ::inotify_init1(IN_CLOEXEC);
+    if (_fd < 0)
+      qiLogVerbose() << "no inotify (" << std::strerror(errno) << "), the files are polled";
+#endif
+  }
+
+  FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (_fd >= 0)
+      ::close(_fd);
+#endif
+  }
+
+  bool FileWatcher::addTree(const std::string& dir, std::string* error) {
+    boost::system::error_code ec;
+    std::string root = formatPath(fs::absolute(dir).string());
+    if (!fs::is_directory(root, ec)) {
+      if (error)
+        *error = "'" + dir + "' is not a directory";
+      return false;
+    }
+    _trees.push_back(root);
+    if (!native()) {
+      _files = scan();
+      return true;
+    }
+    if (!addDir(root, error))
+      return false;
+    for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+      if (fs::is_directory(it->status()) && !addDir(it->path().string(), error))
+        return false;
+    }
+    return true;
+  }
+
+  bool FileWatcher::addDir(const std::string& dir, std::string* error) {
+#ifdef __linux__
+    int wd = ::inotify_add_watch(_fd, dir.c_str(),
+                                 IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF);
+    if (wd < 0) {
+      if (error)
+        *error = "can't watch '" + dir + "': " + std::strerror(errno);
+      return false;
+    }
+    _watches[wd] = formatPath(dir);
+    return true;
+#else
+    (void)dir;
+    (void)error;
+    return false;
+#endif
+  }
+
+  bool FileWatcher::wait(StringVector* files, int timeout) {
+    files->clear();
+    bool ret = native() ? readEvents(files, timeout) : poll(files, timeout);
+    std::sort(files->begin(), files->end());
+    files->erase(std::unique(files->begin(), files->end()), files->end());
+    return ret && !files->empty();
+  }
+
+  bool FileWatcher::readEvents(StringVector* files, int timeout) {
+#ifdef __linux__
+    //files created and not written since: hard links, only reported when the changes settle
+    std::set<std::string> created;
+    //wait for the first change, then until the changes settle
+    for (;;) {
+      struct pollfd pfd;
+      pfd.fd     = _fd;
+      pfd.events = POLLIN;
+      int n = ::poll(&pfd, 1, files->empty() && created.empty() ? timeout : SettleTime);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) {
+        files->insert(files->end(), created.begin(), created.end());
+        return !files->empty();
+      }
+
+      char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+      ssize_t size = ::read(_fd, buffer, sizeof(buffer));
+      if (size <= 0) {
+        files->insert(files->end(), created.begin(), created.end());
+        return !files->empty();
+      }
+      for (char* cur = buffer; cur < buffer + size; ) {
+        const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(cur);
+        cur += sizeof(struct inotify_event) + event->len;
+        if (event->mask & IN_Q_OVERFLOW) {
+          //events were lost: report every file of the trees
+          qiLogVerbose() << "inotify queue overflow, rescanning the watched trees";
+          rescan(files);
+          return true;
+        }
+        std::map<int, std::string>::iterator it = _watches.find(event->wd);
+        if (it == _watches.end())
+          continue;
+        if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+          _watches.erase(it);
+          continue;
+        }
+        if (!event->len)
+          continue;
+        std::string path = formatPath((fs::path(it->second) / event->name).string());
+        if (event->mask & IN_ISDIR) {
+          //a new directory: watch it, and report the files already there
+          if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            addDir(path, 0);
+            boost::system::error_code ec;
+            for (fs::recursive_directory_iterator dit(path, ec), end; !ec && dit != end; dit.increment(ec)) {
+              if (fs::is_directory(dit->status()))
+                addDir(dit->path().string(), 0);
+              else if (isIdlFile(dit->path().string()))
+                files->push_back(formatPath(dit->path().string()));
+            }
+          }
+          continue;
+        }
+        if (!isIdlFile(path))
+          continue;
+        //a created file is reported once written, or when the changes settle
+        if (event->mask & IN_CREATE) {
+          created.insert(path);
+          continue;
+        }
+        created.erase(path);
+        files->push_back(path);
+      }
+    }
+#else
+    (void)files;
+    (void)timeout;
+    return false;
+#endif
+  }
+
+  void FileWatcher::rescan(StringVector* files) {
+    for (unsigned i = 0; i < _trees.size(); ++i) {
+      addDir(_trees.at(i), 0);
+      boost::system::error_code ec;
+      for (fs::recursive_directory_iterator it(_trees.at(i), ec), end; !ec && it != end; it.increment(ec)) {
+        if (fs::is_directory(it->status()))
+          addDir(it->path().string(), 0);
+        else if (isIdlFile(it->path().string()))
+          files->push_back(formatPath(it->path().string()));
+      }
+    }
+  }
+
+  FileWatcher::FileStampMap FileWatcher::scan() const {
+    FileStampMap ret;
+    for (unsigned i = 0; i < _trees.size(); ++i) {
+      boost::system::error_code ec;
+      for (fs::recursive_directory_iterator it(_trees.at(i), ec), end; !ec && it != end; it.increment(ec)) {
+        std::string path = formatPath(it->path().string());
+        if (!isIdlFile(path))
+          continue;
+        boost::system::error_code fec;
+        FileStamp& stamp = ret[path];
+        stamp.size  = fs::file_size(path, fec);
+        stamp.mtime = fec ? 0 : fs::last_write_time(path, fec);
+      }
+    }
+    return ret;
+  }
+
+  bool FileWatcher::poll(StringVector* files, int timeout) {
+    int waited = 0;
+    for (;;) {
+      FileStampMap current = scan();
+      for (FileStampMap::const_iterator it = current.begin(); it != current.end(); ++it) {
+        FileStampMap::const_iterator old = _files.find(it->first);
+        if (old == _files.end() || !(old->second == it->second))
+          files->push_back(it->first);
+      }
+      for (FileStampMap::const_iterator it = _files.begin(); it != _files.end(); ++it) {
+        if (current.find(it->first) == current.end())
+          files->push_back(it->first);
+      }
+      _files = current;
+      if (!files->empty())
+        return true;
+      if (timeout >= 0 && waited >= timeout)
+        return false;
+      qi::os::msleep(PollPeriod);
+      waited += PollPeriod;
+    }
+  }
+
+  WatchedInputs::WatchedInputs(const PackageManagerPtr& pm, const StringVector& inputs)
+    : _pm(pm)
+    , _inputs(inputs)
+    , _prs(inputs.size())
+  {
+    for (unsigned i = 0; i < inputs.size(); ++i)
+      _pending.insert(i);
+  }
+
+  ParseResultPtr WatchedInputs::parseResult(unsigned int i) {
+    if (!_prs.at(i))
+      _prs[i] = _pm->parseFile(newFileReader(_inputs.at(i)));
+    return _prs[i];
+  }
+
+  //true when a source file known by the package manager is in the directory of file
+  bool WatchedInputs::inKnownDirectory(const std::string& file) const {
+    const fs::path dir = fs::path(file).parent_path();
+    const StringVector sources = _pm->sourceFiles();
+    for (unsigned i = 0; i < sources.size(); ++i) {
+      if (fs::path(sources.at(i)).parent_path() == dir)
+        return true;
+    }
+    return false;
+  }
+
+  void WatchedInputs::changed(const StringVector& files, std::ostream& diagnostics) {
+    std::set<std::string> packages;
+    for (unsigned i = 0; i < files.size(); ++i) {
+      const std::string& file = files.at(i);
+      qiLogVerbose() << "Changed: " << file;
+      for (unsigned j = 0; j < _inputs.size(); ++j) {
+        if (_inputs.at(j) == file) {
+          _prs[j].reset();
+          _pending.insert(j);
+        }
+      }
+      //the package the file was in, and the one it is in now
+      ParseResultPtr old = _pm->parseResult(file);
+      if (old)
+        packages.insert(old->package);
+      boost::system::error_code ec;
+      if (!fs::is_regular_file(file, ec)) {
+        _pm->removeFile(file);
+        continue;
+      }
+      //a new file matters in the directory of a package already read
+      if (!old && !inKnownDirectory(file))
+        continue;
+      try {
+        packages.insert(_pm->parseFile(newFileReader(file))->package);
+      } catch (const std::exception& e) {
+        diagnostics << "Exception: " << e.what() << std::endl;
+      }
+    }
+
+    //the packages importing them, as of the last analysis
+    const PackageGraph& graph = _pm->graph();
+    std::set<std::string> affected = packages;
+    for (std::set<std::string>::const_iterator it = packages.begin(); it != packages.end(); ++it) {
+      PackageGraph::Index index = graph.find(*it);
+      if (index == PackageGraph::NoIndex)
+        continue;
+      PackageGraph::IndexVector importers = graph.importers(index);
+      for (unsigned i = 0; i < importers.size(); ++i)
+        affected.insert(graph.name(importers[i]));
+    }
+    for (unsigned i = 0; i < _prs.size(); ++i) {
+      if (_prs[i] && affected.count(_prs[i]->package))
+        _pending.insert(i);
+    }
+  }
+
+}
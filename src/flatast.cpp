@@ -0,0 +1,191 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <qilang/flatast.hpp>
+#include <qilang/visitor.hpp>
+#include <boost/bind.hpp>
+
+namespace qilang {
+
+  const FlatAST::Index FlatAST::NoIndex;
+
+  /* Walk the AST with DefaultNodeVisitor: the callback gets the shared pointer
+   * of each node right before it goes through doAccept, exactly once, in
+   * pre-order. The visit methods only add the name of the node.
+   */
+  class FlatASTBuilder : public DefaultNodeVisitor {
+  public:
+    explicit FlatASTBuilder(FlatAST& flat)
+      : DefaultNodeVisitor(boost::bind(&FlatASTBuilder::next, this, _2))
+      , _flat(flat)
+      , _cur(FlatAST::NoIndex)
+    {}
+
+    void build(const NodePtrVector& ast) {
+      each(ast);
+      for (FlatAST::Index i = 0; i < _flat.size(); ++i) {
+        if (_flat._parents[i] == FlatAST::NoIndex)
+          _flat._roots.push_back(i);
+      }
+      buildChildren();
+    }
+
+    using DefaultNodeVisitor::visitDecl;
+    using DefaultNodeVisitor::visitStmt;
+    using DefaultNodeVisitor::visitExpr;
+    using DefaultNodeVisitor::visitTypeExpr;
+
+  protected:
+    virtual void doAccept(Node* node) {
+      FlatAST::Index index = _flat._types.size();
+      _flat._types.push_back(node->type());
+      _flat._kinds.push_back(node->kind());
+      _flat._parents.push_back(_cur);
+      _flat._ends.push_back(index + 1);
+      _flat._names.push_back(Symbol());
+      _flat._locs.push_back(node->loc());
+      _flat._nodes.push_back(_next);
+      _next.reset();
+
+      FlatAST::Index saved = _cur;
+      _cur = index;
+      node->accept(this);
+      _cur = saved;
+      _flat._ends[index] = _flat._types.size();
+    }
+
+    void name(const std::string& name) {
+      _flat._names[_cur] = Symbol(name);
+    }
+    void name(Symbol name) {
+      _flat._names[_cur] = name;
+    }
+
+    void visitDecl(InterfaceDeclNode* node) { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+    void visitDecl(FnDeclNode* node)        { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+    void visitDecl(SigDeclNode* node)       { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+    void visitDecl(PropDeclNode* node)      { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+    void visitDecl(StructDeclNode* node)    { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+    void visitDecl(ConstDeclNode* node)     { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+    void visitDecl(TypeDefDeclNode* node)   { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+    void visitDecl(EnumDeclNode* node)      { name(node->name); DefaultNodeVisitor::visitDecl(node); }
+
+    void visitStmt(PackageNode* node)       { name(node->name); DefaultNodeVisitor::visitStmt(node); }
+    void visitStmt(ImportNode* node)        { name(node->name); DefaultNodeVisitor::visitStmt(node); }
+    void visitStmt(ObjectDefNode* node)     { name(node->name); DefaultNodeVisitor::visitStmt(node); }
+    void visitStmt(PropertyDefNode* node)   { name(node->name); DefaultNodeVisitor::visitStmt(node); }
+    void visitStmt(VarDefNode* node)        { name(node->name); DefaultNodeVisitor::visitStmt(node); }
+
+    void visitExpr(VarExprNode* node)       { name(node->value); DefaultNodeVisitor::visitExpr(node); }
+    void visitExpr(CallExprNode* node)      { name(node->name); DefaultNodeVisitor::visitExpr(node); }
+
+    void visitTypeExpr(BuiltinTypeExprNode* node) { name(node->value); DefaultNodeVisitor::visitTypeExpr(node); }
+    void visitTypeExpr(CustomTypeExprNode* node)  { name(node->value); DefaultNodeVisitor::visitTypeExpr(node); }
+
+  private:
+    void next(const NodePtr& node) {
+      _next = node;
+    }
+
+    //counting sort of the nodes by parent, children keep their pre-order
+    void buildChildren() {
+      std::size_t count = _flat.size();
+      _flat._childBegins.assign(count + 1, 0);
+      for (FlatAST::Index i = 0; i < count; ++i) {
+        if (_flat._parents[i] != FlatAST::NoIndex)
+          ++_flat._childBegins[_flat._parents[i] + 1];
+      }
+      for (FlatAST::Index i = 0; i < count; ++i)
+        _flat._childBegins[i + 1] += _flat._childBegins[i];
+      _flat._children.resize(_flat._childBegins[count]);
+      FlatAST::IndexVector fill(_flat._childBegins.begin(), _flat._childBegins.end() - 1);
+      for (FlatAST::Index i = 0; i < count; ++i) {
+        FlatAST::Index p = _flat._parents[i];
+        if (p != FlatAST::NoIndex)
+          _flat._children[fill[p]++] = i;
+      }
+    }
+
+    FlatAST&       _flat;
+    FlatAST::Index _cur;
+    NodePtr        _next;
+  };
+
+  FlatAST::FlatAST()
+  {
+    clear();
+  }
+
+  FlatAST::FlatAST(const NodePtrVector& ast)
+  {
+    assign(ast);
+  }
+
+  void FlatAST::clear() {
+    _types.clear();
+    _kinds.clear();
+    _parents.clear();
+    _ends.clear();
+    _names.clear();
+    _locs.clear();
+    _nodes.clear();
+    _childBegins.assign(1, 0);
+    _children.clear();
+    _roots.clear();
+  }
+
+  void FlatAST::assign(const NodePtrVector& ast) {
+    clear();
+    FlatASTBuilder(*this).build(ast);
+  }
+
+  FlatAST::IndexVector FlatAST::find(NodeType type) const {
+    IndexVector result;
+    for (Index i = 0; i < _types.size(); ++i) {
+      if (_types[i] == type)
+        result.push_back(i);
+    }
+    return result;
+  }
+
+  FlatAST::IndexVector FlatAST::find(NodeKind kind) const {
+    IndexVector result;
+    for (Index i = 0; i < _kinds.size(); ++i) {
+      if (_kinds[i] == kind)
+        result.push_back(i);
+    }
+    return result;
+  }
+
+  FlatAST::IndexVector FlatAST::find(NodeType type, Symbol name) const {
+    IndexVector result;
+    for (Index i = 0; i < _types.size(); ++i) {
+      if (_types[i] == type && _names[i] == name)
+        result.push_back(i);
+    }
+    return result;
+  }
+
+  NodePtrVector FlatAST::findNode(NodeType type) const {
+    NodePtrVector result;
+    for (Index i = 0; i < _types.size(); ++i) {
+      if (_types[i] == type)
+        result.push_back(_nodes[i]);
+    }
+    return result;
+  }
+
+  NodePtrVector FlatAST::findNode(NodeKind kind) const {
+    NodePtrVector result;
+    for (Index i = 0; i < _kinds.size(); ++i) {
+      if (_kinds[i] == kind)
+        result.push_back(_nodes[i]);
+    }
+    return result;
+  }
+
+}
@@ -25,7 +25,7 @@ namespace qilang {
 class QiLangGenAsyncIface: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
 {
 public:
-  QiLangGenAsyncIface(std::stringstream& ss, std::string api)
+  QiLangGenAsyncIface(OutputStream& ss, std::string api)
     : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss)
     , apiExport(api)
   {}
@@ -79,7 +79,7 @@ class QiLangGenIfaceSigPropParam: public CppTypeFormatter<NodeFormatter<DefaultN
   bool first;
 
 public:
-  QiLangGenIfaceSigPropParam(std::stringstream& ss)
+  QiLangGenIfaceSigPropParam(OutputStream& ss)
     : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss)
     , first(true)
   {}
@@ -112,7 +112,7 @@ class QiLangGenIfaceSigPropParamInit: public CppTypeFormatter<NodeFormatter<Defa
   bool first;
 
 public:
-  QiLangGenIfaceSigPropParamInit(std::stringstream& ss, int indent)
+  QiLangGenIfaceSigPropParamInit(OutputStream& ss, int indent)
     : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss, indent)
     , first(true)
   {}
@@ -146,7 +146,7 @@ public:
 class QiLangGenIface: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
 {
 public:
-  QiLangGenIface(std::stringstream& ss, std::string api)
+  QiLangGenIface(OutputStream& ss, std::string api)
     : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss)
     , apiExport(api)
   {}
@@ -262,8 +262,9 @@ public:
 class QiLangGenObjectDef: public CppTypeFormatter<>
 {
 public:
-  QiLangGenObjectDef(const PackageManagerPtr& pm, const ParseResultPtr& pr, const StringVector& includes)
-    : toclose(0)
+  QiLangGenObjectDef(OutputStream& out, const PackageManagerPtr& pm, const ParseResultPtr& pr, const StringVector& includes)
+    : CppTypeFormatter<>(out)
+    , toclose(0)
     , currentNs()
     , _pm(pm)
     , _pr(pr)
@@ -280,7 +281,7 @@ public:
   FormatAttr  apiAttr;
   std::string apiExport;
 
-  std::string format(const NodePtrVector &nodes) override
+  void write(const NodePtrVector &nodes) override
   {
     formatHeader();
 
@@ -291,7 +292,7 @@ public:
         throw std::runtime_error("Invalid Node");
       firstPassFormatter.accept(node);
     }
-    out() << firstPassFormatter.out().str();
+    out().splice(firstPassFormatter.out());
 
     // Share the namespace information
     currentNs = firstPassFormatter.currentNs;
@@ -303,7 +304,6 @@ public:
     }
 
     formatFooter();
-    return this->out().str();
   }
 
   virtual void doAccept(Node* node) override { node->accept(this); }
@@ -505,9 +505,15 @@ protected:
 
 };
 
-std::string genCppObjectInterface(const PackageManagerPtr& pm, const ParseResultPtr& pr) {
+void genCppObjectInterface(OutputStream& out, const PackageManagerPtr& pm, const ParseResultPtr& pr) {
   StringVector sv = extractCppIncludeDir(pm, pr, false);
-  return QiLangGenObjectDef(pm, pr, sv).format(pr->ast);
+  QiLangGenObjectDef(out, pm, pr, sv).write(pr->ast);
+}
+
+std::string genCppObjectInterface(const PackageManagerPtr& pm, const ParseResultPtr& pr) {
+  OutputStream out;
+  genCppObjectInterface(out, pm, pr);
+  return out.str();
 }
 
 }
@@ -26,7 +26,7 @@ namespace qilang {
   class QiLangGenObjectLocalAsync: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
   {
   public:
-    QiLangGenObjectLocalAsync(std::stringstream& ss, int indent)
+    QiLangGenObjectLocalAsync(OutputStream& ss, int indent)
       : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss, indent)
     {}
 
@@ -121,7 +121,7 @@ namespace qilang {
   class QiLangGenObjectLocalSync: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
   {
   public:
-    QiLangGenObjectLocalSync(std::stringstream& ss, int indent)
+    QiLangGenObjectLocalSync(OutputStream& ss, int indent)
       : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss, indent)
     {}
 
@@ -207,7 +207,7 @@ namespace qilang {
   class QiLangGenObjectBind: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
   {
   public:
-    QiLangGenObjectBind(std::stringstream& ss, const StringVector& ns)
+    QiLangGenObjectBind(OutputStream& ss, const StringVector& ns)
       : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss)
     {
       BOOST_FOREACH(const std::string& nspart, ns) {
@@ -335,8 +335,9 @@ namespace qilang {
     StringVector _includes;
     StringVector _ns;
 
-    QiLangGenObjects(StringVector includes, std::string packageName, std::string fileName)
-      : toclose(0)
+    QiLangGenObjects(OutputStream& out, StringVector includes, std::string packageName, std::string fileName)
+      : NodeFormatter<DefaultNodeVisitor>(out, 0)
+      , toclose(0)
       , _includes(includes)
       , _packageName(std::move(packageName))
       , _fileName(fileName)
@@ -403,8 +404,14 @@ namespace qilang {
     const std::string _fileName;
   };
 
-std::string genCppObjectLocal(const PackageManagerPtr& pm, const ParseResultPtr& pr) {
+void genCppObjectLocal(OutputStream& out, const PackageManagerPtr& pm, const ParseResultPtr& pr) {
   StringVector sv = extractCppIncludeDir(pm, pr, true);
-  return QiLangGenObjects(sv, pr->package, pr->filename).format(pr->ast);
+  QiLangGenObjects(out, sv, pr->package, pr->filename).write(pr->ast);
+}
+
+std::string genCppObjectLocal(const PackageManagerPtr& pm, const ParseResultPtr& pr) {
+  OutputStream out;
+  genCppObjectLocal(out, pm, pr);
+  return out.str();
 }
 }
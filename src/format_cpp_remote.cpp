@@ -22,7 +22,7 @@ namespace qilang {
   class CppAsyncRemoteQiLangGen: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
   {
   public:
-    CppAsyncRemoteQiLangGen(std::stringstream& ss, int indent)
+    CppAsyncRemoteQiLangGen(OutputStream& ss, int indent)
       : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss, indent)
     {}
 
@@ -96,7 +96,7 @@ namespace qilang {
   class CppProxySigPropQiLangGen: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
   {
   public:
-    CppProxySigPropQiLangGen(std::stringstream& ss, int indent)
+    CppProxySigPropQiLangGen(OutputStream& ss, int indent)
       : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss, indent)
     {}
 
@@ -112,7 +112,7 @@ namespace qilang {
   class CppDeclareSigPropQiLangGen: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
   {
   public:
-    CppDeclareSigPropQiLangGen(std::stringstream& ss, int indent)
+    CppDeclareSigPropQiLangGen(OutputStream& ss, int indent)
       : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss, indent)
     {}
 
@@ -134,7 +134,7 @@ namespace qilang {
   class CppSyncRemoteQiLangGen: public CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >
   {
   public:
-    CppSyncRemoteQiLangGen(std::stringstream& ss, int indent)
+    CppSyncRemoteQiLangGen(OutputStream& ss, int indent)
       : CppTypeFormatter<NodeFormatter<DefaultNodeVisitor> >(ss, indent)
     {}
 
@@ -278,8 +278,9 @@ namespace qilang {
   class CppRemoteQiLangGen: public CppTypeFormatter<>
   {
   public:
-    CppRemoteQiLangGen(const PackageManagerPtr& pm, const StringVector& includes)
-      : _includes(includes)
+    CppRemoteQiLangGen(OutputStream& out, const PackageManagerPtr& pm, const StringVector& includes)
+      : CppTypeFormatter<>(out)
+      , _includes(includes)
     {}
 
     void doAccept(Node* node) override { node->accept(this); }
@@ -383,9 +384,15 @@ namespace qilang {
 
 };
 
-std::string genCppObjectRemote(const PackageManagerPtr& pm, const ParseResultPtr& pr) {
+void genCppObjectRemote(OutputStream& out, const PackageManagerPtr& pm, const ParseResultPtr& pr) {
   StringVector sv = extractCppIncludeDir(pm, pr, true);
-  return CppRemoteQiLangGen(pm, sv).format(pr->ast);
+  CppRemoteQiLangGen(out, pm, sv).write(pr->ast);
+}
+
+std::string genCppObjectRemote(const PackageManagerPtr& pm, const ParseResultPtr& pr) {
+  OutputStream out;
+  genCppObjectRemote(out, pm, pr);
+  return out.str();
 }
 
 }
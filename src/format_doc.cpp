@@ -80,6 +80,11 @@ public:
   QiLangGenDoc() {
     first.push(true);
   }
+  explicit QiLangGenDoc(OutputStream& out)
+    : NodeFormatter<>(out, 0)
+  {
+    first.push(true);
+  }
 
   std::stack<bool> first;
   boost::scoped_ptr<Doc> curDoc;
@@ -275,4 +280,10 @@ std::string genDoc(const NodePtrVector& node) {
   return "{" + QiLangGenDoc().format(node) + "}";
 }
 
+void genDoc(OutputStream& out, const NodePtrVector& node) {
+  out << "{";
+  QiLangGenDoc(out).write(node);
+  out << "}";
+}
+
 }
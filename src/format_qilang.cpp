@@ -19,6 +19,14 @@ namespace qilang {
   // #############
   class QiLangFormatter : public NodeFormatter<>
   {
+  public:
+    QiLangFormatter()
+    {}
+    explicit QiLangFormatter(OutputStream& out)
+      : NodeFormatter<>(out, 0)
+    {}
+
+  private:
     virtual void doAccept(Node* node) { node->accept(this); }
 
     void dict(LiteralNodePtrPairVector pv) {
@@ -277,4 +285,8 @@ namespace qilang {
     return QiLangFormatter().format(node);
   }
 
+  void format(OutputStream& out, const NodePtrVector& node) {
+    QiLangFormatter(out).write(node);
+  }
+
 }
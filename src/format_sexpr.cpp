@@ -19,6 +19,14 @@ namespace qilang {
   // #############
   class QiLangASTFormatter : public NodeFormatter<>
   {
+  public:
+    QiLangASTFormatter()
+    {}
+    explicit QiLangASTFormatter(OutputStream& out)
+      : NodeFormatter<>(out, 0)
+    {}
+
+  private:
     virtual void doAccept(Node* node) { node->accept(this); }
 
     const std::string &dict(LiteralNodePtrPairVector pv) {
@@ -85,12 +93,12 @@ namespace qilang {
     }
     void visitTypeExpr(VarArgTypeExprNode* node) {
       out() << "(varg ";
-      accept(node->element);
+      accept(node->effectiveElement());
       out() << ")";
     }
     void visitTypeExpr(KeywordArgTypeExprNode* node) {
       out() << "(kwarg ";
-      accept(node->value);
+      accept(node->effectiveValue());
       out() << ")";
     }
 
@@ -271,4 +279,8 @@ namespace qilang {
     return QiLangASTFormatter().format(node);
   }
 
+  void formatAST(OutputStream& out, const NodePtrVector& node) {
+    QiLangASTFormatter(out).write(node);
+  }
+
 }
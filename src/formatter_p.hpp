@@ -9,6 +9,7 @@
 # define   	FORMATTER_P_HPP_
 
 #include <qilang/node.hpp>
+#include <qilang/outputbuffer.hpp>
 #include <qilang/packagemanager.hpp>
 
 namespace std {
@@ -90,17 +91,17 @@ namespace qilang {
     BasicNodeFormatter()
       : _ss(_ssi)
     {}
-    explicit BasicNodeFormatter(std::stringstream& ss)
+    explicit BasicNodeFormatter(OutputStream& ss)
       : _ss(ss)
     {}
 
-    std::stringstream &out() {
+    OutputStream &out() {
       return _ss;
     }
 
   private:
-    std::stringstream& _ss;
-    std::stringstream _ssi;
+    OutputStream& _ss;
+    OutputStream  _ssi;
   };
 
   /**
@@ -117,7 +118,7 @@ namespace qilang {
     IndentNodeFormatter()
       : _indent(0)
     {}
-    explicit IndentNodeFormatter(std::stringstream& ss, int _indent)
+    explicit IndentNodeFormatter(OutputStream& ss, int _indent)
       : BasicNodeFormatter(ss)
       , _indent(_indent)
     {}
@@ -140,14 +141,11 @@ namespace qilang {
     virtual void formatFooter() {};
 
   public:
-    std::stringstream &indent(int changes = 0) {
+    OutputStream &indent(int changes = 0) {
       _indent += changes;
       if (_indent < 0)
         _indent = 0;
-      for (int i = 0; i < _indent; ++i) {
-        out().put(' ');
-      }
-      return out();
+      return out().repeat(' ', _indent);
     }
 
     //indented block
@@ -159,7 +157,7 @@ namespace qilang {
   template <typename B = NodeVisitor>
   class NodeFormatter : public IndentNodeFormatter, public B {
   public:
-    explicit NodeFormatter(std::stringstream& ss, int indent)
+    explicit NodeFormatter(OutputStream& ss, int indent)
       : IndentNodeFormatter(ss, indent)
     {}
     NodeFormatter()
@@ -195,7 +193,8 @@ namespace qilang {
     virtual void formatHeader() {}
     virtual void formatFooter() {}
 
-    virtual std::string format(const NodePtrVector& node) {
+    //! format the nodes into out()
+    virtual void write(const NodePtrVector& node) {
       formatHeader();
       for (unsigned int i = 0; i < node.size(); ++i) {
         if (!node.at(i))
@@ -203,15 +202,24 @@ namespace qilang {
         this->accept(node.at(i));
       }
       formatFooter();
-      return this->out().str();
     }
 
-    virtual std::string format(const NodePtr& node) {
+    virtual void write(const NodePtr& node) {
       if (!node)
         throw std::runtime_error("Invalid Node");
       formatHeader();
       this->accept(node);
       formatFooter();
+    }
+
+    //! the formatted nodes, in a string: write() streams them instead
+    std::string format(const NodePtrVector& node) {
+      write(node);
+      return this->out().str();
+    }
+
+    std::string format(const NodePtr& node) {
+      write(node);
       return this->out().str();
     }
   };
@@ -36,44 +36,43 @@
 %lex-param   { qilang::Parser* context }
 
 %code requires {
+  #include <qilang/symbol.hpp>
+
   namespace qilang {
     class Parser;
   }
 
   #define NODE0(TYPE, LOC) \
-    boost::make_shared< qilang::TYPE >(qilang::makeLocation(LOC))
+    context->newNode< qilang::TYPE >(context->makeLocation(LOC))
   #define NODE1(TYPE, LOC, a) \
-    boost::make_shared< qilang::TYPE >(a, qilang::makeLocation(LOC))
+    context->newNode< qilang::TYPE >(a, context->makeLocation(LOC))
   #define NODE2(TYPE, LOC, a, b) \
-    boost::make_shared< qilang::TYPE >(a, b, qilang::makeLocation(LOC))
+    context->newNode< qilang::TYPE >(a, b, context->makeLocation(LOC))
   #define NODE3(TYPE, LOC, a, b, c) \
-    boost::make_shared< qilang::TYPE >(a, b, c, qilang::makeLocation(LOC))
+    context->newNode< qilang::TYPE >(a, b, c, context->makeLocation(LOC))
   #define NODE4(TYPE, LOC, a, b, c, d) \
-    boost::make_shared< qilang::TYPE >(a, b, c, d, qilang::makeLocation(LOC))
+    context->newNode< qilang::TYPE >(a, b, c, d, context->makeLocation(LOC))
 
   #define NODEC0(TYPE, LOC, N) \
-    boost::make_shared< qilang::TYPE >(qilang::makeLocation(LOC), N->comment())
+    context->newNode< qilang::TYPE >(context->makeLocation(LOC), N)
   #define NODEC1(TYPE, LOC, N, a) \
-    boost::make_shared< qilang::TYPE >(a, qilang::makeLocation(LOC), N->comment())
+    context->newNode< qilang::TYPE >(a, context->makeLocation(LOC), N)
   #define NODEC2(TYPE, LOC, N, a, b) \
-    boost::make_shared< qilang::TYPE >(a, b, qilang::makeLocation(LOC), N->comment())
+    context->newNode< qilang::TYPE >(a, b, context->makeLocation(LOC), N)
   #define NODEC3(TYPE, LOC, N, a, b, c) \
-    boost::make_shared< qilang::TYPE >(a, b, c, qilang::makeLocation(LOC), N->comment())
+    context->newNode< qilang::TYPE >(a, b, c, context->makeLocation(LOC), N)
   #define NODEC4(TYPE, LOC, N, a, b, c, d) \
-    boost::make_shared< qilang::TYPE >(a, b, c, d, qilang::makeLocation(LOC), N->comment())
+    context->newNode< qilang::TYPE >(a, b, c, d, context->makeLocation(LOC), N)
 }
 
 %code {
 
-  typedef void* yyscan_t;
-  yy::parser::symbol_type qilang_lex(yyscan_t lex);
-
   yy::parser::symbol_type yylex(qilang::Parser* context)
   {
-    return qilang_lex(context->scanner);
+    return context->lex();
   }
 
-  qilang::TypeExprNodePtr makeType(const yy::location& loc, const std::string& id) {
+  qilang::TypeExprNodePtr makeType(qilang::Parser* context, const yy::location& loc, qilang::Symbol id) {
     // ### WARNING ###
     // keep in sync with node.hpp enum BuiltinType
     const char *builtin[] = {
@@ -90,7 +89,7 @@
     int index = 0;
     const char *t = builtin[index];
     while (t != 0) {
-      if (id == t)
+      if (id.str() == t)
         return NODE2(BuiltinTypeExprNode, loc, static_cast<qilang::BuiltinType>(index), id);
       index++;
       t = builtin[index];
@@ -167,12 +166,13 @@
   MAP                 "Map"
   TUPLE               "Tuple"
 
-%token <qilang::KeywordNodePtr>
+// the value is the documentation comment preceding the keyword
+%token <std::string>
   INTERFACE           "interface"
   FN                  "fn"
 
 %token <qilang::LiteralNodePtr>   STRING CONSTANT
-%token <std::string>              ID
+%token <qilang::Symbol>           ID
 
 // the first item here is the last to evaluate, the last item is the first
 %left  "||"
@@ -200,8 +200,8 @@ toplevel:
 
 %type<qilang::NodePtrVector> toplevel.1;
 toplevel.1:
-  toplevel_def            { $$.push_back($1); }
-| toplevel.1 toplevel_def { std::swap($$, $1); $$.push_back($2); }
+  toplevel_def            { $$.push_back($1); context->endToplevel(@1); }
+| toplevel.1 toplevel_def { std::swap($$, $1); $$.push_back($2); context->endToplevel(@2); }
 
 %type<qilang::NodePtr> toplevel_def;
 toplevel_def:
@@ -235,7 +235,7 @@ import:
 | FROM ID IMPORT "*"               { $$ = NODE2(ImportNode, @$, qilang::ImportType_All, $2); }
 | FROM ID IMPORT import_defs       { $$ = NODE3(ImportNode, @$, qilang::ImportType_List, $2, $4); }
 
-%type<qilang::StringVector> import_defs;
+%type<qilang::SymbolVector> import_defs;
 import_defs:
   ID                               { $$.push_back($1); }
 | import_defs "," ID               { std::swap($$, $1);
@@ -283,7 +283,7 @@ at_expr:
 // #######################################################################################
 %type<qilang::TypeExprNodePtr> type;
 type:
-  ID                                { $$ = makeType(@$, $1); }
+  ID                                { $$ = makeType(context, @$, $1); }
 | "Vec" "<" type ">"                { $$ = NODE1(ListTypeExprNode, @$, $3); }
 | "Map" "<" type "," type ">"       { $$ = NODE2(MapTypeExprNode, @$, $3, $5); }
 | "Tuple" "<" tuple_type_defs ">"   { $$ = NODE1(TupleTypeExprNode, @$, $3); }
@@ -592,5 +592,5 @@ list_defs.1:
 
 void yy::parser::error(const yy::parser::location_type& loc, const std::string& msg)
 {
-  throw qilang::ParseException(qilang::makeLocation(loc), msg);
+  throw qilang::ParseException(context->makeLocation(loc), msg);
 }
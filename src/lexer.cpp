@@ -0,0 +1,406 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <cstring>
+#include <sstream>
+#include <qilang/node.hpp>
+#include "parser_p.hpp"
+#include "lexer.hpp"
+#include "numeric.hpp"
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+namespace qilang {
+
+  // ###############
+  // # Keywords
+  // ###############
+  enum Keyword {
+    Keyword_None = 0,
+    Keyword_And,
+    Keyword_Or,
+    Keyword_True,
+    Keyword_False,
+    Keyword_Package,
+    Keyword_From,
+    Keyword_Import,
+    Keyword_Object,
+    Keyword_Struct,
+    Keyword_End,
+    Keyword_Const,
+    Keyword_Fn,
+    Keyword_Sig,
+    Keyword_Prop,
+    Keyword_At,
+    Keyword_For,
+    Keyword_If,
+    Keyword_Typedef,
+    Keyword_Enum,
+    Keyword_Interface,
+    Keyword_Vec,
+    Keyword_Map,
+    Keyword_Tuple
+  };
+
+  struct KeywordEntry {
+    const char*  text;
+    std::size_t  size;
+    Keyword      keyword;
+  };
+
+  static const KeywordEntry keywordList[] = {
+    { "and", 3, Keyword_And },          { "or", 2, Keyword_Or },
+    { "true", 4, Keyword_True },        { "false", 5, Keyword_False },
+    { "package", 7, Keyword_Package },  { "from", 4, Keyword_From },
+    { "import", 6, Keyword_Import },    { "object", 6, Keyword_Object },
+    { "struct", 6, Keyword_Struct },    { "end", 3, Keyword_End },
+    { "const", 5, Keyword_Const },      { "fn", 2, Keyword_Fn },
+    { "sig", 3, Keyword_Sig },          { "prop", 4, Keyword_Prop },
+    { "at", 2, Keyword_At },            { "for", 3, Keyword_For },
+    { "if", 2, Keyword_If },            { "typedef", 7, Keyword_Typedef },
+    { "enum", 4, Keyword_Enum },        { "interface", 9, Keyword_Interface },
+    { "Vec", 3, Keyword_Vec },          { "Map", 3, Keyword_Map },
+    { "Tuple", 5, Keyword_Tuple },
+  };
+
+  /* Perfect hash of the keywords: the size, the first and the last character
+   * give a distinct slot to each of them. Check keywordTable when adding one.
+   */
+  static const unsigned KeywordTableSize = 64;
+  static const std::size_t KeywordMinSize = 2;
+  static const std::size_t KeywordMaxSize = 9;
+
+  static inline unsigned keywordHash(const char* str, std::size_t size) {
+    return (static_cast<unsigned>(size) * 2
+            + static_cast<unsigned char>(str[0])
+            + static_cast<unsigned char>(str[size - 1]) * 24) & (KeywordTableSize - 1);
+  }
+
+  struct KeywordTable {
+    KeywordTable() {
+      std::memset(entries, 0, sizeof(entries));
+      for (unsigned i = 0; i < sizeof(keywordList) / sizeof(keywordList[0]); ++i) {
+        const KeywordEntry& kw = keywordList[i];
+        KeywordEntry& slot = entries[keywordHash(kw.text, kw.size)];
+        if (slot.text)
+          throw std::logic_error(std::string("keyword hash collision: ") + kw.text + " and " + slot.text);
+        slot = kw;
+      }
+    }
+
+    Keyword find(const char* str, std::size_t size) const {
+      if (size < KeywordMinSize || size > KeywordMaxSize)
+        return Keyword_None;
+      const KeywordEntry& slot = entries[keywordHash(str, size)];
+      if (slot.size == size && std::memcmp(slot.text, str, size) == 0)
+        return slot.keyword;
+      return Keyword_None;
+    }
+
+    KeywordEntry entries[KeywordTableSize];
+  };
+
+  static const KeywordTable& keywordTable() {
+    static const KeywordTable table;
+    return table;
+  }
+
+  // ###############
+  // # Characters
+  // ###############
+  static inline bool isIdStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+  }
+
+  static inline bool isIdChar(char c) {
+    return isIdStart(c) || (c >= '0' && c <= '9') || c == '.';
+  }
+
+  static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+  }
+
+  //end of the run of spaces and tabs starting at p
+  static inline const char* skipBlanks(const char* p, const char* end) {
+#ifdef __SSE2__
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab   = _mm_set1_epi8('\t');
+    while (end - p >= 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab));
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(blank));
+      if (mask != 0xFFFF)
+        return p + __builtin_ctz(~mask);
+      p += 16;
+    }
+#endif
+    while (p < end && (*p == ' ' || *p == '\t'))
+      ++p;
+    return p;
+  }
+
+  //end of the line starting at p (flex '.' matches anything but \n), memchr is vectorized by the libc
+  static inline const char* lineEnd(const char* p, const char* end) {
+    const void* eol = std::memchr(p, '\n', end - p);
+    return eol ? static_cast<const char*>(eol) : end;
+  }
+
+  // ###############
+  // # Lexer
+  // ###############
+#define LOC _context->loc
+
+#define LEX_OP(Size, Symbol)                                          \
+  do {                                                                \
+    advance(Size);                                                    \
+    yy::parser::symbol_type tok = yy::parser::make_ ## Symbol(LOC);   \
+    LOC.step();                                                       \
+    return tok;                                                       \
+  } while (false)
+
+#define LEX_OP2(Size, Symbol, Next, Symbol2)                          \
+  do {                                                                \
+    if (_cur + 1 < _end && _cur[1] == Next)                           \
+      LEX_OP(2, Symbol2);                                             \
+    LEX_OP(Size, Symbol);                                             \
+  } while (false)
+
+  Lexer::Lexer(Parser* context, const char* begin, const char* end)
+    : _context(context)
+    , _cur(begin)
+    , _end(end)
+  {
+    keywordTable();
+  }
+
+  void Lexer::advance(std::size_t size) {
+    LOC.columns(static_cast<int>(size));
+    _cur += size;
+  }
+
+  void Lexer::newLine(std::size_t size) {
+    advance(size);
+    if (!_context->lastComment.empty())
+    {
+      if (++_context->linesSinceLastComment == 2)
+      {
+        _context->linesSinceLastComment = 0;
+        _context->lastComment.clear();
+      }
+    }
+    LOC.lines(1);
+    LOC.step();
+  }
+
+  //documentation comment: appended to lastComment, the location is not stepped (as in token.l)
+  void Lexer::comment(std::size_t prefix, const char* end) {
+    const char* begin = _cur + prefix;
+    advance(end - _cur);
+    _context->lastComment.append(begin, end);
+    _context->lastComment += '\n';
+    _context->linesSinceLastComment = 0;
+  }
+
+  void Lexer::invalidToken() {
+    char c = *_cur;
+    advance(1);
+    LOC.step();
+    std::stringstream ss;
+    ss << "invalid token '" << (c ? std::string(1, c) : std::string()) << "'";
+    _context->parser.error(LOC, ss.str());
+  }
+
+  yy::parser::symbol_type Lexer::lex() {
+    while (_cur < _end) {
+      switch (*_cur) {
+        case ' ':
+        case '\t':
+          advance(skipBlanks(_cur, _end) - _cur);
+          LOC.step();
+          continue;
+        case '\n':
+          newLine(_cur + 1 < _end && _cur[1] == '\r' ? 2 : 1);
+          continue;
+        case '\r':
+          //a lone \r matches the '.' rule of token.l before EOL
+          if (_cur + 1 < _end && _cur[1] == '\n')
+            newLine(2);
+          else
+            invalidToken();
+          continue;
+        case '#': {
+          const char* end = lineEnd(_cur, _end);
+          if (end - _cur >= 2 && _cur[1] == '!') {
+            comment(2, end);
+          } else {
+            advance(end - _cur);
+            LOC.step();
+          }
+          continue;
+        }
+        case '/': {
+          if (!(_cur + 1 < _end && _cur[1] == '/'))
+            LEX_OP(1, SLASH);
+          const char* end = lineEnd(_cur, _end);
+          if (end - _cur >= 3 && _cur[2] == '!') {
+            comment(3, end);
+          } else {
+            advance(end - _cur);
+            LOC.step();
+          }
+          continue;
+        }
+        case '"':
+          if (std::memchr(_cur + 1, '"', _end - _cur - 1))
+            return string();
+          invalidToken();
+          continue;
+
+        case '!': LEX_OP2(1, BANG, '=', NOT_EQ);
+        case '%': LEX_OP(1, PERCENT);
+        case '*': LEX_OP2(1, STAR, '*', STARSTAR);
+        case '+': LEX_OP(1, PLUS);
+        case '-': LEX_OP2(1, MINUS, '>', ARROW);
+        case '=': LEX_OP2(1, EQ, '=', EQ_EQ);
+        case '>': LEX_OP2(1, GT, '=', GT_EQ);
+        case '<': LEX_OP2(1, LT, '=', LT_EQ);
+        case '&': LEX_OP2(1, AND, '&', AMPERSAND_AMPERSAND);
+        case '|': LEX_OP2(1, OR, '|', PIPE_PIPE);
+        case '{': LEX_OP(1, LBRACE);
+        case '}': LEX_OP(1, RBRACE);
+        case '(': LEX_OP(1, LPAREN);
+        case ')': LEX_OP(1, RPAREN);
+        case '~': LEX_OP(1, TILDA);
+        case '[': LEX_OP(1, LBRACKET);
+        case ']': LEX_OP(1, RBRACKET);
+        case ',': LEX_OP(1, COMMA);
+        case '^': LEX_OP(1, XOR);
+        case '@': LEX_OP(1, ARO);
+        case ':': LEX_OP(1, COLON);
+
+        default:
+          if (isIdStart(*_cur))
+            return identifier();
+          if (isDigit(*_cur))
+            return number();
+          invalidToken();
+          continue;
+      }
+    }
+    return yy::parser::make_END_OF_FILE(LOC);
+  }
+
+  // NATURAL or FLOAT: NATURAL\.NATURAL{EXPONENT}? | NATURAL{EXPONENT}
+  yy::parser::symbol_type Lexer::number() {
+    const char* p = _cur;
+    while (p < _end && isDigit(*p))
+      ++p;
+    bool isFloat = false;
+    if (p + 1 < _end && *p == '.' && isDigit(p[1])) {
+      isFloat = true;
+      p += 2;
+      while (p < _end && isDigit(*p))
+        ++p;
+    }
+    if (p < _end && (*p == 'e' || *p == 'E')) {
+      const char* e = p + 1;
+      if (e < _end && (*e == '-' || *e == '+'))
+        ++e;
+      if (e < _end && isDigit(*e)) {
+        isFloat = true;
+        p = e;
+        while (p < _end && isDigit(*p))
+          ++p;
+      }
+    }
+
+    const char* begin = _cur;
+    advance(p - _cur);
+    LiteralNodePtr node;
+    if (isFloat) {
+      double value = 0;
+      if (!parseFloat(begin, p, &value))
+        _context->parser.error(LOC, "float constant out of range");
+      node = _context->newNode<FloatLiteralNode>(value, _context->makeLocation(LOC));
+    } else {
+      qi::uint64_t value = 0;
+      if (!parseNatural(begin, p, &value))
+        _context->parser.error(LOC, "integer constant out of range");
+      node = _context->newNode<IntLiteralNode>(value, _context->makeLocation(LOC));
+    }
+    yy::parser::symbol_type tok = yy::parser::make_CONSTANT(node, LOC);
+    LOC.step();
+    return tok;
+  }
+
+  yy::parser::symbol_type Lexer::identifier() {
+    const char* begin = _cur;
+    const char* p = _cur + 1;
+    while (p < _end && isIdChar(*p))
+      ++p;
+    std::size_t size = p - begin;
+    advance(size);
+
+    switch (keywordTable().find(begin, size)) {
+      case Keyword_None:
+        break;
+      case Keyword_And:       { yy::parser::symbol_type tok = yy::parser::make_AMPERSAND_AMPERSAND(LOC); LOC.step(); return tok; }
+      case Keyword_Or:        { yy::parser::symbol_type tok = yy::parser::make_PIPE_PIPE(LOC); LOC.step(); return tok; }
+      case Keyword_True:      { yy::parser::symbol_type tok = yy::parser::make_TRUE(LOC); LOC.step(); return tok; }
+      case Keyword_False:     { yy::parser::symbol_type tok = yy::parser::make_FALSE(LOC); LOC.step(); return tok; }
+      case Keyword_Package:   { yy::parser::symbol_type tok = yy::parser::make_PACKAGE(LOC); LOC.step(); return tok; }
+      case Keyword_From:      { yy::parser::symbol_type tok = yy::parser::make_FROM(LOC); LOC.step(); return tok; }
+      case Keyword_Import:    { yy::parser::symbol_type tok = yy::parser::make_IMPORT(LOC); LOC.step(); return tok; }
+      case Keyword_Object:    { yy::parser::symbol_type tok = yy::parser::make_OBJECT(LOC); LOC.step(); return tok; }
+      case Keyword_Struct:    { yy::parser::symbol_type tok = yy::parser::make_STRUCT(LOC); LOC.step(); return tok; }
+      case Keyword_End:       { yy::parser::symbol_type tok = yy::parser::make_END(LOC); LOC.step(); return tok; }
+      case Keyword_Const:     { yy::parser::symbol_type tok = yy::parser::make_CONST(LOC); LOC.step(); return tok; }
+      case Keyword_Sig:       { yy::parser::symbol_type tok = yy::parser::make_SIG(LOC); LOC.step(); return tok; }
+      case Keyword_Prop:      { yy::parser::symbol_type tok = yy::parser::make_PROP(LOC); LOC.step(); return tok; }
+      case Keyword_At:        { yy::parser::symbol_type tok = yy::parser::make_AT(LOC); LOC.step(); return tok; }
+      case Keyword_For:       { yy::parser::symbol_type tok = yy::parser::make_FOR(LOC); LOC.step(); return tok; }
+      case Keyword_If:        { yy::parser::symbol_type tok = yy::parser::make_IF(LOC); LOC.step(); return tok; }
+      case Keyword_Typedef:   { yy::parser::symbol_type tok = yy::parser::make_TYPEDEF(LOC); LOC.step(); return tok; }
+      case Keyword_Enum:      { yy::parser::symbol_type tok = yy::parser::make_ENUM(LOC); LOC.step(); return tok; }
+      case Keyword_Vec:       { yy::parser::symbol_type tok = yy::parser::make_VEC(LOC); LOC.step(); return tok; }
+      case Keyword_Map:       { yy::parser::symbol_type tok = yy::parser::make_MAP(LOC); LOC.step(); return tok; }
+      case Keyword_Tuple:     { yy::parser::symbol_type tok = yy::parser::make_TUPLE(LOC); LOC.step(); return tok; }
+      case Keyword_Fn: {
+        yy::parser::symbol_type tok = yy::parser::make_FN(_context->lastComment, LOC);
+        LOC.step();
+        return tok;
+      }
+      case Keyword_Interface: {
+        yy::parser::symbol_type tok = yy::parser::make_INTERFACE(_context->lastComment, LOC);
+        LOC.step();
+        return tok;
+      }
+    }
+
+    yy::parser::symbol_type tok = yy::parser::make_ID(Symbol(begin, size), LOC);
+    LOC.step();
+    return tok;
+  }
+
+  // STRING: ["][^"]*["], the closing quote is known to exist
+  yy::parser::symbol_type Lexer::string() {
+    const char* begin = _cur + 1;
+    const char* end = static_cast<const char*>(std::memchr(begin, '"', _end - begin));
+    advance(end + 1 - _cur);
+    LiteralNodePtr node = _context->newNode<StringLiteralNode>(std::string(begin, end), _context->makeLocation(LOC));
+    yy::parser::symbol_type tok = yy::parser::make_STRING(node, LOC);
+    LOC.step();
+    return tok;
+  }
+
+#undef LEX_OP2
+#undef LEX_OP
+#undef LOC
+
+}
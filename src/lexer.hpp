@@ -0,0 +1,46 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_LEXER_HPP_
+#define QILANG_LEXER_HPP_
+
+#include "grammar.tab.hpp"
+
+namespace qilang {
+
+  class Parser;
+
+  /** Hand-written replacement of the flex scanner (token.l).
+   *
+   *  It produces the same tokens, locations and comment handling as the flex
+   *  rules, including their longest match and rule order, over a contiguous
+   *  buffer that must outlive it. The buffer is not modified.
+   */
+  class Lexer {
+  public:
+    Lexer(Parser* context, const char* begin, const char* end);
+
+    yy::parser::symbol_type lex();
+
+  private:
+    void advance(std::size_t size);
+    void newLine(std::size_t size);
+    void comment(std::size_t prefix, const char* end);
+    void invalidToken();
+
+    yy::parser::symbol_type number();
+    yy::parser::symbol_type identifier();
+    yy::parser::symbol_type string();
+
+    Parser*     _context;
+    const char* _cur;
+    const char* _end;
+  };
+
+}
+
+#endif  // QILANG_LEXER_HPP_
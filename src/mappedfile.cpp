@@ -0,0 +1,125 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <fstream>
+#include "mappedfile.hpp"
+#include <boost/filesystem.hpp>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace qilang {
+
+  //an empty file is "open" but has no mapping: point at a valid empty string
+  static const char emptyData[1] = { 0 };
+
+  MappedFile::MappedFile()
+    : _data(0)
+    , _size(0)
+    , _mapped(false)
+  {}
+
+  MappedFile::~MappedFile() {
+    close();
+  }
+
+  bool MappedFile::open(const std::string& filename) {
+    close();
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+      ::close(fd);
+      return false;
+    }
+    if (st.st_size == 0) {
+      ::close(fd);
+      _data = emptyData;
+      return true;
+    }
+    void* addr = ::mmap(0, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr != MAP_FAILED) {
+      _data   = static_cast<const char*>(addr);
+      _size   = static_cast<std::size_t>(st.st_size);
+      _mapped = true;
+      return true;
+    }
+#endif
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!is.is_open())
+      return false;
+    is.seekg(0, std::ios::end);
+    std::streamoff size = is.tellg();
+    is.seekg(0, std::ios::beg);
+    if (size < 0)
+      return false;
+    _buffer.resize(static_cast<std::size_t>(size));
+    if (size > 0 && !is.read(&_buffer[0], size)) {
+      _buffer.clear();
+      return false;
+    }
+    _data = _buffer.empty() ? emptyData : &_buffer[0];
+    _size = _buffer.size();
+    return true;
+  }
+
+  void MappedFile::close() {
+#ifndef _WIN32
+    if (_mapped)
+      ::munmap(const_cast<char*>(_data), _size);
+#endif
+    std::vector<char>().swap(_buffer);
+    _data   = 0;
+    _size   = 0;
+    _mapped = false;
+  }
+
+  bool writeFileAtomically(const std::string& filename, const FileContentWriter& write,
+                           std::ios::openmode mode, std::string* error) {
+    namespace fs = boost::filesystem;
+    boost::system::error_code ec;
+    fs::path path(filename);
+    if (path.has_parent_path())
+      fs::create_directories(path.parent_path(), ec);
+    //readers, and concurrent writers of the same file (parallel builds,
+    //qicc runs sharing a tree), must never see a partial file
+    fs::path tmp = path;
+    tmp += fs::unique_path(".%%%%-%%%%.tmp");
+    {
+      std::ofstream os(tmp.string().c_str(), mode | std::ios::out);
+      if (!os || !write(os) || !os.flush()) {
+        if (error)
+          *error = "can't write '" + tmp.string() + "'";
+        os.close();
+        fs::remove(tmp, ec);
+        return false;
+      }
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+      if (error)
+        *error = "can't write '" + filename + "': " + ec.message();
+      fs::remove(tmp, ec);
+      return false;
+    }
+    return true;
+  }
+
+  bool writeFileAtomically(const std::string& filename, const std::string& content, std::string* error) {
+    return writeFileAtomically(filename, [&content](std::ostream& os) {
+      return static_cast<bool>(os.write(content.data(), content.size()));
+    }, std::ios::binary, error);
+  }
+
+}
@@ -0,0 +1,58 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_MAPPEDFILE_HPP_
+#define QILANG_MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <ios>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace qilang {
+
+  /** Read only view of a whole file.
+   *
+   * The file is mmap'ed on POSIX systems, and read in memory elsewhere.
+   */
+  class MappedFile : private boost::noncopyable {
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    //! map filename, return false if the file can't be opened or read
+    bool open(const std::string& filename);
+    void close();
+
+    bool        isOpen() const { return _data != 0; }
+    const char* data() const   { return _data; }
+    std::size_t size() const   { return _size; }
+
+  private:
+    const char*       _data;
+    std::size_t       _size;
+    bool              _mapped;
+    std::vector<char> _buffer;   // fallback storage when the file is not mapped
+  };
+
+  //! writes the content of a file on a stream, false on failure
+  typedef boost::function<bool (std::ostream&)> FileContentWriter;
+
+  /** write a whole file atomically: the content goes to a temporary file
+   *  next to it, renamed over filename once complete. The parent directory
+   *  is created. On failure, error (if set) tells why.
+   */
+  bool writeFileAtomically(const std::string& filename, const FileContentWriter& write,
+                           std::ios::openmode mode = std::ios::binary, std::string* error = 0);
+  bool writeFileAtomically(const std::string& filename, const std::string& content, std::string* error = 0);
+
+}
+
+#endif  // QILANG_MAPPEDFILE_HPP_
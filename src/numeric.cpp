@@ -0,0 +1,99 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <locale>
+#include <sstream>
+#include <string>
+#include "numeric.hpp"
+
+namespace qilang {
+
+  bool parseNatural(const char* begin, const char* end, qi::uint64_t* value) {
+    static const qi::uint64_t max = static_cast<qi::uint64_t>(-1);
+    qi::uint64_t v = 0;
+    for (const char* p = begin; p != end; ++p) {
+      unsigned int d = *p - '0';
+      if (v > (max - d) / 10)
+        return false;
+      v = v * 10 + d;
+    }
+    *value = v;
+    return true;
+  }
+
+  // powers of ten exactly representable by a double
+  static const double exactPowers[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  //slow path, correctly rounded by the standard library
+  static bool parseFloatClassic(const char* begin, const char* end, double* value) {
+    std::istringstream is(std::string(begin, end));
+    is.imbue(std::locale::classic());
+    double v = 0;
+    is >> v;
+    if (is.fail())
+      return false;
+    *value = v;
+    return true;
+  }
+
+  /* Most literals have a few significant digits and a small exponent: the
+   * mantissa and the power of ten are then both exact doubles, and a single
+   * multiplication or division gives the correctly rounded result.
+   */
+  bool parseFloat(const char* begin, const char* end, double* value) {
+    const qi::uint64_t maxExactMantissa = static_cast<qi::uint64_t>(1) << 53;
+    qi::uint64_t mantissa = 0;
+    int digits = 0;     // significant digits in mantissa
+    int exponent = 0;
+    const char* p = begin;
+
+    for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+      if (mantissa || *p != '0') {
+        if (++digits > 19)
+          return parseFloatClassic(begin, end, value);
+        mantissa = mantissa * 10 + (*p - '0');
+      }
+    }
+    if (p != end && *p == '.') {
+      for (++p; p != end && *p >= '0' && *p <= '9'; ++p) {
+        if (mantissa || *p != '0') {
+          if (++digits > 19)
+            return parseFloatClassic(begin, end, value);
+          mantissa = mantissa * 10 + (*p - '0');
+        }
+        --exponent;
+      }
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+      ++p;
+      bool negative = false;
+      if (p != end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+      int e = 0;
+      for (; p != end; ++p) {
+        if (e > 100000)
+          return parseFloatClassic(begin, end, value);
+        e = e * 10 + (*p - '0');
+      }
+      exponent += negative ? -e : e;
+    }
+
+    if (mantissa == 0) {
+      *value = 0.0;
+      return true;
+    }
+    if (mantissa > maxExactMantissa || exponent < -22 || exponent > 22)
+      return parseFloatClassic(begin, end, value);
+    double m = static_cast<double>(mantissa);
+    *value = exponent < 0 ? m / exactPowers[-exponent] : m * exactPowers[exponent];
+    return true;
+  }
+
+}
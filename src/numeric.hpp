@@ -0,0 +1,28 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#ifndef QILANG_NUMERIC_HPP_
+#define QILANG_NUMERIC_HPP_
+
+#include <qi/types.hpp>
+
+namespace qilang {
+
+  /* Conversion of the numeric tokens of the lexers. The text is the one of
+   * the token, it is already known to be well formed. The conversions do not
+   * depend on the locale and return false if the value is out of range.
+   */
+
+  //! NATURAL: [0-9]+
+  bool parseNatural(const char* begin, const char* end, qi::uint64_t* value);
+
+  //! FLOAT: [0-9]+ ("." [0-9]+)? ([eE] [-+]? [0-9]+)?
+  bool parseFloat(const char* begin, const char* end, double* value);
+
+}
+
+#endif  // QILANG_NUMERIC_HPP_
@@ -0,0 +1,154 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <qilang/outputbuffer.hpp>
+
+namespace qilang {
+
+  const std::size_t OutputBuffer::MinChunkSize;
+  const std::size_t OutputBuffer::MaxChunkSize;
+
+  OutputBuffer::OutputBuffer()
+    : _sealed(0)
+  {}
+
+  std::size_t OutputBuffer::size() const {
+    return _sealed + (pptr() - pbase());
+  }
+
+  void OutputBuffer::clear() {
+    _chunks.clear();
+    _sealed = 0;
+    setp(0, 0);
+  }
+
+  void OutputBuffer::grow(std::size_t min) {
+    std::size_t capacity = MinChunkSize;
+    if (!_chunks.empty()) {
+      std::size_t used = pptr() - pbase();
+      capacity = std::min(_chunks.back().capacity() * 2, MaxChunkSize);
+      if (used) {
+        _chunks.back().resize(used);
+        _sealed += used;
+      } else {
+        _chunks.pop_back();
+      }
+    }
+    _chunks.push_back(std::vector<char>(std::max(capacity, min)));
+    std::vector<char>& chunk = _chunks.back();
+    setp(&chunk[0], &chunk[0] + chunk.size());
+  }
+
+  OutputBuffer::int_type OutputBuffer::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      return traits_type::not_eof(c);
+    grow(1);
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+  }
+
+  std::streamsize OutputBuffer::xsputn(const char* s, std::streamsize n) {
+    std::size_t left = static_cast<std::size_t>(n);
+    while (left) {
+      std::size_t room = epptr() - pptr();
+      if (!room) {
+        grow(left);
+        continue;
+      }
+      std::size_t count = std::min(room, left);
+      std::memcpy(pptr(), s, count);
+      pbump(static_cast<int>(count));
+      s    += count;
+      left -= count;
+    }
+    return n;
+  }
+
+  void OutputBuffer::repeat(char c, std::size_t count) {
+    while (count) {
+      std::size_t room = epptr() - pptr();
+      if (!room) {
+        grow(count);
+        continue;
+      }
+      std::size_t n = std::min(room, count);
+      std::memset(pptr(), c, n);
+      pbump(static_cast<int>(n));
+      count -= n;
+    }
+  }
+
+  void OutputBuffer::splice(OutputBuffer& other) {
+    if (&other == this || other.empty())
+      return;
+    //small outputs (a nested formatter) are cheaper copied than in a chunk of their own
+    if (other.size() < MaxChunkSize / 4) {
+      for (unsigned i = 0; i < other._chunks.size(); ++i) {
+        std::size_t n = i + 1 < other._chunks.size() ? other._chunks[i].size() : other.pptr() - other.pbase();
+        if (n)
+          xsputn(&other._chunks[i][0], static_cast<std::streamsize>(n));
+      }
+      other.clear();
+      return;
+    }
+
+    std::size_t total = size() + other.size();
+    if (!_chunks.empty())
+      _chunks.back().resize(pptr() - pbase());
+    other._chunks.back().resize(other.pptr() - other.pbase());
+    for (unsigned i = 0; i < other._chunks.size(); ++i) {
+      if (!other._chunks[i].empty()) {
+        _chunks.push_back(std::vector<char>());
+        _chunks.back().swap(other._chunks[i]);
+      }
+    }
+    other.clear();
+    //the last chunk is full: the next write starts a new one
+    std::vector<char>& last = _chunks.back();
+    _sealed = total - last.size();
+    setp(&last[0], &last[0] + last.size());
+    pbump(static_cast<int>(last.size()));
+  }
+
+  std::string OutputBuffer::str() const {
+    std::string ret;
+    ret.reserve(size());
+    for (unsigned i = 0; i < _chunks.size(); ++i) {
+      std::size_t n = i + 1 < _chunks.size() ? _chunks[i].size() : pptr() - pbase();
+      ret.append(n ? &_chunks[i][0] : "", n);
+    }
+    return ret;
+  }
+
+  bool OutputBuffer::writeTo(std::ostream& os) const {
+    for (unsigned i = 0; i < _chunks.size() && os; ++i) {
+      std::size_t n = i + 1 < _chunks.size() ? _chunks[i].size() : pptr() - pbase();
+      if (n)
+        os.write(&_chunks[i][0], static_cast<std::streamsize>(n));
+    }
+    return os.good();
+  }
+
+  bool OutputBuffer::equals(std::istream& is) const {
+    std::vector<char> data(MaxChunkSize);
+    for (unsigned i = 0; i < _chunks.size(); ++i) {
+      std::size_t n = i + 1 < _chunks.size() ? _chunks[i].size() : pptr() - pbase();
+      for (std::size_t done = 0; done < n; ) {
+        std::size_t count = std::min(n - done, data.size());
+        if (!is.read(&data[0], static_cast<std::streamsize>(count)) ||
+            std::memcmp(&data[0], &_chunks[i][done], count) != 0)
+          return false;
+        done += count;
+      }
+    }
+    return is.peek() == std::istream::traits_type::eof();
+  }
+
+}
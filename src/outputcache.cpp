@@ -0,0 +1,541 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <qilang/outputcache.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/pathformatter.hpp>
+#include "mappedfile.hpp"
+#include <qi/log.hpp>
+#include <qi/os.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+
+qiLogCategory("qilang.cache");
+
+namespace qilang {
+
+  namespace fs = boost::filesystem;
+
+  const qi::uint64_t OutputCache::DefaultMaxSize;
+
+  static const char* const OutputManifestMagic = "qilang-output-manifest";
+  //results kept per run key: one per build directory of the same sources, usually
+  static const unsigned int MaxManifestEntries = 16;
+
+  //two FNV-1a 64 chains with different offsets, for 128 bits keys
+  class KeyHasher {
+  public:
+    KeyHasher()
+      : _a(14695981039346656037ULL)
+      , _b(0x6c62272e07bb0142ULL)
+    {}
+
+    void add(const char* data, std::size_t size) {
+      for (std::size_t i = 0; i < size; ++i) {
+        _a ^= static_cast<unsigned char>(data[i]);
+        _a *= 1099511628211ULL;
+        _b ^= static_cast<unsigned char>(data[i]);
+        _b *= 1099511628211ULL;
+      }
+    }
+
+    void add(qi::uint64_t value) {
+      add(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void add(const std::string& str) {
+      add(static_cast<qi::uint64_t>(str.size()));
+      add(str.data(), str.size());
+    }
+
+    std::string key() const {
+      char buf[33];
+      std::snprintf(buf, sizeof(buf), "%016llx%016llx",
+                    static_cast<unsigned long long>(_a), static_cast<unsigned long long>(_b));
+      return buf;
+    }
+
+    qi::uint64_t hash() const { return _a; }
+
+  private:
+    qi::uint64_t _a;
+    qi::uint64_t _b;
+  };
+
+  //held while the statistics or a manifest are read and written back
+  class CacheLock {
+  public:
+    explicit CacheLock(const std::string& dir)
+      : _locked(false)
+    {
+      std::string filename = (fs::path(dir) / "lock").string();
+      boost::system::error_code ec;
+      fs::create_directories(dir, ec);
+      try {
+        //a file_lock needs an existing file
+        std::ofstream(filename.c_str(), std::ios::out | std::ios::app);
+        _lock = boost::interprocess::file_lock(filename.c_str());
+        _lock.lock();
+        _locked = true;
+      } catch (const std::exception& e) {
+        qiLogVerbose() << "can't lock '" << filename << "': " << e.what();
+      }
+    }
+
+    ~CacheLock() {
+      if (_locked)
+        _lock.unlock();
+    }
+
+    bool locked() const { return _locked; }
+
+  private:
+    boost::interprocess::file_lock _lock;
+    bool                           _locked;
+  };
+
+  static bool readFile(const fs::path& path, std::string* data) {
+    std::ifstream is(path.string().c_str(), std::ios::in | std::ios::binary);
+    if (!is)
+      return false;
+    data->assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    return !is.bad();
+  }
+
+  //hash of the names of the .idl.qi files of dir
+  static qi::uint64_t listingHash(const std::string& dir) {
+    StringVector names;
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+      std::string name = it->path().filename().string();
+      if (boost::algorithm::ends_with(name, ".idl.qi"))
+        names.push_back(name);
+    }
+    std::sort(names.begin(), names.end());
+    KeyHasher h;
+    for (unsigned i = 0; i < names.size(); ++i)
+      h.add(names.at(i));
+    return h.hash();
+  }
+
+  struct ManifestFile {
+    ManifestFile()
+      : size(0)
+      , hash(0)
+    {}
+
+    qi::uint64_t size;
+    qi::uint64_t hash;
+    std::string  name;
+  };
+
+  struct ManifestEntry {
+    ManifestEntry()
+      : outputs(0)
+    {}
+
+    std::string                                   result;
+    unsigned int                                  outputs;
+    std::vector<ManifestFile>                     files;
+    std::vector<std::pair<qi::uint64_t, std::string> > listings;
+  };
+  typedef std::vector<ManifestEntry> ManifestEntryVector;
+
+  static ManifestEntryVector readManifest(const fs::path& path) {
+    ManifestEntryVector ret;
+    std::string data;
+    if (!readFile(path, &data))
+      return ret;
+    std::istringstream is(data);
+    std::string  line;
+    std::string  magic;
+    unsigned int version = 0;
+    std::getline(is, line);
+    std::istringstream header(line);
+    header >> magic >> version;
+    if (!header || magic != OutputManifestMagic || version != OutputCacheVersion)
+      return ret;
+
+    while (std::getline(is, line)) {
+      std::istringstream ls(line);
+      char kind = 0;
+      bool ok = false;
+      ls >> kind;
+      if (kind == 'r') {
+        ManifestEntry entry;
+        ok = static_cast<bool>(ls >> entry.result >> entry.outputs);
+        ret.push_back(entry);
+      } else if (kind == 'f' && !ret.empty()) {
+        ManifestFile file;
+        ok = static_cast<bool>(ls >> file.size >> file.hash >> std::ws) && std::getline(ls, file.name) && !file.name.empty();
+        ret.back().files.push_back(file);
+      } else if (kind == 'l' && !ret.empty()) {
+        std::pair<qi::uint64_t, std::string> listing;
+        ok = static_cast<bool>(ls >> listing.first >> std::ws) && std::getline(ls, listing.second) && !listing.second.empty();
+        ret.back().listings.push_back(listing);
+      }
+      if (!ok) {
+        qiLogVerbose() << "'" << path.string() << "' is malformed";
+        return ManifestEntryVector();
+      }
+    }
+    return ret;
+  }
+
+  static std::string formatManifest(const ManifestEntryVector& entries) {
+    std::ostringstream os;
+    os << OutputManifestMagic << " " << OutputCacheVersion << "\n";
+    for (unsigned i = 0; i < entries.size(); ++i) {
+      const ManifestEntry& entry = entries.at(i);
+      os << "r " << entry.result << " " << entry.outputs << "\n";
+      for (unsigned j = 0; j < entry.files.size(); ++j)
+        os << "f " << entry.files.at(j).size << " " << entry.files.at(j).hash << " " << entry.files.at(j).name << "\n";
+      for (unsigned j = 0; j < entry.listings.size(); ++j)
+        os << "l " << entry.listings.at(j).first << " " << entry.listings.at(j).second << "\n";
+    }
+    return os.str();
+  }
+
+  OutputCache::OutputCache(const std::string& dir, qi::uint64_t maxSize)
+    : _dir(dir)
+    , _maxSize(maxSize)
+  {}
+
+  std::string OutputCache::defaultDir() {
+    std::string dir = qi::os::getenv("QICC_CACHE_DIR");
+    if (!dir.empty())
+      return dir;
+    dir = qi::os::getenv("XDG_CACHE_HOME");
+    if (!dir.empty())
+      return (fs::path(dir) / "qicc").string();
+    return (fs::path(qi::os::home()) / ".cache" / "qicc").string();
+  }
+
+  std::string OutputCache::path(const std::string& key, const std::string& suffix) const {
+    return (fs::path(_dir) / key.substr(0, 2) / (key + suffix)).string();
+  }
+
+  void OutputCache::setBaseDirs(const StringVector& dirs) {
+    _baseDirs.clear();
+    for (unsigned i = 0; i < dirs.size(); ++i) {
+      std::string dir = formatPath(fs::absolute(dirs.at(i)).string());
+      while (dir.size() > 1 && (dir[dir.size() - 1] == '/' || dir[dir.size() - 1] == fs::path::preferred_separator))
+        dir.erase(dir.size() - 1);
+      _baseDirs.push_back(dir);
+    }
+  }
+
+  std::string OutputCache::relative(const std::string& file) const {
+    std::string path = formatPath(fs::absolute(file).string());
+    for (unsigned i = 0; i < _baseDirs.size(); ++i) {
+      const std::string& base = _baseDirs.at(i);
+      if (path.size() <= base.size() + 1 || path.compare(0, base.size(), base) != 0)
+        continue;
+      char sep = path[base.size()];
+      if (sep != '/' && sep != fs::path::preferred_separator)
+        continue;
+      std::stringstream ss;
+      ss << "$" << i << "/" << path.substr(base.size() + 1);
+      return ss.str();
+    }
+    return path;
+  }
+
+  std::string OutputCache::absolute(const std::string& name) const {
+    if (name.empty() || name[0] != '$')
+      return name;
+    std::istringstream is(name.substr(1));
+    unsigned int index = 0;
+    char sep = 0;
+    if (!(is >> index) || !is.get(sep) || sep != '/' || index >= _baseDirs.size())
+      return std::string();
+    std::string rest;
+    std::getline(is, rest);
+    return formatPath((fs::path(_baseDirs.at(index)) / rest).string());
+  }
+
+  std::string OutputCache::runKey(const StringVector& parts, const StringVector& files) const {
+    KeyHasher h;
+    h.add(static_cast<qi::uint64_t>(OutputCacheVersion));
+    h.add(static_cast<qi::uint64_t>(parts.size()));
+    for (unsigned i = 0; i < parts.size(); ++i)
+      h.add(parts.at(i));
+    h.add(static_cast<qi::uint64_t>(_baseDirs.size()));
+    for (unsigned i = 0; i < files.size(); ++i) {
+      AstSourceStamp stamp;
+      if (!astSourceStamp(files.at(i), &stamp))
+        return std::string();
+      h.add(relative(files.at(i)));
+      h.add(stamp.size);
+      h.add(stamp.hash);
+    }
+    return h.key();
+  }
+
+  bool OutputCache::lookup(const std::string& runKey, Result* result) {
+    Stats delta;
+    delta.misses = 1;
+    ManifestEntryVector entries;
+    if (!runKey.empty())
+      entries = readManifest(path(runKey, ".manifest"));
+
+    //the files are shared by the entries of different configurations
+    std::map<std::string, AstSourceStamp> stamps;
+    for (unsigned i = 0; i < entries.size() && delta.misses; ++i) {
+      const ManifestEntry& entry = entries.at(i);
+      Result found;
+      bool ok = true;
+      for (unsigned j = 0; ok && j < entry.files.size(); ++j) {
+        const ManifestFile& file = entry.files.at(j);
+        std::string filename = absolute(file.name);
+        std::map<std::string, AstSourceStamp>::iterator it = stamps.find(filename);
+        if (it == stamps.end()) {
+          AstSourceStamp stamp;
+          if (filename.empty() || !astSourceStamp(filename, &stamp))
+            stamp.size = stamp.hash = 0;
+          it = stamps.insert(std::make_pair(filename, stamp)).first;
+        }
+        ok = it->second.size == file.size && it->second.hash == file.hash;
+        found.files.push_back(filename);
+      }
+      for (unsigned j = 0; ok && j < entry.listings.size(); ++j) {
+        std::string dir = absolute(entry.listings.at(j).second);
+        ok = !dir.empty() && listingHash(dir) == entry.listings.at(j).first;
+      }
+      for (unsigned n = 0; ok && n < entry.outputs; ++n) {
+        std::stringstream suffix;
+        suffix << "." << n;
+        found.outputs.push_back(std::string());
+        ok = readFile(path(entry.result, suffix.str()), &found.outputs.back());
+        if (!ok)
+          qiLogVerbose() << "result " << entry.result << " was evicted";
+      }
+      if (!ok)
+        continue;
+      *result = found;
+
+      //used recently: evicted last
+      boost::system::error_code ec;
+      std::time_t now = std::time(0);
+      for (unsigned n = 0; n < entry.outputs; ++n) {
+        std::stringstream suffix;
+        suffix << "." << n;
+        fs::last_write_time(path(entry.result, suffix.str()), now, ec);
+      }
+      fs::last_write_time(path(runKey, ".manifest"), now, ec);
+      delta.misses = 0;
+      delta.hits   = 1;
+    }
+    addStats(delta);
+    return delta.hits != 0;
+  }
+
+  bool OutputCache::store(const std::string& runKey, const Result& result) {
+    if (runKey.empty())
+      return false;
+
+    ManifestEntry entry;
+    entry.outputs = result.outputs.size();
+    StringVector dirs;
+    for (unsigned i = 0; i < result.files.size(); ++i) {
+      ManifestFile file;
+      AstSourceStamp stamp;
+      if (!astSourceStamp(result.files.at(i), &stamp))
+        return false;
+      file.name = relative(result.files.at(i));
+      file.size = stamp.size;
+      file.hash = stamp.hash;
+      entry.files.push_back(file);
+      dirs.push_back(fs::path(result.files.at(i)).parent_path().string());
+    }
+    std::sort(dirs.begin(), dirs.end());
+    dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+    for (unsigned i = 0; i < dirs.size(); ++i)
+      entry.listings.push_back(std::make_pair(listingHash(dirs.at(i)), relative(dirs.at(i))));
+
+    //the outputs are stored by content: runs with the same outputs share them
+    KeyHasher h;
+    h.add(static_cast<qi::uint64_t>(result.outputs.size()));
+    for (unsigned n = 0; n < result.outputs.size(); ++n)
+      h.add(result.outputs.at(n));
+    entry.result = h.key();
+
+    Stats delta;
+    delta.stores = 1;
+    boost::system::error_code ec;
+    for (unsigned n = 0; n < result.outputs.size(); ++n) {
+      std::stringstream suffix;
+      suffix << "." << n;
+      std::string filename = path(entry.result, suffix.str());
+      if (fs::exists(filename, ec) && fs::file_size(filename, ec) == result.outputs.at(n).size())
+        continue;
+      if (!writeFileAtomically(filename, result.outputs.at(n)))
+        return false;
+      delta.size += result.outputs.at(n).size();
+    }
+
+    {
+      CacheLock lock(_dir);
+      if (!lock.locked())
+        return false;
+      fs::path manifest = path(runKey, ".manifest");
+      ManifestEntryVector entries = readManifest(manifest);
+      qi::uint64_t oldSize = fs::exists(manifest, ec) ? fs::file_size(manifest, ec) : 0;
+      //an entry for the same files: replaced by the new one
+      for (ManifestEntryVector::iterator it = entries.begin(); it != entries.end();) {
+        bool same = it->files.size() == entry.files.size();
+        for (unsigned j = 0; same && j < entry.files.size(); ++j) {
+          same = it->files.at(j).name == entry.files.at(j).name
+              && it->files.at(j).size == entry.files.at(j).size
+              && it->files.at(j).hash == entry.files.at(j).hash;
+        }
+        if (same)
+          it = entries.erase(it);
+        else
+          ++it;
+      }
+      entries.insert(entries.begin(), entry);
+      if (entries.size() > MaxManifestEntries)
+        entries.resize(MaxManifestEntries);
+      std::string data = formatManifest(entries);
+      if (!writeFileAtomically(manifest.string(), data))
+        return false;
+      delta.size += data.size();
+      delta.size -= std::min<qi::uint64_t>(oldSize, delta.size);
+    }
+    addStats(delta);
+    return true;
+  }
+
+  OutputCache::Stats OutputCache::readStats() const {
+    Stats ret;
+    std::ifstream is((fs::path(_dir) / "stats").string().c_str());
+    std::string  name;
+    qi::uint64_t value;
+    while (is >> name >> value) {
+      if (name == "hits")
+        ret.hits = value;
+      else if (name == "misses")
+        ret.misses = value;
+      else if (name == "stores")
+        ret.stores = value;
+      else if (name == "evictions")
+        ret.evictions = value;
+      else if (name == "size")
+        ret.size = value;
+    }
+    return ret;
+  }
+
+  bool OutputCache::writeStats(const Stats& stats) const {
+    std::ostringstream os;
+    os << "hits "      << stats.hits      << "\n"
+       << "misses "    << stats.misses    << "\n"
+       << "stores "    << stats.stores    << "\n"
+       << "evictions " << stats.evictions << "\n"
+       << "size "      << stats.size      << "\n";
+    return writeFileAtomically((fs::path(_dir) / "stats").string(), os.str());
+  }
+
+  OutputCache::Stats OutputCache::stats() const {
+    return readStats();
+  }
+
+  void OutputCache::addStats(const Stats& delta) {
+    CacheLock lock(_dir);
+    if (!lock.locked())
+      return;
+    Stats stats = readStats();
+    stats.hits      += delta.hits;
+    stats.misses    += delta.misses;
+    stats.stores    += delta.stores;
+    stats.evictions += delta.evictions;
+    stats.size      += delta.size;
+    if (stats.size > _maxSize)
+      evictLocked(&stats);
+    writeStats(stats);
+  }
+
+  void OutputCache::evict() {
+    CacheLock lock(_dir);
+    if (!lock.locked())
+      return;
+    Stats stats = readStats();
+    evictLocked(&stats);
+    writeStats(stats);
+  }
+
+  void OutputCache::evictLocked(Stats* stats) {
+    //a key and all its files (outputs or manifest) go together
+    struct Group {
+      Group() : mtime(0), size(0), manifest(false) {}
+      std::time_t  mtime;
+      qi::uint64_t size;
+      bool         manifest;
+      std::vector<fs::path> files;
+    };
+    std::map<std::string, Group> groups;
+    qi::uint64_t total = 0;
+    boost::system::error_code ec;
+    for (fs::directory_iterator dit(_dir, ec), dend; !ec && dit != dend; dit.increment(ec)) {
+      if (!fs::is_directory(dit->status()))
+        continue;
+      boost::system::error_code fec;
+      for (fs::directory_iterator it(dit->path(), fec), end; !fec && it != end; it.increment(fec)) {
+        std::string name = it->path().filename().string();
+        if (boost::algorithm::ends_with(name, ".tmp"))
+          continue;
+        Group& group = groups[name.substr(0, name.find('.'))];
+        qi::uint64_t size = fs::file_size(it->path(), ec);
+        group.size += ec ? 0 : size;
+        group.mtime = std::max(group.mtime, fs::last_write_time(it->path(), ec));
+        group.manifest = group.manifest || boost::algorithm::ends_with(name, ".manifest");
+        group.files.push_back(it->path());
+        total += ec ? 0 : size;
+      }
+    }
+
+    //least recently used first, down to 90% so that the next runs do not evict again
+    std::vector<std::pair<std::time_t, std::string> > order;
+    for (std::map<std::string, Group>::const_iterator it = groups.begin(); it != groups.end(); ++it)
+      order.push_back(std::make_pair(it->second.mtime, it->first));
+    std::sort(order.begin(), order.end());
+    const qi::uint64_t target = _maxSize / 10 * 9;
+    for (unsigned i = 0; i < order.size() && total > target; ++i) {
+      const Group& group = groups[order.at(i).second];
+      for (unsigned j = 0; j < group.files.size(); ++j)
+        fs::remove(group.files.at(j), ec);
+      total -= group.size;
+      if (!group.manifest)
+        stats->evictions++;
+    }
+    stats->size = total;
+  }
+
+  bool OutputCache::clear() {
+    CacheLock lock(_dir);
+    if (!lock.locked())
+      return false;
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(_dir, ec), end; !ec && it != end; it.increment(ec)) {
+      if (fs::is_directory(it->status()))
+        fs::remove_all(it->path(), ec);
+    }
+    Stats stats = readStats();
+    stats.size = 0;
+    return writeStats(stats);
+  }
+
+}
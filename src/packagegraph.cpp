@@ -0,0 +1,195 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <deque>
+#include <qilang/packagegraph.hpp>
+
+namespace qilang {
+
+  const PackageGraph::Index PackageGraph::NoIndex;
+
+  PackageGraph::Index PackageGraph::addPackage(const std::string& name) {
+    std::map<std::string, Index>::const_iterator it = _indexes.find(name);
+    if (it != _indexes.end())
+      return it->second;
+    Index index = _names.size();
+    _names.push_back(name);
+    _indexes[name] = index;
+    _imports.push_back(IndexVector());
+    _importedBy.push_back(IndexVector());
+    return index;
+  }
+
+  void PackageGraph::addImport(const std::string& pkg, const std::string& imported) {
+    Index from = addPackage(pkg);
+    Index to   = addPackage(imported);
+    insertSorted(_imports[from], to);
+    insertSorted(_importedBy[to], from);
+  }
+
+  void PackageGraph::clear() {
+    _names.clear();
+    _indexes.clear();
+    _imports.clear();
+    _importedBy.clear();
+  }
+
+  PackageGraph::Index PackageGraph::find(const std::string& name) const {
+    std::map<std::string, Index>::const_iterator it = _indexes.find(name);
+    return it == _indexes.end() ? NoIndex : it->second;
+  }
+
+  PackageGraph::IndexVector PackageGraph::importers(Index i) const {
+    std::vector<bool> seen(size(), false);
+    IndexVector ret;
+    std::deque<Index> todo(1, i);
+    while (!todo.empty()) {
+      Index v = todo.front();
+      todo.pop_front();
+      for (IndexVector::const_iterator it = _importedBy[v].begin(); it != _importedBy[v].end(); ++it) {
+        if (seen[*it])
+          continue;
+        seen[*it] = true;
+        ret.push_back(*it);
+        todo.push_back(*it);
+      }
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  }
+
+  void PackageGraph::insertSorted(IndexVector& v, Index i) const {
+    IndexVector::iterator it = v.begin();
+    while (it != v.end() && _names[*it] < _names[i])
+      ++it;
+    if (it == v.end() || *it != i)
+      v.insert(it, i);
+  }
+
+  /* Tarjan's algorithm, without recursion: deep import chains must not
+   * overflow the stack. A component is complete when its root is left,
+   * after all the components it can reach, hence the dependency order.
+   */
+  std::vector<PackageGraph::IndexVector> PackageGraph::components() const {
+    const std::size_t count = size();
+    std::vector<Index> number(count, NoIndex);
+    std::vector<Index> low(count, 0);
+    std::vector<bool>  onStack(count, false);
+    IndexVector        stack;
+    std::vector<IndexVector> ret;
+    Index next = 0;
+
+    //call stack of (package, next import to visit)
+    std::vector<std::pair<Index, std::size_t> > frames;
+    //roots in name order
+    for (std::map<std::string, Index>::const_iterator root = _indexes.begin(); root != _indexes.end(); ++root) {
+      if (number[root->second] != NoIndex)
+        continue;
+      frames.push_back(std::make_pair(root->second, 0));
+      while (!frames.empty()) {
+        Index v = frames.back().first;
+        if (frames.back().second == 0 && number[v] == NoIndex) {
+          number[v] = low[v] = next++;
+          stack.push_back(v);
+          onStack[v] = true;
+        }
+        const IndexVector& imports = _imports[v];
+        if (frames.back().second < imports.size()) {
+          Index w = imports[frames.back().second++];
+          if (number[w] == NoIndex)
+            frames.push_back(std::make_pair(w, 0));
+          else if (onStack[w])
+            low[v] = std::min(low[v], number[w]);
+          continue;
+        }
+        frames.pop_back();
+        if (!frames.empty())
+          low[frames.back().first] = std::min(low[frames.back().first], low[v]);
+        if (low[v] != number[v])
+          continue;
+        IndexVector component;
+        Index w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          onStack[w] = false;
+          component.push_back(w);
+        } while (w != v);
+        std::sort(component.begin(), component.end(),
+                  [this](Index a, Index b) { return _names[a] < _names[b]; });
+        ret.push_back(component);
+      }
+    }
+    return ret;
+  }
+
+  bool PackageGraph::inCycle(Index i) const {
+    const IndexVector& imports = _imports[i];
+    if (std::find(imports.begin(), imports.end(), i) != imports.end())
+      return true;
+    std::vector<IndexVector> comps = components();
+    for (unsigned c = 0; c < comps.size(); ++c) {
+      if (std::find(comps[c].begin(), comps[c].end(), i) != comps[c].end())
+        return comps[c].size() > 1;
+    }
+    return false;
+  }
+
+  std::vector<PackageGraph::IndexVector> PackageGraph::cycles() const {
+    std::vector<IndexVector> comps = components();
+    std::vector<IndexVector> ret;
+    for (unsigned c = 0; c < comps.size(); ++c) {
+      const IndexVector& comp = comps[c];
+      const IndexVector& imports = _imports[comp[0]];
+      if (comp.size() > 1 || std::find(imports.begin(), imports.end(), comp[0]) != imports.end())
+        ret.push_back(comp);
+    }
+    return ret;
+  }
+
+  PackageGraph::IndexVector PackageGraph::cyclePath(const IndexVector& cycle) const {
+    if (cycle.empty())
+      return IndexVector();
+    //breadth first search inside the cycle, from its first package back to it
+    const Index start = cycle[0];
+    std::vector<Index> parent(size(), NoIndex);
+    std::deque<Index> todo(1, start);
+    while (!todo.empty()) {
+      Index v = todo.front();
+      todo.pop_front();
+      const IndexVector& imports = _imports[v];
+      for (unsigned i = 0; i < imports.size(); ++i) {
+        Index w = imports[i];
+        if (std::find(cycle.begin(), cycle.end(), w) == cycle.end())
+          continue;
+        if (w == start) {
+          IndexVector ret(1, start);
+          for (Index p = v; p != start; p = parent[p])
+            ret.push_back(p);
+          ret.push_back(start);
+          std::reverse(ret.begin(), ret.end());
+          return ret;
+        }
+        if (parent[w] == NoIndex) {
+          parent[w] = v;
+          todo.push_back(w);
+        }
+      }
+    }
+    return IndexVector();
+  }
+
+  PackageGraph::IndexVector PackageGraph::topologicalOrder() const {
+    std::vector<IndexVector> comps = components();
+    IndexVector ret;
+    for (unsigned c = 0; c < comps.size(); ++c)
+      ret.insert(ret.end(), comps[c].begin(), comps[c].end());
+    return ret;
+  }
+
+}
@@ -0,0 +1,199 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <qilang/packageindex.hpp>
+#include <qilang/pathformatter.hpp>
+#include "mappedfile.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <qi/log.hpp>
+
+qiLogCategory("qilang.index");
+
+namespace qilang {
+
+  namespace fs = boost::filesystem;
+
+  static const char* const PackageIndexMagic = "qilang-package-index";
+
+  //paths of the entries are made relative by removing the root and a separator
+  static std::string trimRoot(const std::string& root) {
+    std::string ret = root;
+    while (ret.size() > 1 && (*ret.rbegin() == '/' || *ret.rbegin() == '\\'))
+      ret.erase(ret.size() - 1);
+    return ret;
+  }
+
+  PackageIndex::PackageIndex()
+    : _time(0)
+  {}
+
+  void PackageIndex::scan(const std::string& root) {
+    _root = trimRoot(root);
+    _entries.clear();
+    //entries modified after this are not trusted, see upToDate
+    _time = std::time(0);
+
+    std::size_t rootSize = fs::path(_root).generic_string().size() + 1;
+    fs::recursive_directory_iterator it(_root), end;
+    for (; it != end; ++it) {
+      boost::system::error_code ec;
+      const fs::path& path = it->path();
+      std::string rel = path.generic_string().substr(rootSize);
+      Entry entry;
+      //packages stored in a symlink are not listed: looking them up walks the tree
+      if (fs::is_symlink(it->symlink_status()) && fs::is_directory(it->status()))
+        continue;
+      if (fs::is_directory(it->status())) {
+        entry.dir = true;
+      } else if (boost::algorithm::ends_with(formatPath(rel), ".idl.qi")) {
+        entry.size = fs::file_size(path, ec);
+        if (ec)
+          continue;
+      } else {
+        continue;
+      }
+      entry.mtime = fs::last_write_time(path, ec);
+      if (ec)
+        continue;
+      _entries[rel] = entry;
+    }
+    qiLogVerbose() << "indexed " << _entries.size() << " entries in " << _root;
+  }
+
+  //parse "<n> " at cur, move cur after the space
+  template <typename T>
+  static bool parseField(const char*& cur, const char* end, T* value) {
+    const char* begin = cur;
+    T ret = 0;
+    bool negative = cur != end && *cur == '-';
+    if (negative)
+      ++cur;
+    for (; cur != end && *cur >= '0' && *cur <= '9'; ++cur)
+      ret = ret * 10 + (*cur - '0');
+    if (cur == begin + (negative ? 1 : 0) || cur == end || *cur != ' ')
+      return false;
+    ++cur;
+    *value = negative ? -ret : ret;
+    return true;
+  }
+
+  bool PackageIndex::load(const std::string& root, std::string* error) {
+    _root = trimRoot(root);
+    _entries.clear();
+    std::string filename = (fs::path(_root) / PackageIndexFileName).string();
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!is) {
+      if (error)
+        *error = "can't open '" + filename + "'";
+      return false;
+    }
+
+    std::string  line;
+    std::string  magic;
+    unsigned int version = 0;
+    std::getline(is, line);
+    std::istringstream header(line);
+    header >> magic >> version >> _time;
+    if (!header || magic != PackageIndexMagic || version != PackageIndexVersion) {
+      if (error)
+        *error = "'" + filename + "' is not a package index of this version";
+      return false;
+    }
+
+    //the index of a large SDK is read by every qicc run: no stream per line
+    std::string content((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    const char* cur = content.data();
+    const char* end = cur + content.size();
+    while (cur != end) {
+      const char* eol = std::find(cur, end, '\n');
+      Entry entry;
+      char type = *cur;
+      entry.dir = type == 'd';
+      bool ok = (type == 'd' || type == 'f') && cur + 1 != eol && cur[1] == ' ';
+      cur += 2;
+      ok = ok && parseField(cur, eol, &entry.mtime);
+      if (ok && type == 'f')
+        ok = parseField(cur, eol, &entry.size);
+      if (!ok || cur >= eol) {
+        _entries.clear();
+        if (error)
+          *error = "'" + filename + "' is malformed";
+        return false;
+      }
+      //written sorted, insert at the end
+      _entries.insert(_entries.end(), EntryMap::value_type(std::string(cur, eol), entry));
+      cur = eol == end ? end : eol + 1;
+    }
+    return true;
+  }
+
+  bool PackageIndex::save(std::string* error) const {
+    //several qicc may index the same tree
+    return writeFileAtomically((fs::path(_root) / PackageIndexFileName).string(), [this](std::ostream& os) {
+      os << PackageIndexMagic << " " << PackageIndexVersion << " " << _time << "\n";
+      for (EntryMap::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+        if (it->second.dir)
+          os << "d " << it->second.mtime << " " << it->first << "\n";
+        else
+          os << "f " << it->second.mtime << " " << it->second.size << " " << it->first << "\n";
+      }
+      return static_cast<bool>(os);
+    }, std::ios::binary, error);
+  }
+
+  bool PackageIndex::upToDate(const std::string& rel, const Entry& entry) const {
+    //with a one second resolution, a change in the second of the walk may be missed
+    if (entry.mtime >= _time)
+      return false;
+    boost::system::error_code ec;
+    return fs::last_write_time(fs::path(_root) / rel, ec) == entry.mtime && !ec;
+  }
+
+  bool PackageIndex::locate(const std::string& dir, std::vector<std::string>* files) const {
+    EntryMap::const_iterator it = _entries.find(dir);
+    if (it == _entries.end() || !it->second.dir) {
+      //not a package of this tree, as long as it was not added since
+      boost::system::error_code ec;
+      return fs::status(fs::path(_root) / dir, ec).type() == fs::file_not_found;
+    }
+    if (!upToDate(it->first, it->second))
+      return false;
+
+    //the list of files only changes with the mtime of a directory, the stamps
+    //of the files themselves are left to the tools that need them
+    std::vector<std::string> result;
+    std::string prefix = dir + "/";
+    for (it = _entries.lower_bound(prefix); it != _entries.end(); ++it) {
+      if (!boost::algorithm::starts_with(it->first, prefix))
+        break;
+      if (!it->second.dir)
+        result.push_back(it->first);
+      else if (!upToDate(it->first, it->second))
+        return false;
+    }
+    files->insert(files->end(), result.begin(), result.end());
+    return true;
+  }
+
+  bool writePackageIndex(const std::string& root, std::string* error) {
+    boost::system::error_code ec;
+    if (!fs::is_directory(root, ec)) {
+      if (error)
+        *error = "'" + root + "' is not a directory";
+      return false;
+    }
+    PackageIndex index;
+    index.scan(root);
+    return index.save(error);
+  }
+
+}
@@ -5,9 +5,19 @@
 ** Copyright (C) 2014 Aldebaran Robotics
 */
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <iostream>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <qilang/packagemanager.hpp>
 #include <qilang/parser.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/packagesummary.hpp>
 #include <qilang/visitor.hpp>
 #include "cpptype.hpp"
 #include <boost/make_shared.hpp>
@@ -31,40 +41,37 @@ namespace qilang {
     };
   }
 
-  void importExportDeclVisitor(const NodePtr& parent, const NodePtr& node, PackagePtr& pkg) {
-    //we care only about toplevel decl
-    if (parent)
-      return;
-
+  //we care only about toplevel decl
+  static void importExportDecl(const NodePtr& node, const PackagePtr& pkg) {
     switch (node->type()) {
       // EXPORT
       case NodeType_InterfaceDecl: {
         InterfaceDeclNode* tnode = static_cast<InterfaceDeclNode*>(node.get());
-        pkg->addMember(tnode->name, node);
+        pkg->addMember(Symbol(tnode->name), node);
         return;
       } case NodeType_StructDecl: {
         StructDeclNode* tnode = static_cast<StructDeclNode*>(node.get());
-        pkg->addMember(tnode->name, node);
+        pkg->addMember(Symbol(tnode->name), node);
         return;
       } case NodeType_FnDecl: {
         FnDeclNode* tnode = static_cast<FnDeclNode*>(node.get());
-        pkg->addMember(tnode->name, node);
+        pkg->addMember(Symbol(tnode->name), node);
         return;
       } case NodeType_ConstDecl: {
         ConstDeclNode* tnode = static_cast<ConstDeclNode*>(node.get());
-        pkg->addMember(tnode->name, node);
+        pkg->addMember(Symbol(tnode->name), node);
         return;
       } case NodeType_ObjectDef: {
         ObjectDefNode* tnode = static_cast<ObjectDefNode*>(node.get());
-        pkg->addMember(tnode->name, node);
+        pkg->addMember(Symbol(tnode->name), node);
         return;
       } case NodeType_TypeDefDecl: {
         TypeDefDeclNode* tnode = static_cast<TypeDefDeclNode*>(node.get());
-        pkg->addMember(tnode->name, node);
+        pkg->addMember(Symbol(tnode->name), node);
         return;
       } case NodeType_EnumDecl: {
         EnumDeclNode* tnode = static_cast<EnumDeclNode*>(node.get());
-        pkg->addMember(tnode->name, node);
+        pkg->addMember(Symbol(tnode->name), node);
         return;
       }
 
@@ -92,13 +99,12 @@ namespace qilang {
    *  2 / Check that the directory path and package name match
    *  3 / register the content of the file to the package
    */
-  bool PackageManager::addFileToPackage(const std::string& absfile, const FileReaderPtr& file, ParseResultPtr& pr) {
+  bool PackageManager::addFileToPackage(const std::string& absfile, const std::string& filename, ParseResultPtr& pr) {
 
     // 1
-    NodePtrVector result;
-    result = findNode(pr->ast, NodeType_Package);
+    const NodePtrVector& result = pr->nodes(NodeType_Package);
     if (result.size() == 0) {
-      pr->addDiag(Diagnostic(DiagnosticType_Error, "missing package declaration", Location(file->filename())));
+      pr->addDiag(Diagnostic(DiagnosticType_Error, "missing package declaration", Location(filename)));
       return false;
     }
     if (result.size() > 1) {
@@ -111,7 +117,7 @@ namespace qilang {
     }
     std::string pkgname = extractPackageName(result.at(0));
     // 2
-    qi::Path pf(file->filename());
+    qi::Path pf(filename);
     StringVector leafs = splitPkgName(pkgname);
 
 
@@ -153,19 +159,185 @@ namespace qilang {
     if (!fsfname.isRegularFile())
       throw std::runtime_error(file->filename() + " is not a regular file");
     qiLogVerbose() << "Parsing file: " << filename;
-    if (_sources.find(filename) != _sources.end()) {
-      qiLogVerbose() << "already parsed, skipping '" << filename << "'";
-      return package(_sources[filename])->_contents[filename];
+    FilenameToPackageMap::const_iterator known = _sources.find(filename);
+    if (known != _sources.end()) {
+      const ParseResultPtr& pr = package(known->second)->_contents[filename];
+      //streams can't be read twice, their content is not compared
+      if (!pr->summary && (!file->isBuffered() || !file->isOpen() ||
+          astSourceStamp(file->buffer().data(), file->buffer().size() - 2).hash == pr->sourceHash)) {
+        qiLogVerbose() << "already parsed, skipping '" << filename << "'";
+        return pr;
+      }
+      qiLogVerbose() << (pr->summary ? "loaded from a summary" : "content changed") << ", parsing again '" << filename << "'";
+      removeFile(filename);
     }
 
-    ParseResultPtr ret = qilang::parse(file);
-    if (addFileToPackage(filename, file, ret))
-      _sources[filename] = ret->package;
+    ParseResultPtr ret = qilang::parse(file, false);
+    ret->diagnosticStream = _diagnostics;
+    ret->printMessage(*_diagnostics);
+    ret->echoDiagnostics = true;
+    mergeFile(filename, file->filename(), ret);
+    //the exports of a package are only known once it is parsed as a whole
+    if (!ret->package.empty() && package(ret->package)->_parsed)
+      indexPackage(package(ret->package));
     return ret;
   }
 
+  void PackageManager::removeFile(const std::string& absfile)
+  {
+    FilenameToPackageMap::iterator it = _sources.find(absfile);
+    if (it == _sources.end())
+      return;
+    PackagePtr pkg = package(it->second);
+    _sources.erase(it);
+    pkg->_contents.erase(absfile);
+    if (pkg->_parsed)
+      indexPackage(pkg);
+  }
+
+  void PackageManager::mergeFile(const std::string& absfile, const std::string& filename, ParseResultPtr& ret)
+  {
+    ret->diagnosticStream = _diagnostics;
+    if (addFileToPackage(absfile, filename, ret))
+      _sources[absfile] = ret->package;
+  }
+
+  /** Installed files come with a binary AST (see astfile.hpp): load it
+   *  when it is up to date, otherwise parse the source.
+   */
+  ParseResultPtr PackageManager::loadOrParse(const std::string& filename, bool echoDiagnostics) const
+  {
+    if (_useAstFiles) {
+      ParseResultPtr pr = loadAST(filename);
+      if (pr) {
+        qiLogVerbose() << "Loaded binary AST for: " << filename;
+        return pr;
+      }
+    }
+    qiLogVerbose() << "Parsing file: " << filename;
+    return qilang::parse(newFileReader(filename), echoDiagnostics);
+  }
+
+  void PackageManager::setJobs(unsigned int jobs)
+  {
+    if (jobs == 0)
+      jobs = std::thread::hardware_concurrency();
+    _jobs = jobs ? jobs : 1;
+  }
+
+  void PackageManager::setDiagnosticStream(std::ostream& os)
+  {
+    _diagnostics = &os;
+    for (PackagePtrMap::const_iterator pit = _packages.begin(); pit != _packages.end(); ++pit) {
+      for (ParseResultMap::const_iterator it = pit->second->_contents.begin(); it != pit->second->_contents.end(); ++it)
+        it->second->diagnosticStream = _diagnostics;
+    }
+  }
 
-  static bool locateFileInDir(const std::string& path, std::unordered_set<std::string>* resultfile, StringVector* resultdir) {
+  /** Parse a set of files, in sorted order.
+   *
+   * With more than one job the parsers run on worker threads. Workers only
+   * touch their own FileReader/ParseResult; registering into _packages and
+   * _sources and printing the diagnostics is done afterward on the calling
+   * thread, file by file in the same order as the serial path, so the
+   * outcome does not depend on the number of jobs.
+   */
+  void PackageManager::parseFiles(const StringVector& files, StringVector* failed)
+  {
+    StringVector sorted(files);
+    std::sort(sorted.begin(), sorted.end());
+
+    StringVector todo;
+    StringVector absfiles;
+    std::set<std::string> seen;
+    //packages of the files only known by their summary, indexed again once parsed
+    std::set<std::string> summarized;
+    for (unsigned i = 0; i < sorted.size(); ++i) {
+      qi::Path fsfname(sorted.at(i));
+      if (!fsfname.isRegularFile()) {
+        if (!failed)
+          throw std::runtime_error(sorted.at(i) + " is not a regular file");
+        failed->push_back(sorted.at(i));
+        continue;
+      }
+      std::string filename = fsfname.absolute().str();
+      FilenameToPackageMap::const_iterator known = _sources.find(filename);
+      if (known != _sources.end() && package(known->second)->_contents[filename]->summary) {
+        summarized.insert(known->second);
+        removeFile(filename);
+      } else if (known != _sources.end()) {
+        continue;
+      }
+      if (!seen.insert(filename).second)
+        continue;
+      todo.push_back(sorted.at(i));
+      absfiles.push_back(filename);
+    }
+
+    mergeFiles(todo, absfiles, failed);
+    for (std::set<std::string>::const_iterator it = summarized.begin(); it != summarized.end(); ++it)
+      indexPackage(package(*it));
+  }
+
+  void PackageManager::mergeFiles(const StringVector& todo, const StringVector& absfiles, StringVector* failed)
+  {
+    const std::size_t count = todo.size();
+    if (_jobs <= 1 || count <= 1) {
+      for (unsigned i = 0; i < count; ++i) {
+        ParseResultPtr pr;
+        try {
+          pr = loadOrParse(todo.at(i), false);
+        } catch (const std::exception&) {
+          if (!failed)
+            throw;
+          failed->push_back(todo.at(i));
+          continue;
+        }
+        pr->printMessage(*_diagnostics);
+        pr->echoDiagnostics = true;
+        mergeFile(absfiles.at(i), todo.at(i), pr);
+      }
+      return;
+    }
+
+    std::vector<ParseResultPtr>     results(count);
+    std::vector<std::exception_ptr> errors(count);
+    std::atomic<std::size_t>        next(0);
+
+    auto worker = [&]() {
+      for (std::size_t i = next++; i < count; i = next++) {
+        try {
+          results[i] = loadOrParse(todo.at(i), false);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    const std::size_t nthreads = std::min<std::size_t>(_jobs, count);
+    for (std::size_t t = 1; t < nthreads; ++t)
+      threads.push_back(std::thread(worker));
+    worker();
+    for (std::size_t t = 0; t < threads.size(); ++t)
+      threads[t].join();
+
+    for (std::size_t i = 0; i < count; ++i) {
+      if (errors[i] && !failed)
+        std::rethrow_exception(errors[i]);
+      if (errors[i]) {
+        failed->push_back(todo.at(i));
+        continue;
+      }
+      ParseResultPtr& pr = results[i];
+      pr->printMessage(*_diagnostics);
+      pr->echoDiagnostics = true;
+      mergeFile(absfiles.at(i), todo.at(i), pr);
+    }
+  }
+
+
+  //the directories and .qi files of path, sorted: the order of the filesystem is not stable
+  static bool locateFileInDir(const std::string& path, StringVector* resultfile, StringVector* resultdir) {
     qi::PathVector pv = qi::Path(path).dirs();
     bool ret = false;
     for (unsigned i = 0; i < pv.size(); ++i) {
@@ -178,11 +350,13 @@ namespace qilang {
       qi::Path& p = pv.at(i);
       if (p.isRegularFile()) {
         if (p.extension() == ".qi") {
-          resultfile->insert(p.bfsPath().generic_string());
+          resultfile->push_back(p.bfsPath().generic_string());
           ret = true;
         }
       }
     }
+    std::sort(resultdir->begin(), resultdir->end());
+    std::sort(resultfile->begin(), resultfile->end());
     return ret;
   }
 
@@ -193,18 +367,30 @@ namespace qilang {
     }
   }
 
-  std::unordered_set<std::string> PackageManager::locatePackage(const std::string& pkgName) {
+  StringVector PackageManager::locatePackage(const std::string& pkgName) {
 
     if (pkgName.empty())
       throw std::runtime_error("empty package name");
 
     qi::Path pkgPath(pkgNameToDir(pkgName));
 
-    std::unordered_set<std::string> packageFiles;
+    StringVector packageFiles;
     using boost::filesystem::recursive_directory_iterator;
     recursive_directory_iterator itPath, itEnd;
     for (qi::Path lookupPath : _lookupPaths) {
       lookupPath /= "share/qi/idl";
+
+      PackageIndexPtr index = packageIndex(lookupPath.str());
+      std::vector<std::string> indexed;
+      if (index && index->locate(pkgPath.bfsPath().generic_string(), &indexed)) {
+        for (unsigned i = 0; i < indexed.size(); ++i) {
+          std::string pathStr = formatPath((lookupPath / qi::Path(indexed.at(i))).str());
+          packageFiles.push_back(pathStr);
+          qiLogVerbose() << "Found package '" << pkgName << "' in " << pathStr << " (indexed)";
+        }
+        continue;
+      }
+
       lookupPath /= pkgPath;
       if (!lookupPath.exists()) {
         continue;
@@ -214,14 +400,73 @@ namespace qilang {
         auto path = itPath->path();
         std::string pathStr = formatPath(path.string());
         if (boost::algorithm::ends_with(pathStr, ".idl.qi")) {
-          packageFiles.insert(pathStr);
+          packageFiles.push_back(pathStr);
           qiLogVerbose() << "Found package '" << pkgName << "' in " << pathStr;
         }
       }
     }
+    //in the order of the hash of the names, not of the directories: sort
+    std::sort(packageFiles.begin(), packageFiles.end());
+    packageFiles.erase(std::unique(packageFiles.begin(), packageFiles.end()), packageFiles.end());
     return packageFiles;
   }
 
+  PackageIndexPtr PackageManager::packageIndex(const std::string& root) {
+    if (!_usePackageIndexes)
+      return PackageIndexPtr();
+    std::map<std::string, PackageIndexPtr>::const_iterator it = _indexes.find(root);
+    if (it != _indexes.end())
+      return it->second;
+
+    PackageIndexPtr index = boost::make_shared<PackageIndex>();
+    std::string error;
+    if (!index->load(root, &error)) {
+      qiLogVerbose() << "no package index: " << error;
+      index.reset();
+    }
+    _indexes[root] = index;
+    return index;
+  }
+
+  StringVector PackageManager::sourceFiles() const
+  {
+    StringVector ret;
+    for (FilenameToPackageMap::const_iterator it = _sources.begin(); it != _sources.end(); ++it)
+      ret.push_back(it->first);
+    return ret;
+  }
+
+  StringVector PackageManager::sourceFiles(const StringVector& packages) const
+  {
+    std::set<std::string> seen;
+    StringVector todo(packages);
+    StringVector ret;
+    while (!todo.empty()) {
+      std::string name = todo.back();
+      todo.pop_back();
+      PackagePtrMap::const_iterator pit = _packages.find(name);
+      if (pit == _packages.end() || !seen.insert(name).second)
+        continue;
+      const Package& pkg = *pit->second;
+      for (ParseResultMap::const_iterator it = pkg._contents.begin(); it != pkg._contents.end(); ++it)
+        ret.push_back(it->first);
+      for (ASTMap::const_iterator it = pkg._imports.begin(); it != pkg._imports.end(); ++it)
+        todo.push_back(it->first);
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  }
+
+  ParseResultPtr PackageManager::parseResult(const std::string& absfile) const
+  {
+    FilenameToPackageMap::const_iterator it = _sources.find(absfile);
+    if (it == _sources.end())
+      return ParseResultPtr();
+    const ParseResultMap& contents = package(it->second)->_contents;
+    ParseResultMap::const_iterator pit = contents.find(absfile);
+    return pit == contents.end() ? ParseResultPtr() : pit->second;
+  }
+
   bool PackageManager::hasError() const
   {
     PackagePtrMap::const_iterator it;
@@ -254,19 +499,81 @@ namespace qilang {
       return;
     }
     auto sv = locatePackage(packageName);
+    //the package of the files being compiled needs their full AST
+    if (!_usePackageSummaries || !pkg->_contents.empty() || !loadSummaries(pkg, sv))
+      parseFiles(sv);
+
+    indexPackage(pkg);
+    qiLogVerbose() << "parsed pkg '" << packageName << "'";
+    pkg->_parsed = true;
+  }
+
+  /** the files of package name from the summaries of the directories of the
+   *  package, when they are all present and up to date (all or nothing).
+   *  files are the files found by locatePackage, subpackages included.
+   */
+  bool PackageManager::readSummaries(const std::string& name, const StringVector& files,
+                                     ParseResultVector* results) const {
+    //the files of a package are directly in a <lookup path>/share/qi/idl/<package dir>
+    std::string pkgdir = "/" + pkgNameToDir(name);
+    std::map<std::string, StringVector> dirs;
+    for (StringVector::const_iterator it = files.begin(); it != files.end(); ++it) {
+      std::string dir = boost::filesystem::path(*it).parent_path().generic_string();
+      if (boost::algorithm::ends_with(dir, pkgdir))
+        dirs[dir].push_back(*it);
+    }
+    if (dirs.empty())
+      return false;
+
+    for (std::map<std::string, StringVector>::const_iterator it = dirs.begin(); it != dirs.end(); ++it) {
+      PackageSummary summary;
+      std::string error;
+      if (!summary.load(it->first, &error) || summary.package() != name || !summary.matches(it->second)) {
+        qiLogVerbose() << "no up to date summary for '" << name << "' in '" << it->first << "' " << error;
+        return false;
+      }
+      ParseResultVector prs = summary.toParseResults();
+      results->insert(results->end(), prs.begin(), prs.end());
+    }
+    return true;
+  }
 
-    for (const auto& currSv : sv) {
-      parseFile(newFileReader(currSv));
+  //! register the files of pkg from its summaries, see readSummaries
+  bool PackageManager::loadSummaries(const PackagePtr& pkg, const StringVector& files) {
+    ParseResultVector results;
+    if (!readSummaries(pkg->_name, files, &results))
+      return false;
+    for (unsigned i = 0; i < results.size(); ++i) {
+      qiLogVerbose() << "Loaded summary for: " << results.at(i)->filename;
+      std::string absfile = qi::Path(results.at(i)->filename).absolute().str();
+      mergeFile(absfile, results.at(i)->filename, results.at(i));
     }
+    return true;
+  }
 
+  //(re)build the exports and imports of a package from its files
+  void PackageManager::indexPackage(const PackagePtr& pkg) {
+    pkg->_exports.clear();
+    pkg->_imports.clear();
+    pkg->_resolutions.clear();
     // for each decl in the package. reference it into the package.
     ParseResultMap::iterator it;
     for (it = pkg->_contents.begin(); it != pkg->_contents.end(); ++it) {
       qiLogVerbose() << "Visiting: " << it->first;
-      visitNode(it->second->ast, boost::bind<void>(&importExportDeclVisitor, _1, _2, boost::ref(pkg)));
+      const NodePtrVector& ast = it->second->ast;
+      for (unsigned i = 0; i < ast.size(); ++i)
+        importExportDecl(ast.at(i), pkg);
     }
-    qiLogVerbose() << "parsed pkg '" << packageName << "'";
-    pkg->_parsed = true;
+  }
+
+  static void collectDir(const std::string& dirname, StringVector* files)
+  {
+    StringVector resdir;
+    StringVector resfile;
+    locateFileInDir(dirname, &resfile, &resdir);
+    files->insert(files->end(), resfile.begin(), resfile.end());
+    for (unsigned i = 0; i < resdir.size(); ++i)
+      collectDir(dirname + "/" + resdir.at(i), files);
   }
 
   void PackageManager::parseDir(const std::string& dirname)
@@ -276,76 +583,63 @@ namespace qilang {
     if (!fsp.isDir())
       throw std::runtime_error(dirname + " is not a directory");
 
-    StringVector resdir;
-    std::unordered_set<std::string> resfile;
-    locateFileInDir(dirname, &resfile, &resdir);
-    for (const auto& currResfile : resfile)
-      parseFile(newFileReader(currResfile));
-    for (unsigned i = 0; i < resdir.size(); ++i)
-      parseDir(dirname + "/" + resdir.at(i));
+    //the whole tree at once, so that it can be parsed in parallel
+    StringVector files;
+    collectDir(dirname, &files);
+    parseFiles(files);
   }
 
-  //throw on error
-  static ResolutionResult checkImport(const PackageManager& pm, const ParseResultPtr& pr, const std::string& pkgName, const CustomTypeExprNode* tnode, const std::string& type)
+  ResolutionResult PackageManager::resolveExport(Symbol pkgName, Symbol type) const
   {
-    PackagePtr pkg = pm.package(pkgName);
-    NodePtr node = pkg->getExport(type);
-    TypeKind kind;
-    if (node) {
-      switch (node->type()) {
-      case NodeType_InterfaceDecl:
-        kind = TypeKind_Interface;
-        break;
-      case NodeType_EnumDecl:
-        kind = TypeKind_Enum;
-        break;
-      case NodeType_StructDecl:
-        kind = TypeKind_Struct;
-        break;
-      default:
-        pr->addDiag(Diagnostic(DiagnosticType_Error, "'" + type + "' in package '" + pkgName + "' is not a type", tnode->loc()));
-        throw std::runtime_error("Not a type");
-        break;
-      }
-      return ResolutionResult(pkgName, type, kind);
+    PackagePtrMap::const_iterator it = _packages.find(pkgName);
+    if (it == _packages.end())
+      return ResolutionResult(pkgName, type, ResolutionStatus_NoPackage);
+    NodePtr node = it->second->getExport(type);
+    if (!node)
+      return ResolutionResult(pkgName, type, ResolutionStatus_NotFound);
+    switch (node->type()) {
+    case NodeType_InterfaceDecl:
+      return ResolutionResult(pkgName, type, TypeKind_Interface);
+    case NodeType_EnumDecl:
+      return ResolutionResult(pkgName, type, TypeKind_Enum);
+    case NodeType_StructDecl:
+      return ResolutionResult(pkgName, type, TypeKind_Struct);
+    default:
+      return ResolutionResult(pkgName, type, ResolutionStatus_NotAType);
     }
-    pr->addDiag(Diagnostic(DiagnosticType_Error, "Can't find '" + type + "' in package '" + pkgName + "'", tnode->loc()));
-    throw std::runtime_error("Can't find import");
   }
 
-  //throw on error
-  ResolutionResult PackageManager::resolveImport(const ParseResultPtr& pr, const PackagePtr& pkg, const CustomTypeExprNode* tnode)
+  ResolutionResult PackageManager::resolveName(const Package& pkg, Symbol type) const
   {
-    const std::string type = tnode->value;
-    qiLogVerbose() << "Resolving: " << type << " from package: " << pkg->_name;
-    const auto lastDot = type.find_last_of('.');
-    const std::string pkgName = (lastDot == std::string::npos) ? "" : type.substr(0, lastDot);
-    const auto valueBegins = pkgName.empty() ? 0 : (pkgName.size() + 1);
-    std::string value = type.substr(valueBegins);
+    const std::string& stype = type.str();
+    qiLogVerbose() << "Resolving: " << type << " from package: " << pkg._name;
+    const auto lastDot = stype.find_last_of('.');
 
     //package name provided
-    if (!pkgName.empty() && pkgName != type)
-      return checkImport(*this, pr, pkgName, tnode, value);
-    value = type;
+    if (lastDot != std::string::npos && lastDot != 0) {
+      Symbol pkgName(stype.data(), lastDot);
+      Symbol value(stype.data() + lastDot + 1, stype.size() - lastDot - 1);
+      return resolveExport(pkgName, value);
+    }
 
     //no package name. find the package name
-    NodePtr exportnode = pkg->getExport(type);
-    if (exportnode)
-      return checkImport(*this, pr, pkg->_name, tnode, type);
+    NodeMap::const_iterator exportit = pkg._exports.find(type);
+    if (exportit != pkg._exports.end())
+      return resolveExport(Symbol(pkg._name), type);
 
     ASTMap::const_iterator it;
-    for (it = pkg->_imports.begin(); it != pkg->_imports.end(); ++it) {
+    for (it = pkg._imports.begin(); it != pkg._imports.end(); ++it) {
       const NodePtrVector& v = it->second;
       for (unsigned i = 0; i < v.size(); ++i) {
         ImportNode* inode = static_cast<ImportNode*>(v.at(i).get());
         switch (inode->importType) {
           case ImportType_All: {
-            return checkImport(*this, pr, inode->name, tnode, type);
+            return resolveExport(inode->name, type);
           }
           case ImportType_List: {
-            StringVector::iterator it = std::find(inode->imports.begin(), inode->imports.end(), type);
+            SymbolVector::iterator it = std::find(inode->imports.begin(), inode->imports.end(), type);
             if (it != inode->imports.end()) {
-              return checkImport(*this, pr, inode->name, tnode, type);
+              return resolveExport(inode->name, type);
             }
             break;
           }
@@ -354,17 +648,92 @@ namespace qilang {
         }
       }
     }
-    pr->addDiag(Diagnostic(DiagnosticType_Error, "cant resolve id '" + type + "' from package '" + pkg->_name + "'", tnode->loc()));
-    throw std::runtime_error("cant resolve id");
+    return ResolutionResult(Symbol(pkg._name), type, ResolutionStatus_Unresolved);
+  }
+
+  ResolutionResult PackageManager::resolveImport(const ParseResultPtr& pr, const PackagePtr& pkg, const CustomTypeExprNode* tnode)
+  {
+    ResolutionMap::const_iterator it = pkg->_resolutions.find(tnode->value);
+    if (it == pkg->_resolutions.end())
+      it = pkg->_resolutions.insert(std::make_pair(tnode->value, resolveName(*pkg, tnode->value))).first;
+    const ResolutionResult& res = it->second;
+
+    switch (res.status) {
+      case ResolutionStatus_Resolved:
+      case ResolutionStatus_NoPackage:
+        break;
+      case ResolutionStatus_NotAType:
+        pr->addDiag(Diagnostic(DiagnosticType_Error, "'" + res.type.str() + "' in package '" + res.pkg.str() + "' is not a type", tnode->loc()));
+        break;
+      case ResolutionStatus_NotFound:
+        pr->addDiag(Diagnostic(DiagnosticType_Error, "Can't find '" + res.type.str() + "' in package '" + res.pkg.str() + "'", tnode->loc()));
+        break;
+      case ResolutionStatus_Unresolved:
+        pr->addDiag(Diagnostic(DiagnosticType_Error, "cant resolve id '" + tnode->value.str() + "' from package '" + pkg->_name + "'", tnode->loc()));
+        break;
+    }
+    return res;
   }
 
   /** parse all dependents packages
    */
   void PackageManager::resolvePackage(const std::string& packageName) {
     PackagePtr pkg = package(packageName);
+    parseImports(pkg);
+    resolveTypes(pkg);
+  }
 
+  /** parse the files of packages in one batch, concurrently (see setJobs),
+   *  before parsePackage registers the packages one by one. Nothing is
+   *  reported here: a package that can't be located, or the files that can't
+   *  be read, are left to parsePackage, which reports them as with one job.
+   */
+  void PackageManager::prefetchPackages(const StringVector& names) {
+    StringVector files;
+    for (unsigned i = 0; i < names.size(); ++i) {
+      const std::string& name = names.at(i);
+      PackagePtrMap::const_iterator pit = _packages.find(name);
+      if (name.empty() || (pit != _packages.end() && pit->second->_parsed))
+        continue;
+      StringVector sv;
+      try {
+        sv = locatePackage(name);
+      } catch (const boost::filesystem::filesystem_error& e) {
+        qiLogVerbose() << "not prefetching package '" << name << "': " << e.what();
+        continue;
+      }
+      //parsePackage loads its summaries instead, as long as it has no file yet
+      ParseResultVector summaries;
+      if (_usePackageSummaries && (pit == _packages.end() || pit->second->_contents.empty()) &&
+          readSummaries(name, sv, &summaries)) {
+        qiLogVerbose() << "not prefetching package '" << name << "': summarized";
+        continue;
+      }
+      //parseFiles would reject all the files of the package
+      bool regular = true;
+      for (unsigned j = 0; j < sv.size() && regular; ++j)
+        regular = qi::Path(sv.at(j)).isRegularFile();
+      if (regular)
+        files.insert(files.end(), sv.begin(), sv.end());
+      else
+        qiLogVerbose() << "not prefetching package '" << name << "': not only regular files";
+    }
+    StringVector failed;
+    parseFiles(files, &failed);
+    for (unsigned i = 0; i < failed.size(); ++i)
+      qiLogVerbose() << "not prefetching file '" << failed.at(i) << "'";
+  }
+
+  void PackageManager::parseImports(const PackagePtr& pkg) {
     DiagnosticVector mv;
     ASTMap::iterator it;
+    if (_jobs > 1) {
+      StringVector names;
+      for (it = pkg->_imports.begin(); it != pkg->_imports.end(); ++it)
+        names.push_back(it->first);
+      prefetchPackages(names);
+    }
+
     for (it = pkg->_imports.begin(); it != pkg->_imports.end(); ++it) {
 
       try {
@@ -378,20 +747,66 @@ namespace qilang {
     //for each imports verify each symbol are correct
     //for (it = pkg->_imports.begin(); it != pkg->_imports.end(); ++it) {
     //}
+  }
+
+  qi::uint64_t PackageManager::exportsHash(const std::string& pkgName) const {
+    PackagePtrMap::const_iterator it = _packages.find(pkgName);
+    return it == _packages.end() ? 0 : it->second->exportsHash();
+  }
+
+  /** the resolution of a package reads its imports, its exports and the
+   *  exports of the packages it resolved names in (imported or written with
+   *  their package), nothing else.
+   */
+  bool PackageManager::analysisUpToDate(const Package& pkg) const {
+    if (!pkg._analyzed || pkg._analysisImports != pkg.importsHash())
+      return false;
+    std::map<std::string, qi::uint64_t>::const_iterator it;
+    for (it = pkg._analysisInputs.begin(); it != pkg._analysisInputs.end(); ++it) {
+      if (exportsHash(it->first) != it->second)
+        return false;
+    }
+    for (ASTMap::const_iterator iit = pkg._imports.begin(); iit != pkg._imports.end(); ++iit) {
+      if (pkg._analysisInputs.find(iit->first) == pkg._analysisInputs.end())
+        return false;
+    }
+    return true;
+  }
+
+  /** resolve the custom types used in the files of pkg.
+   *  Only pkg and its ParseResults are modified: packages can be resolved
+   *  concurrently, once every package they may import is parsed.
+   *
+   *  When nothing the resolution reads changed since the last one, only the
+   *  files added or modified since are resolved. The diagnostics of the
+   *  previous resolution of a file are replaced.
+   */
+  void PackageManager::resolveTypes(const PackagePtr& pkg) {
+    bool upToDate = analysisUpToDate(*pkg);
+    //the imported packages may have changed since the last pass
+    if (!upToDate)
+      pkg->_resolutions.clear();
 
     //for each customtype expr resolve name
     //for each files in the package
     ParseResultMap::iterator it2;
     for (it2 = pkg->_contents.begin(); it2 != pkg->_contents.end(); ++it2) {
-      NodePtrVector customs = findNode(it2->second->ast, NodeType_CustomTypeExpr);
+      ParseResult& pr = *it2->second;
+      if (upToDate && pr.analyzed) {
+        qiLogVerbose() << "already analysed, skipping '" << it2->first << "'";
+        continue;
+      }
+      DiagnosticVector& messages = pr.messages();
+      if (pr.analysisBegin < pr.analysisEnd && pr.analysisEnd <= messages.size())
+        messages.erase(messages.begin() + pr.analysisBegin, messages.begin() + pr.analysisEnd);
+      pr.analysisBegin = messages.size();
 
+      const NodePtrVector& customs = pr.nodes(NodeType_CustomTypeExpr);
       for (unsigned j = 0; j < customs.size(); ++j) {
         CustomTypeExprNode* tnode = static_cast<CustomTypeExprNode*>(customs.at(j).get());
-        ResolutionResult sp;
-        try {
-          sp = resolveImport(it2->second, pkg, tnode);
-        } catch(const std::exception& e) {
-          it2->second->addDiag(Diagnostic(DiagnosticType_Error, "Can't find id '" + tnode->value + "'", tnode->loc()));
+        ResolutionResult sp = resolveImport(it2->second, pkg, tnode);
+        if (!sp.resolved()) {
+          pr.addDiag(Diagnostic(DiagnosticType_Error, "Can't find id '" + tnode->value.str() + "'", tnode->loc()));
           continue;
         }
         qiLogVerbose() << "resolved value '" << tnode->value << " to '" << sp.pkg << "." << sp.type << "'";
@@ -399,7 +814,218 @@ namespace qilang {
         tnode->resolved_value   = sp.type;
         tnode->resolved_kind    = sp.kind;
       }
+      pr.analysisEnd = messages.size();
+      pr.analyzed = true;
+    }
+
+    if (upToDate)
+      return;
+    pkg->_analysisInputs.clear();
+    pkg->_analysisInputs[pkg->_name] = pkg->exportsHash();
+    for (ASTMap::const_iterator it = pkg->_imports.begin(); it != pkg->_imports.end(); ++it)
+      pkg->_analysisInputs[it->first] = exportsHash(it->first);
+    for (ResolutionMap::const_iterator it = pkg->_resolutions.begin(); it != pkg->_resolutions.end(); ++it)
+      pkg->_analysisInputs[it->second.pkg.str()] = exportsHash(it->second.pkg.str());
+    pkg->_analysisImports = pkg->importsHash();
+    pkg->_analyzed = true;
+  }
+
+  /** parse the known packages and, transitively, the packages they import,
+   *  and build the dependency graph. Each round parses the files of all its
+   *  packages in one batch.
+   */
+  void PackageManager::loadDependencies() {
+    _graph.clear();
+    std::set<std::string> seen;
+    std::set<std::string> imported;
+    StringVector todo;
+    for (PackagePtrMap::const_iterator it = _packages.begin(); it != _packages.end(); ++it) {
+      seen.insert(it->first);
+      todo.push_back(it->first);
+    }
+
+    while (!todo.empty()) {
+      if (_jobs > 1)
+        prefetchPackages(todo);
+
+      StringVector next;
+      for (unsigned i = 0; i < todo.size(); ++i) {
+        const std::string& name = todo.at(i);
+        //like resolvePackage, an import that can't be parsed is not an error here
+        if (imported.count(name)) {
+          try {
+            parsePackage(name);
+          } catch (const std::exception&) {
+            continue;
+          }
+        } else {
+          parsePackage(name);
+        }
+        _graph.addPackage(name);
+        PackagePtr pkg = package(name);
+        for (ASTMap::const_iterator it = pkg->_imports.begin(); it != pkg->_imports.end(); ++it) {
+          _graph.addImport(name, it->first);
+          if (seen.insert(it->first).second) {
+            next.push_back(it->first);
+            imported.insert(it->first);
+          }
+        }
+      }
+      //parsing a directory may have found other packages
+      for (PackagePtrMap::const_iterator it = _packages.begin(); it != _packages.end(); ++it) {
+        if (seen.insert(it->first).second)
+          next.push_back(it->first);
+      }
+      todo.swap(next);
+    }
+  }
+
+  void PackageManager::reportCycles() {
+    std::vector<PackageGraph::IndexVector> cycles = _graph.cycles();
+    for (unsigned c = 0; c < cycles.size(); ++c) {
+      PackageGraph::IndexVector path = _graph.cyclePath(cycles[c]);
+      std::string desc;
+      for (unsigned i = 0; i < path.size(); ++i)
+        desc += (i ? " -> " : "") + _graph.name(path[i]);
+      if (path.size() < 2 || !_reportedCycles.insert(desc).second)
+        continue;
+
+      //on the first import of the cycle, in the file that declares it
+      PackagePtrMap::const_iterator pit = _packages.find(_graph.name(path[0]));
+      if (pit == _packages.end())
+        continue;
+      const PackagePtr& pkg = pit->second;
+      ASTMap::const_iterator iit = pkg->_imports.find(_graph.name(path[1]));
+      if (iit == pkg->_imports.end() || iit->second.empty())
+        continue;
+      const NodePtr& node = iit->second.front();
+      for (ParseResultMap::const_iterator it = pkg->_contents.begin(); it != pkg->_contents.end(); ++it) {
+        if (it->second->filename == node->loc().filename()) {
+          it->second->addDiag(Diagnostic(DiagnosticType_Warning, "import cycle: " + desc, node->loc()));
+          break;
+        }
+      }
+    }
+  }
+
+  /** resolve the types of every component, each one after the components it
+   *  imports, and the independent ones concurrently. The packages of a
+   *  component (an import cycle) are resolved together, in name order.
+   *
+   *  Ready components go through a single queue shared by the workers: a
+   *  component is a whole package, far bigger than the cost of the lock.
+   */
+  void PackageManager::resolveComponents(const std::vector<PackageGraph::IndexVector>& components)
+  {
+    const std::size_t count = components.size();
+    std::vector<std::size_t> componentOf(_graph.size());
+    for (std::size_t c = 0; c < count; ++c) {
+      for (unsigned i = 0; i < components[c].size(); ++i)
+        componentOf[components[c][i]] = c;
+    }
+
+    //imported components and importing components of each component
+    std::vector<std::set<std::size_t> > deps(count);
+    std::vector<std::set<std::size_t> > users(count);
+    for (std::size_t c = 0; c < count; ++c) {
+      for (unsigned i = 0; i < components[c].size(); ++i) {
+        const PackageGraph::IndexVector& imports = _graph.imports(components[c][i]);
+        for (unsigned j = 0; j < imports.size(); ++j) {
+          std::size_t d = componentOf[imports[j]];
+          if (d != c) {
+            deps[c].insert(d);
+            users[d].insert(c);
+          }
+        }
+      }
+    }
+
+    auto resolve = [&](std::size_t c) {
+      for (unsigned i = 0; i < components[c].size(); ++i) {
+        PackagePtrMap::const_iterator it = _packages.find(_graph.name(components[c][i]));
+        if (it != _packages.end())
+          resolveTypes(it->second);
+      }
+    };
+
+    if (_jobs <= 1 || count <= 1) {
+      //components come in dependency order
+      for (std::size_t c = 0; c < count; ++c)
+        resolve(c);
+      return;
+    }
+
+    //diagnostics of the files resolved again are echoed afterward, in the order of the serial path
+    std::vector<ParseResultPtr> echoed;
+    for (std::size_t c = 0; c < count; ++c) {
+      for (unsigned i = 0; i < components[c].size(); ++i) {
+        PackagePtrMap::const_iterator it = _packages.find(_graph.name(components[c][i]));
+        if (it == _packages.end())
+          continue;
+        bool upToDate = analysisUpToDate(*it->second);
+        const ParseResultMap& contents = it->second->_contents;
+        for (ParseResultMap::const_iterator pit = contents.begin(); pit != contents.end(); ++pit) {
+          if (!pit->second->echoDiagnostics || (upToDate && pit->second->analyzed))
+            continue;
+          pit->second->echoDiagnostics = false;
+          echoed.push_back(pit->second);
+        }
+      }
+    }
+
+    std::mutex                 mutex;
+    std::condition_variable    cond;
+    std::deque<std::size_t>    ready;
+    std::vector<std::size_t>   waiting(count);
+    std::size_t                done = 0;
+    std::exception_ptr         error;
+    for (std::size_t c = 0; c < count; ++c) {
+      waiting[c] = deps[c].size();
+      if (!waiting[c])
+        ready.push_back(c);
+    }
+
+    auto worker = [&]() {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true) {
+        cond.wait(lock, [&]() { return !ready.empty() || done == count; });
+        if (ready.empty())
+          return;
+        std::size_t c = ready.front();
+        ready.pop_front();
+        lock.unlock();
+        try {
+          resolve(c);
+        } catch (...) {
+          std::lock_guard<std::mutex> elock(mutex);
+          if (!error)
+            error = std::current_exception();
+        }
+        lock.lock();
+        ++done;
+        for (std::set<std::size_t>::const_iterator it = users[c].begin(); it != users[c].end(); ++it) {
+          if (--waiting[*it] == 0)
+            ready.push_back(*it);
+        }
+        cond.notify_all();
+      }
+    };
+    std::vector<std::thread> threads;
+    const std::size_t nthreads = std::min<std::size_t>(_jobs, count);
+    for (std::size_t t = 1; t < nthreads; ++t)
+      threads.push_back(std::thread(worker));
+    worker();
+    for (std::size_t t = 0; t < threads.size(); ++t)
+      threads[t].join();
+
+    for (std::size_t i = 0; i < echoed.size(); ++i) {
+      ParseResultPtr& pr = echoed[i];
+      for (std::size_t m = pr->analysisBegin; m < pr->analysisEnd && m < pr->messages().size(); ++m)
+        pr->messages().at(m).print(*_diagnostics, pr->source);
+      pr->echoDiagnostics = true;
     }
+    if (error)
+      std::rethrow_exception(error);
   }
 
   void PackageManager::addLookupPaths(const StringVector& lookupPaths) {
@@ -426,11 +1052,66 @@ namespace qilang {
       resolvePackage(packageName);
     }
     else {
-      PackagePtrMap::iterator it;
-      for (it = _packages.begin(); it != _packages.end(); ++it) {
-        anal(it->first);
+      qiLogVerbose() << "Package Verification: all packages";
+      loadDependencies();
+      reportCycles();
+      resolveComponents(_graph.components());
+    }
+  }
+
+  //FNV-1a 64, chained
+  static qi::uint64_t hashBytes(const char* data, std::size_t size, qi::uint64_t h = 14695981039346656037ULL) {
+    for (std::size_t i = 0; i < size; ++i) {
+      h ^= static_cast<unsigned char>(data[i]);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  static qi::uint64_t hashString(const std::string& str, qi::uint64_t h = 14695981039346656037ULL) {
+    //the size separates consecutive strings
+    qi::uint64_t size = str.size();
+    h = hashBytes(reinterpret_cast<const char*>(&size), sizeof(size), h);
+    return hashBytes(str.data(), str.size(), h);
+  }
+
+  static qi::uint64_t hashValue(qi::uint64_t value, qi::uint64_t h) {
+    return hashBytes(reinterpret_cast<const char*>(&value), sizeof(value), h);
+  }
+
+  qi::uint64_t Package::exportsHash() const
+  {
+    //_exports is not ordered: sum the hashes of the entries. never 0, that is "no package"
+    qi::uint64_t ret = 1;
+    for (NodeMap::const_iterator it = _exports.begin(); it != _exports.end(); ++it)
+      ret += hashValue(it->second->type(), hashString(it->first.str()));
+    return ret ? ret : 1;
+  }
+
+  qi::uint64_t Package::importsHash() const
+  {
+    qi::uint64_t ret = hashString(std::string());
+    for (ASTMap::const_iterator it = _imports.begin(); it != _imports.end(); ++it) {
+      ret = hashString(it->first, ret);
+      for (unsigned i = 0; i < it->second.size(); ++i) {
+        ImportNode* inode = static_cast<ImportNode*>(it->second.at(i).get());
+        ret = hashValue(inode->importType, ret);
+        ret = hashValue(inode->imports.size(), ret);
+        for (unsigned j = 0; j < inode->imports.size(); ++j)
+          ret = hashString(inode->imports.at(j).str(), ret);
       }
     }
+    return ret;
+  }
+
+  qi::uint64_t Package::contentHash() const
+  {
+    qi::uint64_t ret = hashString(_name);
+    for (ParseResultMap::const_iterator it = _contents.begin(); it != _contents.end(); ++it) {
+      ret = hashString(it->first, ret);
+      ret = hashValue(it->second->sourceHash, ret);
+    }
+    return ret;
   }
 
   bool Package::hasError() const
@@ -0,0 +1,335 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <qilang/packagesummary.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/pathformatter.hpp>
+#include "mappedfile.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <qi/log.hpp>
+
+qiLogCategory("qilang.summary");
+
+namespace qilang {
+
+  namespace fs = boost::filesystem;
+
+  static const char* const PackageSummaryMagic = "qilang-package-summary";
+
+  static bool declLess(const PackageSummary::Decl& a, const PackageSummary::Decl& b) {
+    if (a.line != b.line)
+      return a.line < b.line;
+    if (a.column != b.column)
+      return a.column < b.column;
+    return a.name < b.name;
+  }
+
+  PackageSummary::PackageSummary()
+    : _time(0)
+  {}
+
+  static bool fileLess(const PackageSummary::File& a, const PackageSummary::File& b) {
+    return a.name < b.name;
+  }
+
+  void PackageSummary::build(const std::string& dir, const Package& pkg) {
+    _dir = dir;
+    _package = pkg._name;
+    _files.clear();
+    //files modified after this are hashed again, see matches
+    _time = std::time(0);
+
+    //the toplevel nodes exported by the package, and their name
+    std::unordered_map<const Node*, Symbol> exported;
+    for (NodeMap::const_iterator it = pkg._exports.begin(); it != pkg._exports.end(); ++it)
+      exported[it->second.get()] = it->first;
+
+    for (ParseResultMap::const_iterator it = pkg._contents.begin(); it != pkg._contents.end(); ++it) {
+      fs::path path(it->first);
+      boost::system::error_code ec;
+      if (!fs::equivalent(path.parent_path(), dir, ec))
+        continue;
+      File file;
+      file.name = path.filename().string();
+      //the mtime before the content: a change in between is seen by matches
+      file.mtime = fs::last_write_time(path, ec);
+      AstSourceStamp stamp;
+      if (ec || !astSourceStamp(it->first, &stamp))
+        continue;
+      file.size = stamp.size;
+      file.hash = stamp.hash;
+
+      const NodePtrVector& ast = it->second->ast;
+      for (unsigned i = 0; i < ast.size(); ++i) {
+        const NodePtr& node = ast.at(i);
+        Decl decl;
+        decl.type   = node->type();
+        decl.line   = node->loc().beg_line;
+        decl.column = node->loc().beg_column;
+        if (node->type() == NodeType_Import) {
+          ImportNode* inode = static_cast<ImportNode*>(node.get());
+          decl.name       = inode->name.str();
+          decl.importType = inode->importType;
+          for (unsigned j = 0; j < inode->imports.size(); ++j)
+            decl.imports.push_back(inode->imports.at(j).str());
+        } else {
+          std::unordered_map<const Node*, Symbol>::const_iterator eit = exported.find(node.get());
+          if (eit == exported.end())
+            continue;
+          decl.name = eit->second.str();
+        }
+        file.decls.push_back(decl);
+      }
+      std::sort(file.decls.begin(), file.decls.end(), declLess);
+      _files.push_back(file);
+    }
+    std::sort(_files.begin(), _files.end(), fileLess);
+  }
+
+  //the node types a summary can describe
+  static bool isSummaryType(int type) {
+    switch (type) {
+      case NodeType_Import:
+      case NodeType_InterfaceDecl:
+      case NodeType_StructDecl:
+      case NodeType_FnDecl:
+      case NodeType_ConstDecl:
+      case NodeType_ObjectDef:
+      case NodeType_TypeDefDecl:
+      case NodeType_EnumDecl:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool PackageSummary::load(const std::string& dir, std::string* error) {
+    _dir = dir;
+    _package.clear();
+    _time = 0;
+    _files.clear();
+    std::string filename = (fs::path(dir) / PackageSummaryFileName).string();
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!is) {
+      if (error)
+        *error = "can't open '" + filename + "'";
+      return false;
+    }
+
+    std::string  line;
+    std::string  magic;
+    unsigned int version = 0;
+    std::getline(is, line);
+    std::istringstream header(line);
+    header >> magic >> version >> _time >> _package;
+    if (!header || magic != PackageSummaryMagic || version != PackageSummaryVersion) {
+      if (error)
+        *error = "'" + filename + "' is not a package summary of this version";
+      return false;
+    }
+
+    //a summary is a few lines per file, read it line by line
+    while (std::getline(is, line)) {
+      std::istringstream ls(line);
+      char kind = 0;
+      bool ok = false;
+      ls >> kind;
+      if (kind == 'f') {
+        File file;
+        ok = static_cast<bool>(ls >> file.mtime >> file.size >> file.hash >> std::ws) && std::getline(ls, file.name) && !file.name.empty();
+        _files.push_back(file);
+      } else if ((kind == 'i' || kind == 'e') && !_files.empty()) {
+        Decl decl;
+        int type = 0;
+        if (kind == 'i') {
+          int importType = 0;
+          ok = static_cast<bool>(ls >> decl.line >> decl.column >> importType >> decl.name);
+          ok = ok && importType >= ImportType_Package && importType <= ImportType_All;
+          type = NodeType_Import;
+          decl.importType = static_cast<ImportType>(importType);
+          std::string name;
+          while (ls >> name)
+            decl.imports.push_back(name);
+        } else {
+          ok = static_cast<bool>(ls >> decl.line >> decl.column >> type >> decl.name);
+          ok = ok && type != NodeType_Import;
+        }
+        ok = ok && isSummaryType(type);
+        decl.type = static_cast<NodeType>(type);
+        _files.back().decls.push_back(decl);
+      }
+      if (!ok) {
+        _files.clear();
+        if (error)
+          *error = "'" + filename + "' is malformed";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool PackageSummary::save(std::string* error) const {
+    return writeFileAtomically((fs::path(_dir) / PackageSummaryFileName).string(), [this](std::ostream& os) {
+      os << PackageSummaryMagic << " " << PackageSummaryVersion << " " << _time << " " << _package << "\n";
+      for (FileVector::const_iterator it = _files.begin(); it != _files.end(); ++it) {
+        os << "f " << it->mtime << " " << it->size << " " << it->hash << " " << it->name << "\n";
+        for (DeclVector::const_iterator dit = it->decls.begin(); dit != it->decls.end(); ++dit) {
+          if (dit->type == NodeType_Import) {
+            os << "i " << dit->line << " " << dit->column << " " << dit->importType << " " << dit->name;
+            for (unsigned i = 0; i < dit->imports.size(); ++i)
+              os << " " << dit->imports.at(i);
+            os << "\n";
+          } else {
+            os << "e " << dit->line << " " << dit->column << " " << dit->type << " " << dit->name << "\n";
+          }
+        }
+      }
+      return static_cast<bool>(os);
+    }, std::ios::binary, error);
+  }
+
+  bool PackageSummary::matches(const StringVector& files) const {
+    if (files.size() != _files.size())
+      return false;
+    StringVector names;
+    for (unsigned i = 0; i < files.size(); ++i)
+      names.push_back(fs::path(files.at(i)).filename().string());
+    std::sort(names.begin(), names.end());
+    for (unsigned i = 0; i < names.size(); ++i) {
+      const File& file = _files.at(i);
+      if (names.at(i) != file.name)
+        return false;
+      fs::path path = fs::path(_dir) / file.name;
+      boost::system::error_code ec;
+      qi::uint64_t size = fs::file_size(path, ec);
+      if (ec || size != file.size)
+        return false;
+      //with a one second resolution, a change in the second of the build may be missed
+      qi::int64_t mtime = fs::last_write_time(path, ec);
+      if (!ec && mtime == file.mtime && mtime < _time)
+        continue;
+      AstSourceStamp stamp;
+      if (!astSourceStamp(path.string(), &stamp) || stamp.size != file.size || stamp.hash != file.hash)
+        return false;
+    }
+    return true;
+  }
+
+  template <typename T, typename... Args>
+  static boost::shared_ptr<T> make(const ParseResultPtr& pr, Args&&... args) {
+    return boost::allocate_shared<T>(NodeAllocator<T>(pr->arena), std::forward<Args>(args)...);
+  }
+
+  ParseResultVector PackageSummary::toParseResults() const {
+    ParseResultVector ret;
+    for (FileVector::const_iterator it = _files.begin(); it != _files.end(); ++it) {
+      ParseResultPtr pr = newParseResult();
+      pr->filename   = (fs::path(_dir) / it->name).string();
+      pr->sourceHash = it->hash;
+      pr->summary    = true;
+      Symbol file(pr->filename);
+      pr->ast.push_back(make<PackageNode>(pr, _package, Location(file)));
+      for (DeclVector::const_iterator dit = it->decls.begin(); dit != it->decls.end(); ++dit) {
+        Location loc(dit->line, dit->column, dit->line, dit->column, file);
+        switch (dit->type) {
+          case NodeType_Import: {
+            SymbolVector imports;
+            for (unsigned i = 0; i < dit->imports.size(); ++i)
+              imports.push_back(Symbol(dit->imports.at(i)));
+            pr->ast.push_back(make<ImportNode>(pr, dit->importType, Symbol(dit->name), imports, loc));
+            break;
+          }
+          case NodeType_InterfaceDecl:
+            pr->ast.push_back(make<InterfaceDeclNode>(pr, dit->name, DeclNodePtrVector(), loc));
+            break;
+          case NodeType_StructDecl:
+            pr->ast.push_back(make<StructDeclNode>(pr, dit->name, DeclNodePtrVector(), loc));
+            break;
+          case NodeType_FnDecl:
+            pr->ast.push_back(make<FnDeclNode>(pr, dit->name, ParamFieldDeclNodePtrVector(), loc));
+            break;
+          case NodeType_ConstDecl:
+            pr->ast.push_back(make<ConstDeclNode>(pr, dit->name, LiteralNodePtr(), loc));
+            break;
+          case NodeType_ObjectDef:
+            pr->ast.push_back(make<ObjectDefNode>(pr, TypeExprNodePtr(), dit->name, StmtNodePtrVector(), loc));
+            break;
+          case NodeType_TypeDefDecl:
+            pr->ast.push_back(make<TypeDefDeclNode>(pr, dit->name, TypeExprNodePtr(), loc));
+            break;
+          case NodeType_EnumDecl:
+            pr->ast.push_back(make<EnumDeclNode>(pr, dit->name, EnumFieldDeclNodePtrVector(), loc));
+            break;
+          default:
+            break;
+        }
+      }
+      ret.push_back(pr);
+    }
+    return ret;
+  }
+
+  bool writePackageSummaries(const std::string& root, std::string* error) {
+    boost::system::error_code ec;
+    if (!fs::is_directory(root, ec)) {
+      if (error)
+        *error = "'" + root + "' is not a directory";
+      return false;
+    }
+
+    //the files of a package are the .idl.qi of its directory
+    std::map<std::string, StringVector> dirs;
+    for (fs::recursive_directory_iterator it(root), end; it != end; ++it) {
+      std::string path = formatPath(it->path().string());
+      if (boost::algorithm::ends_with(path, ".idl.qi") && fs::is_regular_file(it->status()))
+        dirs[it->path().parent_path().string()].push_back(path);
+    }
+
+    PackageManagerPtr pm = newPackageManager();
+    pm->setUsePackageSummaries(false);
+    for (std::map<std::string, StringVector>::iterator it = dirs.begin(); it != dirs.end(); ++it) {
+      StringVector& files = it->second;
+      std::sort(files.begin(), files.end());
+      //kept when its files did not change: only the packages that did are parsed
+      PackageSummary current;
+      if (current.load(it->first) && current.matches(files))
+        continue;
+      std::string name;
+      bool ok = true;
+      try {
+        for (unsigned i = 0; ok && i < files.size(); ++i) {
+          ParseResultPtr pr = pm->parseFile(newFileReader(files.at(i)));
+          ok = !pr->hasError() && !pr->package.empty() && (name.empty() || name == pr->package);
+          name = pr->package;
+        }
+        //without lookup path, this only indexes the files parsed above
+        if (ok)
+          pm->parsePackage(name);
+      } catch (const std::exception& e) {
+        qiLogVerbose() << "can't summarize '" << it->first << "': " << e.what();
+        ok = false;
+      }
+      if (!ok || pm->package(name)->hasError()) {
+        qiLogVerbose() << "no summary for '" << it->first << "': it has errors";
+        continue;
+      }
+      PackageSummary summary;
+      summary.build(it->first, *pm->package(name));
+      if (!summary.save(error))
+        return false;
+    }
+    return true;
+  }
+
+}
@@ -7,44 +7,142 @@
 
 #include <qi/os.hpp>
 #include <qilang/parser.hpp>
+#include <qilang/astfile.hpp>
 #include <qilang/node.hpp>
+#include <qilang/sourcemanager.hpp>
+#include <qilang/visitor.hpp>
 #include "parser_p.hpp"
+#include "lexer.hpp"
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <unordered_set>
 #include "grammar.tab.hpp"
 
+yy::parser::symbol_type qilang_lex(void* yyscanner);
 int  qilang_lex_init(void**);
 int  qilang_lex_destroy(void*);
 void qilang_set_extra(qilang::Parser*, void *);
 struct yyscan_t;
 void qilang_set_debug(int debug_flag, void* yyscanner);
+struct yy_buffer_state;
+yy_buffer_state* qilang__scan_buffer(char* base, size_t size, void* yyscanner);
 
 qiLogCategory("qilang.parser");
 
 namespace qilang {
 
-  Parser::Parser(const FileReaderPtr &file)
+  FileReader::FileReader(const std::string& filename)
+    : _filename(filename)
+    , _in(0)
+    , _loaded(false)
+  {
+    std::ifstream is(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!is.is_open())
+      return;
+    is.seekg(0, std::ios::end);
+    std::streamoff size = is.tellg();
+    is.seekg(0, std::ios::beg);
+    if (size < 0)
+      return;
+
+    //flex expect two YY_END_OF_BUFFER_CHAR at the end of the buffer
+    _buffer.resize(static_cast<size_t>(size) + 2, '\0');
+    if (size > 0 && !is.read(&_buffer[0], size)) {
+      qiLogWarning() << "can't read file '" << filename << "'";
+      _buffer.clear();
+      return;
+    }
+    _loaded = true;
+  }
+
+  FileReader::FileReader(const std::string& filename, const char* data, std::size_t size)
+    : _filename(filename)
+    , _in(0)
+    , _buffer(data, size)
+    , _loaded(true)
+  {
+    _buffer.resize(size + 2, '\0');
+  }
+
+  bool FileReader::isOpen() const {
+    if (isBuffered())
+      return _loaded;
+    return _in->good();
+  }
+
+  LexerType defaultLexer() {
+#ifdef QILANG_HANDWRITTEN_LEXER
+    return LexerType_HandWritten;
+#else
+    return LexerType_Flex;
+#endif
+  }
+
+  Parser::Parser(const FileReaderPtr &file, LexerType lexerType)
     : file(file)
     , _result(newParseResult())
     , _parsed(false)
+    , fileSymbol(file->filename())
+    , lexerType(lexerType)
+    , lexer(0)
     , parser(this)
     , linesSinceLastComment(0)
+    , partial(false)
+    , tokenCount(0)
   {
     _result->filename = file->filename();
+    //rough estimate of the memory used by the AST, to allocate it at once
+    if (file->isBuffered())
+      _result->arena->reserve(file->buffer().size() * 8);
     qilang_lex_init(&scanner);
     qilang_set_extra(this, scanner);
   }
 
   Parser::~Parser()
   {
+    delete lexer;
     qilang_lex_destroy(scanner);
   }
 
-  void Parser::parse() {
-    if (_parsed)
-      return;
-    _parsed = true;
+  yy::parser::symbol_type Parser::lex() {
+    yy::parser::symbol_type tok = lexer ? lexer->lex() : qilang_lex(scanner);
+    ParseBoundary& end = tokenEnds[tokenCount++ & 1];
+    end.line              = tok.location.end.line;
+    end.column            = tok.location.end.column;
+    end.comment           = lastComment;
+    end.linesSinceComment = linesSinceLastComment;
+    return tok;
+  }
+
+  void Parser::startAt(const ParseBoundary& b) {
+    partial = true;
+    start = b;
+  }
+
+  void Parser::endToplevel(const yy::location& l) {
+    for (unsigned i = 0; i < 2; ++i) {
+      const ParseBoundary& end = tokenEnds[i];
+      if (end.line == static_cast<int>(l.end.line) && end.column == static_cast<int>(l.end.column)) {
+        _result->boundaries.push_back(end);
+        return;
+      }
+    }
+    ParseBoundary unknown;
+    unknown.line = 0;
+    _result->boundaries.push_back(unknown);
+  }
+
+  void Parser::startLexer() {
     loc.initialize(const_cast<std::string*>(&file->filename()));
+    if (partial) {
+      loc.begin.line   = loc.end.line   = start.line;
+      loc.begin.column = loc.end.column = start.column;
+      lastComment           = start.comment;
+      linesSinceLastComment = start.linesSinceComment;
+    }
     std::string pdebug = qi::os::getenv("QILANG_PARSER_DEBUG");
     if (!pdebug.empty() && pdebug != "0") {
       parser.set_debug_level(1);
@@ -59,15 +157,138 @@ namespace qilang {
     else {
       qilang_set_debug(0, scanner);
     }
+    if (lexerType == LexerType_HandWritten) {
+      //the hand-written lexer needs the whole content, read streams at once.
+      //It does not modify it: it scans the source kept for the diagnostics,
+      //the buffer of the reader is moved there
+      if (file->isBuffered()) {
+        streamSource.swap(file->buffer());
+        streamSource.resize(streamSource.size() >= 2 ? streamSource.size() - 2 : 0);
+      } else {
+        char chunk[16384];
+        while (file->in().read(chunk, sizeof(chunk)) || file->in().gcount())
+          streamSource.append(chunk, file->in().gcount());
+      }
+      const std::string* content = &streamSource;
+      if (!partial) {
+        _result->source = SourceManager::instance().setSource(fileSymbol, std::move(streamSource));
+        content = &_result->source->content();
+      }
+      lexer = new Lexer(this, content->data(), content->data() + content->size());
+      return;
+    }
+    //preloaded content: run the scanner in place, no YY_INPUT copies
+    //the scanner modifies the buffer, keep the pristine content for diagnostics
+    if (file->isBuffered()) {
+      std::string& buf = file->buffer();
+      if (!partial)
+        _result->source = SourceManager::instance().setSource(fileSymbol, buf.data(), buf.size() - 2);
+      qilang__scan_buffer(&buf[0], buf.size(), scanner);
+    }
+  }
+
+  void Parser::parse() {
+    if (_parsed)
+      return;
+    _parsed = true;
+    startLexer();
     try {
       parser.parse();
     } catch (const ParseException& pe) {
       _result->ast.clear();
+      _result->boundaries.clear();
+      registerStreamSource();
       _result->addDiag(Diagnostic(DiagnosticType_Error, pe.what(), pe.loc()));
+      return;
+    }
+    registerStreamSource();
+  }
+
+  static void setSourceHash(ParseResult& result) {
+    if (result.source)
+      result.sourceHash = astSourceStamp(result.source->content().data(), result.source->content().size()).hash;
+  }
+
+  namespace {
+    //describe the value of the tokens that carry one
+    struct TokenKinds {
+      TokenKinds() {
+        yy::parser::location_type l;
+        id        = yy::parser::make_ID(Symbol(), l).type_get();
+        str       = yy::parser::make_STRING(LiteralNodePtr(), l).type_get();
+        constant  = yy::parser::make_CONSTANT(LiteralNodePtr(), l).type_get();
+        fn        = yy::parser::make_FN(std::string(), l).type_get();
+        iface     = yy::parser::make_INTERFACE(std::string(), l).type_get();
+      }
+
+      int id, str, constant, fn, iface;
+    };
+
+    std::string describeLiteral(const LiteralNodePtr& node) {
+      std::stringstream ss;
+      switch (node->type()) {
+        case NodeType_IntData:
+          ss << "int " << static_cast<IntLiteralNode*>(node.get())->value;
+          break;
+        case NodeType_FloatData:
+          ss << "float " << std::setprecision(17) << static_cast<FloatLiteralNode*>(node.get())->value;
+          break;
+        case NodeType_StringData:
+          ss << "str '" << static_cast<StringLiteralNode*>(node.get())->value << "'";
+          break;
+        default:
+          ss << "literal";
+          break;
+      }
+      return ss.str();
+    }
+  }
+
+  std::size_t Parser::tokenize(StringVector* tokens) {
+    static const TokenKinds kinds;
+    std::size_t count = 0;
+    _parsed = true;
+    startLexer();
+    try {
+      for (;;) {
+        yy::parser::symbol_type tok = lex();
+        int kind = tok.type_get();
+        if (kind == 0)
+          break;
+        ++count;
+        if (!tokens)
+          continue;
+        std::stringstream ss;
+        ss << kind << " " << tok.location;
+        if (kind == kinds.id)
+          ss << " " << tok.value.as<Symbol>();
+        else if (kind == kinds.fn || kind == kinds.iface)
+          ss << " '" << tok.value.as<std::string>() << "'";
+        else if (kind == kinds.str || kind == kinds.constant)
+          ss << " " << describeLiteral(tok.value.as<LiteralNodePtr>());
+        tokens->push_back(ss.str());
+      }
+    } catch (const ParseException& pe) {
+      if (tokens) {
+        std::stringstream ss;
+        ss << "error " << pe.loc() << " " << pe.what();
+        tokens->push_back(ss.str());
+      }
     }
+    registerStreamSource();
+    return count;
   }
 
-  void Diagnostic::print(std::ostream &out) const {
+  //the content read by flex from a stream, once scanned
+  void Parser::registerStreamSource() {
+    if (file->isBuffered() || lexerType == LexerType_HandWritten)
+      return;
+    if (!partial)
+      _result->source = SourceManager::instance().setSource(fileSymbol, std::move(streamSource));
+    std::string().swap(streamSource);
+  }
+
+  void Diagnostic::print(std::ostream &out, const SourceBufferPtr& source) const {
     out << loc() << ":";
 
     switch (type()) {
@@ -85,75 +306,349 @@ namespace qilang {
     }
 
     out << what() << std::endl;
-    out << qilang::getErrorLine(filename(), loc());
+    out << qilang::getErrorLine(loc(), source);
   }
 
   void ParseResult::printMessage(std::ostream &out) const {
     for (unsigned i = 0; i < _messages.size(); ++i)
-      _messages.at(i).print(out);
+      _messages.at(i).print(out, source);
   }
 
-  ParseResultPtr Parser::result() {
-    parse();
-    return _result;
+  namespace {
+    struct NodeIndexer {
+      NodeIndexer(std::vector<NodePtrVector>& types, std::vector<NodePtrVector>& kinds)
+        : types(types)
+        , kinds(kinds)
+      {}
+
+      template <typename T>
+      void operator()(Node* parent, const boost::shared_ptr<T>& node) {
+        Node* n = node.get();
+        types[n->type()].push_back(node);
+        kinds[n->kind()].push_back(node);
+      }
+
+      std::vector<NodePtrVector>& types;
+      std::vector<NodePtrVector>& kinds;
+    };
   }
 
-  Location makeLocation(const yy::location& loc) {
-    if (loc.begin.filename)
-      return Location(loc.begin.line, loc.begin.column, loc.end.line, loc.end.column, *loc.begin.filename);
-    else {
-      qiLogWarning() << "missing filename for location";
-      return Location(loc.begin.line, loc.begin.column, loc.end.line, loc.end.column);
-    }
+  //lock held
+  void ParseResult::updateIndex() const {
+    bool valid = !_typeIndex.empty() && _indexedRoots.size() == ast.size();
+    for (unsigned i = 0; valid && i < ast.size(); ++i)
+      valid = _indexedRoots[i] == ast[i].get();
+    if (valid)
+      return;
+
+    _indexedRoots.clear();
+    for (unsigned i = 0; i < ast.size(); ++i)
+      _indexedRoots.push_back(ast[i].get());
+    _typeIndex.assign(NodeType_CallExpr + 1, NodePtrVector());
+    _kindIndex.assign(NodeKind_Stmt + 1, NodePtrVector());
+    NodeIndexer indexer(_typeIndex, _kindIndex);
+    walkNode(ast, indexer);
   }
 
-  std::string getErrorLine(const std::string& filename, const Location& loc) {
-    std::ifstream is;
-    std::string   ret;
+  const NodePtrVector& ParseResult::nodes(NodeType type) const {
+    std::lock_guard<std::mutex> lock(_indexMutex);
+    updateIndex();
+    return _typeIndex[type];
+  }
+
+  const NodePtrVector& ParseResult::nodes(NodeKind kind) const {
+    std::lock_guard<std::mutex> lock(_indexMutex);
+    updateIndex();
+    return _kindIndex[kind];
+  }
+
+  void ParseResult::invalidateIndex() {
+    std::lock_guard<std::mutex> lock(_indexMutex);
+    _indexedRoots.clear();
+    _typeIndex.clear();
+    _kindIndex.clear();
+  }
+
+  ParseResultPtr Parser::result() {
+    parse();
+    return _result;
+  }
 
+  std::string getErrorLine(const Location& loc, const SourceBufferPtr& source) {
     //no location provided just drop
     if (loc.beg_column == 0 || loc.beg_line == 0)
       return std::string();
-    is.open(filename.c_str());
-    if (!is.is_open())
+    SourceBufferPtr src = source ? source : SourceManager::instance().source(loc.file);
+    const char* lbeg;
+    std::size_t lsize;
+    if (!src || !src->line(loc.beg_line, &lbeg, &lsize))
       return std::string();
 
-    std::string ln;
-    unsigned int lico = loc.beg_line;
-    for (unsigned int i = 0; i < lico; ++i) {
-      if (!is.good())
-        return std::string();
-      getline(is, ln);
-    }
-    //ret = "";
-    ret = ln + "\n";
-    unsigned int cbeg = loc.beg_column;
-    unsigned int cend = loc.end_column;
-    int count = cend - cbeg;
-    int space = cbeg - 1;
+    int count = loc.end_column - loc.beg_column;
+    int space = loc.beg_column - 1;
     //multiline error just display the beginning
     if (loc.end_line != loc.beg_line)
       count = 1;
     space = space < 0 ? 0 : space;
     count = count < 1 ? 1 : count;
-    for (int i = 0; i < space; ++i)
-      ret += " ";
-    for (int i = 0; i < count; ++i)
-      ret += "^";
-    ret += "\n";
+
+    std::string ret;
+    ret.reserve(lsize + space + count + 2);
+    ret.append(lbeg, lsize);
+    ret += '\n';
+    ret.append(space, ' ');
+    ret.append(count, '^');
+    ret += '\n';
     return ret;
   }
 
   //public interface
   ParseResultPtr parse(const FileReaderPtr& file) {
+    return parse(file, true);
+  }
+
+  namespace {
+    /* move a subtree by a number of lines. All the children are moved, not
+     * only the ones walkNode visits, each once: the fields of "x, y : int"
+     * share their type node.
+     */
+    struct LineShifter {
+      explicit LineShifter(int delta)
+        : delta(delta)
+      {}
+
+      void shift(Node* node) {
+        if (!node || !shifted.insert(node).second)
+          return;
+        Location l = node->loc();
+        l.beg_line += delta;
+        l.end_line += delta;
+        node->setLoc(l);
+        dispatchNode(node, *this);
+      }
+
+      template <typename T>
+      void shift(const boost::shared_ptr<T>& node) {
+        shift(static_cast<Node*>(node.get()));
+      }
+
+      template <typename T>
+      void each(const std::vector< boost::shared_ptr<T> >& nodes) {
+        for (unsigned i = 0; i < nodes.size(); ++i)
+          shift(nodes[i]);
+      }
+
+      void operator()(ListLiteralNode* node)        { each(node->values); }
+      void operator()(TupleLiteralNode* node)       { each(node->values); }
+      void operator()(DictLiteralNode* node) {
+        for (unsigned i = 0; i < node->values.size(); ++i) {
+          shift(node->values[i].first);
+          shift(node->values[i].second);
+        }
+      }
+
+      void operator()(ListTypeExprNode* node)       { shift(node->element); }
+      void operator()(MapTypeExprNode* node)        { shift(node->key); shift(node->value); }
+      void operator()(TupleTypeExprNode* node)      { each(node->elements); }
+      void operator()(VarArgTypeExprNode* node)     { shift(node->element); }
+      void operator()(KeywordArgTypeExprNode* node) { shift(node->value); }
+
+      void operator()(BinaryOpExprNode* node)       { shift(node->left); shift(node->right); }
+      void operator()(UnaryOpExprNode* node)        { shift(node->expr); }
+      void operator()(LiteralExprNode* node)        { shift(node->data); }
+      void operator()(CallExprNode* node)           { each(node->args); }
+
+      void operator()(InterfaceDeclNode* node)      { each(node->values); }
+      void operator()(FnDeclNode* node)             { each(node->args); shift(node->ret); }
+      void operator()(ParamFieldDeclNode* node)     { shift(node->type); }
+      void operator()(SigDeclNode* node)            { each(node->args); }
+      void operator()(PropDeclNode* node)           { each(node->args); }
+      void operator()(StructDeclNode* node)         { each(node->decls); }
+      void operator()(StructFieldDeclNode* node)    { shift(node->type); }
+      void operator()(ConstDeclNode* node)          { shift(node->type); shift(node->data); }
+      void operator()(EnumDeclNode* node)           { each(node->fields); }
+      void operator()(EnumFieldDeclNode* node)      { shift(node->node); }
+      void operator()(TypeDefDeclNode* node)        { shift(node->type); }
+
+      void operator()(ObjectDefNode* node)          { shift(node->type); each(node->values); }
+      void operator()(PropertyDefNode* node)        { shift(node->data); }
+      void operator()(AtNode* node)                 { shift(node->_sender); }
+      void operator()(VarDefNode* node)             { shift(node->type); shift(node->data); }
+
+      //leaves
+      template <typename T>
+      void operator()(T* node) {}
+
+      int                       delta;
+      std::unordered_set<Node*> shifted;
+    };
+
+    //byte offset of a line/column position in src (the column after the last line is the end of the source)
+    bool positionOffset(const SourceBuffer& src, int line, int column, std::size_t* offset) {
+      const std::string& content = src.content();
+      if (line < 1 || column < 1)
+        return false;
+      const char* lbeg;
+      std::size_t lsize;
+      if (!src.line(line, &lbeg, &lsize)) {
+        bool endsWithEol = content.empty() || content[content.size() - 1] == '\n';
+        if (static_cast<unsigned int>(line) != src.lineCount() + 1 || column != 1 || !endsWithEol)
+          return false;
+        *offset = content.size();
+        return true;
+      }
+      if (static_cast<std::size_t>(column - 1) > lsize)
+        return false;
+      *offset = (lbeg - content.data()) + column - 1;
+      return true;
+    }
+
+    //offset of a boundary, false if unknown or if the lines of the lexer may differ from the ones of SourceBuffer ("\n\r")
+    bool boundaryOffset(const SourceBuffer& src, const ParseBoundary& pb, std::size_t* offset) {
+      if (pb.line == 0 || !positionOffset(src, pb.line, pb.column, offset))
+        return false;
+      const std::string& content = src.content();
+      std::size_t lbeg = *offset - (pb.column - 1);
+      return !(lbeg > 0 && lbeg < content.size() && content[lbeg] == '\r' && content[lbeg - 1] == '\n');
+    }
+
+    inline bool isBlank(char c) {
+      return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    inline bool isEol(char c) {
+      return c == '\n' || c == '\r';
+    }
+
+    /* Parse again the toplevel declarations of result around the edited range
+     * [b, e) of src, content is the new source. Return the number of
+     * declarations parsed, -1 if the change can't be isolated.
+     *
+     * The region starts at the end of a declaration followed by a blank (no
+     * token can extend across it) and ends at the end of a declaration followed
+     * by an EOL. So the tokens after the region are the same, and the lexer
+     * state at its end only depends on the documentation comments.
+     */
+    int reparseToplevels(ParseResult& result, const SourceBuffer& src, std::size_t b, std::size_t e, const std::string& content) {
+      const std::string& old = src.content();
+      std::size_t n = result.ast.size();
+      if (n == 0 || result.hasError() || result.boundaries.size() != n)
+        return -1;
+      std::vector<std::size_t> ends(n);
+      for (std::size_t i = 0; i < n; ++i) {
+        if (!boundaryOffset(src, result.boundaries[i], &ends[i]))
+          return -1;
+      }
+
+      std::size_t first = std::lower_bound(ends.begin(), ends.end(), b) - ends.begin();
+      while (first > 0 && !isBlank(old[ends[first - 1]]))
+        --first;
+      std::size_t last = std::lower_bound(ends.begin() + first, ends.end(), e) - ends.begin();
+      while (last < n && ends[last] != old.size() && !isEol(old[ends[last]]))
+        ++last;
+
+      //declarations [first, stop) are replaced, the ones after are kept
+      std::size_t stop = n;
+      std::size_t regionBegin = first ? ends[first - 1] : 0;
+      std::size_t regionEnd = content.size();
+      if (last + 1 < n) {
+        stop = last + 1;
+        regionEnd = ends[last] + content.size() - old.size();
+      }
+
+      Parser p(boost::make_shared<FileReader>(result.filename, content.data() + regionBegin, regionEnd - regionBegin));
+      p.startAt(first ? result.boundaries[first - 1] : ParseBoundary());
+      p._result->echoDiagnostics = false;
+      p.parse();
+      ParseResultPtr part = p._result;
+      if (part->hasError())
+        return -1;
+
+      int lineDelta = 0;
+      if (stop < n) {
+        const ParseBoundary& oldEnd = result.boundaries[stop - 1];
+        if (p.lastComment != oldEnd.comment || p.linesSinceLastComment != oldEnd.linesSinceComment)
+          return -1;
+        lineDelta = static_cast<int>(p.loc.end.line) - oldEnd.line;
+      }
+
+      if (lineDelta != 0) {
+        LineShifter shifter(lineDelta);
+        for (std::size_t i = stop; i < n; ++i) {
+          shifter.shift(result.ast[i]);
+          result.boundaries[i].line += lineDelta;
+        }
+      }
+      result.ast.erase(result.ast.begin() + first, result.ast.begin() + stop);
+      result.ast.insert(result.ast.begin() + first, part->ast.begin(), part->ast.end());
+      result.boundaries.erase(result.boundaries.begin() + first, result.boundaries.begin() + stop);
+      result.boundaries.insert(result.boundaries.begin() + first, part->boundaries.begin(), part->boundaries.end());
+      result.source = SourceManager::instance().setSource(Symbol(result.filename), content.data(), content.size());
+      result.invalidateIndex();
+      setSourceHash(result);
+      result.analyzed = false;
+      return part->ast.size();
+    }
+  }
+
+  std::size_t tokenize(const FileReaderPtr& file, LexerType lexer, StringVector* tokens) {
+    if (!file->isOpen())
+      throw std::runtime_error("Can't open file '" + file->filename() + "'");
+    Parser p(file, lexer);
+    return p.tokenize(tokens);
+  }
+
+  ParseResultPtr parse(const FileReaderPtr& file, bool echoDiagnostics) {
     ParseResultPtr ret = newParseResult();
     ret->filename = file->filename();
+    ret->echoDiagnostics = echoDiagnostics;
     if (!file->isOpen()) {
       ret->addDiag(Diagnostic(DiagnosticType_Error, "Can't open file '" + file->filename() + "'"));
       return ret;
     }
     Parser p(file);
-    return p.result();
+    p._result->echoDiagnostics = echoDiagnostics;
+    ParseResultPtr pr = p.result();
+    setSourceHash(*pr);
+    return pr;
+  }
+
+  int reparse(const ParseResultPtr& result, const TextEdit& edit) {
+    SourceBufferPtr src = result->source;
+    if (!src)
+      src = SourceManager::instance().source(Symbol(result->filename));
+    if (!src)
+      throw std::runtime_error("No source for '" + result->filename + "'");
+    const std::string& old = src->content();
+    std::size_t b;
+    std::size_t e;
+    if (!positionOffset(*src, edit.beg_line, edit.beg_column, &b) ||
+        !positionOffset(*src, edit.end_line, edit.end_column, &e) || e < b)
+      throw std::runtime_error("Edit out of the source of '" + result->filename + "'");
+
+    std::string content;
+    content.reserve(old.size() - (e - b) + edit.text.size());
+    content.append(old, 0, b);
+    content.append(edit.text);
+    content.append(old, e, std::string::npos);
+
+    int count = reparseToplevels(*result, *src, b, e, content);
+    if (count >= 0)
+      return count;
+
+    Parser p(newFileReader(result->filename, content));
+    p._result->echoDiagnostics = result->echoDiagnostics;
+    p.parse();
+    result->ast        = p._result->ast;
+    result->_messages  = p._result->_messages;
+    result->arena      = p._result->arena;
+    result->source     = p._result->source;
+    result->boundaries = p._result->boundaries;
+    result->invalidateIndex();
+    setSourceHash(*result);
+    result->analyzed      = false;
+    result->analysisBegin = result->analysisEnd = 0;
+    return -1;
   }
 
 }
@@ -34,35 +34,77 @@ namespace qilang {
     std::string _what;
   };
 
+  class Lexer;
+
   class QILANG_API Parser: public ParserContext {
   public:
-    Parser(const FileReaderPtr &file);
+    explicit Parser(const FileReaderPtr &file, LexerType lexerType = defaultLexer());
     ~Parser();
 
     void parse();
+    //! run the lexer alone, see qilang::tokenize
+    std::size_t tokenize(StringVector* tokens);
+    //! next token, from the lexer selected at construction
+    yy::parser::symbol_type lex();
+    //! hand the content read from a stream over to the SourceManager
+    void registerStreamSource();
+
+    /** parse a part of a file starting at a toplevel boundary: the lexer
+     *  starts with the position and comment state of b, the content is not
+     *  registered in the SourceManager. Call before parse.
+     */
+    void startAt(const ParseBoundary& b);
+    //! called by the grammar on each toplevel declaration, record its ParseBoundary
+    void endToplevel(const yy::location& loc);
 
     ParseResultPtr   result();
 
+    //! convert a bison location, the filename is the interned one of the file being parsed
+    Location makeLocation(const yy::location& loc) const {
+      return Location(loc.begin.line, loc.begin.column, loc.end.line, loc.end.column, fileSymbol);
+    }
+
+    //! allocate a node in the arena of the result
+    template <typename T, typename... Args>
+    boost::shared_ptr<T> newNode(Args&&... args) {
+      return boost::allocate_shared<T>(NodeAllocator<T>(_result->arena), std::forward<Args>(args)...);
+    }
+
     // parser context
     FileReaderPtr        file;
     ParseResultPtr       _result;
     bool                 _parsed;
 
     std::string          package;
+    Symbol               fileSymbol;
     yy::location         loc;
 
     // flex / bison struct
+    LexerType            lexerType;
     void*                scanner;  // flex context
+    Lexer*               lexer;    // hand-written lexer, set by startLexer
     yy::parser           parser;
 
+    // copy of the content read by YY_INPUT (stream readers only)
+    std::string          streamSource;
+
     // comment handling (only used by lexer)
     std::string          lastComment;
     unsigned int         linesSinceLastComment;
 
+    // partial parse (see startAt)
+    bool                 partial;
+    ParseBoundary        start;
+    // state after the last two tokens, the grammar reads at most one token past a declaration
+    ParseBoundary        tokenEnds[2];
+    unsigned int         tokenCount;
+
+  private:
+    void startLexer();
   };
 
-  Location makeLocation(const yy::location& loc);
-  std::string getErrorLine(const std::string& filename, const Location& loc);
+  //! source line of loc, in source if set, followed by a caret line
+  std::string getErrorLine(const Location& loc, const SourceBufferPtr& source);
 
 }
 
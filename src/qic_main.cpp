@@ -5,17 +5,34 @@
 ** Copyright (C) 2014 Aldebaran Robotics
 */
 
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
 #include <qi/applicationsession.hpp>
 #include <qi/log.hpp>
+#include <qi/os.hpp>
 #include <qi/path_conf.hpp>
 #include <fstream>
 #include <qilang/node.hpp>
 #include <qilang/parser.hpp>
 #include <qilang/formatter.hpp>
 #include <qilang/packagemanager.hpp>
+#include <qilang/packageindex.hpp>
+#include <qilang/packagesummary.hpp>
+#include <qilang/outputcache.hpp>
+#include <qilang/compileserver.hpp>
+#include <qilang/filewatcher.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/commandline.hpp>
 #include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/filesystem.hpp>
 #include <qi/session.hpp>
+#ifndef _WIN32
+# include <dlfcn.h>
+#endif
 #include <qilang/pathformatter.hpp>
 
 qiLogCategory("qic");
@@ -45,87 +62,649 @@ int codegen_service(const std::string& codegen,
 
 
 
-int codegen_file(const std::string& codegen,
-                 qilang::FileWriterPtr out,
-                 qilang::PackageManagerPtr pm,
-                 const std::string& file) {
-  qiLogVerbose() << "Generating " << codegen << " for file " << file;
-  qilang::ParseResultPtr pr;
+/** what a qicc run prints to, resolves its relative paths against and
+ *  caches in by default: the standard output, working directory and
+ *  environment of the process, or the ones of a compile server client.
+ */
+struct Run {
+  explicit Run(std::ostream& out)
+    : out(out)
+    , cache(false)
+    , cacheDir(qilang::formatPath(boost::filesystem::absolute(qilang::OutputCache::defaultDir()).string()))
+  {
+    std::string env = qi::os::getenv("QICC_CACHE");
+    cache = !env.empty() && env != "0";
+  }
+
+  Run(std::ostream& out, const qilang::CompileRequest& request)
+    : out(out)
+    , cwd(request.cwd)
+    , cache(request.cache)
+    , cacheDir(request.cacheDir)
+  {}
+
+  //! a path of the command line, to open
+  std::string path(const std::string& p) const {
+    if (cwd.empty() || p.empty())
+      return p;
+    return qilang::formatPath(boost::filesystem::absolute(p, cwd).string());
+  }
+
+  std::ostream& out;
+  std::string   cwd;  // empty: the working directory of the process
+  bool          cache;    // QICC_CACHE enables the output cache
+  std::string   cacheDir; // where it is without --cache-dir
+};
+
+static qilang::FileWriterPtr newOutput(const Run& run, const qilang::Generation& gen) {
+  if (gen.output.empty())
+    return qilang::newFileWriter(&run.out, "cout");
+  //the binary AST is not text
+  return qilang::newFileWriter(run.path(gen.output), gen.codegen == "ast" ? std::ios::out | std::ios::binary : std::ios::out);
+}
+
+//! a path in a Makefile rule
+static std::string depfileEscape(const std::string& path) {
+  std::string ret;
+  for (unsigned i = 0; i < path.size(); ++i) {
+    if (path[i] == ' ' || path[i] == '#')
+      ret += '\\';
+    else if (path[i] == '$')
+      ret += '$';
+    ret += path[i];
+  }
+  return ret;
+}
+
+/** write a Makefile/Ninja depfile: every output of the run depends on
+ *  every IDL file read to generate it, imported packages included
+ */
+static bool writeDepfile(const std::string& depfile,
+                         const qilang::StringVector& outputs,
+                         const qilang::StringVector& sources) {
+  qilang::FileWriterPtr out = qilang::newFileWriter(depfile);
+  std::ostream& os = out->out();
+  for (unsigned i = 0; i < outputs.size(); ++i)
+    os << (i ? " " : "") << depfileEscape(outputs.at(i));
+  os << ":";
+  for (unsigned i = 0; i < sources.size(); ++i)
+    os << " \\\n  " << depfileEscape(sources.at(i));
+  os << "\n";
+  return out->close();
+}
+
+/** after a successful run: write the depfile and touch the stamp.
+ *  With a stamp, it is the target of the depfile: unchanged outputs keep
+ *  their time, make compares the stamp to the IDL files instead.
+ */
+static bool finishRun(const Run& run,
+                      const std::string& depfile,
+                      const std::string& stamp,
+                      const qilang::StringVector& outputs,
+                      const qilang::StringVector& sources) {
+  const qilang::StringVector targets = stamp.empty() ? outputs : qilang::StringVector(1, stamp);
+  if (!depfile.empty() && !writeDepfile(run.path(depfile), targets, sources))
+    return false;
+  if (stamp.empty())
+    return true;
+  std::ofstream os(run.path(stamp).c_str(), std::ios::out | std::ios::trunc);
+  os.close();
+  if (!os) {
+    run.out << "error: can't write " << stamp << std::endl;
+    return false;
+  }
+  return true;
+}
+
+//! the files generated by a run, in order
+static qilang::StringVector outputFiles(const qilang::InputVector& inputs) {
+  qilang::StringVector ret;
+  for (unsigned i = 0; i < inputs.size(); ++i) {
+    for (unsigned j = 0; j < inputs[i].generations.size(); ++j) {
+      if (!inputs[i].generations[j].output.empty())
+        ret.push_back(inputs[i].generations[j].output);
+    }
+  }
+  return ret;
+}
+
+/** key of a run in the output cache: the generator, the flags that change
+ *  what is read, the codegens and the inputs. Empty when the run can't be
+ *  cached (output on the console).
+ *  The files are named relative to the include and lookup paths, and the
+ *  include paths relative to the working directory of the run (absolute on
+ *  another root): the same run in another build directory with the same
+ *  layout has the same key.
+ */
+static std::string cacheKey(const Run& run,
+                            const std::string& identity,
+                            qilang::PackageManagerPtr pm,
+                            qilang::OutputCache* cache,
+                            const qilang::InputVector& inputs) {
+  namespace fs = boost::filesystem;
+  fs::path cwd = run.cwd.empty() ? fs::current_path() : fs::path(run.cwd);
+  qilang::StringVector bases = pm->includes();
+  qilang::StringVector parts(1, identity);
+  parts.push_back("-I");
+  for (unsigned i = 0; i < bases.size(); ++i) {
+    fs::path include = fs::absolute(bases[i], cwd).lexically_normal();
+    fs::path rel = include.lexically_relative(cwd);
+    parts.push_back((rel.empty() ? include : rel).generic_string());
+  }
+  bases.insert(bases.end(), pm->lookupPaths().begin(), pm->lookupPaths().end());
+  cache->setBaseDirs(bases);
+  qilang::StringVector files;
+  for (unsigned i = 0; i < inputs.size(); ++i) {
+    parts.push_back("--");
+    for (unsigned j = 0; j < inputs[i].generations.size(); ++j) {
+      if (inputs[i].generations[j].output.empty())
+        return std::string();
+      parts.push_back(inputs[i].generations[j].codegen);
+    }
+    files.push_back(run.path(inputs[i].file));
+  }
+  return cache->runKey(parts, files);
+}
+
+/** parse every input first, so that the package manager analyses the
+ *  imported packages once for all the generations.
+ *  With a cache, a run done before with the same files writes the outputs
+ *  it stored, without parsing anything.
+ */
+int codegen_files(const Run& run,
+                  qilang::PackageManagerPtr pm,
+                  const qilang::InputVector& inputs,
+                  const std::string& depfile,
+                  const std::string& stamp,
+                  qilang::OutputCache* cache,
+                  const std::string& identity) {
+  const qilang::StringVector outputs = outputFiles(inputs);
+  std::string key;
+  if (cache && !identity.empty())
+    key = cacheKey(run, identity, pm, cache, inputs);
+
+  qilang::OutputCache::Result cached;
+  if (!key.empty() && cache->lookup(key, &cached)) {
+    qiLogVerbose() << "Outputs found in the cache (" << key << ")";
+    int ret = 0;
+    unsigned int n = 0;
+    for (unsigned i = 0; i < inputs.size(); ++i) {
+      for (unsigned j = 0; j < inputs[i].generations.size(); ++j, ++n) {
+        qilang::FileWriterPtr out = newOutput(run, inputs[i].generations[j]);
+        out->out().write(cached.outputs.at(n).data(), cached.outputs.at(n).size());
+        if (!out->close())
+          ret = 1;
+      }
+    }
+    if (ret == 0 && !finishRun(run, depfile, stamp, outputs, cached.files))
+      ret = 1;
+    return ret;
+  }
+
+  std::vector<qilang::ParseResultPtr> prs;
   try {
-    pr = pm->parseFile(qilang::newFileReader(file));
+    for (unsigned i = 0; i < inputs.size(); ++i) {
+      qiLogVerbose() << "Parsing file " << inputs[i].file;
+      prs.push_back(pm->parseFile(qilang::newFileReader(run.path(inputs[i].file))));
+    }
   } catch(const std::exception& e) {
-    std::cout << "Exception: " << e.what() << std::endl;
-    exit(1);
+    run.out << "Exception: " << e.what() << std::endl;
+    return 1;
+  }
+
+  //what the outputs depend on: a warm package manager knows more packages
+  qilang::StringVector packages;
+  for (unsigned i = 0; i < prs.size(); ++i)
+    packages.push_back(prs[i]->package);
+
+  int ret = 0;
+  for (unsigned i = 0; i < inputs.size(); ++i) {
+    for (unsigned j = 0; j < inputs[i].generations.size(); ++j) {
+      const qilang::Generation& gen = inputs[i].generations[j];
+      qiLogVerbose() << "Generating " << gen.codegen << " for file " << inputs[i].file;
+      qilang::FileWriterPtr out = newOutput(run, gen);
+      if (!qilang::codegen(out, gen.codegen, pm, prs[i]) || !out->close())
+        ret = 1;
+      else if (out->written())
+        qiLogVerbose() << "Wrote " << gen.output;
+      if (!key.empty())
+        cached.outputs.push_back(out->str());
+    }
+  }
+  if (ret == 0 && !finishRun(run, depfile, stamp, outputs, pm->sourceFiles(packages)))
+    ret = 1;
+  if (ret == 0 && !key.empty()) {
+    cached.files = pm->sourceFiles(packages);
+    cache->store(key, cached);
+  }
+  return ret;
+}
+
+/** generate the outputs of the pending inputs. The inputs generated are no
+ *  longer pending, outputs with the same content are not rewritten.
+ */
+static void regenerate(const Run& run,
+                       qilang::PackageManagerPtr pm,
+                       const qilang::InputVector& inputs,
+                       qilang::WatchedInputs& watched) {
+  const qilang::WatchedInputs::IndexSet todo = watched.pending();
+  for (qilang::WatchedInputs::IndexSet::const_iterator it = todo.begin(); it != todo.end(); ++it) {
+    const qilang::Input& input = inputs[*it];
+    try {
+      qilang::ParseResultPtr pr = watched.parseResult(*it);
+      bool ok = true;
+      for (unsigned j = 0; j < input.generations.size(); ++j) {
+        const qilang::Generation& gen = input.generations[j];
+        qiLogVerbose() << "Generating " << gen.codegen << " for file " << input.file;
+        qilang::FileWriterPtr out = newOutput(run, gen);
+        if (!qilang::codegen(out, gen.codegen, pm, pr) || !out->close())
+          ok = false;
+        else if (out->written())
+          run.out << "qicc: wrote " << gen.output << std::endl;
+      }
+      if (ok)
+        watched.generated(*it);
+      else
+        run.out << "qicc: can't generate for " << input.file << std::endl;
+    } catch (const std::exception& e) {
+      watched.failed(*it);
+      run.out << "Exception: " << e.what() << std::endl;
+    }
+  }
+}
+
+/** watch mode: generate, then follow the IDL files of the watched trees.
+ *  A changed file is parsed again (or forgotten when removed) with the same
+ *  package manager, and only the inputs depending on its package, directly
+ *  or not, are generated again (see WatchedInputs): the analysis redoes the
+ *  packages whose files or imported exports changed. Inputs that failed are
+ *  retried after every change.
+ */
+static int watch_files(const Run& run,
+                       qilang::PackageManagerPtr pm,
+                       const qilang::InputVector& inputs,
+                       const qilang::StringVector& dirs) {
+  qilang::FileWatcher watcher;
+  for (unsigned i = 0; i < dirs.size(); ++i) {
+    std::string error;
+    if (!watcher.addTree(run.path(dirs.at(i)), &error)) {
+      run.out << "Error: " << error << std::endl;
+      return 1;
+    }
+  }
+
+  qilang::StringVector files;
+  for (unsigned i = 0; i < inputs.size(); ++i)
+    files.push_back(qilang::formatPath(boost::filesystem::absolute(run.path(inputs[i].file)).string()));
+  qilang::WatchedInputs watched(pm, files);
+  regenerate(run, pm, inputs, watched);
+  run.out << "qicc: watching " << dirs.size() << " directories"
+            << (watcher.native() ? "" : " (polling)") << std::endl;
+
+  for (;;) {
+    if (!watcher.wait(&files))
+      continue;
+    watched.changed(files, run.out);
+    regenerate(run, pm, inputs, watched);
+  }
+  return 0;
+}
+
+//! the inputs and generations of the command line, in order
+static qilang::CommandLineOptionVector commandLineOptions(const po::parsed_options& parsed) {
+  qilang::CommandLineOptionVector ret;
+  for (unsigned i = 0; i < parsed.options.size(); ++i) {
+    const po::option& opt = parsed.options[i];
+    for (unsigned v = 0; v < opt.value.size(); ++v)
+      ret.push_back(qilang::CommandLineOption(opt.string_key, opt.value[v]));
   }
-  bool ret = qilang::codegen(out, codegen, pm, pr);
-  if (!ret)
+  return ret;
+}
+
+//! size and date of a file the generator is made of, empty when unknown
+static std::string fileStamp(const boost::filesystem::path& file) {
+  boost::system::error_code ec;
+  boost::filesystem::path path = boost::filesystem::canonical(file, ec);
+  if (ec || !boost::filesystem::is_regular_file(path, ec))
+    return std::string();
+  boost::uintmax_t size = boost::filesystem::file_size(path, ec);
+  if (ec)
+    return std::string();
+  std::time_t date = boost::filesystem::last_write_time(path, ec);
+  if (ec)
+    return std::string();
+  std::stringstream ss;
+  ss << size << " " << date;
+  return ss.str();
+}
+
+/** the running qicc and the qilang library it uses, as far as their files
+ *  tell: a new build changes the cache keys. Computed once, when the files
+ *  are the ones loaded. Empty, and nothing is cached, when one of them
+ *  can't be found.
+ */
+static const std::string& executableIdentity() {
+  struct Identity {
+    std::string value;
+    Identity() {
+      std::string exe, lib;
+#ifdef __linux__
+      exe = fileStamp("/proc/self/exe");
+#endif
+#ifndef _WIN32
+      Dl_info info;
+      if (dladdr(reinterpret_cast<void*>(&qilang::codegen), &info) && info.dli_fname)
+        lib = fileStamp(info.dli_fname);
+#endif
+      if (exe.empty() || lib.empty()) {
+        qiLogVerbose() << "qicc or libqilang not found, the output cache is disabled";
+        return;
+      }
+      std::stringstream ss;
+      ss << "qicc " << qilang::OutputCacheVersion << " " << qilang::AstFileVersion
+         << " " << exe << " " << lib;
+      value = ss.str();
+    }
+  };
+  static const Identity identity;
+  return identity.value;
+}
+
+static void printCacheStats(std::ostream& out, const qilang::OutputCache& cache) {
+  qilang::OutputCache::Stats stats = cache.stats();
+  qi::uint64_t lookups = stats.hits + stats.misses;
+  out << "cache directory: " << cache.dir() << std::endl
+            << "hits:            " << stats.hits << std::endl
+            << "misses:          " << stats.misses << std::endl
+            << "hit rate:        " << (lookups ? stats.hits * 100 / lookups : 0) << "%" << std::endl
+            << "stores:          " << stats.stores << std::endl
+            << "evictions:       " << stats.evictions << std::endl
+            << "size:            " << stats.size / 1024 << " KB (max " << cache.maxSize() / 1024 << " KB)" << std::endl;
+}
+
+/** libqi options are parsed by qi::ApplicationSession: --qi-url... and the
+ *  log options, long (--log-level...) or short (-v, -d, -q, -L, possibly
+ *  grouped as in -vd). None of them is a qicc option.
+ */
+static bool hasLibqiOptions(int argc, char *argv[]) {
+  static const char* const logOptions[] = {
+    "--verbose", "--debug", "--quiet", "--context", "--synchronous-log", "--log-level", "--log-color", 0
+  };
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (std::strncmp(arg, "--qi-", 5) == 0)
+      return true;
+    if (arg[0] == '-' && arg[1] != '-' && arg[1] && std::strchr("vdqL", arg[1]))
+      return true;
+    for (unsigned j = 0; logOptions[j]; ++j) {
+      std::size_t len = std::strlen(logOptions[j]);
+      if (std::strncmp(arg, logOptions[j], len) == 0 && (arg[len] == 0 || arg[len] == '='))
+        return true;
+    }
+  }
+  return false;
+}
+
+static int qicc(const Run& run, int argc, char *argv[], boost::scoped_ptr<qi::ApplicationSession>& app, qilang::PackageManagerPool* pool);
+
+/** the compile server: runs the command lines of its clients as qicc would,
+ *  in their working directory, with the package managers of the previous
+ *  runs. What they print is sent back, the log stays on the server.
+ *
+ *  Runs go in parallel, as the qicc processes of a parallel build would,
+ *  except those sharing a package manager (same include and lookup paths):
+ *  they wait for each other.
+ */
+static int serve(const std::string& socket, unsigned int jobs, char* argv0, boost::scoped_ptr<qi::ApplicationSession>& app) {
+  qilang::CompileServer server(socket);
+  if (jobs)
+    server.setJobs(jobs);
+  std::string error;
+  if (!server.listen(&error)) {
+    std::cout << "Error: " << error << std::endl;
     return 1;
+  }
+  std::cout << "qicc: compile server listening on " << socket << " (" << server.jobs() << " jobs)" << std::endl;
+
+  //the files of the loaded build, before a new one replaces them
+  executableIdentity();
+  qilang::PackageManagerPool pool;
+  server.run([&](const qilang::CompileRequest& request) {
+    std::vector<char*> args(1, argv0);
+    for (unsigned i = 0; i < request.args.size(); ++i)
+      args.push_back(const_cast<char*>(request.args[i].c_str()));
+    args.push_back(0);
+
+    qilang::CompileResponse response;
+    std::stringstream out;
+    boost::system::error_code ec;
+    try {
+      if (!boost::filesystem::path(request.cwd).is_absolute() || !boost::filesystem::is_directory(request.cwd, ec))
+        out << "Error: bad working directory '" << request.cwd << "'" << std::endl;
+      else
+        response.status = qicc(Run(out, request), static_cast<int>(args.size() - 1), &args[0], app, &pool);
+    } catch (const std::exception& e) {
+      out << "Exception: " << e.what() << std::endl;
+    }
+    response.output = out.str();
+    qilang::PackageManagerPool::Stats stats = pool.stats();
+    qiLogVerbose() << "Request " << stats.acquired << ": " << stats.reused << " warm, "
+                   << stats.reparsed << " files parsed again, " << stats.dropped << " dropped";
+    return response;
+  });
   return 0;
 }
 
 int main(int argc, char *argv[])
 {
-  qi::ApplicationSession app(argc, argv);
-  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  /* file mode runs once per generated file of a build: it does not need
+   * libqi's application and session machinery, only service mode does.
+   * libqi options must be removed from argv before we parse ours though.
+   */
+  boost::scoped_ptr<qi::ApplicationSession> app;
+  if (hasLibqiOptions(argc, argv))
+    app.reset(new qi::ApplicationSession(argc, argv));
+  else
+    qi::log::setSynchronousLog(true); //nothing flushes the log at exit otherwise
+
+  return qicc(Run(std::cout), argc, argv, app, 0);
+}
 
+/** a qicc run. Through the compile server, pool holds the package managers
+ *  of its previous runs.
+ */
+static int qicc(const Run& run, int argc, char *argv[], boost::scoped_ptr<qi::ApplicationSession>& app, qilang::PackageManagerPool* pool)
+{
   po::options_description desc("qilang options");
   desc.add_options()
       ("help,h", "produce help message")
-      ("codegen,c", po::value<std::string>(), "Set the codegenerator to use")
+      ("codegen,c", po::value<std::string>(), "Set the codegenerator to use for the inputs without --generate")
+      ("generate,g", po::value< std::vector<std::string> >(), "codegen:output to generate for the input file given before (or the only one), may be repeated")
       ("input-mode,i", po::value<std::string>()->default_value("file"), "Set the input type (file or service)")
       ("inputs", po::value< std::vector< std::string> >(), "input files")
       ("include,I", po::value< std::vector< std::string> >(), "include directories for packages")
       ("output-file,o", po::value<std::string>(), "output file")
+      ("depfile", po::value<std::string>(), "write a Makefile depfile: the outputs depend on every IDL file read (file mode)")
+      ("stamp", po::value<std::string>(), "touch this file after a successful run, the target of the depfile instead of the outputs (file mode)")
       ("target-sdk-dir,t", po::value<std::string>(), "the SDK directory of the target platform")
+      ("jobs,j", po::value<unsigned int>()->default_value(1), "number of threads used to parse packages (0: one per core)")
+      ("cache", "reuse the outputs of identical runs from the output cache (file mode, also enabled by QICC_CACHE=1)")
+      ("cache-dir", po::value<std::string>(), "directory of the output cache, enables it (default: $QICC_CACHE_DIR, $XDG_CACHE_HOME/qicc or ~/.cache/qicc)")
+      ("cache-max-size", po::value<unsigned int>()->default_value(1024), "maximum size of the output cache, in MB")
+      ("cache-stats", "print the statistics of the output cache and exit")
+      ("cache-clear", "remove the outputs stored in the output cache and exit")
+      ("write-package-index", po::value<std::string>(), "index the IDL files of a SDK directory (in <dir>/share/qi/idl) and exit")
+      ("write-package-summaries", po::value<std::string>(), "write the export summary of the packages of a SDK directory (in <dir>/share/qi/idl) and exit")
+      ("server", "run a compile server: keep the analysed packages in memory and generate for the qicc clients (see --connect)")
+      ("server-jobs", po::value<unsigned int>()->default_value(0), "requests the compile server answers at once (0: one per core)")
+      ("connect", "generate through the compile server when one runs (file mode, also enabled by QICC_SERVER=1)")
+      ("server-socket", po::value<std::string>(), "local socket of the compile server (default: $QICC_SERVER_SOCKET, qicc.sock in $XDG_RUNTIME_DIR or qicc-<user>.sock in the temporary directory)")
+      ("server-stop", "stop the compile server and exit")
+      ("watch", po::value< std::vector<std::string> >(), "generate, then generate again what the changes of the IDL files under this directory affect, until interrupted (file mode, may be repeated)")
       ;
 
   po::positional_options_description p;
   p.add("inputs", -1);
 
   po::variables_map vm;
-  po::store(po::command_line_parser(argc, argv).options(desc).positional(p).run(), vm);
+  po::parsed_options parsed = po::command_line_parser(argc, argv).options(desc).positional(p).run();
+  po::store(parsed, vm);
   po::notify(vm);
 
   if (vm.count("help")) {
-      std::cout << desc << std::endl;
+      run.out << desc << std::endl;
+      return 1;
+  }
+
+  bool useCache = vm.count("cache") || vm.count("cache-dir") || run.cache;
+  qilang::OutputCache cache(vm.count("cache-dir") ? run.path(qilang::formatPath(vm["cache-dir"].as<std::string>()))
+                                                  : run.cacheDir,
+                            static_cast<qi::uint64_t>(vm["cache-max-size"].as<unsigned int>()) * 1024 * 1024);
+  if (vm.count("cache-stats") || vm.count("cache-clear")) {
+    if (vm.count("cache-clear") && !cache.clear()) {
+      run.out << "Error: can't clear the cache in '" << cache.dir() << "'" << std::endl;
+      return 1;
+    }
+    if (vm.count("cache-stats"))
+      printCacheStats(run.out, cache);
+    return 0;
+  }
+
+  std::string socket = vm.count("server-socket") ? run.path(qilang::formatPath(vm["server-socket"].as<std::string>()))
+                                                 : qilang::CompileServer::defaultSocket();
+  if (pool && (vm.count("server") || vm.count("server-stop") || vm.count("watch"))) {
+    run.out << "Error: --server, --server-stop and --watch can't go through the compile server" << std::endl;
+    return 1;
+  }
+  if (vm.count("server-stop")) {
+    qilang::CompileRequest request;
+    request.stop = true;
+    qilang::CompileResponse response;
+    std::string error;
+    if (!qilang::callCompileServer(socket, request, &response, &error)) {
+      run.out << "Error: " << error << std::endl;
       return 1;
+    }
+    return 0;
+  }
+  if (vm.count("server"))
+    return serve(socket, vm["server-jobs"].as<unsigned int>(), argv[0], app);
+
+  //summaries first: writing them changes the directories an index describes
+  if (vm.count("write-package-summaries")) {
+    std::string root = run.path(qilang::formatPath(vm["write-package-summaries"].as<std::string>() + "/share/qi/idl"));
+    std::string error;
+    if (!qilang::writePackageSummaries(root, &error)) {
+      run.out << "Error: " << error << std::endl;
+      return 1;
+    }
+    if (!vm.count("write-package-index"))
+      return 0;
+  }
+
+  if (vm.count("write-package-index")) {
+    std::string root = run.path(qilang::formatPath(vm["write-package-index"].as<std::string>() + "/share/qi/idl"));
+    std::string error;
+    if (!qilang::writePackageIndex(root, &error)) {
+      run.out << "Error: " << error << std::endl;
+      return 1;
+    }
+    return 0;
   }
 
+  qilang::StringVector lookupPaths;
   if (vm.count("target-sdk-dir")) {
     auto targetSdkDir =
-        qi::Path::fromNative(qilang::formatPath(vm["target-sdk-dir"].as<std::string>()));
+        qi::Path::fromNative(run.path(qilang::formatPath(vm["target-sdk-dir"].as<std::string>())));
     if (!targetSdkDir.isEmpty()) {
-      pm->addLookupPaths(qi::path::parseQiPathConf(targetSdkDir.str()));
+      lookupPaths = qi::path::parseQiPathConf(targetSdkDir.str());
     }
   }
 
-  qilang::FileWriterPtr    out;
-  std::string              codegen = vm["codegen"].as<std::string>();
   std::string              mode = vm["input-mode"].as<std::string>();
-  std::vector<std::string> inputs;
   std::vector<std::string> includes;
-
-  if (vm.count("inputs"))
-    inputs = vm["inputs"].as<std::vector<std::string> >();
-
-  if (vm.count("output-file")) {
-    std::string outf = qilang::formatPath(vm["output-file"].as<std::string>());
-    out = qilang::newFileWriter(outf);
-  } else {
-    out = qilang::newFileWriter(&std::cout, "cout");
+  qilang::InputVector      inputs;
+  std::string              error;
+  //-c and -o: a single generation, for the inputs without -g
+  qilang::Generation       single;
+  if (vm.count("codegen"))
+    single.codegen = vm["codegen"].as<std::string>();
+  if (vm.count("output-file"))
+    single.output = qilang::formatPath(vm["output-file"].as<std::string>());
+  if (!qilang::parseInputs(commandLineOptions(parsed), single, &inputs, &error)) {
+    run.out << "Error: " << error << std::endl;
+    return 1;
   }
 
   if (vm.count("include"))
     includes = vm["include"].as< std::vector<std::string> >();
+  for (unsigned i = 0; i < includes.size(); ++i)
+    includes[i] = run.path(includes[i]);
 
-  pm->setIncludes(includes);
-  std::string idlFile = qilang::formatPath(inputs[0]);
+  std::string serverEnv = qi::os::getenv("QICC_SERVER");
+  if (!pool && mode == "file" && !vm.count("watch") && (vm.count("connect") || (!serverEnv.empty() && serverEnv != "0"))) {
+    qilang::CompileRequest request;
+    request.cwd = boost::filesystem::current_path().string();
+    //the server has its own environment
+    request.cache = run.cache;
+    request.cacheDir = run.cacheDir;
+    request.args.assign(argv + 1, argv + argc);
+    qilang::CompileResponse response;
+    if (qilang::callCompileServer(socket, request, &response, &error)) {
+      run.out.write(response.output.data(), response.output.size());
+      run.out.flush();
+      return response.status;
+    }
+    qiLogVerbose() << error << ", generating without the compile server";
+  }
+  if (pool && mode != "file") {
+    run.out << "Error: only the file mode is available through the compile server" << std::endl;
+    return 1;
+  }
+
+  qilang::PackageManagerPtr pm;
+  if (pool) {
+    pm = pool->acquire(includes, lookupPaths, vm["jobs"].as<unsigned int>(), run.out);
+  } else {
+    pm = qilang::newPackageManager();
+    pm->addLookupPaths(lookupPaths);
+    pm->setIncludes(includes);
+    pm->setJobs(vm["jobs"].as<unsigned int>());
+    pm->setDiagnosticStream(run.out);
+  }
 
   if (mode == "service") {
-    app.startSession();
-    return codegen_service(codegen, out, pm, app.session(), idlFile);
+    if (inputs.size() != 1 || inputs[0].generations.size() != 1)
+      throw std::runtime_error("service mode generates one codegen for one service");
+    if (!app)
+      app.reset(new qi::ApplicationSession(argc, argv));
+    app->startSession();
+    return codegen_service(inputs[0].generations[0].codegen, newOutput(run, inputs[0].generations[0]), pm, app->session(), inputs[0].file);
   } else if (mode == "file") {
-    return codegen_file(codegen, out, pm, idlFile);
+    std::string depfile;
+    if (vm.count("depfile"))
+      depfile = qilang::formatPath(vm["depfile"].as<std::string>());
+    std::string stamp;
+    if (vm.count("stamp"))
+      stamp = qilang::formatPath(vm["stamp"].as<std::string>());
+    if (vm.count("watch")) {
+      qilang::StringVector dirs = vm["watch"].as< std::vector<std::string> >();
+      for (unsigned i = 0; i < dirs.size(); ++i)
+        dirs[i] = qilang::formatPath(dirs[i]);
+      return watch_files(run, pm, inputs, dirs);
+    }
+    if (!pool)
+      return codegen_files(run, pm, inputs, depfile, stamp, useCache ? &cache : 0, executableIdentity());
+    //after an exception, the state of the package manager is unknown
+    int ret = 1;
+    try {
+      ret = codegen_files(run, pm, inputs, depfile, stamp, useCache ? &cache : 0, executableIdentity());
+    } catch (...) {
+      pool->drop(pm);
+      throw;
+    }
+    pool->release(pm);
+    return ret;
   } else {
     throw std::runtime_error("bad input option value. must be service or file");
   }
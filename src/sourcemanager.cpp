@@ -0,0 +1,117 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include <boost/make_shared.hpp>
+#include <qilang/sourcemanager.hpp>
+
+namespace qilang {
+
+  SourceBuffer::SourceBuffer(const char* data, std::size_t size)
+    : _content(data, size)
+  {
+  }
+
+  SourceBuffer::SourceBuffer(std::string&& content)
+    : _content(std::move(content))
+  {
+  }
+
+  void SourceBuffer::buildLines() const {
+    _lines.push_back(0);
+    const char* beg = _content.data();
+    const char* end = beg + _content.size();
+    for (const char* p = beg; p != end; ++p) {
+      if (*p == '\n')
+        _lines.push_back(p - beg + 1);
+    }
+    //a trailing EOL does not start a new line
+    if (_lines.size() > 1 && _lines.back() == _content.size())
+      _lines.pop_back();
+  }
+
+  unsigned int SourceBuffer::lineCount() const {
+    std::call_once(_linesOnce, &SourceBuffer::buildLines, this);
+    if (_content.empty())
+      return 0;
+    return _lines.size();
+  }
+
+  bool SourceBuffer::line(unsigned int lineno, const char** begin, std::size_t* size) const {
+    if (lineno == 0 || lineno > lineCount())
+      return false;
+    std::size_t beg = _lines[lineno - 1];
+    std::size_t end = (lineno < _lines.size()) ? _lines[lineno] : _content.size();
+    //strip the EOL (\n or \r\n)
+    if (end > beg && _content[end - 1] == '\n')
+      --end;
+    if (end > beg && _content[end - 1] == '\r')
+      --end;
+    *begin = _content.data() + beg;
+    *size  = end - beg;
+    return true;
+  }
+
+  static const std::size_t MinSweepSize = 64;
+
+  SourceManager::SourceManager()
+    : _sweepSize(MinSweepSize)
+  {
+  }
+
+  SourceManager& SourceManager::instance() {
+    static SourceManager sm;
+    return sm;
+  }
+
+  SourceBufferPtr SourceManager::store(Symbol file, const SourceBufferPtr& buf) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sources[file] = buf;
+    //amortized: the map is swept each time it doubled since the last sweep
+    if (_sources.size() >= _sweepSize) {
+      for (SourceMap::iterator it = _sources.begin(); it != _sources.end(); ) {
+        if (it->second.expired())
+          it = _sources.erase(it);
+        else
+          ++it;
+      }
+      _sweepSize = std::max(MinSweepSize, _sources.size() * 2);
+    }
+    return buf;
+  }
+
+  SourceBufferPtr SourceManager::setSource(Symbol file, const char* data, std::size_t size) {
+    return store(file, boost::make_shared<SourceBuffer>(data, size));
+  }
+
+  SourceBufferPtr SourceManager::setSource(Symbol file, std::string&& content) {
+    return store(file, boost::make_shared<SourceBuffer>(std::move(content)));
+  }
+
+  SourceBufferPtr SourceManager::source(Symbol file) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      SourceMap::const_iterator it = _sources.find(file);
+      if (it != _sources.end()) {
+        SourceBufferPtr buf = it->second.lock();
+        if (buf)
+          return buf;
+      }
+    }
+    if (file.empty())
+      return SourceBufferPtr();
+    std::ifstream is(file.str().c_str(), std::ios::in | std::ios::binary);
+    if (!is.is_open())
+      return SourceBufferPtr();
+    std::string content((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    return setSource(file, std::move(content));
+  }
+
+}
@@ -0,0 +1,145 @@
+/*
+** Author(s):
+**  - Cedric GESTES <gestes@aldebaran-robotics.com>
+**
+** Copyright (C) 2014 Aldebaran Robotics
+*/
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <qilang/symbol.hpp>
+
+namespace qilang {
+
+  namespace {
+
+    /** Process wide table of interned strings.
+     *
+     * Strings are stored in fixed size blocks that never move, so str() can
+     * read them without locking: a Symbol is only known to a thread after
+     * its interning happened-before (through whatever passed it along).
+     * The table is split in shards chosen by the hash of the string, each
+     * one an open addressing hash table protected by its own mutex: threads
+     * parsing different files seldom wait for each other.
+     * An id is the index in its shard followed by the shard number.
+     */
+    class SymbolTable {
+    public:
+      static const unsigned int ShardBits = 5;
+      static const unsigned int Shards    = 1u << ShardBits;
+      static const unsigned int BlockBits = 12;
+      static const unsigned int BlockSize = 1u << BlockBits;
+      static const unsigned int MaxBlocks = 4096 / Shards; // per shard
+
+      static SymbolTable& instance() {
+        static SymbolTable table;
+        return table;
+      }
+
+      const std::string& get(unsigned int id) const {
+        return _shards[id & (Shards - 1)].get(id >> ShardBits);
+      }
+
+      unsigned int intern(const char* str, std::size_t size) {
+        if (size == 0)
+          return 0;
+        std::size_t h = hash(str, size);
+        unsigned int shard = static_cast<unsigned int>(h >> 16) & (Shards - 1);
+        return (_shards[shard].intern(str, size, h) << ShardBits) | shard;
+      }
+
+    private:
+      class Shard {
+      public:
+        Shard()
+          : _count(0)
+          , _slots(64, 0)
+        {
+          std::memset(_blocks, 0, sizeof(_blocks));
+          //index 0 is the empty string (id 0 in shard 0), and marks free slots
+          store(std::string());
+        }
+
+        const std::string& get(unsigned int index) const {
+          return _blocks[index >> BlockBits][index & (BlockSize - 1)];
+        }
+
+        unsigned int intern(const char* str, std::size_t size, std::size_t h) {
+          std::lock_guard<std::mutex> lock(_mutex);
+          std::size_t mask = _slots.size() - 1;
+          for (std::size_t i = h & mask;; i = (i + 1) & mask) {
+            unsigned int index = _slots[i];
+            if (index == 0)
+              break;
+            const std::string& s = get(index);
+            if (s.size() == size && std::memcmp(s.data(), str, size) == 0)
+              return index;
+          }
+          unsigned int index = store(std::string(str, size));
+          insert(_slots, index, h);
+          if (_count * 2 > _slots.size())
+            rehash();
+          return index;
+        }
+
+      private:
+        unsigned int store(const std::string& str) {
+          unsigned int index = _count;
+          unsigned int block = index >> BlockBits;
+          if (block >= MaxBlocks)
+            throw std::runtime_error("symbol table is full");
+          if (!_blocks[block])
+            _blocks[block] = new std::string[BlockSize];
+          _blocks[block][index & (BlockSize - 1)] = str;
+          ++_count;
+          return index;
+        }
+
+        void rehash() {
+          std::vector<unsigned int> slots(_slots.size() * 2, 0);
+          for (unsigned int index = 1; index < _count; ++index) {
+            const std::string& s = get(index);
+            insert(slots, index, hash(s.data(), s.size()));
+          }
+          _slots.swap(slots);
+        }
+
+        std::mutex                _mutex;
+        unsigned int              _count;
+        std::vector<unsigned int> _slots;
+        std::string*              _blocks[MaxBlocks];
+      };
+
+      static std::size_t hash(const char* str, std::size_t size) {
+        //FNV-1a
+        std::size_t h = 2166136261u;
+        for (std::size_t i = 0; i < size; ++i) {
+          h ^= static_cast<unsigned char>(str[i]);
+          h *= 16777619u;
+        }
+        return h;
+      }
+
+      static void insert(std::vector<unsigned int>& slots, unsigned int index, std::size_t h) {
+        std::size_t mask = slots.size() - 1;
+        std::size_t i = h & mask;
+        while (slots[i] != 0)
+          i = (i + 1) & mask;
+        slots[i] = index;
+      }
+
+      Shard _shards[Shards];
+    };
+
+  }
+
+  const std::string& Symbol::str() const {
+    return SymbolTable::instance().get(_id);
+  }
+
+  unsigned int Symbol::intern(const char* str, std::size_t size) {
+    return SymbolTable::instance().intern(str, size);
+  }
+
+}
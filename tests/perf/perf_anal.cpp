@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/packagemanager.hpp>
+#include "perf_common.hpp"
+
+// Analyse layers of packages, each one importing two packages of the layer
+// below, with an increasing number of jobs: the packages of a layer are
+// independent and can be resolved concurrently.
+static const unsigned Layers = 6;
+static const unsigned Width  = 8;
+
+static std::string packageName(unsigned layer, unsigned i)
+{
+  std::stringstream ss;
+  ss << "perfanal.l" << layer << "p" << i;
+  return ss.str();
+}
+
+static void writeLayers(const std::string& root)
+{
+  for (unsigned l = 0; l < Layers; ++l) {
+    for (unsigned i = 0; i < Width; ++i) {
+      std::string name = packageName(l, i);
+      std::string dir = name;
+      std::replace(dir.begin(), dir.end(), '.', '/');
+      perf::writeSyntheticPackage(root, dir, 10, 5);
+      //the synthetic files declare the package by its directory
+      std::vector<std::string> files;
+      for (boost::filesystem::directory_iterator it(boost::filesystem::path(root) / "share/qi/idl" / dir), end; it != end; ++it)
+        files.push_back(it->path().string());
+      for (unsigned f = 0; f < files.size(); ++f) {
+        std::ifstream is(files[f].c_str());
+        std::stringstream content;
+        content << is.rdbuf();
+        std::string text = content.str();
+        text.replace(0, text.find('\n'), "package " + name);
+        std::ofstream os(files[f].c_str());
+        os << text;
+      }
+
+      std::ofstream os((boost::filesystem::path(root) / "share/qi/idl" / dir / "uses.idl.qi").string().c_str());
+      os << "package " << name << std::endl;
+      if (l > 0) {
+        os << "from " << packageName(l - 1, i) << " import Struct0" << std::endl;
+        os << "from " << packageName(l - 1, (i + 1) % Width) << " import Struct1" << std::endl;
+      }
+      os << "interface Uses" << std::endl;
+      if (l > 0)
+        os << "  fn f(a: Struct0) -> Struct1" << std::endl;
+      os << "end" << std::endl;
+    }
+  }
+  std::ofstream os((boost::filesystem::path(root) / "share/qi/idl/perfanal/top.idl.qi").string().c_str());
+  os << "package perfanal" << std::endl;
+  for (unsigned i = 0; i < Width; ++i)
+    os << "from " << packageName(Layers - 1, i) << " import Uses" << std::endl;
+}
+
+static std::string analyse(const std::string& root, unsigned int jobs, double* ms)
+{
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, root));
+  pm->setJobs(jobs);
+  pm->setUseAstFiles(false);
+  pm->parseFile(qilang::newFileReader(root + "/share/qi/idl/perfanal/top.idl.qi"));
+
+  perf::Clock::time_point start = perf::Clock::now();
+  pm->anal();
+  *ms = perf::msSince(start);
+
+  std::stringstream ss;
+  ss << pm->graph().size() << " packages" << std::endl;
+  pm->printMessage(ss);
+  return ss.str();
+}
+
+// Analyse again with nothing changed, then after an edit of the top package
+// that does not change its exports: only that file has to be resolved again.
+static void reanalyse(const std::string& root)
+{
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, root));
+  pm->setUseAstFiles(false);
+  std::string top = root + "/share/qi/idl/perfanal/top.idl.qi";
+  pm->parseFile(qilang::newFileReader(top));
+  pm->anal();
+
+  perf::Clock::time_point start = perf::Clock::now();
+  pm->anal();
+  std::cout << "unchanged: " << perf::msSince(start) << " ms" << std::endl;
+
+  std::ifstream is(top.c_str());
+  std::stringstream content;
+  content << is.rdbuf() << "//edited" << std::endl;
+  pm->parseFile(qilang::newFileReader(top, content.str()));
+  start = perf::Clock::now();
+  pm->anal();
+  std::cout << "one file edited: " << perf::msSince(start) << " ms" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_anal");
+  writeLayers(root);
+
+  double ms;
+  std::string reference = analyse(root, 1, &ms);
+  std::cout << "jobs 1: " << ms << " ms" << std::endl;
+  double serial = ms;
+
+  unsigned int maxjobs = std::max(2u, std::thread::hardware_concurrency());
+  int ret = 0;
+  for (unsigned int jobs = 2; jobs <= maxjobs; jobs *= 2) {
+    std::string res = analyse(root, jobs, &ms);
+    std::cout << "jobs " << jobs << ": " << ms << " ms (speedup x" << serial / ms << ")" << std::endl;
+    if (res != reference) {
+      std::cout << "error: result differs with " << jobs << " jobs" << std::endl;
+      ret = 1;
+    }
+  }
+
+  reanalyse(root);
+
+  boost::filesystem::remove_all(root);
+  return ret;
+}
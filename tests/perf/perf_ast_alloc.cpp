@@ -0,0 +1,61 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/parser.hpp>
+#include "perf_common.hpp"
+
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+// Count heap allocations and report peak RSS while parsing a synthetic
+// package of 10k interfaces.
+
+static std::atomic<unsigned long> allocations(0);
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+static long peakRssKb() {
+#ifndef _WIN32
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+#else
+  return -1;
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_alloc");
+  std::vector<std::string> files = perf::writeSyntheticPackage(root, "perfalloc", 100, 100);
+
+  std::vector<qilang::ParseResultPtr> results;
+  unsigned long before = allocations;
+  perf::Clock::time_point start = perf::Clock::now();
+  for (unsigned i = 0; i < files.size(); ++i)
+    results.push_back(qilang::parse(qilang::newFileReader(files[i])));
+  double ms = perf::msSince(start);
+  unsigned long count = allocations - before;
+
+  std::cout << "files: " << files.size() << std::endl;
+  std::cout << "parse: " << ms << " ms" << std::endl;
+  std::cout << "allocations: " << count << " (" << count / files.size() << " per file)" << std::endl;
+  std::cout << "peak rss: " << peakRssKb() << " kB" << std::endl;
+
+  boost::filesystem::remove_all(root);
+  return 0;
+}
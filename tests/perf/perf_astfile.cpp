@@ -0,0 +1,50 @@
+#include <fstream>
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/parser.hpp>
+#include "perf_common.hpp"
+
+// Compare parsing the sources with loading their binary AST.
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_astfile");
+  std::vector<std::string> files = perf::writeSyntheticPackage(root, "perfast", 200, 50);
+  const unsigned iterations = 5;
+  size_t nodes = 0;
+  size_t bytes = 0;
+
+  for (unsigned i = 0; i < files.size(); ++i) {
+    qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(files[i]));
+    qilang::AstSourceStamp stamp;
+    qilang::astSourceStamp(files[i], &stamp);
+    std::string data = qilang::serializeAST(pr->ast, stamp);
+    std::ofstream os(qilang::astFileName(files[i]).c_str(), std::ios::out | std::ios::binary);
+    os.write(data.data(), data.size());
+    bytes += data.size();
+  }
+  std::cout << "binary AST size: " << bytes << " bytes" << std::endl;
+
+  perf::Clock::time_point start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it) {
+    for (unsigned i = 0; i < files.size(); ++i)
+      nodes += qilang::parse(qilang::newFileReader(files[i]))->ast.size();
+  }
+  perf::report("parse", perf::msSince(start), iterations);
+
+  start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it) {
+    for (unsigned i = 0; i < files.size(); ++i) {
+      qilang::ParseResultPtr pr = qilang::loadAST(files[i]);
+      if (!pr)
+        return 1;
+      nodes += pr->ast.size();
+    }
+  }
+  perf::report("load", perf::msSince(start), iterations);
+
+  boost::filesystem::remove_all(root);
+  return nodes ? 0 : 1;
+}
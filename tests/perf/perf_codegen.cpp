@@ -0,0 +1,40 @@
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/formatter.hpp>
+#include <qilang/packagemanager.hpp>
+#include "perf_common.hpp"
+
+// Generate the C++ code of one large file: the headers of a big package are
+// several megabytes, built in memory then compared with (and written to) the
+// file on disk.
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_codegen");
+  std::vector<std::string> files = perf::writeSyntheticPackage(root, "perfcodegen", 1, 4000);
+  const unsigned iterations = 5;
+
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, root));
+  qilang::ParseResultPtr pr = pm->parseFile(qilang::newFileReader(files[0]));
+  pm->anal();
+
+  const char* codegens[] = { "cpp_interface", "cpp_local", "cpp_remote", "sexpr" };
+  for (unsigned c = 0; c < sizeof(codegens) / sizeof(codegens[0]); ++c) {
+    std::string output = root + "/out." + codegens[c];
+    std::size_t size = 0;
+    perf::Clock::time_point start = perf::Clock::now();
+    //the first iteration writes the file, the next ones find it up to date
+    for (unsigned it = 0; it < iterations; ++it) {
+      qilang::FileWriterPtr out = qilang::newFileWriter(output);
+      if (!qilang::codegen(out, codegens[c], pm, pr) || !out->close())
+        return 1;
+      size = boost::filesystem::file_size(output);
+    }
+    perf::report(std::string(codegens[c]) + " (" + std::to_string(size / 1024) + " KB)", perf::msSince(start), iterations);
+  }
+
+  boost::filesystem::remove_all(root);
+  return 0;
+}
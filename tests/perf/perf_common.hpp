@@ -0,0 +1,59 @@
+#ifndef QILANG_PERF_COMMON_HPP_
+#define QILANG_PERF_COMMON_HPP_
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace perf {
+
+  typedef std::chrono::steady_clock Clock;
+
+  inline double msSince(const Clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  /// Write a synthetic package <root>/share/qi/idl/<pkg>/file<i>.idl.qi
+  /// and return the list of written files.
+  inline std::vector<std::string> writeSyntheticPackage(const std::string& root,
+                                                        const std::string& pkg,
+                                                        unsigned files,
+                                                        unsigned ifacePerFile) {
+    std::vector<std::string> ret;
+    boost::filesystem::path dir = boost::filesystem::path(root) / "share/qi/idl" / pkg;
+    boost::filesystem::create_directories(dir);
+    for (unsigned f = 0; f < files; ++f) {
+      std::stringstream name;
+      name << "file" << f << ".idl.qi";
+      boost::filesystem::path p = dir / name.str();
+      std::ofstream os(p.string().c_str());
+      os << "package " << pkg << std::endl << std::endl;
+      os << "struct Struct" << f << std::endl
+         << "  x : int" << std::endl
+         << "  names : Vec<str>" << std::endl
+         << "end" << std::endl << std::endl;
+      for (unsigned i = 0; i < ifacePerFile; ++i) {
+        os << "//! interface number " << i << std::endl;
+        os << "interface Iface" << f << "_" << i << std::endl;
+        os << "  //! does something" << std::endl;
+        os << "  fn doIt(a: int, b: str, c: Map<str, Vec<float>>) -> Struct" << f << std::endl;
+        os << "  fn ping() -> bool" << std::endl;
+        os << "  sig changed(value: int)" << std::endl;
+        os << "  prop level(value: float)" << std::endl;
+        os << "end" << std::endl << std::endl;
+      }
+      ret.push_back(p.string());
+    }
+    return ret;
+  }
+
+  inline void report(const std::string& name, double ms, unsigned iterations) {
+    std::cout << name << ": " << ms << " ms (" << ms / iterations << " ms/iteration)" << std::endl;
+  }
+}
+
+#endif  // QILANG_PERF_COMMON_HPP_
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/flatast.hpp>
+#include <qilang/parser.hpp>
+#include <qilang/visitor.hpp>
+#include "perf_common.hpp"
+
+// Compare findNode on the node tree with a linear scan of the flat AST.
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_flatast");
+  std::vector<std::string> files = perf::writeSyntheticPackage(root, "perfflat", 50, 50);
+  const unsigned iterations = 20;
+  size_t found = 0;
+
+  std::vector<qilang::ParseResultPtr> prs;
+  for (unsigned i = 0; i < files.size(); ++i)
+    prs.push_back(qilang::parse(qilang::newFileReader(files[i])));
+
+  perf::Clock::time_point start = perf::Clock::now();
+  std::vector<qilang::FlatAST> flats(prs.size());
+  for (unsigned i = 0; i < prs.size(); ++i)
+    flats[i].assign(prs[i]->ast);
+  perf::report("flatten", perf::msSince(start), 1);
+
+  start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it) {
+    for (unsigned i = 0; i < prs.size(); ++i) {
+      found += qilang::findNode(prs[i]->ast, qilang::NodeKind_TypeExpr).size();
+      found += qilang::findNode(prs[i]->ast, qilang::NodeType_FnDecl).size();
+    }
+  }
+  perf::report("findNode", perf::msSince(start), iterations);
+
+  start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it) {
+    for (unsigned i = 0; i < flats.size(); ++i) {
+      found += flats[i].find(qilang::NodeKind_TypeExpr).size();
+      found += flats[i].find(qilang::NodeType_FnDecl).size();
+    }
+  }
+  perf::report("FlatAST::find", perf::msSince(start), iterations);
+
+  boost::filesystem::remove_all(root);
+  return found ? 0 : 1;
+}
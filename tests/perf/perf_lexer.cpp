@@ -0,0 +1,31 @@
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/parser.hpp>
+#include "perf_common.hpp"
+
+// Tokens per second of the flex and of the hand-written lexer.
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_lexer");
+  std::vector<std::string> files = perf::writeSyntheticPackage(root, "perflexer", 100, 50);
+  const unsigned iterations = 5;
+  const char* names[] = { "flex", "handwritten" };
+  qilang::LexerType lexers[] = { qilang::LexerType_Flex, qilang::LexerType_HandWritten };
+  size_t counts[2] = { 0, 0 };
+
+  for (unsigned l = 0; l < 2; ++l) {
+    perf::Clock::time_point start = perf::Clock::now();
+    for (unsigned it = 0; it < iterations; ++it) {
+      for (unsigned i = 0; i < files.size(); ++i)
+        counts[l] += qilang::tokenize(qilang::newFileReader(files[i]), lexers[l]);
+    }
+    double ms = perf::msSince(start);
+    perf::report(names[l], ms, iterations);
+    std::cout << names[l] << ": " << static_cast<size_t>(counts[l] / (ms / 1000.0)) << " tokens/s" << std::endl;
+  }
+
+  boost::filesystem::remove_all(root);
+  return counts[0] == counts[1] ? 0 : 1;
+}
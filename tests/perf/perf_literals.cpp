@@ -0,0 +1,38 @@
+#include <fstream>
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/parser.hpp>
+#include "perf_common.hpp"
+
+// Lexing of a constant table: integer and float literals.
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_literals");
+  std::string path = (boost::filesystem::path(root) / "consts.idl.qi").string();
+  {
+    std::ofstream os(path.c_str());
+    os << "package perfliterals" << std::endl;
+    for (unsigned i = 0; i < 20000; ++i) {
+      os << "const i" << i << " = " << 1000003ULL * i * i << std::endl;
+      os << "const f" << i << " = " << i << "." << (i * 7919) % 100000 << "e-" << i % 30 << std::endl;
+    }
+  }
+  const unsigned iterations = 20;
+  const char* names[] = { "flex", "handwritten" };
+  qilang::LexerType lexers[] = { qilang::LexerType_Flex, qilang::LexerType_HandWritten };
+  size_t counts[2] = { 0, 0 };
+
+  for (unsigned l = 0; l < 2; ++l) {
+    perf::Clock::time_point start = perf::Clock::now();
+    for (unsigned it = 0; it < iterations; ++it)
+      counts[l] += qilang::tokenize(qilang::newFileReader(path), lexers[l]);
+    double ms = perf::msSince(start);
+    perf::report(names[l], ms, iterations);
+    std::cout << names[l] << ": " << static_cast<size_t>(counts[l] / (ms / 1000.0)) << " tokens/s" << std::endl;
+  }
+
+  boost::filesystem::remove_all(root);
+  return counts[0] == counts[1] ? 0 : 1;
+}
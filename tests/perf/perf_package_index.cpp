@@ -0,0 +1,57 @@
+#include <ctime>
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/packageindex.hpp>
+#include <qilang/packagemanager.hpp>
+#include "perf_common.hpp"
+
+// Locate packages in a large SDK tree, by walking it and with its index.
+static double locateAll(const std::string& root, unsigned packages, bool useIndex, unsigned* found)
+{
+  perf::Clock::time_point start = perf::Clock::now();
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, root));
+  pm->setUsePackageIndexes(useIndex);
+  *found = 0;
+  for (unsigned p = 0; p < packages; ++p) {
+    std::stringstream name;
+    name << "perfindex.pkg" << p;
+    *found += pm->locatePackage(name.str()).size();
+  }
+  return perf::msSince(start);
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_package_index");
+  const unsigned packages = 200;
+  for (unsigned p = 0; p < packages; ++p) {
+    std::stringstream name;
+    name << "perfindex/pkg" << p;
+    perf::writeSyntheticPackage(root, name.str(), 20, 1);
+  }
+  //entries of the last second are not trusted by the index
+  std::time_t past = std::time(0) - 10;
+  std::string idl = root + "/share/qi/idl";
+  for (boost::filesystem::recursive_directory_iterator it(idl), end; it != end; ++it)
+    boost::filesystem::last_write_time(it->path(), past);
+
+  perf::Clock::time_point start = perf::Clock::now();
+  qilang::writePackageIndex(idl);
+  std::cout << "index: " << perf::msSince(start) << " ms" << std::endl;
+
+  unsigned walked, indexed;
+  double ms = locateAll(root, packages, false, &walked);
+  perf::report("walk", ms, packages);
+  ms = locateAll(root, packages, true, &indexed);
+  perf::report("indexed", ms, packages);
+
+  boost::filesystem::remove_all(root);
+  if (walked != indexed || walked != packages * 20) {
+    std::cout << "error: " << walked << " files walked, " << indexed << " indexed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <sstream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/packagemanager.hpp>
+#include <qilang/packagesummary.hpp>
+#include "perf_common.hpp"
+
+// Analyse a file importing many large packages, with the imported packages
+// parsed from their sources and loaded from their summaries.
+static const unsigned Packages = 40;
+
+static double analyse(const std::string& root, bool useSummaries, std::string* result)
+{
+  perf::Clock::time_point start = perf::Clock::now();
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, root));
+  pm->setUseAstFiles(false);
+  pm->setUsePackageSummaries(useSummaries);
+  pm->parseFile(qilang::newFileReader(root + "/share/qi/idl/perfsummary/app.idl.qi"));
+  pm->anal();
+  double ms = perf::msSince(start);
+
+  std::stringstream ss;
+  pm->printMessage(ss);
+  for (unsigned p = 0; p < Packages; ++p) {
+    std::stringstream name;
+    name << "psum" << p;
+    ss << name.str() << " " << pm->package(name.str())->exportsHash() << std::endl;
+  }
+  *result = ss.str();
+  return ms;
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_package_summary");
+  boost::filesystem::create_directories(root + "/share/qi/idl/perfsummary");
+  std::ofstream os((root + "/share/qi/idl/perfsummary/app.idl.qi").c_str());
+  os << "package perfsummary" << std::endl;
+  for (unsigned p = 0; p < Packages; ++p) {
+    std::stringstream name;
+    name << "psum" << p;
+    perf::writeSyntheticPackage(root, name.str(), 10, 5);
+    os << "from " << name.str() << " import *" << std::endl;
+  }
+  os << "interface App" << std::endl << "  fn f(s: Struct0)" << std::endl << "end" << std::endl;
+  os.close();
+
+  perf::Clock::time_point start = perf::Clock::now();
+  qilang::writePackageSummaries(root + "/share/qi/idl");
+  std::cout << "summaries: " << perf::msSince(start) << " ms" << std::endl;
+
+  std::string parsed, summarized;
+  perf::report("sources", analyse(root, false, &parsed), Packages);
+  perf::report("summaries", analyse(root, true, &summarized), Packages);
+
+  boost::filesystem::remove_all(root);
+  if (parsed != summarized) {
+    std::cout << "error: the summaries give other exports than the sources" << std::endl;
+    return 1;
+  }
+  return 0;
+}
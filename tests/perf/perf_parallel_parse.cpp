@@ -0,0 +1,55 @@
+#include <iostream>
+#include <map>
+#include <thread>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/packagemanager.hpp>
+#include <qilang/formatter.hpp>
+#include "perf_common.hpp"
+
+// Parse a whole package with an increasing number of jobs,
+// and check that the result does not depend on it.
+static std::map<std::string, std::string> parsePackage(const std::string& root, unsigned int jobs, double* ms)
+{
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  qilang::StringVector lookup;
+  lookup.push_back(root);
+  pm->addLookupPaths(lookup);
+  pm->setJobs(jobs);
+
+  perf::Clock::time_point start = perf::Clock::now();
+  pm->parsePackage("perfparallel");
+  *ms = perf::msSince(start);
+
+  std::map<std::string, std::string> ret;
+  qilang::PackagePtr pkg = pm->package("perfparallel");
+  for (qilang::ParseResultMap::const_iterator it = pkg->_contents.begin(); it != pkg->_contents.end(); ++it)
+    ret[it->first] = qilang::formatAST(it->second->ast);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_parallel_parse");
+  perf::writeSyntheticPackage(root, "perfparallel", 400, 50);
+
+  double ms;
+  std::map<std::string, std::string> reference = parsePackage(root, 1, &ms);
+  std::cout << "jobs 1: " << ms << " ms" << std::endl;
+  double serial = ms;
+
+  unsigned int maxjobs = std::max(2u, std::thread::hardware_concurrency());
+  int ret = 0;
+  for (unsigned int jobs = 2; jobs <= maxjobs; jobs *= 2) {
+    std::map<std::string, std::string> res = parsePackage(root, jobs, &ms);
+    std::cout << "jobs " << jobs << ": " << ms << " ms (speedup x" << serial / ms << ")" << std::endl;
+    if (res != reference) {
+      std::cout << "error: result differs with " << jobs << " jobs" << std::endl;
+      ret = 1;
+    }
+  }
+
+  boost::filesystem::remove_all(root);
+  return ret;
+}
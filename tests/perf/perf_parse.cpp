@@ -0,0 +1,38 @@
+#include <fstream>
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/parser.hpp>
+#include "perf_common.hpp"
+
+// Compare the stream based scanner input with the preloaded buffer one.
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_parse");
+  std::vector<std::string> files = perf::writeSyntheticPackage(root, "perfparse", 200, 50);
+  const unsigned iterations = 5;
+  size_t nodes = 0;
+
+  perf::Clock::time_point start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it) {
+    for (unsigned i = 0; i < files.size(); ++i) {
+      std::ifstream is(files[i].c_str());
+      qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(&is, files[i]));
+      nodes += pr->ast.size();
+    }
+  }
+  perf::report("istream", perf::msSince(start), iterations);
+
+  start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it) {
+    for (unsigned i = 0; i < files.size(); ++i) {
+      qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(files[i]));
+      nodes += pr->ast.size();
+    }
+  }
+  perf::report("buffer", perf::msSince(start), iterations);
+
+  boost::filesystem::remove_all(root);
+  return nodes ? 0 : 1;
+}
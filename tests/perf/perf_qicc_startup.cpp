@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qi/path.hpp>
+#include "perf_common.hpp"
+
+// Run qicc on a trivial IDL file, from process start to exit: most of the
+// qicc runs of a build generate small files, their cost is the startup.
+static const unsigned Runs = 50;
+
+static double run(const std::string& command, unsigned runs, bool* ok)
+{
+  perf::Clock::time_point start = perf::Clock::now();
+  for (unsigned i = 0; i < runs; ++i) {
+    if (std::system(command.c_str()) != 0)
+      *ok = false;
+  }
+  return perf::msSince(start);
+}
+
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string qicc = qi::path::findBin("qicc");
+  if (qicc.empty()) {
+    std::cout << "error: qicc not found" << std::endl;
+    return 1;
+  }
+
+  std::string root = qi::os::mktmpdir("qilang_perf_qicc_startup");
+  boost::filesystem::path dir = boost::filesystem::path(root) / "perfstartup";
+  boost::filesystem::path idl = dir / "trivial.idl.qi";
+  boost::filesystem::path out = dir / "trivial.hpp";
+  boost::filesystem::create_directories(dir);
+  {
+    std::ofstream os(idl.string().c_str());
+    os << "package perfstartup" << std::endl
+       << "interface Trivial" << std::endl
+       << "  fn ping() -> bool" << std::endl
+       << "end" << std::endl;
+  }
+
+  std::string command = "\"" + qicc + "\" -c cpp_interface \"" + idl.string() + "\" -o \"" + out.string() + "\"";
+  bool ok = true;
+  //warm up the file cache
+  run(command, 1, &ok);
+  double ms = run(command, Runs, &ok);
+  perf::report("file mode", ms, Runs);
+  //any libqi option brings back the application session
+  ms = run(command + " --qi-log-level=info", Runs, &ok);
+  perf::report("file mode with libqi options", ms, Runs);
+
+  boost::filesystem::remove_all(root);
+  if (!ok) {
+    std::cout << "error: qicc failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,35 @@
+#include <iostream>
+#include <qi/application.hpp>
+#include <qi/os.hpp>
+#include <qilang/parser.hpp>
+#include "perf_common.hpp"
+
+// Rename a method in the middle of a big IDL: full parse vs reparse.
+int main(int argc, char *argv[])
+{
+  qi::Application app(argc, argv);
+  std::string root = qi::os::mktmpdir("qilang_perf_reparse");
+  const unsigned ifaces = 1000;
+  std::vector<std::string> files = perf::writeSyntheticPackage(root, "perfreparse", 1, ifaces);
+  const unsigned iterations = 100;
+
+  perf::Clock::time_point start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it)
+    qilang::parse(qilang::newFileReader(files[0]), false);
+  perf::report("full parse", perf::msSince(start), iterations);
+
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(files[0]), false);
+  //line of "  fn ping() -> bool" in the interface in the middle (see writeSyntheticPackage)
+  int line = 12 + 8 * (ifaces / 2);
+  int partial = 0;
+  start = perf::Clock::now();
+  for (unsigned it = 0; it < iterations; ++it) {
+    qilang::TextEdit edit(line, 6, line, 10, it % 2 ? "ping" : "pong");
+    if (qilang::reparse(pr, edit) >= 0)
+      ++partial;
+  }
+  perf::report("reparse", perf::msSince(start), iterations);
+
+  boost::filesystem::remove_all(root);
+  return (partial == static_cast<int>(iterations) && !pr->hasError()) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <ctime>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <qilang/astfile.hpp>
+#include <qilang/parser.hpp>
+#include <qilang/formatter.hpp>
+#include <qilang/packagemanager.hpp>
+#include "tmpdir_fixture.hpp"
+
+static const char* someIdl =
+    "package foo\n"
+    "from bar import Baz\n"
+    "\n"
+    "//! a doc\n"
+    "interface Iface(Base)\n"
+    "  fn f(a: int, b: Vec<str>, *rest) -> Map<str, Baz>\n"
+    "  sig changed(v: Tuple<int, float>)\n"
+    "  prop level(v: any)\n"
+    "end\n"
+    "\n"
+    "struct Point\n"
+    "  x, y : float\n"
+    "end\n"
+    "enum Color\n"
+    "  const Red = 1\n"
+    "  const Name = \"blue\"\n"
+    "end\n"
+    "const answer = [1, 2.5, \"three\", {\"k\": true}]\n";
+
+class QiLangAstFile: public TmpDirFixture
+{
+protected:
+  QiLangAstFile()
+    : TmpDirFixture("test_qilang_astfile")
+  {}
+
+  void SetUp() override
+  {
+    TmpDirFixture::SetUp();
+    _source = write("foo/foo.idl.qi", someIdl);
+  }
+
+  void writeAst(const qilang::ParseResultPtr& pr)
+  {
+    qilang::AstSourceStamp stamp;
+    ASSERT_TRUE(qilang::astSourceStamp(_source, &stamp));
+    write(qilang::astFileName(_source), qilang::serializeAST(pr->ast, stamp));
+  }
+
+  std::string _source;
+};
+
+TEST_F(QiLangAstFile, RoundTrip)
+{
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(_source));
+  ASSERT_FALSE(pr->hasError());
+  writeAst(pr);
+
+  qilang::ParseResultPtr loaded = qilang::loadAST(_source);
+  ASSERT_TRUE(loaded);
+  ASSERT_EQ(pr->ast.size(), loaded->ast.size());
+  EXPECT_EQ(qilang::formatAST(pr->ast), qilang::formatAST(loaded->ast));
+  EXPECT_EQ(qilang::format(pr->ast), qilang::format(loaded->ast));
+  EXPECT_EQ(pr->ast.at(2)->comment(), loaded->ast.at(2)->comment());
+  EXPECT_EQ(pr->ast.at(2)->loc().beg_line, loaded->ast.at(2)->loc().beg_line);
+  EXPECT_EQ(_source, loaded->ast.at(2)->loc().filename());
+}
+
+TEST_F(QiLangAstFile, StaleFileIsIgnored)
+{
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(_source));
+  writeAst(pr);
+  write(_source, std::string(someIdl) + "struct Other\n  z : int\nend\n");
+  EXPECT_FALSE(qilang::loadAST(_source));
+}
+
+TEST_F(QiLangAstFile, CorruptedFileIsIgnored)
+{
+  write(qilang::astFileName(_source), "QILAST\n garbage");
+  EXPECT_FALSE(qilang::loadAST(_source));
+
+  qilang::AstFile af;
+  std::string error;
+  EXPECT_FALSE(af.open(qilang::astFileName(_source), &error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST_F(QiLangAstFile, PackageManagerLoadsAst)
+{
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(_source));
+  writeAst(pr);
+
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->parseDir(_dir + "/foo");
+  EXPECT_FALSE(pm->hasError());
+  qilang::PackagePtr pkg = pm->package("foo");
+  ASSERT_EQ(1u, pkg->_contents.size());
+  EXPECT_EQ(qilang::formatAST(pr->ast), qilang::formatAST(pkg->_contents.begin()->second->ast));
+}
+
+TEST_F(QiLangAstFile, UnchangedOutputIsNotWritten)
+{
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  qilang::ParseResultPtr pr = pm->parseFile(qilang::newFileReader(_source));
+  std::string output = (boost::filesystem::path(_dir) / "gen" / "foo.ast").string();
+
+  qilang::FileWriterPtr out = qilang::newFileWriter(output, std::ios::out | std::ios::binary);
+  ASSERT_TRUE(qilang::codegen(out, "ast", pm, pr));
+  ASSERT_TRUE(out->close());
+  EXPECT_TRUE(out->written());
+  std::time_t past = std::time(0) - 10;
+  boost::filesystem::last_write_time(output, past);
+
+  out = qilang::newFileWriter(output, std::ios::out | std::ios::binary);
+  ASSERT_TRUE(qilang::codegen(out, "ast", pm, pr));
+  ASSERT_TRUE(out->close());
+  EXPECT_FALSE(out->written());
+  EXPECT_EQ(past, boost::filesystem::last_write_time(output));
+
+  //a writer that is never used writes nothing
+  out = qilang::newFileWriter(output + ".unused");
+  EXPECT_TRUE(out->close());
+  EXPECT_FALSE(boost::filesystem::exists(output + ".unused"));
+
+  qilang::StringVector sources = pm->sourceFiles();
+  ASSERT_EQ(1u, sources.size());
+  EXPECT_TRUE(boost::filesystem::equivalent(_source, sources.at(0)));
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <qilang/commandline.hpp>
+#include <qilang/pathformatter.hpp>
+
+//the options of: qicc <args>, with "-g x" written "g:x"
+static qilang::CommandLineOptionVector options(const char* args[], unsigned count)
+{
+  qilang::CommandLineOptionVector ret;
+  for (unsigned i = 0; i < count; ++i) {
+    std::string arg(args[i]);
+    if (arg.compare(0, 2, "g:") == 0)
+      ret.push_back(qilang::CommandLineOption("generate", arg.substr(2)));
+    else
+      ret.push_back(qilang::CommandLineOption("inputs", arg));
+  }
+  return ret;
+}
+
+static qilang::Generation generation(const std::string& codegen, const std::string& output = std::string())
+{
+  qilang::Generation ret;
+  ret.codegen = codegen;
+  ret.output  = output;
+  return ret;
+}
+
+//codegen:output of the generations of an input, space separated
+static std::string generations(const qilang::Input& input)
+{
+  std::string ret;
+  for (unsigned i = 0; i < input.generations.size(); ++i)
+    ret += (i ? " " : "") + input.generations[i].codegen + ":" + input.generations[i].output;
+  return ret;
+}
+
+TEST(QiLangCommandLine, SeveralInputs)
+{
+  const char* args[] = { "a.idl.qi", "g:cpp_interface:a.hpp", "g:cpp_local:a_p.hpp",
+                         "b.idl.qi", "g:cpp_remote:bremote.cpp" };
+  qilang::InputVector inputs;
+  std::string error;
+  ASSERT_TRUE(qilang::parseInputs(options(args, 5), qilang::Generation(), &inputs, &error)) << error;
+  ASSERT_EQ(2u, inputs.size());
+  EXPECT_EQ("a.idl.qi", inputs[0].file);
+  EXPECT_EQ("cpp_interface:a.hpp cpp_local:a_p.hpp", generations(inputs[0]));
+  EXPECT_EQ("b.idl.qi", inputs[1].file);
+  EXPECT_EQ("cpp_remote:bremote.cpp", generations(inputs[1]));
+}
+
+TEST(QiLangCommandLine, GenerateBeforeTheInput)
+{
+  const char* args[] = { "g:ast:a.ast", "a.idl.qi", "g:cpp_interface:a.hpp" };
+  qilang::InputVector inputs;
+  ASSERT_TRUE(qilang::parseInputs(options(args, 3), qilang::Generation(), &inputs));
+  ASSERT_EQ(1u, inputs.size());
+  EXPECT_EQ("ast:a.ast cpp_interface:a.hpp", generations(inputs[0]));
+
+  //only valid with one input
+  const char* two[] = { "g:ast:a.ast", "a.idl.qi", "b.idl.qi" };
+  inputs.clear();
+  std::string error;
+  EXPECT_FALSE(qilang::parseInputs(options(two, 3), generation("cpp_interface"), &inputs, &error));
+  EXPECT_NE(std::string::npos, error.find("before the input files"));
+}
+
+TEST(QiLangCommandLine, DefaultCodegenForInputsWithoutGenerate)
+{
+  const char* args[] = { "a.idl.qi", "b.idl.qi", "g:cpp_local:b_p.hpp", "c.idl.qi" };
+  qilang::InputVector inputs;
+  ASSERT_TRUE(qilang::parseInputs(options(args, 4), generation("cpp_interface"), &inputs));
+  ASSERT_EQ(3u, inputs.size());
+  EXPECT_EQ("cpp_interface:", generations(inputs[0]));
+  EXPECT_EQ("cpp_local:b_p.hpp", generations(inputs[1]));
+  EXPECT_EQ("cpp_interface:", generations(inputs[2]));
+
+  //-o is for one input only
+  inputs.clear();
+  std::string error;
+  EXPECT_FALSE(qilang::parseInputs(options(args, 4), generation("cpp_interface", "out.hpp"), &inputs, &error));
+  EXPECT_NE(std::string::npos, error.find("-o is for a single input"));
+
+  //and without -c, every input needs a -g
+  inputs.clear();
+  EXPECT_FALSE(qilang::parseInputs(options(args, 4), qilang::Generation(), &inputs, &error));
+  EXPECT_NE(std::string::npos, error.find("no codegen for 'a.idl.qi'"));
+}
+
+TEST(QiLangCommandLine, OutputWithColon)
+{
+  const char* args[] = { "a.idl.qi", "g:cpp_interface:C:/build/a.hpp", "g:ast:dir:with:colons/a.ast" };
+  qilang::InputVector inputs;
+  ASSERT_TRUE(qilang::parseInputs(options(args, 3), qilang::Generation(), &inputs));
+  ASSERT_EQ(1u, inputs.size());
+  ASSERT_EQ(2u, inputs[0].generations.size());
+  EXPECT_EQ("cpp_interface", inputs[0].generations[0].codegen);
+  EXPECT_EQ(qilang::formatPath("C:/build/a.hpp"), inputs[0].generations[0].output);
+  EXPECT_EQ("ast", inputs[0].generations[1].codegen);
+  EXPECT_EQ(qilang::formatPath("dir:with:colons/a.ast"), inputs[0].generations[1].output);
+}
+
+TEST(QiLangCommandLine, InvalidCommandLines)
+{
+  std::string error;
+  qilang::InputVector inputs;
+  EXPECT_FALSE(qilang::parseInputs(qilang::CommandLineOptionVector(), generation("cpp_interface"), &inputs, &error));
+  EXPECT_EQ("no input", error);
+
+  const char* noCodegen[] = { "a.idl.qi", "g::a.hpp" };
+  EXPECT_FALSE(qilang::parseInputs(options(noCodegen, 2), qilang::Generation(), &inputs, &error));
+  EXPECT_NE(std::string::npos, error.find("expected codegen:output"));
+
+  const char* noColon[] = { "a.idl.qi", "g:cpp_interface" };
+  inputs.clear();
+  EXPECT_FALSE(qilang::parseInputs(options(noColon, 2), qilang::Generation(), &inputs, &error));
+  EXPECT_NE(std::string::npos, error.find("expected codegen:output"));
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <boost/filesystem.hpp>
+#include <qilang/compileserver.hpp>
+#include <qilang/formatter.hpp>
+#include <qilang/parser.hpp>
+#include "tmpdir_fixture.hpp"
+
+namespace fs = boost::filesystem;
+
+class QiLangCompileServer: public TmpDirFixture
+{
+protected:
+  QiLangCompileServer()
+    : TmpDirFixture("test_qilang_compileserver")
+  {}
+
+  void SetUp() override
+  {
+    TmpDirFixture::SetUp();
+    _root = (fs::path(_dir) / "share/qi/idl").string();
+    _app = write("app/app.idl.qi",
+                 "package app\n"
+                 "from lib import *\n"
+                 "interface App\n"
+                 "  fn f(s: S) -> int\n"
+                 "end\n");
+    _lib = write("lib/lib.idl.qi", "package lib\nstruct S\n  x : int\nend\n");
+  }
+
+  //files written in the past: the pool trusts their stamps
+  std::string write(const std::string& name, const std::string& content)
+  {
+    std::string path = TmpDirFixture::write(name, content);
+    fs::last_write_time(path, std::time(0) - 100 + _writes++);
+    return path;
+  }
+
+  std::string generate(qilang::PackageManagerPool& pool)
+  {
+    qilang::PackageManagerPtr pm = pool.acquire(qilang::StringVector(), qilang::StringVector(1, _dir), 1);
+    qilang::ParseResultPtr pr = pm->parseFile(qilang::newFileReader(_app));
+    std::stringstream ss;
+    bool ok = qilang::codegen(qilang::newFileWriter(&ss, "out"), "cpp_interface", pm, pr);
+    pool.release(pm);
+    return ok ? ss.str() : "error";
+  }
+
+  std::string _app;
+  std::string _lib;
+  int         _writes = 0;
+};
+
+TEST_F(QiLangCompileServer, PoolReusesPackageManagers)
+{
+  qilang::PackageManagerPool pool;
+  std::string first = generate(pool);
+  ASSERT_NE("error", first);
+  EXPECT_EQ(first, generate(pool));
+  EXPECT_EQ(2u, pool.stats().acquired);
+  EXPECT_EQ(1u, pool.stats().reused);
+  EXPECT_EQ(0u, pool.stats().reparsed);
+
+  //another lookup path is another package manager
+  qilang::PackageManagerPtr other = pool.acquire(qilang::StringVector(), qilang::StringVector(1, _root), 1);
+  EXPECT_EQ(1u, pool.stats().reused);
+  pool.release(other);
+}
+
+TEST_F(QiLangCompileServer, PoolSeesChangedFiles)
+{
+  qilang::PackageManagerPool pool;
+  std::string first = generate(pool);
+
+  //an imported file changed: parsed again, with the same package manager
+  write("lib/lib.idl.qi", "package lib\nstruct S\n  x : int\n  y : str\nend\nstruct T\n  z : int\nend\n");
+  write("app/app.idl.qi", "package app\nfrom lib import *\ninterface App\n  fn f(s: S) -> T\nend\n");
+  std::string second = generate(pool);
+  EXPECT_NE(first, second);
+  EXPECT_NE(std::string::npos, second.find("::lib::T"));
+  EXPECT_EQ(1u, pool.stats().reused);
+  EXPECT_EQ(2u, pool.stats().reparsed);
+
+  //a new file in a package, included by what imports it: the package manager is not reused
+  write("lib/more.idl.qi", "package lib\nstruct U\n  z : int\nend\n");
+  std::string third = generate(pool);
+  EXPECT_NE(std::string::npos, third.find("#include <lib/more.hpp>"));
+  EXPECT_EQ(1u, pool.stats().reused);
+  EXPECT_EQ(1u, pool.stats().dropped);
+
+  //an error: not kept either
+  write("app/app.idl.qi", "package app\nfrom lib import *\ninterface App\n  fn f(s: Missing) -> int\nend\n");
+  EXPECT_EQ("error", generate(pool));
+  EXPECT_EQ(2u, pool.stats().dropped);
+  write("app/app.idl.qi", "package app\nfrom lib import *\ninterface App\n  fn f(s: S) -> T\nend\n");
+  EXPECT_EQ(third, generate(pool));
+}
+
+TEST_F(QiLangCompileServer, PoolHoldsPackageManagers)
+{
+  qilang::PackageManagerPool pool;
+  qilang::PackageManagerPtr pm = pool.acquire(qilang::StringVector(), qilang::StringVector(1, _dir), 1);
+  //other paths: another package manager, available
+  pool.release(pool.acquire(qilang::StringVector(), qilang::StringVector(1, _root), 1));
+
+  //the same paths: waits for the release
+  std::atomic<bool> acquired(false);
+  std::thread thread([&]() {
+    pool.release(pool.acquire(qilang::StringVector(), qilang::StringVector(1, _dir), 1));
+    acquired = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(acquired);
+  pool.release(pm);
+  thread.join();
+  EXPECT_TRUE(acquired);
+  EXPECT_EQ(3u, pool.stats().acquired);
+  EXPECT_EQ(1u, pool.stats().reused);
+}
+
+static qilang::CompileResponse echo(const qilang::CompileRequest& request)
+{
+  qilang::CompileResponse ret;
+  ret.status = static_cast<int>(request.args.size());
+  ret.output = request.cwd + (request.cache ? "|cache " : "|no cache ") + request.cacheDir;
+  for (unsigned i = 0; i < request.args.size(); ++i)
+    ret.output += "|" + request.args.at(i);
+  return ret;
+}
+
+TEST_F(QiLangCompileServer, RequestAndStop)
+{
+  std::string socket = (fs::path(_dir) / "server.sock").string();
+  qilang::CompileServer server(socket);
+  ASSERT_TRUE(server.listen());
+  //one server per socket
+  qilang::CompileServer other(socket);
+  std::string error;
+  EXPECT_FALSE(other.listen(&error));
+  EXPECT_FALSE(error.empty());
+
+  std::thread thread([&server]() { server.run(&echo); });
+  qilang::CompileRequest request;
+  request.cwd = "/some/dir";
+  request.cache = true;
+  request.cacheDir = "/client/cache";
+  request.args.push_back("-c");
+  request.args.push_back(std::string("with\nnewline\0and nul", 20));
+  request.args.push_back("");
+  qilang::CompileResponse response;
+  ASSERT_TRUE(qilang::callCompileServer(socket, request, &response));
+  EXPECT_EQ(3, response.status);
+  EXPECT_EQ("/some/dir|cache /client/cache|-c|" + std::string("with\nnewline\0and nul", 20) + "|", response.output);
+
+  qilang::CompileRequest stop;
+  stop.stop = true;
+  ASSERT_TRUE(qilang::callCompileServer(socket, stop, &response));
+  EXPECT_EQ(0, response.status);
+  thread.join();
+
+  //gone
+  EXPECT_FALSE(qilang::callCompileServer(socket, request, &response, &error));
+  EXPECT_FALSE(fs::exists(socket));
+}
+
+TEST_F(QiLangCompileServer, OnlyTrustsSocketsOfTheUser)
+{
+  //not a socket: nothing is sent, the client generates by itself
+  std::string path = write("fake.sock", "");
+  qilang::CompileRequest request;
+  qilang::CompileResponse response;
+  std::string error;
+  EXPECT_FALSE(qilang::callCompileServer(path, request, &response, &error));
+  EXPECT_NE(std::string::npos, error.find("not a socket of this user"));
+}
+
+TEST_F(QiLangCompileServer, RequestsAnsweredConcurrently)
+{
+  std::string socket = (fs::path(_dir) / "server.sock").string();
+  qilang::CompileServer server(socket);
+  server.setJobs(2);
+  ASSERT_TRUE(server.listen());
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  int inside = 0;
+  std::thread thread([&]() {
+    server.run([&](const qilang::CompileRequest&) {
+      std::unique_lock<std::mutex> lock(mutex);
+      ++inside;
+      cv.notify_all();
+      //the other request is answered at the same time, or this one times out
+      qilang::CompileResponse ret;
+      ret.status = cv.wait_for(lock, std::chrono::seconds(5), [&]() { return inside == 2; }) ? 0 : 1;
+      return ret;
+    });
+  });
+
+  qilang::CompileRequest request;
+  qilang::CompileResponse first;
+  qilang::CompileResponse second;
+  std::thread client([&]() { qilang::callCompileServer(socket, request, &first); });
+  ASSERT_TRUE(qilang::callCompileServer(socket, request, &second));
+  client.join();
+  EXPECT_EQ(0, first.status);
+  EXPECT_EQ(0, second.status);
+
+  qilang::CompileRequest stop;
+  stop.stop = true;
+  ASSERT_TRUE(qilang::callCompileServer(socket, stop, &first));
+  thread.join();
+  EXPECT_FALSE(fs::exists(socket));
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <qilang/filewatcher.hpp>
+#include <qilang/packagemanager.hpp>
+#include <qilang/pathformatter.hpp>
+#include "tmpdir_fixture.hpp"
+
+namespace fs = boost::filesystem;
+
+class QiLangFileWatcher: public TmpDirFixture
+{
+protected:
+  QiLangFileWatcher()
+    : TmpDirFixture("test_qilang_filewatcher")
+  {}
+
+  void SetUp() override
+  {
+    TmpDirFixture::SetUp();
+    _dir = qilang::formatPath(fs::canonical(_dir).string());
+    _root = _dir;
+  }
+
+  std::string write(const std::string& name, const std::string& content)
+  {
+    return qilang::formatPath(TmpDirFixture::write(name, content));
+  }
+};
+
+TEST_F(QiLangFileWatcher, ReportsChangedIdlFiles)
+{
+  std::string lib = write("lib/lib.idl.qi", "package lib\n");
+  qilang::FileWatcher watcher;
+  std::string error;
+  ASSERT_TRUE(watcher.addTree(_dir, &error)) << error;
+  EXPECT_FALSE(watcher.addTree(_dir + "/missing", &error));
+
+  qilang::StringVector files;
+  EXPECT_FALSE(watcher.wait(&files, 0));
+
+  //polling compares the stamps: the change must be seen in the size
+  write("lib/lib.idl.qi", "package lib\nstruct S\n  x : int\nend\n");
+  write("lib/notes.txt", "not an IDL file");
+  ASSERT_TRUE(watcher.wait(&files, 5000));
+  EXPECT_EQ(qilang::StringVector(1, lib), files);
+
+  //files of a new directory, reported together
+  std::string a = write("app/a.idl.qi", "package app\n");
+  std::string b = write("app/b.idl.qi", "package app\n");
+  ASSERT_TRUE(watcher.wait(&files, 5000));
+  qilang::StringVector expected;
+  expected.push_back(a);
+  expected.push_back(b);
+  EXPECT_EQ(expected, files);
+
+  fs::remove(a);
+  ASSERT_TRUE(watcher.wait(&files, 5000));
+  EXPECT_EQ(qilang::StringVector(1, a), files);
+
+  //a hard link is created, never written
+  fs::create_hard_link(b, a);
+  ASSERT_TRUE(watcher.wait(&files, 5000));
+  EXPECT_EQ(qilang::StringVector(1, a), files);
+}
+
+TEST_F(QiLangFileWatcher, ImportersOfChangedPackagesArePending)
+{
+  _root = _dir + "/share/qi/idl";
+  std::string a = write("a/a.idl.qi", "package a\nstruct A\n  x : int\nend\n");
+  write("b/b.idl.qi", "package b\nfrom a import A\nstruct B\n  a : A\nend\n");
+  qilang::StringVector inputs;
+  inputs.push_back(write("c/c.idl.qi", "package c\nfrom b import B\ninterface C\n  fn f(b: B)\nend\n"));
+  inputs.push_back(write("d/d.idl.qi", "package d\nstruct D\n  y : int\nend\n"));
+
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, _dir));
+  pm->setUseAstFiles(false);
+  pm->setUsePackageSummaries(false);
+  qilang::WatchedInputs watched(pm, inputs);
+  ASSERT_EQ(2u, watched.pending().size());
+  for (unsigned i = 0; i < inputs.size(); ++i) {
+    EXPECT_EQ(inputs[i], watched.parseResult(i)->filename);
+    watched.generated(i);
+  }
+  //as generating C++ does
+  pm->anal();
+  ASSERT_FALSE(pm->hasError());
+  EXPECT_TRUE(watched.pending().empty());
+
+  //an exported type of a changes: c imports it through b
+  write("a/a.idl.qi", "package a\nstruct A\n  x : int\n  y : str\nend\n");
+  std::stringstream diagnostics;
+  watched.changed(qilang::StringVector(1, a), diagnostics);
+  EXPECT_EQ("", diagnostics.str());
+  ASSERT_EQ(1u, watched.pending().size());
+  EXPECT_EQ(0u, *watched.pending().begin());
+  watched.generated(0);
+
+  //an input changes: only itself
+  write("d/d.idl.qi", "package d\nstruct D\n  y : str\nend\n");
+  watched.changed(qilang::StringVector(1, inputs[1]), diagnostics);
+  ASSERT_EQ(1u, watched.pending().size());
+  EXPECT_EQ(1u, *watched.pending().begin());
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <qilang/flatast.hpp>
+#include <qilang/parser.hpp>
+#include <qilang/visitor.hpp>
+
+static const char* someIdl =
+    "package foo\n"
+    "from bar import Baz\n"
+    "\n"
+    "interface Iface(Base)\n"
+    "  fn f(a: int, b: Vec<str>) -> Map<str, Baz>\n"
+    "  sig changed(v: Tuple<int, float>)\n"
+    "  prop level(v: any)\n"
+    "end\n"
+    "\n"
+    "struct Point\n"
+    "  x, y : float\n"
+    "end\n"
+    "enum Color\n"
+    "  const Red = 1\n"
+    "end\n";
+
+static qilang::ParseResultPtr parseSome()
+{
+  std::stringstream ss(someIdl);
+  return qilang::parse(qilang::newFileReader(&ss, "foo.idl.qi"));
+}
+
+TEST(QiLangFlatAST, FindMatchesVisitor)
+{
+  qilang::ParseResultPtr pr = parseSome();
+  ASSERT_FALSE(pr->hasError());
+  qilang::FlatAST flat(pr->ast);
+
+  for (int t = qilang::NodeType_Package; t <= qilang::NodeType_CallExpr; ++t) {
+    qilang::NodeType type = static_cast<qilang::NodeType>(t);
+    EXPECT_EQ(qilang::findNode(pr->ast, type), flat.findNode(type)) << "type " << t;
+  }
+  for (int k = qilang::NodeKind_Expr; k <= qilang::NodeKind_Stmt; ++k) {
+    qilang::NodeKind kind = static_cast<qilang::NodeKind>(k);
+    EXPECT_EQ(qilang::findNode(pr->ast, kind), flat.findNode(kind)) << "kind " << k;
+  }
+}
+
+TEST(QiLangFlatAST, Structure)
+{
+  qilang::ParseResultPtr pr = parseSome();
+  ASSERT_FALSE(pr->hasError());
+  qilang::FlatAST flat(pr->ast);
+
+  ASSERT_EQ(pr->ast.size(), flat.roots().size());
+  for (unsigned i = 0; i < pr->ast.size(); ++i)
+    EXPECT_EQ(pr->ast.at(i), flat.node(flat.roots().at(i)));
+
+  for (qilang::FlatAST::Index i = 0; i < flat.size(); ++i) {
+    EXPECT_EQ(flat.node(i)->type(), flat.type(i));
+    EXPECT_EQ(flat.node(i)->loc().beg_line, flat.loc(i).beg_line);
+    EXPECT_LE(i + 1, flat.subtreeEnd(i));
+    for (qilang::FlatAST::Index c = 0; c < flat.childCount(i); ++c) {
+      qilang::FlatAST::Index child = flat.child(i, c);
+      EXPECT_EQ(i, flat.parent(child));
+      EXPECT_GT(child, i);
+      EXPECT_LT(child, flat.subtreeEnd(i));
+    }
+  }
+
+  qilang::FlatAST::IndexVector ifaces = flat.find(qilang::NodeType_InterfaceDecl, qilang::Symbol("Iface"));
+  ASSERT_EQ(1u, ifaces.size());
+  qilang::FlatAST::Index iface = ifaces.at(0);
+  ASSERT_EQ(3u, flat.childCount(iface));
+  EXPECT_EQ("f", flat.name(flat.child(iface, 0)).str());
+  EXPECT_EQ("changed", flat.name(flat.child(iface, 1)).str());
+  EXPECT_EQ("level", flat.name(flat.child(iface, 2)).str());
+
+  qilang::FlatAST::IndexVector customs = flat.find(qilang::NodeType_CustomTypeExpr, qilang::Symbol("Baz"));
+  ASSERT_EQ(1u, customs.size());
+  EXPECT_LT(iface, customs.at(0));
+  EXPECT_LT(customs.at(0), flat.subtreeEnd(iface));
+
+  flat.clear();
+  EXPECT_TRUE(flat.empty());
+  EXPECT_TRUE(flat.find(qilang::NodeKind_Decl).empty());
+}
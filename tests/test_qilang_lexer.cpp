@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <qilang/parser.hpp>
+
+static qilang::StringVector tokens(const qilang::FileReaderPtr& file, qilang::LexerType lexer)
+{
+  qilang::StringVector ret;
+  qilang::tokenize(file, lexer, &ret);
+  return ret;
+}
+
+static qilang::StringVector tokens(const std::string& content, qilang::LexerType lexer)
+{
+  std::stringstream ss(content);
+  return tokens(qilang::newFileReader(&ss, "memory.idl.qi"), lexer);
+}
+
+static void expectSameTokens(const std::string& content)
+{
+  qilang::StringVector flex = tokens(content, qilang::LexerType_Flex);
+  qilang::StringVector hand = tokens(content, qilang::LexerType_HandWritten);
+  EXPECT_EQ(flex, hand) << "content: " << content;
+}
+
+TEST(QiLangLexer, SameTokensOnCorpus)
+{
+  boost::filesystem::recursive_directory_iterator it(QILANG_TEST_SOURCE_DIR), end;
+  unsigned files = 0;
+  for (; it != end; ++it) {
+    const std::string path = it->path().string();
+    if (it->path().extension() != ".qi")
+      continue;
+    ++files;
+    qilang::StringVector flex = tokens(qilang::newFileReader(path), qilang::LexerType_Flex);
+    qilang::StringVector hand = tokens(qilang::newFileReader(path), qilang::LexerType_HandWritten);
+    ASSERT_EQ(flex.size(), hand.size()) << path;
+    for (unsigned i = 0; i < flex.size(); ++i)
+      ASSERT_EQ(flex.at(i), hand.at(i)) << path << " token " << i;
+  }
+  EXPECT_GT(files, 5u);
+}
+
+TEST(QiLangLexer, SameTokensOnEdgeCases)
+{
+  expectSameTokens("");
+  expectSameTokens("package foo.bar\n\nfrom a.b import *\n");
+  expectSameTokens("a.b _x x1 1 12 1.5 1.5e+3 1e5 1E-2 1e 1.5e 2.x 007\n");
+  expectSameTokens("* ** - -> = == ! != < <= > >= & && | || and or andy orx % ~ ^ @ : , ( ) [ ] { }\n");
+  expectSameTokens("\"str\" \"\" \"multi\nline\" x\n");
+  expectSameTokens("//! doc\n//! more\ninterface Foo\n  # plain\n  #! doc fn\n  fn f()\nend\n");
+  expectSameTokens("//! doc lost\n\n\nfn f()\n");
+  expectSameTokens("// comment\r\nfn\r\n\t  fn\n\rx\n");
+  expectSameTokens("Vec Map Tuple true false package from import object struct end const sig prop at for if typedef enum\n");
+  expectSameTokens("Vecx Map2 Tuple.a truefalse\n");
+  expectSameTokens("a / b // c\nd");
+  expectSameTokens("x $ y");
+  expectSameTokens("x \"unterminated");
+  expectSameTokens("x\ry");
+}
+
+TEST(QiLangLexer, CommentsAreAttachedToKeywords)
+{
+  qilang::StringVector toks = tokens("//! the doc\nfn f()\n", qilang::LexerType_HandWritten);
+  ASSERT_EQ(4u, toks.size());
+  EXPECT_NE(std::string::npos, toks.at(0).find("' the doc\n'"));
+  toks = tokens("x $", qilang::LexerType_HandWritten);
+  ASSERT_EQ(2u, toks.size());
+  EXPECT_NE(std::string::npos, toks.at(1).find("invalid token '$'"));
+}
+
+TEST(QiLangLexer, ParseKeepsDocComments)
+{
+  const char* idl =
+      "package foo\n"
+      "//! iface doc\n"
+      "interface Foo\n"
+      "  //! fn doc\n"
+      "  fn f(a: int, b: Vec<str>) -> Map<str, float>\n"
+      "  sig s(x: Tuple<int, str>)\n"
+      "end\n";
+  std::stringstream ss(idl);
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(&ss, "memory.idl.qi"));
+  ASSERT_FALSE(pr->hasError());
+  ASSERT_EQ(2u, pr->ast.size());
+  EXPECT_EQ(" iface doc\n", pr->ast.at(1)->comment());
+}
+
+static qilang::LiteralNodePtr constValue(const qilang::ParseResultPtr& pr, unsigned index)
+{
+  return static_cast<qilang::ConstDeclNode*>(pr->ast.at(index).get())->data;
+}
+
+TEST(QiLangLexer, NumericLiterals)
+{
+  const char* idl =
+      "const big = 18446744073709551615\n"
+      "const pi = 3.141592653589793\n"
+      "const tiny = 4.9e-324\n"
+      "const many = 123456789012345678901234.5\n";
+  expectSameTokens(idl);
+  std::stringstream ss(idl);
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(&ss, "memory.idl.qi"));
+  ASSERT_FALSE(pr->hasError());
+  ASSERT_EQ(4u, pr->ast.size());
+  EXPECT_EQ(std::numeric_limits<qi::uint64_t>::max(),
+            static_cast<qilang::IntLiteralNode*>(constValue(pr, 0).get())->value);
+  EXPECT_EQ(3.141592653589793, static_cast<qilang::FloatLiteralNode*>(constValue(pr, 1).get())->value);
+  EXPECT_EQ(std::strtod("4.9e-324", 0), static_cast<qilang::FloatLiteralNode*>(constValue(pr, 2).get())->value);
+  EXPECT_EQ(std::strtod("123456789012345678901234.5", 0),
+            static_cast<qilang::FloatLiteralNode*>(constValue(pr, 3).get())->value);
+}
+
+TEST(QiLangLexer, NumericLiteralsOutOfRange)
+{
+  expectSameTokens("const a = 18446744073709551616\n");
+  expectSameTokens("const a = 1e309\n");
+
+  qilang::StringVector toks = tokens("const a = 18446744073709551616\n", qilang::LexerType_HandWritten);
+  ASSERT_EQ(4u, toks.size());
+  EXPECT_NE(std::string::npos, toks.at(3).find("integer constant out of range"));
+  toks = tokens("const a = 1.5e309\n", qilang::LexerType_HandWritten);
+  ASSERT_EQ(4u, toks.size());
+  EXPECT_NE(std::string::npos, toks.at(3).find("float constant out of range"));
+
+  std::stringstream ss("const a = 99999999999999999999\n");
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(&ss, "memory.idl.qi"), false);
+  ASSERT_TRUE(pr->hasError());
+  EXPECT_EQ(std::string("integer constant out of range"), pr->messages().at(0).what());
+  EXPECT_EQ(11, pr->messages().at(0).loc().beg_column);
+}
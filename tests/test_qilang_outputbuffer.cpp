@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <qilang/outputbuffer.hpp>
+
+//what a std::stringstream would hold, written the same way
+static std::string expected(unsigned lines)
+{
+  std::stringstream ss;
+  for (unsigned i = 0; i < lines; ++i)
+    ss << std::string(i % 7, ' ') << "line " << i << std::endl;
+  return ss.str();
+}
+
+TEST(QiLangOutputBuffer, WritesAcrossChunks)
+{
+  qilang::OutputStream out;
+  EXPECT_EQ(0u, out.size());
+  EXPECT_EQ("", out.str());
+
+  const unsigned lines = 20000;
+  for (unsigned i = 0; i < lines; ++i)
+    out.repeat(' ', i % 7) << "line " << i << std::endl;
+  //one write larger than a chunk
+  std::string big(3 * qilang::OutputBuffer::MaxChunkSize, 'x');
+  out << big;
+
+  std::string all = expected(lines) + big;
+  EXPECT_EQ(all.size(), out.size());
+  EXPECT_EQ(all, out.str());
+
+  std::stringstream copy;
+  EXPECT_TRUE(out.buffer().writeTo(copy));
+  EXPECT_EQ(all, copy.str());
+
+  std::stringstream same(all);
+  EXPECT_TRUE(out.buffer().equals(same));
+  std::stringstream longer(all + "more");
+  EXPECT_FALSE(out.buffer().equals(longer));
+  std::stringstream shorter(all.substr(0, all.size() - 1));
+  EXPECT_FALSE(out.buffer().equals(shorter));
+  all[all.size() / 2] = '#';
+  std::stringstream different(all);
+  EXPECT_FALSE(out.buffer().equals(different));
+
+  out.buffer().clear();
+  EXPECT_EQ(0u, out.size());
+  out << "again";
+  EXPECT_EQ("again", out.str());
+}
+
+TEST(QiLangOutputBuffer, Splice)
+{
+  qilang::OutputStream out;
+  out << "head\n";
+
+  //small: copied
+  qilang::OutputStream small;
+  small << "small\n";
+  out.splice(small);
+  EXPECT_EQ(0u, small.size());
+
+  //large: its chunks are moved
+  qilang::OutputStream large;
+  const unsigned lines = 20000;
+  for (unsigned i = 0; i < lines; ++i)
+    large.repeat(' ', i % 7) << "line " << i << std::endl;
+  out.splice(large);
+  EXPECT_EQ(0u, large.size());
+  out << "tail\n";
+  large << "reused";
+
+  EXPECT_EQ("head\nsmall\n" + expected(lines) + "tail\n", out.str());
+  EXPECT_EQ("reused", large.str());
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include <ctime>
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <qilang/outputcache.hpp>
+#include "tmpdir_fixture.hpp"
+
+namespace fs = boost::filesystem;
+
+class QiLangOutputCache: public TmpDirFixture
+{
+protected:
+  QiLangOutputCache()
+    : TmpDirFixture("test_qilang_outputcache")
+  {}
+
+  void SetUp() override
+  {
+    TmpDirFixture::SetUp();
+    _cacheDir = (fs::path(_dir) / "cache").string();
+    _input = write("build1/app/app.idl.qi", "package app\nfrom lib import S\n");
+    _lib = write("build1/lib/lib.idl.qi", "package lib\nstruct S\n  x : int\nend\n");
+  }
+
+  //a cache used from a build directory
+  boost::shared_ptr<qilang::OutputCache> cache(const std::string& build, qi::uint64_t maxSize = qilang::OutputCache::DefaultMaxSize)
+  {
+    boost::shared_ptr<qilang::OutputCache> ret(new qilang::OutputCache(_cacheDir, maxSize));
+    ret->setBaseDirs(qilang::StringVector(1, (fs::path(_dir) / build).string()));
+    return ret;
+  }
+
+  qilang::StringVector parts() const
+  {
+    qilang::StringVector ret;
+    ret.push_back("qicc test");
+    ret.push_back("cpp_interface");
+    return ret;
+  }
+
+  qilang::OutputCache::Result result(const std::string& input, const std::string& lib) const
+  {
+    qilang::OutputCache::Result ret;
+    ret.outputs.push_back("// interface\n");
+    ret.outputs.push_back(std::string("binary\0data", 11));
+    ret.files.push_back(input);
+    ret.files.push_back(lib);
+    return ret;
+  }
+
+  std::string _cacheDir;
+  std::string _input;
+  std::string _lib;
+};
+
+TEST_F(QiLangOutputCache, StoreAndLookup)
+{
+  boost::shared_ptr<qilang::OutputCache> cache = this->cache("build1");
+  std::string key = cache->runKey(parts(), qilang::StringVector(1, _input));
+  ASSERT_FALSE(key.empty());
+
+  qilang::OutputCache::Result found;
+  EXPECT_FALSE(cache->lookup(key, &found));
+  ASSERT_TRUE(cache->store(key, result(_input, _lib)));
+  ASSERT_TRUE(cache->lookup(key, &found));
+  ASSERT_EQ(2u, found.outputs.size());
+  EXPECT_EQ("// interface\n", found.outputs[0]);
+  EXPECT_EQ(std::string("binary\0data", 11), found.outputs[1]);
+  ASSERT_EQ(2u, found.files.size());
+  EXPECT_EQ(_lib, found.files[1]);
+
+  //another codegen is another run
+  qilang::StringVector other = parts();
+  other.push_back("cpp_local");
+  EXPECT_FALSE(cache->lookup(cache->runKey(other, qilang::StringVector(1, _input)), &found));
+
+  qilang::OutputCache::Stats stats = cache->stats();
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_EQ(2u, stats.misses);
+  EXPECT_EQ(1u, stats.stores);
+  EXPECT_LT(0u, stats.size);
+}
+
+TEST_F(QiLangOutputCache, ImportedFilesInvalidate)
+{
+  boost::shared_ptr<qilang::OutputCache> cache = this->cache("build1");
+  std::string key = cache->runKey(parts(), qilang::StringVector(1, _input));
+  ASSERT_TRUE(cache->store(key, result(_input, _lib)));
+
+  qilang::OutputCache::Result found;
+  write("build1/lib/lib.idl.qi", "package lib\nstruct S\n  y : int\nend\n");
+  EXPECT_FALSE(cache->lookup(key, &found));
+  ASSERT_TRUE(cache->store(key, result(_input, _lib)));
+  EXPECT_TRUE(cache->lookup(key, &found));
+
+  //a new file of an imported package may export what the input uses
+  write("build1/lib/more.idl.qi", "package lib\nstruct T\n  y : int\nend\n");
+  EXPECT_FALSE(cache->lookup(key, &found));
+}
+
+TEST_F(QiLangOutputCache, SharedBetweenBuildDirectories)
+{
+  boost::shared_ptr<qilang::OutputCache> cache1 = cache("build1");
+  std::string key = cache1->runKey(parts(), qilang::StringVector(1, _input));
+  ASSERT_TRUE(cache1->store(key, result(_input, _lib)));
+
+  //the same sources in another build directory: the same run
+  std::string input2 = write("build2/app/app.idl.qi", "package app\nfrom lib import S\n");
+  std::string lib2   = write("build2/lib/lib.idl.qi", "package lib\nstruct S\n  x : int\nend\n");
+  boost::shared_ptr<qilang::OutputCache> cache2 = cache("build2");
+  std::string key2 = cache2->runKey(parts(), qilang::StringVector(1, input2));
+  EXPECT_EQ(key, key2);
+  qilang::OutputCache::Result found;
+  ASSERT_TRUE(cache2->lookup(key2, &found));
+  ASSERT_EQ(2u, found.files.size());
+  EXPECT_EQ(lib2, found.files[1]);
+
+  //an imported package that differs in a build directory
+  write("build2/lib/lib.idl.qi", "package lib\nstruct S\n  y : int\nend\n");
+  EXPECT_FALSE(cache2->lookup(key2, &found));
+  qilang::OutputCache::Result other = result(input2, lib2);
+  other.outputs[0] = "// other interface\n";
+  ASSERT_TRUE(cache2->store(key2, other));
+  ASSERT_TRUE(cache2->lookup(key2, &found));
+  EXPECT_EQ("// other interface\n", found.outputs[0]);
+  ASSERT_TRUE(cache1->lookup(key, &found));
+  EXPECT_EQ("// interface\n", found.outputs[0]);
+  EXPECT_EQ(_lib, found.files[1]);
+
+  //outputs are stored by content, once
+  qilang::OutputCache::Stats stats = cache1->stats();
+  ASSERT_TRUE(cache1->store(key, result(_input, _lib)));
+  EXPECT_EQ(stats.size, cache1->stats().size);
+}
+
+TEST_F(QiLangOutputCache, EvictLeastRecentlyUsed)
+{
+  boost::shared_ptr<qilang::OutputCache> cache = this->cache("build1", 1000);
+  qilang::StringVector keys;
+  for (unsigned i = 0; i < 3; ++i) {
+    qilang::StringVector p = parts();
+    p.push_back(std::string(1, 'a' + i));
+    keys.push_back(cache->runKey(p, qilang::StringVector(1, _input)));
+    qilang::OutputCache::Result r = result(_input, _lib);
+    r.outputs[0] = std::string(300, 'a' + i);
+    ASSERT_TRUE(cache->store(keys.back(), r));
+    //least recently used: by modification time, make them older in order
+    for (fs::recursive_directory_iterator it(_cacheDir), end; it != end; ++it) {
+      if (fs::is_regular_file(it->status()))
+        fs::last_write_time(it->path(), fs::last_write_time(it->path()) - 10);
+    }
+  }
+
+  qilang::OutputCache::Result found;
+  EXPECT_FALSE(cache->lookup(keys[0], &found));
+  EXPECT_TRUE(cache->lookup(keys[2], &found));
+  EXPECT_LT(0u, cache->stats().evictions);
+  EXPECT_GE(1000u, cache->stats().size);
+
+  EXPECT_TRUE(cache->clear());
+  EXPECT_FALSE(cache->lookup(keys[2], &found));
+  EXPECT_EQ(0u, cache->stats().size);
+}
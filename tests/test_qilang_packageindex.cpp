@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <ctime>
+#include <boost/filesystem.hpp>
+#include <qilang/packageindex.hpp>
+#include <qilang/packagemanager.hpp>
+#include "tmpdir_fixture.hpp"
+
+namespace fs = boost::filesystem;
+
+class QiLangPackageIndex: public TmpDirFixture
+{
+protected:
+  QiLangPackageIndex()
+    : TmpDirFixture("test_qilang_packageindex")
+  {}
+
+  void SetUp() override
+  {
+    TmpDirFixture::SetUp();
+    _root = (fs::path(_dir) / "share/qi/idl").string();
+    write("foo/a.idl.qi", "package foo\n");
+    write("foo/b.idl.qi", "package foo\n");
+    write("foo/notes.txt", "not an idl\n");
+    write("foo/sub/c.idl.qi", "package foo.sub\n");
+    write("foo.bar/d.idl.qi", "package foo\n");
+    write("foobar/e.idl.qi", "package foobar\n");
+  }
+
+  //move the tree in the past, an index does not trust entries of the second it was written in
+  void age(std::time_t delta = 100)
+  {
+    std::time_t past = std::time(0) - delta;
+    for (fs::recursive_directory_iterator it(_root), end; it != end; ++it)
+      fs::last_write_time(it->path(), past);
+    fs::last_write_time(_root, past);
+  }
+
+  std::vector<std::string> locate(bool useIndex, const std::string& pkg)
+  {
+    qilang::PackageManagerPtr pm = qilang::newPackageManager();
+    pm->addLookupPaths(qilang::StringVector(1, _dir));
+    pm->setUsePackageIndexes(useIndex);
+    return pm->locatePackage(pkg);
+  }
+};
+
+TEST_F(QiLangPackageIndex, SaveAndLoad)
+{
+  age();
+  ASSERT_TRUE(qilang::writePackageIndex(_root));
+
+  qilang::PackageIndex index;
+  ASSERT_TRUE(index.load(_root));
+  const qilang::PackageIndex::EntryMap& entries = index.entries();
+  EXPECT_EQ(9u, entries.size());
+  EXPECT_TRUE(entries.at("foo/sub").dir);
+  EXPECT_FALSE(entries.at("foo/a.idl.qi").dir);
+  EXPECT_EQ(12u, entries.at("foo/a.idl.qi").size);
+  EXPECT_EQ(0u, entries.count("foo/notes.txt"));
+
+  std::vector<std::string> files;
+  ASSERT_TRUE(index.locate("foo", &files));
+  ASSERT_EQ(3u, files.size());
+  EXPECT_EQ("foo/a.idl.qi", files[0]);
+  EXPECT_EQ("foo/b.idl.qi", files[1]);
+  EXPECT_EQ("foo/sub/c.idl.qi", files[2]);
+}
+
+TEST_F(QiLangPackageIndex, LocateSameFilesAsWalk)
+{
+  age();
+  ASSERT_TRUE(qilang::writePackageIndex(_root));
+
+  EXPECT_EQ(3u, locate(true, "foo").size());
+  EXPECT_EQ(locate(false, "foo"), locate(true, "foo"));
+  EXPECT_EQ(locate(false, "foo.sub"), locate(true, "foo.sub"));
+  EXPECT_EQ(locate(false, "foobar"), locate(true, "foobar"));
+  EXPECT_TRUE(locate(true, "nothere").empty());
+}
+
+TEST_F(QiLangPackageIndex, StaleIndexFallsBackToWalk)
+{
+  age();
+  ASSERT_TRUE(qilang::writePackageIndex(_root));
+  qilang::PackageIndex index;
+  ASSERT_TRUE(index.load(_root));
+
+  write("foo/sub/new.idl.qi", "package foo.sub\n");
+  write("baz/f.idl.qi", "package baz\n");
+
+  std::vector<std::string> files;
+  EXPECT_FALSE(index.locate("foo", &files));
+  EXPECT_FALSE(index.locate("baz", &files));
+  EXPECT_TRUE(index.locate("foobar", &files));
+  EXPECT_TRUE(index.locate("nothere", &files));
+  EXPECT_EQ(1u, files.size());
+
+  EXPECT_EQ(4u, locate(true, "foo").size());
+  EXPECT_EQ(1u, locate(true, "baz").size());
+}
+
+TEST_F(QiLangPackageIndex, RecentEntriesAreNotTrusted)
+{
+  ASSERT_TRUE(qilang::writePackageIndex(_root));
+  qilang::PackageIndex index;
+  ASSERT_TRUE(index.load(_root));
+
+  std::vector<std::string> files;
+  EXPECT_FALSE(index.locate("foo", &files));
+  EXPECT_EQ(locate(false, "foo"), locate(true, "foo"));
+}
+
+TEST_F(QiLangPackageIndex, MissingOrMalformedIndex)
+{
+  qilang::PackageIndex index;
+  std::string error;
+  EXPECT_FALSE(index.load(_root, &error));
+  EXPECT_FALSE(error.empty());
+
+  write(qilang::PackageIndexFileName, "qilang-package-index 1 0\nx 12 foo\n");
+  EXPECT_FALSE(index.load(_root));
+  write(qilang::PackageIndexFileName, "qilang-package-index 999 0\n");
+  EXPECT_FALSE(index.load(_root));
+  EXPECT_EQ(3u, locate(true, "foo").size());
+}
@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include <ctime>
+#include <boost/filesystem.hpp>
+#include <qilang/packagesummary.hpp>
+#include <qilang/packagemanager.hpp>
+#include "tmpdir_fixture.hpp"
+
+namespace fs = boost::filesystem;
+
+class QiLangPackageSummary: public TmpDirFixture
+{
+protected:
+  QiLangPackageSummary()
+    : TmpDirFixture("test_qilang_packagesummary")
+  {}
+
+  void SetUp() override
+  {
+    TmpDirFixture::SetUp();
+    _root = (fs::path(_dir) / "share/qi/idl").string();
+    write("lib/a.idl.qi",
+          "package lib\n"
+          "from dep import D\n"
+          "struct S\n"
+          "  x : D\n"
+          "end\n"
+          "const answer = 42\n");
+    write("lib/b.idl.qi",
+          "package lib\n"
+          "interface I\n"
+          "  fn f(s: S) -> int\n"
+          "end\n"
+          "enum E\n"
+          "  const A = 1\n"
+          "end\n");
+    write("lib/sub/c.idl.qi", "package lib.sub\nstruct C\n  y : int\nend\n");
+    write("dep/d.idl.qi", "package dep\nstruct D\n  z : int\nend\n");
+    write("app/app.idl.qi",
+          "package app\n"
+          "from lib import S, I, E\n"
+          "interface App\n"
+          "  fn g(s: S, e: E) -> I\n"
+          "end\n");
+  }
+
+  qilang::PackageManagerPtr analyse(bool useSummaries, unsigned int jobs = 1)
+  {
+    qilang::PackageManagerPtr pm = qilang::newPackageManager();
+    pm->setJobs(jobs);
+    pm->addLookupPaths(qilang::StringVector(1, _dir));
+    pm->setUseAstFiles(false);
+    pm->setUsePackageSummaries(useSummaries);
+    pm->parseFile(qilang::newFileReader(_root + "/app/app.idl.qi"));
+    pm->anal();
+    return pm;
+  }
+
+  static bool summarized(const qilang::PackagePtr& pkg)
+  {
+    for (qilang::ParseResultMap::const_iterator it = pkg->_contents.begin(); it != pkg->_contents.end(); ++it) {
+      if (!it->second->summary)
+        return false;
+    }
+    return !pkg->_contents.empty();
+  }
+};
+
+TEST_F(QiLangPackageSummary, SaveAndLoad)
+{
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+
+  qilang::PackageSummary summary;
+  ASSERT_TRUE(summary.load(_root + "/lib"));
+  EXPECT_EQ("lib", summary.package());
+  ASSERT_EQ(2u, summary.files().size());
+  const qilang::PackageSummary::File& a = summary.files()[0];
+  EXPECT_EQ("a.idl.qi", a.name);
+  ASSERT_EQ(3u, a.decls.size());
+  EXPECT_EQ(qilang::NodeType_Import, a.decls[0].type);
+  EXPECT_EQ("dep", a.decls[0].name);
+  ASSERT_EQ(1u, a.decls[0].imports.size());
+  EXPECT_EQ("D", a.decls[0].imports[0]);
+  EXPECT_EQ(qilang::NodeType_StructDecl, a.decls[1].type);
+  EXPECT_EQ("S", a.decls[1].name);
+  EXPECT_EQ(3, a.decls[1].line);
+  EXPECT_EQ(qilang::NodeType_ConstDecl, a.decls[2].type);
+  EXPECT_EQ(2u, summary.files()[1].decls.size());
+
+  //subpackages have their own summary
+  ASSERT_TRUE(summary.load(_root + "/lib/sub"));
+  EXPECT_EQ("lib.sub", summary.package());
+}
+
+TEST_F(QiLangPackageSummary, ImportFromSummaries)
+{
+  qilang::PackageManagerPtr parsed = analyse(false);
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+  qilang::PackageManagerPtr pm = analyse(true);
+
+  EXPECT_FALSE(pm->hasError());
+  EXPECT_TRUE(summarized(pm->package("lib")));
+  EXPECT_TRUE(summarized(pm->package("dep")));
+  //the package being compiled is parsed
+  EXPECT_FALSE(summarized(pm->package("app")));
+  EXPECT_EQ(parsed->package("lib")->exportsHash(), pm->package("lib")->exportsHash());
+  EXPECT_EQ(parsed->package("lib")->importsHash(), pm->package("lib")->importsHash());
+  EXPECT_EQ(parsed->package("lib")->fileFromExport(qilang::Symbol("E")),
+            pm->package("lib")->fileFromExport(qilang::Symbol("E")));
+  //the files of subpackages are not parsed along with their parent anymore
+  EXPECT_NE(qilang::PackageGraph::NoIndex, parsed->graph().find("lib.sub"));
+  EXPECT_EQ(qilang::PackageGraph::NoIndex, pm->graph().find("lib.sub"));
+
+  const qilang::ParseResultPtr& app = pm->package("app")->_contents.begin()->second;
+  const qilang::NodePtrVector& customs = app->nodes(qilang::NodeType_CustomTypeExpr);
+  ASSERT_EQ(3u, customs.size());
+  for (unsigned i = 0; i < customs.size(); ++i)
+    EXPECT_EQ(qilang::Symbol("lib"), static_cast<qilang::CustomTypeExprNode*>(customs.at(i).get())->resolved_package);
+}
+
+TEST_F(QiLangPackageSummary, ImportFromSummariesWithJobs)
+{
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+  //the imported packages are not prefetched from their sources
+  qilang::PackageManagerPtr pm = analyse(true, 4);
+  EXPECT_FALSE(pm->hasError());
+  EXPECT_TRUE(summarized(pm->package("lib")));
+  EXPECT_TRUE(summarized(pm->package("dep")));
+  EXPECT_FALSE(summarized(pm->package("app")));
+}
+
+TEST_F(QiLangPackageSummary, OutOfDateSummaryFallsBackToSources)
+{
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+  write("lib/b.idl.qi", "package lib\ninterface I\nend\nenum E\n  const A = 1\nend\nstruct S2\n  x : int\nend\n");
+  qilang::PackageManagerPtr pm = analyse(true);
+  EXPECT_FALSE(summarized(pm->package("lib")));
+  EXPECT_TRUE(pm->package("lib")->getExport(qilang::Symbol("S2")));
+
+  //a new file is not in the summary either
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+  write("dep/e.idl.qi", "package dep\nstruct D2\n  z : int\nend\n");
+  pm = analyse(true);
+  EXPECT_TRUE(summarized(pm->package("lib")));
+  EXPECT_FALSE(summarized(pm->package("dep")));
+  EXPECT_FALSE(pm->hasError());
+}
+
+TEST_F(QiLangPackageSummary, StampsOfTheFiles)
+{
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+  qilang::PackageSummary summary;
+  ASSERT_TRUE(summary.load(_root + "/dep"));
+  qilang::StringVector files(1, _root + "/dep/d.idl.qi");
+  EXPECT_TRUE(summary.matches(files));
+
+  //touched: hashed again, the content is the same
+  fs::last_write_time(files[0], std::time(0) - 100);
+  EXPECT_TRUE(summary.matches(files));
+
+  //same size, in the second of the summary: hashed too
+  write("dep/d.idl.qi", "package dep\nstruct D\n  w : int\nend\n");
+  EXPECT_FALSE(summary.matches(files));
+}
+
+TEST_F(QiLangPackageSummary, UpToDateSummariesAreKept)
+{
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+  fs::path lib = fs::path(_root) / "lib" / qilang::PackageSummaryFileName;
+  fs::path dep = fs::path(_root) / "dep" / qilang::PackageSummaryFileName;
+  std::time_t past = std::time(0) - 100;
+  fs::last_write_time(lib, past);
+  fs::last_write_time(dep, past);
+
+  write("dep/d.idl.qi", "package dep\nstruct D\n  z : int\n  w : int\nend\n");
+  ASSERT_TRUE(qilang::writePackageSummaries(_root));
+  EXPECT_EQ(past, fs::last_write_time(lib));
+  EXPECT_NE(past, fs::last_write_time(dep));
+}
+
+TEST_F(QiLangPackageSummary, MalformedSummary)
+{
+  write(qilang::PackageSummaryFileName, "qilang-package-summary 2 0 lib\ne 1 1 9 S\n");
+  qilang::PackageSummary summary;
+  std::string error;
+  EXPECT_FALSE(summary.load(_root, &error));
+  EXPECT_FALSE(error.empty());
+  write(qilang::PackageSummaryFileName, "qilang-package-summary 999 lib\n");
+  EXPECT_FALSE(summary.load(_root));
+  EXPECT_FALSE(summary.load(_root + "/nothere"));
+}
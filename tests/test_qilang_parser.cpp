@@ -0,0 +1,525 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <qilang/parser.hpp>
+#include <qilang/formatter.hpp>
+#include <qilang/sourcemanager.hpp>
+#include <qilang/packagemanager.hpp>
+#include <qilang/visitor.hpp>
+#include "tmpdir_fixture.hpp"
+
+static const char* someIdl =
+    "package foo\n"
+    "\n"
+    "//! a doc\n"
+    "interface Bar\n"
+    "  fn baz(a: int, b: Vec<str>) -> float\n"
+    "  sig changed(v: int)\n"
+    "end\n"
+    "\n"
+    "struct Point\n"
+    "  x, y : float\n"
+    "end\n"
+    "const answer = 42\n";
+
+class QiLangParser: public TmpDirFixture
+{
+protected:
+  QiLangParser()
+    : TmpDirFixture("test_qilang_parser")
+  {}
+};
+
+TEST_F(QiLangParser, BufferedAndStreamReadersGiveSameAST)
+{
+  std::string path = write("foo.idl.qi", someIdl);
+
+  qilang::FileReaderPtr buffered = qilang::newFileReader(path);
+  ASSERT_TRUE(buffered->isOpen());
+  ASSERT_TRUE(buffered->isBuffered());
+  EXPECT_THROW(buffered->in(), std::runtime_error);
+  qilang::ParseResultPtr prb = qilang::parse(buffered);
+
+  std::stringstream ss(someIdl);
+  qilang::FileReaderPtr stream = qilang::newFileReader(&ss, path);
+  ASSERT_FALSE(stream->isBuffered());
+  qilang::ParseResultPtr prs = qilang::parse(stream);
+
+  ASSERT_FALSE(prb->hasError());
+  ASSERT_FALSE(prs->hasError());
+  ASSERT_EQ(4u, prb->ast.size());
+  EXPECT_EQ(qilang::formatAST(prs->ast), qilang::formatAST(prb->ast));
+}
+
+TEST_F(QiLangParser, EmptyFile)
+{
+  std::string path = write("empty.idl.qi", "");
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(path));
+  EXPECT_FALSE(pr->hasError());
+  EXPECT_TRUE(pr->ast.empty());
+}
+
+TEST_F(QiLangParser, MissingFile)
+{
+  qilang::FileReaderPtr file = qilang::newFileReader(_dir + "/nothere.idl.qi");
+  EXPECT_FALSE(file->isOpen());
+  qilang::ParseResultPtr pr = qilang::parse(file);
+  EXPECT_TRUE(pr->hasError());
+}
+
+TEST_F(QiLangParser, DiagnosticFromMemoryStream)
+{
+  std::stringstream ss("package foo\n\nstruct Bar\n  x : int\n  ) y\nend\n");
+  //the file does not exist on disk: the line must come from the stream content
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader(&ss, _dir + "/memory.idl.qi"));
+  ASSERT_TRUE(pr->hasError());
+
+  std::stringstream out;
+  pr->messages().at(0).print(out);
+  EXPECT_NE(std::string::npos, out.str().find("\n  ) y\n  ^"));
+}
+
+TEST_F(QiLangParser, DiagnosticLineFromItsOwnSource)
+{
+  std::string path = _dir + "/twice.idl.qi";
+  qilang::ParseResultPtr first = qilang::parse(qilang::newFileReader(path, "package foo\n  ) first\n"), false);
+  ASSERT_TRUE(first->hasError());
+  //the same file parsed again with another content replaces it in the SourceManager
+  qilang::parse(qilang::newFileReader(path, "package foo\n  ) second\n"), false);
+
+  std::stringstream out;
+  first->printMessage(out);
+  EXPECT_NE(std::string::npos, out.str().find("\n  ) first\n"));
+}
+
+TEST_F(QiLangParser, SourcesLiveWithTheirParseResults)
+{
+  std::string path = write("share/qi/idl/foo/foo.idl.qi", "package foo\n");
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->parseFile(qilang::newFileReader(path, "package foo\nstruct Unsaved\nend\n"));
+  qilang::Symbol file(path);
+  ASSERT_TRUE(qilang::SourceManager::instance().source(file));
+  EXPECT_NE(std::string::npos, qilang::SourceManager::instance().source(file)->content().find("Unsaved"));
+
+  //another package manager parses its own content of the file, and goes
+  qilang::PackageManagerPtr other = qilang::newPackageManager();
+  other->parseFile(qilang::newFileReader(path, "package foo\nstruct Other\nend\n"));
+  other.reset();
+  qilang::ParseResultPtr pr = pm->parseResult(path);
+  ASSERT_TRUE(pr && pr->source);
+  EXPECT_NE(std::string::npos, pr->source->content().find("Unsaved"));
+
+  //removed: nothing uses the content anymore, it is loaded from the disk again
+  pr.reset();
+  pm->removeFile(path);
+  ASSERT_TRUE(qilang::SourceManager::instance().source(file));
+  EXPECT_EQ("package foo\n", qilang::SourceManager::instance().source(file)->content());
+}
+
+TEST(QiLangSourceBuffer, Lines)
+{
+  const std::string content = "a\nbc\r\n\nlast";
+  qilang::SourceBuffer buf(content.data(), content.size());
+  const char* b;
+  std::size_t n;
+
+  ASSERT_EQ(4u, buf.lineCount());
+  ASSERT_TRUE(buf.line(2, &b, &n));
+  EXPECT_EQ("bc", std::string(b, n));
+  ASSERT_TRUE(buf.line(3, &b, &n));
+  EXPECT_EQ("", std::string(b, n));
+  ASSERT_TRUE(buf.line(4, &b, &n));
+  EXPECT_EQ("last", std::string(b, n));
+  EXPECT_FALSE(buf.line(0, &b, &n));
+  EXPECT_FALSE(buf.line(5, &b, &n));
+
+  qilang::SourceBuffer empty("", 0);
+  EXPECT_EQ(0u, empty.lineCount());
+  EXPECT_FALSE(empty.line(1, &b, &n));
+}
+
+static std::string dumpPackage(const qilang::PackageManagerPtr& pm, const std::string& name)
+{
+  std::string ret;
+  qilang::PackagePtr pkg = pm->package(name);
+  for (qilang::ParseResultMap::const_iterator it = pkg->_contents.begin(); it != pkg->_contents.end(); ++it)
+    ret += it->first + "\n" + qilang::formatAST(it->second->ast);
+  return ret;
+}
+
+TEST_F(QiLangParser, ParallelParseDirIsDeterministic)
+{
+  for (int i = 0; i < 12; ++i) {
+    std::stringstream name;
+    std::stringstream content;
+    name << "foo/file" << i << ".idl.qi";
+    content << "package foo\ninterface Iface" << i << "\n  fn f(a: int) -> str\nend\n";
+    write(name.str(), content.str());
+  }
+
+  qilang::PackageManagerPtr serial = qilang::newPackageManager();
+  serial->parseDir(_dir + "/foo");
+  qilang::PackageManagerPtr parallel = qilang::newPackageManager();
+  parallel->setJobs(4);
+  parallel->parseDir(_dir + "/foo");
+
+  EXPECT_FALSE(parallel->hasError());
+  EXPECT_EQ(12u, parallel->package("foo")->_contents.size());
+  EXPECT_EQ(dumpPackage(serial, "foo"), dumpPackage(parallel, "foo"));
+}
+
+TEST_F(QiLangParser, ResolveTypesOncePerPackage)
+{
+  write("share/qi/idl/bar/bar.idl.qi", "package bar\nstruct B1\n  y : int\nend\n");
+  write("share/qi/idl/foo/a.idl.qi", "package foo\nstruct S1\n  x : int\nend\nconst notype = 1\n");
+  write("share/qi/idl/foo/b.idl.qi",
+            "package foo\n"
+            "from bar import *\n"
+            "interface I\n"
+            "  fn f(a: S1, b: S1, c: S1) -> S1\n"
+            "  fn g(a: Missing, b: Missing) -> B1\n"
+            "  fn h(a: notype) -> bar.B1\n"
+            "end\n");
+
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, _dir));
+  pm->parseDir(_dir + "/share/qi/idl/foo");
+  pm->anal("foo");
+
+  qilang::PackagePtr foo = pm->package("foo");
+  EXPECT_EQ(5u, foo->_resolutions.size());
+  const qilang::ResolutionResult& s1 = foo->_resolutions.at(qilang::Symbol("S1"));
+  EXPECT_TRUE(s1.resolved());
+  EXPECT_EQ(qilang::Symbol("foo"), s1.pkg);
+  EXPECT_EQ(qilang::TypeKind_Struct, s1.kind);
+  EXPECT_EQ(qilang::Symbol("bar"), foo->_resolutions.at(qilang::Symbol("B1")).pkg);
+  EXPECT_EQ(qilang::Symbol("B1"), foo->_resolutions.at(qilang::Symbol("bar.B1")).type);
+  EXPECT_EQ(qilang::ResolutionStatus_NotFound, foo->_resolutions.at(qilang::Symbol("Missing")).status);
+  EXPECT_EQ(qilang::ResolutionStatus_NotAType, foo->_resolutions.at(qilang::Symbol("notype")).status);
+
+  //each use of an unknown name is reported at its location
+  qilang::ParseResultPtr b = foo->_contents.begin()->second;
+  for (qilang::ParseResultMap::const_iterator it = foo->_contents.begin(); it != foo->_contents.end(); ++it) {
+    if (it->second->hasError())
+      b = it->second;
+  }
+  unsigned missing = 0;
+  for (unsigned i = 0; i < b->messages().size(); ++i) {
+    if (std::string(b->messages().at(i).what()) == "Can't find 'Missing' in package 'bar'")
+      ++missing;
+  }
+  EXPECT_EQ(2u, missing);
+  EXPECT_EQ(6u, b->messages().size());
+}
+
+static std::string analyse(const std::string& dir, unsigned int jobs, qilang::PackageManagerPtr* ppm = 0)
+{
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, dir));
+  pm->setJobs(jobs);
+  pm->parseFile(qilang::newFileReader(dir + "/share/qi/idl/app/app.idl.qi"));
+  pm->anal();
+  if (ppm)
+    *ppm = pm;
+
+  std::stringstream ss;
+  const qilang::PackageGraph& graph = pm->graph();
+  qilang::PackageGraph::IndexVector order = graph.topologicalOrder();
+  for (unsigned i = 0; i < order.size(); ++i) {
+    qilang::PackagePtr pkg = pm->package(graph.name(order[i]));
+    ss << pkg->_name << std::endl;
+    pkg->printMessage(ss);
+    for (qilang::ParseResultMap::const_iterator it = pkg->_contents.begin(); it != pkg->_contents.end(); ++it) {
+      const qilang::NodePtrVector& customs = it->second->nodes(qilang::NodeType_CustomTypeExpr);
+      for (unsigned j = 0; j < customs.size(); ++j) {
+        qilang::CustomTypeExprNode* tnode = static_cast<qilang::CustomTypeExprNode*>(customs.at(j).get());
+        ss << "  " << tnode->value << " -> " << tnode->resolved_package << "." << tnode->resolved_value << std::endl;
+      }
+    }
+  }
+  return ss.str();
+}
+
+TEST_F(QiLangParser, AnalyseInDependencyOrder)
+{
+  boost::filesystem::path idl = boost::filesystem::path(_dir) / "share/qi/idl";
+  boost::filesystem::create_directories(idl / "app");
+  boost::filesystem::create_directories(idl / "lib");
+  boost::filesystem::create_directories(idl / "cyc/a");
+  boost::filesystem::create_directories(idl / "cyc/b");
+  write("share/qi/idl/lib/lib.idl.qi", "package lib\nstruct L\n  x : int\nend\n");
+  write("share/qi/idl/cyc/a/a.idl.qi", "package cyc.a\nfrom cyc.b import *\nstruct A\n  b : B\nend\n");
+  write("share/qi/idl/cyc/b/b.idl.qi", "package cyc.b\nfrom cyc.a import *\nstruct B\n  a : Vec<A>\nend\n");
+  write("share/qi/idl/app/app.idl.qi",
+            "package app\n"
+            "from lib import L\n"
+            "from cyc.a import A\n"
+            "interface I\n"
+            "  fn f(l: L) -> A\n"
+            "  fn g(m: Missing)\n"
+            "end\n");
+
+  qilang::PackageManagerPtr pm;
+  std::string serial = analyse(_dir, 1, &pm);
+  const qilang::PackageGraph& graph = pm->graph();
+  ASSERT_EQ(4u, graph.size());
+  qilang::PackageGraph::Index app = graph.find("app");
+  ASSERT_NE(qilang::PackageGraph::NoIndex, app);
+  ASSERT_EQ(2u, graph.imports(app).size());
+  EXPECT_EQ("cyc.a", graph.name(graph.imports(app)[0]));
+  EXPECT_EQ("lib", graph.name(graph.imports(app)[1]));
+  EXPECT_EQ(1u, graph.importedBy(graph.find("lib")).size());
+  //directly or not: cyc.b is imported by cyc.a, and through it by app and itself
+  qilang::PackageGraph::IndexVector importers = graph.importers(graph.find("cyc.b"));
+  ASSERT_EQ(3u, importers.size());
+  EXPECT_NE(importers.end(), std::find(importers.begin(), importers.end(), app));
+  EXPECT_TRUE(graph.importers(app).empty());
+
+  //dependencies first, the cycle is one component
+  std::vector<qilang::PackageGraph::IndexVector> components = graph.components();
+  ASSERT_EQ(3u, components.size());
+  ASSERT_EQ(2u, components[0].size());
+  EXPECT_EQ("cyc.a", graph.name(components[0][0]));
+  EXPECT_EQ("cyc.b", graph.name(components[0][1]));
+  EXPECT_EQ("lib", graph.name(components[1][0]));
+  EXPECT_EQ("app", graph.name(components[2][0]));
+  EXPECT_TRUE(graph.inCycle(graph.find("cyc.b")));
+  EXPECT_FALSE(graph.inCycle(app));
+  ASSERT_EQ(1u, graph.cycles().size());
+
+  //the cycle is a warning, reported once
+  std::stringstream cycle;
+  pm->package("cyc.a")->printMessage(cycle);
+  pm->package("cyc.b")->printMessage(cycle);
+  pm->anal();
+  pm->package("cyc.a")->printMessage(cycle);
+  EXPECT_NE(std::string::npos, cycle.str().find("warning: import cycle: cyc.a -> cyc.b -> cyc.a"));
+  EXPECT_EQ(1u, pm->package("cyc.a")->_contents.begin()->second->messages().size());
+  EXPECT_TRUE(pm->package("cyc.b")->_contents.begin()->second->messages().empty());
+  EXPECT_FALSE(pm->package("cyc.a")->hasError());
+  EXPECT_TRUE(pm->package("app")->hasError());
+
+  EXPECT_NE(std::string::npos, serial.find("  L -> lib.L\n"));
+  EXPECT_NE(std::string::npos, serial.find("  A -> cyc.a.A\n"));
+  EXPECT_NE(std::string::npos, serial.find("  B -> cyc.b.B\n"));
+  EXPECT_EQ(serial, analyse(_dir, 4));
+}
+
+TEST_F(QiLangParser, UnreadableImportIsReportedAsWithOneJob)
+{
+  write("share/qi/idl/lib/lib.idl.qi", "package lib\nstruct L\n  x : int\nend\n");
+  write("share/qi/idl/dep/dep.idl.qi", "package dep\nstruct D\n  y : int\nend\n");
+  //not a regular file: lib can't be parsed, dep still is
+  boost::filesystem::create_directories(boost::filesystem::path(_dir) / "share/qi/idl/lib/bad.idl.qi");
+  write("share/qi/idl/app/app.idl.qi",
+            "package app\n"
+            "from lib import L\n"
+            "from dep import D\n"
+            "interface I\n"
+            "  fn f(l: L) -> D\n"
+            "end\n");
+
+  qilang::PackageManagerPtr pm;
+  std::string serial = analyse(_dir, 1);
+  EXPECT_NE(std::string::npos, serial.find("  D -> dep.D\n"));
+  EXPECT_EQ(serial, analyse(_dir, 4, &pm));
+  EXPECT_TRUE(pm->package("app")->hasError());
+  EXPECT_TRUE(pm->package("lib")->_contents.empty());
+}
+
+//the outputs of every codegen for the file of app, one after the other
+static std::string generate(const std::string& dir, unsigned int jobs)
+{
+  qilang::PackageManagerPtr pm = qilang::newPackageManager();
+  pm->addLookupPaths(qilang::StringVector(1, dir));
+  pm->setJobs(jobs);
+  qilang::ParseResultPtr pr = pm->parseFile(qilang::newFileReader(dir + "/share/qi/idl/app/app.idl.qi"));
+  pm->anal();
+
+  std::string ret;
+  const char* codegens[] = { "qilang", "sexpr", "doc", "cpp_interface", "cpp_local", "cpp_remote" };
+  for (unsigned i = 0; i < sizeof(codegens) / sizeof(codegens[0]); ++i) {
+    std::stringstream ss;
+    EXPECT_TRUE(qilang::codegen(qilang::newFileWriter(&ss, "out"), codegens[i], pm, pr));
+    ret += std::string(codegens[i]) + ":\n" + ss.str();
+  }
+  //the files read, relative to the lookup path
+  qilang::StringVector files = pm->locatePackage("lib");
+  for (unsigned i = 0; i < files.size(); ++i)
+    ret += files.at(i).substr(dir.size()) + "\n";
+  return ret;
+}
+
+TEST_F(QiLangParser, GenerationDoesNotDependOnDiscoveryOrder)
+{
+  const char* names[] = { "zeta", "alpha", "mid", "beta", "omega", "gamma" };
+  const unsigned count = sizeof(names) / sizeof(names[0]);
+  //the same tree twice, its files created in opposite orders
+  for (unsigned tree = 0; tree < 2; ++tree) {
+    std::string root = tree ? "two" : "one";
+    for (unsigned n = 0; n < count; ++n) {
+      unsigned i = tree ? count - 1 - n : n;
+      std::stringstream content;
+      content << "package lib\nstruct " << names[i] << "S\n  x : int\nend\n"
+              << "interface " << names[i] << "I\n  fn f(s: " << names[i] << "S) -> int\nend\n";
+      write(root + "/share/qi/idl/lib/" + names[i] + ".idl.qi", content.str());
+    }
+    write(root + "/share/qi/idl/app/app.idl.qi",
+              "package app\n"
+              "from lib import *\n"
+              "interface App\n"
+              "  fn g(a: zetaS, b: alphaI, c: midS) -> gammaI\n"
+              "end\n");
+  }
+
+  std::string one = generate(_dir + "/one", 1);
+  EXPECT_NE(std::string::npos, one.find("/share/qi/idl/lib/alpha.idl.qi\n/share/qi/idl/lib/beta.idl.qi\n"));
+  EXPECT_EQ(one, generate(_dir + "/two", 1));
+  EXPECT_EQ(one, generate(_dir + "/two", 4));
+}
+
+TEST_F(QiLangParser, ReanalyseOnlyWhatChanged)
+{
+  boost::filesystem::path idl = boost::filesystem::path(_dir) / "share/qi/idl";
+  boost::filesystem::create_directories(idl / "app");
+  boost::filesystem::create_directories(idl / "lib");
+  std::string lib = write("share/qi/idl/lib/lib.idl.qi", "package lib\nstruct L\n  x : int\nend\n");
+  std::string other = write("share/qi/idl/app/other.idl.qi", "package app\nstruct O\n  m : Missing\nend\n");
+  write("share/qi/idl/app/app.idl.qi",
+            "package app\n"
+            "from lib import *\n"
+            "interface I\n"
+            "  fn f(l: L)\n"
+            "end\n");
+
+  qilang::PackageManagerPtr pm;
+  analyse(_dir, 1, &pm);
+  qilang::PackagePtr app = pm->package("app");
+  qilang::ParseResultPtr appFile = app->_contents.at(_dir + "/share/qi/idl/app/app.idl.qi");
+  qilang::ParseResultPtr otherFile = app->_contents.at(other);
+  qilang::CustomTypeExprNode* l = static_cast<qilang::CustomTypeExprNode*>(appFile->nodes(qilang::NodeType_CustomTypeExpr).at(0).get());
+  EXPECT_EQ(qilang::Symbol("L"), l->resolved_value);
+  ASSERT_EQ(2u, otherFile->messages().size());
+
+  //nothing changed: nothing is resolved again, diagnostics are not duplicated
+  l->resolved_value = qilang::Symbol("sentinel");
+  pm->anal();
+  EXPECT_EQ(qilang::Symbol("sentinel"), l->resolved_value);
+  EXPECT_EQ(2u, otherFile->messages().size());
+
+  //the exports of lib changed: app, which imports it, is resolved again
+  pm->parseFile(qilang::newFileReader(lib, "package lib\nstruct L\n  x : int\nend\nstruct Missing\n  y : int\nend\n"));
+  pm->anal();
+  EXPECT_EQ(qilang::Symbol("L"), l->resolved_value);
+  EXPECT_TRUE(otherFile->messages().empty());
+  EXPECT_FALSE(app->hasError());
+
+  //only other.idl.qi changed: app.idl.qi is left alone
+  l->resolved_value = qilang::Symbol("sentinel");
+  pm->parseFile(qilang::newFileReader(other, "package app\nstruct O\n  m : Unknown\nend\n"));
+  pm->anal();
+  EXPECT_EQ(qilang::Symbol("sentinel"), l->resolved_value);
+  otherFile = app->_contents.at(other);
+  ASSERT_EQ(2u, otherFile->messages().size());
+  EXPECT_TRUE(app->hasError());
+
+  //same content again: the file is not parsed again
+  EXPECT_EQ(otherFile, pm->parseFile(qilang::newFileReader(other, "package app\nstruct O\n  m : Unknown\nend\n")));
+}
+
+struct LocationDumper {
+  template <typename T>
+  void operator()(qilang::Node* parent, const boost::shared_ptr<T>& node)
+  {
+    const qilang::Location& l = static_cast<qilang::Node*>(node.get())->loc();
+    out << l.beg_line << ":" << l.beg_column << "-" << l.end_line << ":" << l.end_column << " ";
+  }
+
+  std::stringstream out;
+};
+
+static std::string dumpLocations(const qilang::NodePtrVector& ast)
+{
+  LocationDumper dumper;
+  qilang::walkNode(ast, dumper);
+  return dumper.out.str();
+}
+
+//reparse result must be the same as a full parse of its new source
+static void expectSameAsFullParse(const qilang::ParseResultPtr& pr)
+{
+  ASSERT_TRUE(pr->source);
+  std::string content = pr->source->content();
+  qilang::ParseResultPtr full = qilang::parse(qilang::newFileReader(pr->filename, content), false);
+  EXPECT_EQ(full->hasError(), pr->hasError());
+  EXPECT_EQ(qilang::formatAST(full->ast), qilang::formatAST(pr->ast));
+  EXPECT_EQ(dumpLocations(full->ast), dumpLocations(pr->ast));
+  EXPECT_EQ(full->boundaries.size(), pr->boundaries.size());
+}
+
+TEST(QiLangReparse, EditInsideDeclaration)
+{
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader("reparse1.idl.qi", someIdl), false);
+  ASSERT_FALSE(pr->hasError());
+  qilang::NodePtr package = pr->ast.at(0);
+  qilang::NodePtr point = pr->ast.at(2);
+
+  //"baz" -> "qux", only the interface is parsed again
+  EXPECT_EQ(1, qilang::reparse(pr, qilang::TextEdit(5, 6, 5, 9, "qux")));
+  EXPECT_NE(std::string::npos, pr->source->content().find("fn qux("));
+  EXPECT_EQ(package, pr->ast.at(0));
+  EXPECT_EQ(point, pr->ast.at(2));
+  expectSameAsFullParse(pr);
+}
+
+TEST(QiLangReparse, NewLinesMoveTheFollowingNodes)
+{
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader("reparse2.idl.qi", someIdl), false);
+  ASSERT_FALSE(pr->hasError());
+  qilang::NodePtr answer = pr->ast.at(3);
+  ASSERT_EQ(12, answer->loc().beg_line);
+
+  EXPECT_EQ(2, qilang::reparse(pr, qilang::TextEdit(8, 1, 8, 1, "struct Extra\n  z : int\nend\n")));
+  ASSERT_EQ(5u, pr->ast.size());
+  EXPECT_EQ(answer, pr->ast.at(4));
+  EXPECT_EQ(15, answer->loc().beg_line);
+  expectSameAsFullParse(pr);
+
+  //remove it, back to the original lines
+  EXPECT_EQ(1, qilang::reparse(pr, qilang::TextEdit(8, 1, 11, 1, "")));
+  EXPECT_EQ(12, answer->loc().beg_line);
+  expectSameAsFullParse(pr);
+}
+
+TEST(QiLangReparse, DocCommentBeforeDeclaration)
+{
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader("reparse3.idl.qi", someIdl), false);
+  ASSERT_FALSE(pr->hasError());
+
+  EXPECT_LE(0, qilang::reparse(pr, qilang::TextEdit(6, 1, 6, 1, "  //! new doc\n  fn other() -> int\n")));
+  expectSameAsFullParse(pr);
+  qilang::NodePtrVector fns = qilang::findNode(pr->ast, qilang::NodeType_FnDecl);
+  ASSERT_EQ(2u, fns.size());
+  EXPECT_EQ(" new doc\n", fns.at(1)->comment());
+
+  //a doc comment at the end of a declaration is not isolated from the next one
+  EXPECT_EQ(-1, qilang::reparse(pr, qilang::TextEdit(9, 4, 9, 4, " //! dangling")));
+  expectSameAsFullParse(pr);
+}
+
+TEST(QiLangReparse, ErrorsFallBackToFullParse)
+{
+  qilang::ParseResultPtr pr = qilang::parse(qilang::newFileReader("reparse4.idl.qi", someIdl), false);
+  ASSERT_FALSE(pr->hasError());
+
+  EXPECT_EQ(-1, qilang::reparse(pr, qilang::TextEdit(12, 16, 12, 18, "42 +")));
+  EXPECT_TRUE(pr->hasError());
+  EXPECT_TRUE(pr->ast.empty());
+
+  EXPECT_EQ(-1, qilang::reparse(pr, qilang::TextEdit(12, 16, 12, 20, "43")));
+  EXPECT_FALSE(pr->hasError());
+  expectSameAsFullParse(pr);
+
+  EXPECT_THROW(qilang::reparse(pr, qilang::TextEdit(40, 1, 40, 2, "x")), std::runtime_error);
+}
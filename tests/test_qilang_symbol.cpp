@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <qilang/symbol.hpp>
+#include <qilang/node.hpp>
+
+TEST(QiLangSymbol, Interning)
+{
+  qilang::Symbol a("foo.Bar");
+  qilang::Symbol b(std::string("foo.Bar"));
+  qilang::Symbol c("foo.Baz");
+
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(a.id(), b.id());
+  EXPECT_NE(a, c);
+  EXPECT_EQ("foo.Bar", a.str());
+  EXPECT_EQ(&a.str(), &b.str());
+  EXPECT_EQ(a, qilang::Symbol("foo.Bar.Baz", 7));
+}
+
+TEST(QiLangSymbol, Empty)
+{
+  qilang::Symbol e;
+  EXPECT_TRUE(e.empty());
+  EXPECT_EQ(0u, e.id());
+  EXPECT_EQ(e, qilang::Symbol(""));
+  EXPECT_EQ("", e.str());
+  EXPECT_FALSE(qilang::Symbol("x").empty());
+}
+
+TEST(QiLangSymbol, OrderOfTheStrings)
+{
+  //interned in the reverse order
+  qilang::Symbol z("order.z");
+  qilang::Symbol a("order.a");
+  EXPECT_TRUE(a < z);
+  EXPECT_FALSE(z < a);
+  EXPECT_FALSE(a < qilang::Symbol("order.a"));
+  EXPECT_TRUE(qilang::Symbol() < a);
+}
+
+TEST(QiLangSymbol, ManySymbolsFromManyThreads)
+{
+  const int count = 20000;
+  std::vector<std::thread> threads;
+  std::vector<std::vector<qilang::Symbol> > res(4);
+  for (unsigned t = 0; t < res.size(); ++t) {
+    threads.push_back(std::thread([&res, t, count]() {
+      for (int i = 0; i < count; ++i)
+        res[t].push_back(qilang::Symbol("sym" + std::to_string(i)));
+    }));
+  }
+  for (unsigned t = 0; t < threads.size(); ++t)
+    threads[t].join();
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(res[0][i], res[1][i]);
+    EXPECT_EQ(res[0][i], res[3][i]);
+    ASSERT_EQ("sym" + std::to_string(i), res[2][i].str());
+  }
+}
+
+TEST(QiLangSymbol, LocationFilename)
+{
+  qilang::Location loc(1, 2, 1, 5, std::string("/tmp/foo.idl.qi"));
+  qilang::Location other(3, 1, 3, 2, qilang::Symbol("/tmp/foo.idl.qi"));
+  EXPECT_EQ(loc.file, other.file);
+  EXPECT_EQ("/tmp/foo.idl.qi", loc.filename());
+  EXPECT_TRUE(qilang::Location().file.empty());
+}
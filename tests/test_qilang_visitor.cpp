@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <qilang/parser.hpp>
+#include <qilang/visitor.hpp>
+
+static const char* someIdl =
+    "package foo\n"
+    "from bar import Baz\n"
+    "\n"
+    "interface Iface\n"
+    "  fn f(a: int, b: Vec<Baz>) -> Map<str, Baz>\n"
+    "  fn g()\n"
+    "  sig changed(v: float)\n"
+    "end\n"
+    "\n"
+    "struct Point\n"
+    "  x, y : float\n"
+    "end\n";
+
+static qilang::ParseResultPtr parseSome()
+{
+  std::stringstream ss(someIdl);
+  return qilang::parse(qilang::newFileReader(&ss, "foo.idl.qi"));
+}
+
+struct CountFn {
+  CountFn() : fn(0), other(0) {}
+  void operator()(qilang::FnDeclNode* node) { ++fn; }
+  template <typename T>
+  void operator()(T* node) { ++other; }
+  int fn;
+  int other;
+};
+
+struct CountAll {
+  CountAll() : count(0), toplevel(0) {}
+  template <typename T>
+  void operator()(qilang::Node* parent, const boost::shared_ptr<T>& node) {
+    ++count;
+    if (!parent)
+      ++toplevel;
+  }
+  int count;
+  int toplevel;
+};
+
+static void countVisitor(const qilang::NodePtr& parent, const qilang::NodePtr& node, int* count)
+{
+  ++*count;
+}
+
+TEST(QiLangVisitor, DispatchNode)
+{
+  qilang::ParseResultPtr pr = parseSome();
+  ASSERT_FALSE(pr->hasError());
+
+  CountFn count;
+  qilang::InterfaceDeclNode* iface = static_cast<qilang::InterfaceDeclNode*>(pr->ast.at(2).get());
+  for (unsigned i = 0; i < iface->values.size(); ++i)
+    qilang::dispatchNode(iface->values.at(i).get(), count);
+  EXPECT_EQ(2, count.fn);
+  EXPECT_EQ(1, count.other);
+}
+
+TEST(QiLangVisitor, WalkNodeMatchesDefaultNodeVisitor)
+{
+  qilang::ParseResultPtr pr = parseSome();
+  ASSERT_FALSE(pr->hasError());
+
+  CountAll all;
+  qilang::walkNode(pr->ast, all);
+  int expected = 0;
+  qilang::visitNode(pr->ast, boost::bind<void>(&countVisitor, _1, _2, &expected));
+  EXPECT_EQ(expected, all.count);
+  EXPECT_EQ(4, all.toplevel);
+}
+
+TEST(QiLangVisitor, FindNodes)
+{
+  qilang::ParseResultPtr pr = parseSome();
+  ASSERT_FALSE(pr->hasError());
+
+  std::vector< boost::shared_ptr<qilang::FnDeclNode> > typed = qilang::findNodes<qilang::FnDeclNode>(pr->ast);
+  qilang::NodePtrVector untyped = qilang::findNode(pr->ast, qilang::NodeType_FnDecl);
+  ASSERT_EQ(2u, typed.size());
+  ASSERT_EQ(untyped.size(), typed.size());
+  EXPECT_EQ("f", typed.at(0)->name);
+  EXPECT_EQ("g", typed.at(1)->name);
+  EXPECT_EQ(untyped.at(0).get(), typed.at(0).get());
+
+  qilang::CustomTypeExprNodePtrVector customs = qilang::findNodes<qilang::CustomTypeExprNode>(pr->ast);
+  ASSERT_EQ(2u, customs.size());
+  EXPECT_EQ("Baz", customs.at(0)->value.str());
+  //x and y share their type, found once per field
+  EXPECT_EQ(qilang::findNode(pr->ast, qilang::NodeKind_TypeExpr).size(), 9u);
+}
+
+TEST(QiLangVisitor, CallExprHasItsOwnType)
+{
+  qilang::ExprNodePtrVector args;
+  args.push_back(boost::make_shared<qilang::VarExprNode>("x", qilang::Location()));
+  qilang::NodePtrVector ast;
+  ast.push_back(boost::make_shared<qilang::CallExprNode>("f", args, qilang::Location()));
+
+  EXPECT_EQ(qilang::NodeType_CallExpr, ast.at(0)->type());
+  EXPECT_TRUE(qilang::findNode(ast, qilang::NodeType_UOpExpr).empty());
+  ASSERT_EQ(1u, qilang::findNodes<qilang::CallExprNode>(ast).size());
+  ASSERT_EQ(1u, qilang::findNodes<qilang::VarExprNode>(ast).size());
+}
+
+TEST(QiLangVisitor, ParseResultIndex)
+{
+  qilang::ParseResultPtr pr = parseSome();
+  ASSERT_FALSE(pr->hasError());
+
+  for (int t = qilang::NodeType_Package; t <= qilang::NodeType_CallExpr; ++t) {
+    qilang::NodeType type = static_cast<qilang::NodeType>(t);
+    EXPECT_EQ(qilang::findNode(pr->ast, type), pr->nodes(type)) << "type " << t;
+  }
+  for (int k = qilang::NodeKind_Expr; k <= qilang::NodeKind_Stmt; ++k) {
+    qilang::NodeKind kind = static_cast<qilang::NodeKind>(k);
+    EXPECT_EQ(qilang::findNode(pr->ast, kind), pr->nodes(kind)) << "kind " << k;
+  }
+  EXPECT_EQ(2u, pr->nodes(qilang::NodeType_FnDecl).size());
+
+  // synthesized toplevel nodes, as done for services
+  qilang::NodePtrVector ast;
+  ast.push_back(boost::make_shared<qilang::PackageNode>("bar", qilang::Location()));
+  pr->ast = ast;
+  EXPECT_TRUE(pr->nodes(qilang::NodeType_FnDecl).empty());
+  ASSERT_EQ(1u, pr->nodes(qilang::NodeType_Package).size());
+  EXPECT_EQ(pr->ast.at(0), pr->nodes(qilang::NodeType_Package).at(0));
+
+  // nested nodes need an explicit invalidation
+  qilang::DeclNodePtrVector decls;
+  pr->ast.push_back(boost::make_shared<qilang::InterfaceDeclNode>("Iface", decls, qilang::Location()));
+  EXPECT_EQ(1u, pr->nodes(qilang::NodeType_InterfaceDecl).size());
+  qilang::InterfaceDeclNode* iface = static_cast<qilang::InterfaceDeclNode*>(pr->ast.back().get());
+  iface->values.push_back(boost::make_shared<qilang::FnDeclNode>("h", qilang::ParamFieldDeclNodePtrVector(), qilang::Location()));
+  pr->invalidateIndex();
+  EXPECT_EQ(1u, pr->nodes(qilang::NodeType_FnDecl).size());
+}
@@ -0,0 +1,48 @@
+#ifndef QILANG_TESTS_TMPDIR_FIXTURE_HPP
+#define QILANG_TESTS_TMPDIR_FIXTURE_HPP
+
+#include <gtest/gtest.h>
+#include <fstream>
+#include <string>
+#include <boost/filesystem.hpp>
+#include <qi/os.hpp>
+
+/** Tests working in a temporary directory, _dir, removed after each test.
+ *  write() creates files in _root (_dir unless the test changes it).
+ */
+class TmpDirFixture: public ::testing::Test
+{
+protected:
+  explicit TmpDirFixture(const std::string& name)
+    : _name(name)
+  {}
+
+  void SetUp() override
+  {
+    _dir = qi::os::mktmpdir(_name.c_str());
+    _root = _dir;
+  }
+
+  void TearDown() override
+  {
+    boost::filesystem::remove_all(_dir);
+  }
+
+  //! write a file, relative to _root or absolute, and its directories
+  std::string write(const std::string& name, const std::string& content)
+  {
+    boost::filesystem::path path(name);
+    if (!path.is_absolute())
+      path = boost::filesystem::path(_root) / name;
+    boost::filesystem::create_directories(path.parent_path());
+    std::ofstream os(path.string().c_str(), std::ios::out | std::ios::binary);
+    os << content;
+    return path.string();
+  }
+
+  std::string _name;
+  std::string _dir;
+  std::string _root;
+};
+
+#endif // QILANG_TESTS_TMPDIR_FIXTURE_HPP